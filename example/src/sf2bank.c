@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fluidliter.h"
+
+/* compiles a SoundFont into a bank that fluid_synth_sfload() loads without
+ * parsing it, see fluid_bank_compile(); the bank only loads with a library
+ * built with the same options as this tool */
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        printf("usage: sf2bank in.sf2 out.bank\n");
+        return 2;
+    }
+    if (fluid_bank_compile(argv[1], argv[2]) != FLUID_OK) {
+        printf("sf2bank: failed to compile %s\n", argv[1]);
+        return 1;
+    }
+    printf("sf2bank: %s compiled to %s\n", argv[1], argv[2]);
+    return 0;
+}
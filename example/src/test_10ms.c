@@ -52,10 +52,10 @@ int main(int argc, char *argv[])
             if (_PLAYING(vt)) {
                 // Test Loop sample 9176 - 10515 GMGSx.sf2
                 unsigned int start = vt->sample->start;
-                int phasei = fluid_phase_index(vt->phase);
+                int phasei = fluid_phase_index(_DSP(vt, phase));
                 int diff = phasei-start;
                 int diff_per = diff/(j+1);
-                int phasef = fluid_phase_fract(vt->phase);
+                int phasef = fluid_phase_fract(_DSP(vt, phase));
                 printf("key:%d, diff:%d, diff_per:%d, phase_index:%d, phase_fract:%x\n", 
                     vt->key, diff, diff_per, phasei, phasef);
             }
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fluidliter.h"
+#include "fluid_sfont.h"
+#include "fluid_synth.h"
+#include "fluid_bank.h"
+
+#define BLOCKS 400
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* notes on the piano and the boomwhackers, loaded from the files given */
+static void play(const char *filename, const char *other, unsigned int cache_size,
+                 float *out) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 32,
+                                           .midi_channels = 2,
+                                           .sample_cache_size = cache_size);
+    int id, other_id, b, chan;
+
+    assert(synth != NULL);
+    id = fluid_synth_sfload(synth, filename, 1);
+    other_id = fluid_synth_sfload(synth, other, 1);
+    assert(id != FLUID_FAILED && other_id != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, id, 0, 0);
+    fluid_synth_program_select(synth, 1, other_id, 0, 0);
+
+    for (b = 0; b < BLOCKS; b++) {
+        chan = (b / 20) % 2;
+        if (b % 20 == 0) fluid_synth_noteon(synth, chan, 36 + (b * 7) % 48, 100);
+        if (b % 20 == 10) fluid_synth_noteoff(synth, chan, 36 + ((b - 10) * 7) % 48);
+        if (b % 100 == 50) fluid_synth_cc(synth, 0, 1, b % 128);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+
+    assert(fluid_synth_sfunload(synth, other_id, 1) == FLUID_OK);
+    delete_fluid_synth(synth);
+}
+
+/* a copy of the bank with 'len' bytes at 'off' overwritten, or cut at
+ * 'off' if 'bytes' is NULL */
+static void corrupt(const char *bank, const char *copy, long off, const void *bytes,
+                    size_t len) {
+    FILE *in = fopen(bank, "rb"), *out = fopen(copy, "wb");
+    long pos = 0;
+    int c;
+
+    assert(in != NULL && out != NULL);
+    while ((c = fgetc(in)) != EOF && (bytes != NULL || pos < off)) {
+        if (bytes != NULL && pos >= off && pos < off + (long)len) {
+            c = ((const unsigned char *)bytes)[pos - off];
+        }
+        fputc(c, out);
+        pos++;
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/* the same presets, pairs and samples */
+static void same_tables(fluid_sfont_t *a, fluid_sfont_t *b) {
+    fluid_preset_t *p, *q;
+    int i, k;
+
+    assert(a->sample_count == b->sample_count);
+    for (p = a->preset, q = b->preset; p != NULL; p = p->next, q = q->next) {
+        assert(q != NULL);
+        assert(strcmp(p->name, q->name) == 0 && p->bank == q->bank && p->num == q->num);
+        assert(q->zone == NULL && q->global_zone == NULL && q->sfont == b);
+        assert(p->pair_count == q->pair_count);
+        assert(memcmp(p->key_first, q->key_first, sizeof(p->key_first)) == 0);
+        for (i = 0; i < p->pair_count; i++) {
+            fluid_zone_pair_t *x = &p->pairs[i], *y = &q->pairs[i];
+            assert(x->sample->idx_in_sfont == y->sample->idx_in_sfont);
+            assert(y->sample->sfont == b);
+            assert(x->gen_count == y->gen_count);
+            for (k = 0; k < x->gen_count; k++) {
+                assert(x->gens[k].num == y->gens[k].num && x->gens[k].val == y->gens[k].val);
+            }
+            assert(x->inst_mod_count == y->inst_mod_count);
+            assert(x->preset_mod_count == y->preset_mod_count);
+            for (k = 0; k < x->inst_mod_count + x->preset_mod_count; k++) {
+                assert(fluid_mod_test_identity(x->mods[k], y->mods[k]));
+                assert(x->mods[k]->amount == y->mods[k]->amount);
+            }
+        }
+    }
+    assert(q == NULL);
+}
+
+/* a compiled bank plays as the SoundFont it was compiled from, paged in or
+ * not, and a bank of another layout is refused */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    char *other = "example/sf_/Boomwhacker.sf2";
+    const char *bank = "tmp_bank.flbk", *other_bank = "tmp_bank2.flbk";
+    float *ref = calloc(2 * LEN, sizeof(float)), *out = calloc(2 * LEN, sizeof(float));
+    fluid_fileapi_t *fapi = fluid_get_default_fileapi();
+    fluid_sfont_t *sfont, *compiled;
+    fluid_bank_header_t header;
+    double t;
+    FILE *file;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    assert(fluid_bank_compile(filename, bank) == FLUID_OK);
+    assert(fluid_bank_compile(other, other_bank) == FLUID_OK);
+    assert(fluid_bank_compile("no_such_file.sf2", "tmp_bank3.flbk") == FLUID_FAILED);
+    assert(fluid_bank_is_compiled(bank, fapi) && !fluid_bank_is_compiled(filename, fapi));
+
+    t = now_ms();
+    sfont = fluid_soundfont_load(fapi, other);
+    printf("bank compile: SoundFont loaded in %.3f ms, ", now_ms() - t);
+    t = now_ms();
+    compiled = fluid_soundfont_load(fapi, other_bank);
+    printf("compiled bank in %.3f ms\n", now_ms() - t);
+    assert(sfont != NULL && compiled != NULL && compiled->image != NULL);
+    assert(compiled->samplesize == sfont->samplesize);
+    assert(memcmp(compiled->sampledata, sfont->sampledata, sfont->samplesize) == 0);
+    same_tables(sfont, compiled);
+    delete_fluid_sfont(sfont);
+    delete_fluid_sfont(compiled);
+
+    play(filename, other, 0, ref);
+    play(bank, other_bank, 0, out);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+
+    /* its samples are paged in from the bank */
+    memset(out, 0, 2 * LEN * sizeof(float));
+    play(bank, other_bank, 1, out);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+
+    /* or streamed from it */
+    compiled = fluid_soundfont_load_streamed(fapi, other_bank, 10);
+    assert(compiled != NULL && compiled->image != NULL && compiled->sampledata == NULL);
+    delete_fluid_sfont(compiled);
+
+    /* compiled from a compiled bank */
+    assert(fluid_bank_compile(bank, other_bank) == FLUID_OK);
+    memset(out, 0, 2 * LEN * sizeof(float));
+    play(other_bank, other, 0, out);
+    play(filename, other, 0, ref);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+
+    /* corrupt or cut short: refused, the pointers the loader sets aren't
+     * read from the file */
+    {
+        const char *copy = "tmp_bank3.flbk";
+        fluid_preset_t raw, *p;
+        uint32_t big = 0xffff, value;
+        char junk[sizeof(void *)];
+        int count = 0;
+
+        file = fopen(bank, "rb");
+        assert(file != NULL && fread(&header, sizeof(header), 1, file) == 1);
+        fseek(file, header.presets, SEEK_SET);
+        assert(fread(&raw, sizeof(raw), 1, file) == 1);
+        fclose(file);
+        assert(raw.key_first[128] > 0);
+
+        corrupt(bank, copy, header.image_size / 2, NULL, 0);
+        assert(fluid_soundfont_load(fapi, copy) == NULL);
+        corrupt(bank, copy, offsetof(fluid_bank_header_t, sample_count), &big, sizeof(big));
+        assert(fluid_soundfont_load(fapi, copy) == NULL);
+        value = header.reloc;
+        corrupt(bank, copy, offsetof(fluid_bank_header_t, presets), &value, sizeof(value));
+        assert(fluid_soundfont_load(fapi, copy) == NULL);
+        value = header.image_size;
+        corrupt(bank, copy, header.reloc, &value, sizeof(value));
+        assert(fluid_soundfont_load(fapi, copy) == NULL);
+        corrupt(bank, copy, (long)(uintptr_t)raw.key_pairs, &big, sizeof(uint16_t));
+        assert(fluid_soundfont_load(fapi, copy) == NULL);
+
+        memset(junk, 0x41, sizeof(junk));
+        corrupt(bank, copy,
+                header.presets + (header.preset_count - 1) * sizeof(fluid_preset_t) +
+                    offsetof(fluid_preset_t, next),
+                junk, sizeof(junk));
+        compiled = fluid_soundfont_load(fapi, copy);
+        assert(compiled != NULL);
+        for (p = compiled->preset; p != NULL; p = p->next) count++;
+        assert(count == (int)header.preset_count);
+        delete_fluid_sfont(compiled);
+        remove(copy);
+    }
+
+    /* built by a library with another layout */
+    file = fopen(other_bank, "r+b");
+    assert(file != NULL);
+    assert(fread(&header, sizeof(header), 1, file) == 1);
+    header.layout[2] ^= 12;
+    fseek(file, 0, SEEK_SET);
+    assert(fwrite(&header, sizeof(header), 1, file) == 1);
+    fclose(file);
+    assert(fluid_soundfont_load(fapi, other_bank) == NULL);
+
+    remove(bank);
+    remove(other_bank);
+    free(ref);
+    free(out);
+    printf("test_bank_compile passed\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define SAMPLE_RATE 44100
+#define NUM_FRAMES (SAMPLE_RATE * 2)
+#define NOTE_FRAMES (SAMPLE_RATE / 2)
+
+typedef struct {
+    int attack;  /* first frame at half the peak level */
+    int release; /* last frame above 1% of the peak level */
+    double energy;
+} envelope_t;
+
+/* one note, held for NOTE_FRAMES, then released */
+static envelope_t render_note(const char *filename, int block_size) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .block_size = block_size);
+    float *buf = calloc(sizeof(float), NUM_FRAMES);
+    envelope_t env = {-1, -1, 0.0};
+    float peak = 0.0f;
+    int sfont, i;
+
+    assert(synth != NULL);
+    assert(fluid_synth_get_internal_bufsize(synth) == (block_size ? block_size : 64));
+
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+
+    fluid_synth_noteon(synth, 0, 60, 100);
+    fluid_synth_render_float(synth, NOTE_FRAMES, buf, 1);
+    fluid_synth_noteoff(synth, 0, 60);
+    fluid_synth_render_float(synth, NUM_FRAMES - NOTE_FRAMES, buf + NOTE_FRAMES, 1);
+
+    for (i = 0; i < NUM_FRAMES; i++) {
+        if (fabsf(buf[i]) > peak) peak = fabsf(buf[i]);
+        env.energy += (double)buf[i] * buf[i];
+    }
+    for (i = 0; i < NUM_FRAMES; i++) {
+        if (env.attack < 0 && fabsf(buf[i]) >= 0.5f * peak) env.attack = i;
+        if (fabsf(buf[i]) >= 0.01f * peak) env.release = i;
+    }
+
+    delete_fluid_synth(synth);
+    free(buf);
+    return env;
+}
+
+static void check_timing(const char *filename) {
+    static const int sizes[] = {16, 32, 128, 256, 1024};
+    envelope_t ref = render_note(filename, 0);
+    int i;
+
+    printf("block 64: attack %d, release %d\n", ref.attack, ref.release);
+    assert(ref.attack >= 0 && ref.release > NOTE_FRAMES);
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(sizes); i++) {
+        envelope_t env = render_note(filename, sizes[i]);
+        int tolerance = sizes[i] + 64;
+
+        printf("block %d: attack %d, release %d, energy %.3f\n", sizes[i],
+               env.attack, env.release, env.energy / ref.energy);
+        /* the envelopes advance once per block, they may be off by a block */
+        assert(abs(env.attack - ref.attack) <= tolerance);
+        assert(abs(env.release - ref.release) <= tolerance);
+        assert(fabs(env.energy / ref.energy - 1.0) < 0.05);
+    }
+}
+
+/* 64 voices with reverb and chorus, the time to render one second */
+static void benchmark(const char *filename) {
+    static const int sizes[] = {16, 32, 64, 256, 1024};
+    float *buf = calloc(sizeof(float), SAMPLE_RATE * 2);
+    int i, n;
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(sizes); i++) {
+        fluid_synth_t *synth = NEW_FLUID_SYNTH(.polyphony = 64, .with_chorus = true,
+                                               .block_size = sizes[i]);
+        int sfont = fluid_synth_sfload(synth, filename, 1);
+        clock_t start;
+
+        fluid_synth_program_select(synth, 0, sfont, 0, 16);
+        for (n = 0; n < 64; n++) {
+            fluid_synth_noteon(synth, 0, 30 + n, 100);
+        }
+        start = clock();
+        fluid_synth_render_float(synth, SAMPLE_RATE, buf, 2);
+        printf("block %4d: latency %5.2f ms, 1 s rendered in %.1f ms\n", sizes[i],
+               1000.0 * sizes[i] / SAMPLE_RATE,
+               1000.0 * (clock() - start) / CLOCKS_PER_SEC);
+        delete_fluid_synth(synth);
+    }
+    free(buf);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    fluid_synth_t *synth;
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    /* out of range sizes are clamped */
+    synth = NEW_FLUID_SYNTH(.block_size = 3);
+    assert(fluid_synth_get_internal_bufsize(synth) == FLUID_MIN_BUFSIZE);
+    delete_fluid_synth(synth);
+    synth = NEW_FLUID_SYNTH(.block_size = 1 << 20);
+    assert(fluid_synth_get_internal_bufsize(synth) == FLUID_MAX_BUFSIZE);
+    delete_fluid_synth(synth);
+
+    check_timing(filename);
+    benchmark(filename);
+
+    printf("test_block_size passed\n");
+    return 0;
+}
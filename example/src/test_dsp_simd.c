@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_dsp_simd.h"
+
+#define NUM_FRAMES 22050
+
+static const int keys[] = {24, 60, 67, 96, 108};
+
+/* render a few notes across the keyboard, so both up and down pitched
+ * samples and looped sustain are covered */
+static float *render(const char *filename, int interp, int level) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.polyphony = 16);
+    float *buf = calloc(sizeof(float), NUM_FRAMES * 2);
+    int sfont, i;
+
+    assert(fluid_dsp_simd_config(level) <= (level < 0 ? FLUID_DSP_SIMD_NEON : level));
+
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    fluid_synth_set_interp_method(synth, -1, interp);
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(keys); i++) {
+        fluid_synth_noteon(synth, 0, keys[i], 100);
+    }
+    fluid_synth_pitch_bend(synth, 0, 8192 + 1234);
+    fluid_synth_render_float(synth, NUM_FRAMES / 2, buf, 2);
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(keys); i++) {
+        fluid_synth_noteoff(synth, 0, keys[i]);
+    }
+    fluid_synth_render_float(synth, NUM_FRAMES / 2, buf + NUM_FRAMES, 2);
+
+    delete_fluid_synth(synth);
+    return buf;
+}
+
+static void compare(const char *filename, int interp) {
+    float *ref = render(filename, interp, FLUID_DSP_SIMD_SCALAR);
+    float *vec = render(filename, interp, FLUID_DSP_SIMD_AUTO);
+    double max_diff = 0.0, energy = 0.0;
+    int i;
+
+    for (i = 0; i < NUM_FRAMES * 2; i++) {
+        double d = fabs((double)ref[i] - vec[i]);
+        if (d > max_diff) max_diff = d;
+        energy += fabs(ref[i]);
+    }
+    printf("interp %d, simd level %d: max diff %g\n", interp,
+           fluid_dsp_simd_get_level(), max_diff);
+
+    /* the per lane amplitude ramp rounds differently from the scalar sum */
+    assert(energy > 0.0);
+    assert(max_diff < 1e-5);
+
+    free(ref);
+    free(vec);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    /* keep the library initialised across the level switches below */
+    fluid_synth_t *keep = NEW_FLUID_SYNTH();
+
+    printf("best simd level: %d\n", fluid_dsp_simd_config(FLUID_DSP_SIMD_AUTO));
+#ifdef FLUID_DSP_SCALAR
+    assert(fluid_dsp_simd_get_level() == FLUID_DSP_SIMD_SCALAR);
+#endif
+
+    compare(filename, FLUID_INTERP_NONE);
+    compare(filename, FLUID_INTERP_LINEAR);
+    compare(filename, FLUID_INTERP_4THORDER);
+#ifdef ENABLE_7th_DSP
+    compare(filename, FLUID_INTERP_7THORDER);
+#endif
+    compare(filename, FLUID_INTERP_SINC8);
+    compare(filename, FLUID_INTERP_SINC32);
+
+#if defined(FLUID_DSP_SIMD_X86)
+    /* every x86 level on its own, the AVX2 kernels fall back to SSE2 for
+     * the tail of a block */
+    if (fluid_dsp_simd_config(FLUID_DSP_SIMD_AVX2) == FLUID_DSP_SIMD_AVX2) {
+        static const int interps[] = {FLUID_INTERP_4THORDER, FLUID_INTERP_SINC16};
+        for (int k = 0; k < 2; k++) {
+            float *ref = render(filename, interps[k], FLUID_DSP_SIMD_SSE2);
+            float *vec = render(filename, interps[k], FLUID_DSP_SIMD_AVX2);
+            for (int i = 0; i < NUM_FRAMES * 2; i++) {
+                assert(fabs((double)ref[i] - vec[i]) < 1e-5);
+            }
+            free(ref);
+            free(vec);
+        }
+    }
+#endif
+
+    fluid_dsp_simd_config(FLUID_DSP_SIMD_AUTO);
+    delete_fluid_synth(keep);
+    return 0;
+}
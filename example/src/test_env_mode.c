@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_conv.h"
+
+#define SAMPLE_RATE 44100
+#define NUM_FRAMES (SAMPLE_RATE * 2)
+#define NOTE_FRAMES (SAMPLE_RATE / 2)
+
+typedef struct {
+    int onset;   /* first frame that is not silent */
+    int delay;   /* the volume envelope delay of the voice, in samples */
+    int release; /* last frame above 1% of the peak level */
+    double energy;
+} envelope_t;
+
+/* one note, with 'delay_tc' timecents added to the envelope delay, held
+ * for NOTE_FRAMES, then released */
+static envelope_t render_note(const char *filename, int env_mode, float delay_tc) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .env_mode = env_mode);
+    float *buf = calloc(sizeof(float), NUM_FRAMES);
+    envelope_t env = {-1, -1, -1, 0.0};
+    float peak = 0.0f;
+    int sfont, i;
+
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    fluid_synth_set_gen2(synth, 0, GEN_VOLENVDELAY, delay_tc, 0);
+
+    fluid_synth_noteon(synth, 0, 60, 100);
+    for (i = 0; i < synth->polyphony; i++) {
+        fluid_voice_t *voice = synth->voice[i];
+        if (fluid_voice_is_playing(voice)) {
+            env.delay = (int)(SAMPLE_RATE * fluid_tc2sec_delay(_GEN(voice, GEN_VOLENVDELAY)));
+        }
+    }
+    fluid_synth_render_float(synth, NOTE_FRAMES, buf, 1);
+    fluid_synth_noteoff(synth, 0, 60);
+    fluid_synth_render_float(synth, NUM_FRAMES - NOTE_FRAMES, buf + NOTE_FRAMES, 1);
+
+    for (i = 0; i < NUM_FRAMES; i++) {
+        if (fabsf(buf[i]) > peak) peak = fabsf(buf[i]);
+        env.energy += (double)buf[i] * buf[i];
+    }
+    for (i = 0; i < NUM_FRAMES; i++) {
+        if (env.onset < 0 && buf[i] != 0.0f) env.onset = i;
+        if (fabsf(buf[i]) >= 0.01f * peak) env.release = i;
+    }
+
+    delete_fluid_synth(synth);
+    free(buf);
+    return env;
+}
+
+static void check_envelope(const char *filename) {
+    /* delays of about 1000 and 2345 samples, off the block grid */
+    static const float delays[] = {5449.0f, 6925.0f};
+    int i;
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(delays); i++) {
+        envelope_t block = render_note(filename, FLUID_ENV_BLOCK, delays[i]);
+        envelope_t sample = render_note(filename, FLUID_ENV_SAMPLE, delays[i]);
+
+        printf("delay %d: block onset %d, release %d; sample onset %d, release %d, "
+               "energy %.3f\n", sample.delay, block.onset, block.release, sample.onset,
+               sample.release, sample.energy / block.energy);
+
+        /* the block envelope starts the note on the block grid, the sample
+         * envelope on the sample that ends the delay */
+        assert(block.onset % FLUID_BUFSIZE <= 1);
+        assert(block.onset / FLUID_BUFSIZE == block.delay / FLUID_BUFSIZE);
+        assert(abs(sample.onset - sample.delay) <= 1);
+
+        /* the rest of the envelope is the same, within a block */
+        assert(abs(sample.release - block.release) <= 2 * FLUID_BUFSIZE);
+        assert(fabs(sample.energy / block.energy - 1.0) < 0.05);
+    }
+}
+
+/* 64 voices with reverb, the time to render one second */
+static void benchmark(const char *filename) {
+    static const int modes[] = {FLUID_ENV_BLOCK, FLUID_ENV_SAMPLE};
+    float *buf = calloc(sizeof(float), SAMPLE_RATE * 2);
+    int i, n;
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(modes); i++) {
+        fluid_synth_t *synth = NEW_FLUID_SYNTH(.polyphony = 64, .env_mode = modes[i]);
+        int sfont = fluid_synth_sfload(synth, filename, 1);
+        clock_t start;
+
+        fluid_synth_program_select(synth, 0, sfont, 0, 16);
+        for (n = 0; n < 64; n++) {
+            fluid_synth_noteon(synth, 0, 30 + n, 100);
+        }
+        start = clock();
+        fluid_synth_render_float(synth, SAMPLE_RATE, buf, 2);
+        printf("%s envelopes: 1 s rendered in %.1f ms\n",
+               modes[i] == FLUID_ENV_SAMPLE ? "sample" : "block",
+               1000.0 * (clock() - start) / CLOCKS_PER_SEC);
+        delete_fluid_synth(synth);
+    }
+    free(buf);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+#ifdef WITH_FIXED
+    /* FLUID_ENV_SAMPLE falls back to block envelopes */
+    printf("test_env_mode: no sample envelopes with WITH_FIXED\n");
+#else
+    check_envelope(filename);
+    benchmark(filename);
+#endif
+
+    printf("test_env_mode passed\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_event_ring.h"
+#include "fluid_midi.h"
+
+#define NUM_EVENTS 200000
+#define NUM_PRODUCERS 4
+
+/* one thread: push and pop alternate, the ring fills up and drains */
+static void check_single_thread(void) {
+    fluid_event_ring_t *ring = new_fluid_event_ring(5, 0);
+    fluid_synth_event_t event = {0, NOTE_ON, 0, 0, 0};
+    int i, n = 0;
+
+    assert(ring != NULL);
+    for (i = 0; i < 8; i++) {
+        event.param1 = i;
+        assert(fluid_event_ring_push(ring, &event) == FLUID_OK);
+    }
+    /* rounded up to 8 */
+    assert(fluid_event_ring_push(ring, &event) == FLUID_FAILED);
+    assert(fluid_event_ring_overflows(ring) == 1);
+
+    while (fluid_event_ring_pop(ring, &event)) {
+        assert(event.param1 == n++);
+    }
+    assert(n == 8);
+
+    for (i = 0; i < 100; i++) {
+        event.param1 = i;
+        assert(fluid_event_ring_push(ring, &event) == FLUID_OK);
+        assert(fluid_event_ring_pop(ring, &event) == 1);
+        assert(event.param1 == i);
+    }
+    assert(fluid_event_ring_pop(ring, &event) == 0);
+    delete_fluid_event_ring(ring);
+}
+
+#ifdef WITH_THREADS
+#include <pthread.h>
+#include <sched.h>
+
+typedef struct {
+    fluid_event_ring_t *ring;
+    int id;
+} producer_t;
+
+/* pushes NUM_EVENTS numbered messages, retrying while the ring is full */
+static void *produce(void *arg) {
+    producer_t *producer = arg;
+    fluid_synth_event_t event = {0, CONTROL_CHANGE, 0, 0, 0};
+    int i;
+
+    event.chan = (unsigned char)producer->id;
+    for (i = 0; i < NUM_EVENTS; i++) {
+        event.param1 = i;
+        event.param2 = ~i;
+        while (fluid_event_ring_push(producer->ring, &event) != FLUID_OK) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/* every message arrives once, in the order of its producer */
+static void check_threads(int nproducers) {
+    fluid_event_ring_t *ring = new_fluid_event_ring(64, nproducers > 1);
+    producer_t producers[NUM_PRODUCERS];
+    pthread_t threads[NUM_PRODUCERS];
+    int next[NUM_PRODUCERS] = {0};
+    fluid_synth_event_t event;
+    int i, received = 0;
+
+    for (i = 0; i < nproducers; i++) {
+        producers[i].ring = ring;
+        producers[i].id = i;
+        pthread_create(&threads[i], NULL, produce, &producers[i]);
+    }
+
+    while (received < nproducers * NUM_EVENTS) {
+        if (!fluid_event_ring_pop(ring, &event)) {
+            sched_yield();
+            continue;
+        }
+        assert(event.chan < nproducers);
+        assert(event.param1 == next[event.chan]);
+        assert(event.param2 == ~event.param1);
+        next[event.chan]++;
+        received++;
+    }
+
+    for (i = 0; i < nproducers; i++) {
+        pthread_join(threads[i], NULL);
+        assert(next[i] == NUM_EVENTS);
+    }
+    assert(fluid_event_ring_pop(ring, &event) == 0);
+    printf("%d producer(s): %d messages, %u times full\n", nproducers, received,
+           fluid_event_ring_overflows(ring));
+    delete_fluid_event_ring(ring);
+}
+#endif
+
+/* posted messages play at the start of the next block */
+static void check_synth(const char *filename) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .event_ring_size = 4);
+    float buf[2 * FLUID_BUFSIZE];
+    int sfont, i, val;
+
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+
+    assert(fluid_synth_post_cc(synth, 0, 7, 90) == FLUID_OK);
+    assert(fluid_synth_post_noteon(synth, 0, 60, 100) == FLUID_OK);
+    assert(fluid_synth_post_pitch_bend(synth, 0, 9000) == FLUID_OK);
+    assert(fluid_synth_post_noteon(synth, 1, 60, 100) == FLUID_FAILED);
+
+    /* nothing changes until the synth renders */
+    fluid_synth_get_cc(synth, 0, 7, &val);
+    assert(val != 90);
+    assert(fluid_synth_is_idle(synth));
+
+    fluid_synth_render_float(synth, FLUID_BUFSIZE, buf, 1);
+    fluid_synth_get_cc(synth, 0, 7, &val);
+    assert(val == 90);
+    fluid_synth_get_pitch_bend(synth, 0, &val);
+    assert(val == 9000);
+    assert(!fluid_synth_is_idle(synth));
+
+    for (i = 0; i < 5; i++) fluid_synth_post_noteoff(synth, 0, 60);
+    assert(fluid_synth_get_post_overflows(synth) == 1);
+    fluid_synth_render_float(synth, FLUID_BUFSIZE, buf, 1);
+    delete_fluid_synth(synth);
+
+    /* no ring */
+    synth = NEW_FLUID_SYNTH(.with_reverb = false);
+    assert(fluid_synth_post_noteon(synth, 0, 60, 100) == FLUID_FAILED);
+    assert(fluid_synth_get_post_overflows(synth) == 0);
+    delete_fluid_synth(synth);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    check_single_thread();
+#ifdef WITH_THREADS
+    check_threads(1);
+    check_threads(NUM_PRODUCERS);
+#endif
+    check_synth(filename);
+
+    printf("test_event_ring passed\n");
+    return 0;
+}
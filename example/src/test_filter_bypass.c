@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define BLOCKS 200
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+/* the blocks the cutoff closes and opens again at */
+#define CLOSE 60
+#define OPEN 120
+
+static fluid_synth_t *new_synth(const char *filename, bool bypass, bool one_step) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 16,
+                                           .filter_bypass = bypass);
+    int sfont;
+
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+#ifdef FLUID_DSP_SIMD
+    if (one_step && synth->dry_buf != NULL) {
+        FLUID_FREE(synth->dry_buf);
+        synth->dry_buf = NULL;
+    }
+#endif
+    return synth;
+}
+
+/* a chord with the filter open, closed by lowering the cutoff and opened
+ * again */
+static unsigned int play(const char *filename, bool bypass, bool one_step, float *out) {
+    fluid_synth_t *synth = new_synth(filename, bypass, one_step);
+    unsigned int count;
+    int b;
+
+    fluid_synth_noteon(synth, 0, 60, 100);
+    fluid_synth_noteon(synth, 0, 64, 90);
+    fluid_synth_noteon(synth, 0, 67, 80);
+    for (b = 0; b < BLOCKS; b++) {
+        if (b == CLOSE) fluid_synth_set_gen2(synth, 0, GEN_FILTERFC, -4500, 0);
+        if (b == OPEN) fluid_synth_set_gen2(synth, 0, GEN_FILTERFC, 0, 0);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+    count = fluid_synth_get_filter_bypass_count(synth);
+    delete_fluid_synth(synth);
+    return count;
+}
+
+#ifndef WITH_FIXED
+/* the largest difference to the reference over the blocks [from, to) */
+static float max_diff(const float *ref, const float *out, int from, int to) {
+    float d = 0;
+    int i;
+    for (i = 2 * from * FLUID_BUFSIZE; i < 2 * to * FLUID_BUFSIZE; i++) {
+        if (fabsf(out[i] - ref[i]) > d) d = fabsf(out[i] - ref[i]);
+    }
+    return d;
+}
+
+/* the largest step from one sample to the next on the left side */
+static float max_step(const float *out, int from, int to) {
+    float d = 0;
+    int i;
+    for (i = 2 * from * FLUID_BUFSIZE + 2; i < 2 * to * FLUID_BUFSIZE; i += 2) {
+        if (fabsf(out[i] - out[i - 2]) > d) d = fabsf(out[i] - out[i - 2]);
+    }
+    return d;
+}
+
+static float peak(const float *out, int from, int to) {
+    float p = 0;
+    int i;
+    for (i = 2 * from * FLUID_BUFSIZE; i < 2 * to * FLUID_BUFSIZE; i++) {
+        if (fabsf(out[i]) > p) p = fabsf(out[i]);
+    }
+    return p;
+}
+#endif
+
+/* an open filter is skipped and sounds like the filter at the top of the
+ * audible range, it fades back in without a click when the cutoff closes
+ * and out again when it opens */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    float *ref = calloc(2 * LEN, sizeof(float)), *out = calloc(2 * LEN, sizeof(float));
+    float *one_step = calloc(2 * LEN, sizeof(float));
+    unsigned int count;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    /* off by default */
+    assert(play(filename, false, false, ref) == 0);
+
+#ifdef WITH_FIXED
+    count = play(filename, true, false, out);
+    assert(count == 0);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+    printf("test_filter_bypass: no filter bypass with WITH_FIXED\n");
+#else
+    count = play(filename, true, false, out);
+    printf("filter bypass: %u voice blocks without the filter\n", count);
+
+    /* skipped while open, three voices before the cutoff closes and after
+     * it opens again and the fade is over */
+    assert(count >= 3 * (CLOSE + BLOCKS - OPEN - 1));
+    assert(count <= 3 * (CLOSE + BLOCKS - OPEN));
+
+    /* the voices render alike one by one and with the filters side by side */
+    assert(play(filename, true, true, one_step) == count);
+    assert(memcmp(out, one_step, 2 * LEN * sizeof(float)) == 0);
+
+    /* open, the filter hardly changes the sound */
+    assert(max_diff(ref, out, 0, CLOSE) < 0.02f * peak(ref, 0, CLOSE));
+    assert(max_diff(ref, out, OPEN + 1, BLOCKS) < 0.02f * peak(ref, OPEN + 1, BLOCKS));
+
+    /* closed, the filter starts from rest and soon sounds as if it had
+     * always run */
+    assert(max_diff(ref, out, CLOSE + 20, OPEN) < 0.01f * peak(ref, CLOSE + 20, OPEN));
+
+    /* no clicks at the fades */
+    assert(max_step(out, CLOSE - 1, CLOSE + 2) <= 1.5f * max_step(ref, CLOSE - 1, CLOSE + 2));
+    assert(max_step(out, OPEN - 1, OPEN + 2) <= 1.5f * max_step(ref, OPEN - 1, OPEN + 2));
+#endif
+
+    free(ref);
+    free(out);
+    free(one_step);
+    printf("test_filter_bypass passed\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_dsp_simd.h"
+
+#define BLOCKS 400
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+/* how the voices of a block are written */
+enum {
+    ONE_STEP,   /* fluid_voice_write() */
+    DRY_SCALAR, /* fluid_voice_write_dry(), the filters one by one */
+    DRY_4,      /* the filters 4 at a time */
+    DRY_ALL     /* 8 at a time where the CPU has the lanes */
+};
+
+static fluid_dsp_simd_t kernels;
+
+static fluid_synth_t *new_synth(const char *filename, int mode, int polyphony) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.polyphony = polyphony, .midi_channels = 4);
+    int sfont = fluid_synth_sfload(synth, filename, 1), chan;
+
+    assert(sfont != FLUID_FAILED);
+    for (chan = 0; chan < 4; chan++) {
+        fluid_synth_program_select(synth, chan, sfont, 0, 0);
+        /* a resonant filter that moves */
+        fluid_synth_set_gen2(synth, chan, GEN_FILTERQ, 150 + 50 * chan, 0);
+    }
+
+    fluid_dsp_simd = kernels;
+    if (mode == DRY_SCALAR) fluid_dsp_simd.biquad4 = NULL;
+    if (mode != DRY_ALL) fluid_dsp_simd.biquad8 = NULL;
+    if (mode == ONE_STEP && synth->dry_buf != NULL) {
+        FLUID_FREE(synth->dry_buf);
+        synth->dry_buf = NULL;
+    }
+    return synth;
+}
+
+/* chords on 4 channels with the cutoff moving, notes that start inside a
+ * block and notes that end */
+static void play(const char *filename, int mode, float *out) {
+    fluid_synth_t *synth = new_synth(filename, mode, 32);
+    int b, k;
+
+    for (b = 0; b < BLOCKS; b++) {
+        int chan = b % 4;
+
+        if (b % 8 == 0) {
+            fluid_synth_set_gen2(synth, chan, GEN_FILTERFC, 6000 + (b * 397) % 6000, 0);
+        }
+        if (b % 40 == 0) {
+            for (k = 0; k < 5; k++) {
+                fluid_synth_noteon(synth, (chan + k) % 4, 40 + 5 * k + b % 7, 60 + 10 * k);
+            }
+            fluid_synth_schedule_noteon(synth, 17 + b % 29, chan, 70 + b % 11, 100);
+        }
+        if (b % 40 == 20) {
+            fluid_synth_noteoff(synth, chan, 40 + b % 7);
+        }
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+    delete_fluid_synth(synth);
+}
+
+/* 64 voices, the time to render one second */
+static void benchmark(const char *filename) {
+    static const char *names[] = {"one step", "dry, scalar filters", "dry, 4 lanes",
+                                  "dry, all lanes"};
+    float *buf = calloc(sizeof(float), 44100 * 2);
+    int mode, n;
+
+    for (mode = ONE_STEP; mode <= DRY_ALL; mode++) {
+        fluid_synth_t *synth = new_synth(filename, mode, 64);
+        clock_t start;
+
+        for (n = 0; n < 64; n++) {
+            fluid_synth_noteon(synth, n % 4, 30 + n, 100);
+        }
+        start = clock();
+        fluid_synth_render_float(synth, 44100, buf, 2);
+        printf("%s: 1 s rendered in %.1f ms\n", names[mode],
+               1000.0 * (clock() - start) / CLOCKS_PER_SEC);
+        delete_fluid_synth(synth);
+    }
+    free(buf);
+}
+
+/* the filters running side by side sound exactly like one voice at a
+ * time */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    float *ref = calloc(2 * LEN, sizeof(float)), *out = calloc(2 * LEN, sizeof(float));
+    fluid_synth_t *synth;
+    int mode;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    /* the kernels are selected with the first synth */
+    synth = NEW_FLUID_SYNTH();
+    kernels = fluid_dsp_simd;
+    assert(kernels.biquad4 == NULL || synth->dry_buf != NULL);
+    delete_fluid_synth(synth);
+    printf("filter lanes: %d\n", kernels.biquad8 ? 8 : kernels.biquad4 ? 4 : 1);
+
+    play(filename, ONE_STEP, ref);
+    for (mode = DRY_SCALAR; mode <= DRY_ALL; mode++) {
+        memset(out, 0, 2 * LEN * sizeof(float));
+        play(filename, mode, out);
+        assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+    }
+
+    benchmark(filename);
+    fluid_dsp_simd = kernels;
+
+    free(ref);
+    free(out);
+    printf("test_filter_lanes passed\n");
+    return 0;
+}
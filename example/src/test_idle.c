@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define SAMPLE_RATE 44100
+#define NUM_FRAMES 4410
+
+static float buf[NUM_FRAMES * 2];
+
+static float peak(void) {
+    float max = 0.0f;
+    int i;
+    for (i = 0; i < NUM_FRAMES * 2; i++) {
+        if (fabsf(buf[i]) > max) max = fabsf(buf[i]);
+    }
+    return max;
+}
+
+static void run(const char *filename, int render_threads) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_chorus = true, .render_threads = render_threads);
+    int sfont, i;
+
+    assert(synth != NULL);
+    /* nothing played yet */
+    assert(fluid_synth_is_idle(synth));
+
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    fluid_synth_cc(synth, 0, 91, 127);
+    fluid_synth_cc(synth, 0, 93, 127);
+
+    fluid_synth_noteon(synth, 0, 60, 127);
+    assert(!fluid_synth_is_idle(synth));
+    fluid_synth_render_float(synth, NUM_FRAMES, buf, 2);
+    assert(peak() > 0.01f);
+
+    fluid_synth_noteoff(synth, 0, 60);
+
+    /* the release and the reverb tail keep the synth busy for a while */
+    for (i = 0; i < 100 && !fluid_synth_is_idle(synth); i++) {
+        fluid_synth_render_float(synth, NUM_FRAMES, buf, 2);
+    }
+    printf("render_threads %d: idle after %d00 ms\n", render_threads, i);
+    assert(i > 1);
+    assert(fluid_synth_is_idle(synth));
+
+    /* idle blocks are exact zeros */
+    fluid_synth_render_float(synth, NUM_FRAMES, buf, 2);
+    assert(peak() == 0.0f);
+    assert(fluid_synth_is_idle(synth));
+
+    /* a new note wakes the synth */
+    fluid_synth_noteon(synth, 0, 64, 127);
+    assert(!fluid_synth_is_idle(synth));
+    fluid_synth_render_float(synth, NUM_FRAMES, buf, 2);
+    assert(peak() > 0.01f);
+    assert(!fluid_synth_is_idle(synth));
+
+    /* controller changes alone don't */
+    fluid_synth_all_sounds_off(synth, 0);
+    for (i = 0; i < 100 && !fluid_synth_is_idle(synth); i++) {
+        fluid_synth_render_float(synth, NUM_FRAMES, buf, 2);
+    }
+    assert(fluid_synth_is_idle(synth));
+    fluid_synth_cc(synth, 0, 7, 100);
+    fluid_synth_pitch_bend(synth, 0, 0);
+    assert(fluid_synth_is_idle(synth));
+
+    delete_fluid_synth(synth);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    run(filename, 0);
+    run(filename, 4);
+
+    printf("test_idle passed\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_mod.h"
+
+#define STEPS 2000
+
+/* every generator holds the sum of its modulators, evaluated now in the
+ * order of the voice, and working out all the parameters again changes
+ * nothing */
+static void check_voice(fluid_voice_t *voice) {
+    char params[sizeof(fluid_voice_t) - offsetof(fluid_voice_t, pitch)];
+    int i, k;
+
+    for (i = 0; i < voice->mod_count; i++) {
+        int gen = voice->mod[i].dest;
+        fluid_real_t modval = 0.0;
+        for (k = 0; k < voice->mod_count; k++) {
+            if (fluid_mod_has_dest(&voice->mod[k], gen)) {
+                modval += fluid_mod_get_value(&voice->mod[k], voice->channel, voice);
+            }
+        }
+        assert(voice->gen[gen].mod == modval);
+    }
+
+    memcpy(params, &voice->pitch, sizeof(params));
+    fluid_voice_modulate_all(voice);
+    assert(memcmp(params, &voice->pitch, sizeof(params)) == 0);
+}
+
+static void check_voices(fluid_synth_t *synth) {
+    int i;
+    for (i = 0; i < synth->polyphony; i++) {
+        if (_PLAYING(synth->voice[i])) check_voice(synth->voice[i]);
+    }
+}
+
+/* random controller changes on voices with several modulators per
+ * generator, a changed controller only reaches the voices and generators
+ * it modulates */
+int main(int argc, char *argv[]) {
+    static const int ccs[] = {1, 7, 10, 11, 91, 93, 74, 64};
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    fluid_synth_t *synth;
+    fluid_voice_t *voice;
+    int sfont, chan, step, i;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 32, .midi_channels = 4);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    for (chan = 0; chan < 4; chan++) {
+        fluid_synth_program_select(synth, chan, sfont, 0, 0);
+        for (i = 0; i < 4; i++) fluid_synth_noteon(synth, chan, 48 + 7 * i, 40 + 20 * i);
+    }
+    check_voices(synth);
+
+    srand(7);
+    for (step = 0; step < STEPS; step++) {
+        chan = rand() % 4;
+        switch (rand() % 4) {
+        case 0:
+            fluid_synth_channel_pressure(synth, chan, rand() % 128);
+            break;
+        case 1:
+            fluid_synth_key_pressure(synth, chan, 48 + 7 * (rand() % 4), rand() % 128);
+            break;
+        default:
+            fluid_synth_cc(synth, chan, ccs[rand() % 8], rand() % 128);
+            break;
+        }
+        check_voices(synth);
+    }
+
+    /* a voice without modulators of the controller isn't touched */
+    voice = NULL;
+    for (i = 0; i < synth->polyphony; i++) {
+        if (_PLAYING(synth->voice[i])) voice = synth->voice[i];
+    }
+    assert(voice != NULL);
+    voice->gen[GEN_PAN].mod = 1234;
+    fluid_voice_modulate(voice, 1, 74);
+    assert(voice->gen[GEN_PAN].mod == 1234);
+    fluid_voice_modulate(voice, 1, 10);
+    assert(voice->gen[GEN_PAN].mod != 1234);
+
+    delete_fluid_synth(synth);
+    printf("test_mod_graph passed\n");
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define NUM_FRAMES 4410
+#define KEY 60
+
+/* odd chunk sizes, so the partial block in synth->cur is exercised */
+static const int chunks[] = {1, 37, 64, 100, 63, 129, 7, 300, 65};
+
+static fluid_synth_t *new_playing_synth(const char *filename) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH();
+    int sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    fluid_synth_noteon(synth, 0, KEY, 127);
+    return synth;
+}
+
+static void test_s16(const char *filename, int channels) {
+    fluid_synth_t *synth1 = new_playing_synth(filename);
+    fluid_synth_t *synth2 = new_playing_synth(filename);
+    int16_t *buf1 = calloc(sizeof(int16_t), NUM_FRAMES * 2);
+    int16_t *buf2 = calloc(sizeof(int16_t), NUM_FRAMES * 2);
+    int i, done = 0;
+
+    if (channels == 1) {
+        fluid_synth_write_s16_mono(synth1, NUM_FRAMES, buf1);
+    } else {
+        fluid_synth_write_s16(synth1, NUM_FRAMES, buf1, 0, 2, buf1, 1, 2);
+    }
+
+    for (i = 0; done < NUM_FRAMES; i++) {
+        int n = chunks[i % FLUID_N_ELEMENTS(chunks)];
+        if (n > NUM_FRAMES - done) n = NUM_FRAMES - done;
+        assert(fluid_synth_render_s16(synth2, n, buf2 + done * channels,
+                                      channels) == FLUID_OK);
+        done += n;
+    }
+
+    assert(synth1->cur == synth2->cur);
+    assert(synth1->ticks == synth2->ticks);
+    for (i = 0; i < NUM_FRAMES * channels; i++) {
+        assert(buf1[i] == buf2[i]);
+    }
+
+    free(buf1);
+    free(buf2);
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+}
+
+static void test_float(const char *filename) {
+    fluid_synth_t *synth1 = new_playing_synth(filename);
+    fluid_synth_t *synth2 = new_playing_synth(filename);
+    float *buf1 = calloc(sizeof(float), NUM_FRAMES * 2);
+    float *buf2 = calloc(sizeof(float), NUM_FRAMES * 2);
+    int i;
+
+    fluid_synth_write_float(synth1, NUM_FRAMES, buf1, 0, 2, buf1, 1, 2);
+    fluid_synth_render_float(synth2, 100, buf2, 2);
+    fluid_synth_render_float(synth2, NUM_FRAMES - 100, buf2 + 200, 2);
+
+    for (i = 0; i < NUM_FRAMES * 2; i++) {
+        assert(buf1[i] == buf2[i]);
+    }
+
+    free(buf1);
+    free(buf2);
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+}
+
+static void test_u12_u8(const char *filename) {
+    fluid_synth_t *synth1 = new_playing_synth(filename);
+    fluid_synth_t *synth2 = new_playing_synth(filename);
+    fluid_synth_t *synth3 = new_playing_synth(filename);
+    uint16_t *buf1 = calloc(sizeof(uint16_t), NUM_FRAMES);
+    uint16_t *buf2 = calloc(sizeof(uint16_t), NUM_FRAMES);
+    uint8_t *buf3 = calloc(sizeof(uint8_t), NUM_FRAMES);
+    int i;
+
+    fluid_synth_write_u12_mono(synth1, NUM_FRAMES, buf1);
+    fluid_synth_render_u12(synth2, 33, buf2, 1);
+    fluid_synth_render_u12(synth2, NUM_FRAMES - 33, buf2 + 33, 1);
+    fluid_synth_render_u8(synth3, NUM_FRAMES, buf3, 1);
+
+    for (i = 0; i < NUM_FRAMES; i++) {
+        assert(buf1[i] == buf2[i]);
+        assert(buf2[i] <= 4095);
+        assert(abs((buf2[i] >> 4) - buf3[i]) <= 1);
+    }
+
+    free(buf1);
+    free(buf2);
+    free(buf3);
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_synth(synth3);
+}
+
+static void test_mixed_api(const char *filename) {
+    fluid_synth_t *synth1 = new_playing_synth(filename);
+    fluid_synth_t *synth2 = new_playing_synth(filename);
+    int16_t buf1[500];
+    int16_t buf2[500];
+    int i;
+
+    fluid_synth_write_s16_mono(synth1, 500, buf1);
+
+    /* leave a partial block behind, then continue with the render API */
+    fluid_synth_write_s16_mono(synth2, 90, buf2);
+    assert(synth2->cur == 90 - FLUID_BUFSIZE);
+    fluid_synth_render_s16(synth2, 410, buf2 + 90, 1);
+
+    for (i = 0; i < 500; i++) {
+        assert(buf1[i] == buf2[i]);
+    }
+
+    assert(fluid_synth_render_s16(synth2, 10, buf2, 3) == FLUID_FAILED);
+    assert(fluid_synth_render_s16(synth2, 0, buf2, 2) == FLUID_OK);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    test_s16(filename, 1);
+    test_s16(filename, 2);
+    test_float(filename);
+    test_u12_u8(filename);
+    test_mixed_api(filename);
+
+    printf("test_render passed\n");
+    return 0;
+}
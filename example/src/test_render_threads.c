@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define NUM_FRAMES 22050
+
+/* render notes on a few channels, with reverb and chorus sends */
+static float *render(const char *filename, int threads, int notes) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.polyphony = 128, .midi_channels = 4,
+                                           .with_chorus = true, .render_threads = threads);
+    float *buf = calloc(sizeof(float), NUM_FRAMES * 2);
+    int sfont, i;
+
+    assert(synth != NULL);
+#ifdef WITH_THREADS
+    assert((synth->render_pool != NULL) == (threads > 1));
+#endif
+
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    for (i = 0; i < 4; i++) {
+        fluid_synth_program_select(synth, i, sfont, 0, i * 16);
+        fluid_synth_cc(synth, i, 10, i * 40);
+        fluid_synth_cc(synth, i, 91, 80);
+        fluid_synth_cc(synth, i, 93, 80);
+    }
+
+    for (i = 0; i < notes; i++) {
+        fluid_synth_noteon(synth, i % 4, 36 + i, 80 + i % 40);
+    }
+    fluid_synth_render_float(synth, NUM_FRAMES / 2, buf, 2);
+
+    for (i = 0; i < notes; i += 2) {
+        fluid_synth_noteoff(synth, i % 4, 36 + i);
+    }
+    fluid_synth_render_float(synth, NUM_FRAMES / 2, buf + NUM_FRAMES, 2);
+
+    delete_fluid_synth(synth);
+    return buf;
+}
+
+static void compare(const char *filename, int threads, int notes) {
+    float *ref = render(filename, 0, notes);
+    float *vec = render(filename, threads, notes);
+    float *again = render(filename, threads, notes);
+    double max_diff = 0.0, energy = 0.0;
+    int i;
+
+    for (i = 0; i < NUM_FRAMES * 2; i++) {
+        double d = fabs((double)ref[i] - vec[i]);
+        if (d > max_diff) max_diff = d;
+        energy += fabs(ref[i]);
+    }
+    printf("threads %d, notes %d: max diff %g\n", threads, notes, max_diff);
+
+    assert(energy > 0.0);
+    /* the buses are summed in another order than the voices */
+    assert(max_diff < 1e-5);
+    /* but always in the same order */
+    assert(memcmp(vec, again, sizeof(float) * NUM_FRAMES * 2) == 0);
+
+    free(ref);
+    free(vec);
+    free(again);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    compare(filename, 2, 48);
+    compare(filename, 4, 48);
+    compare(filename, 7, 33);
+    /* too few voices to hand out, rendered on the caller only */
+    compare(filename, 4, 3);
+
+    printf("test_render_threads passed\n");
+    return 0;
+}
@@ -59,10 +59,10 @@ void gen_song(const char *name, fluid_synth_t *synth, const char *fontname){
 
 void assert_gen_GMGSx_2(fluid_synth_t *synth){
     assert(synth->voice[0]->mod_count == 9);
-    assert(synth->voice[0]->amp_reverb > 1e-6);
+    assert(_DSP(synth->voice[0], amp_reverb) > 1e-6);
     assert(synth->voice[0]->gen[GEN_REVERBSEND].val == 800);
     assert(float_eq(synth->voice[0]->reverb_send, 0.5+0.3)); //ins:50 + global_preset:30
-    assert(synth->voice[0]->amp_chorus > 1e-6);
+    assert(_DSP(synth->voice[0], amp_chorus) > 1e-6);
     assert(synth->voice[0]->gen[GEN_CHORUSSEND].val == 700);
     assert(float_eq(synth->voice[0]->chorus_send, 0.4+0.3)); //global_ins:40 + global_preset:30
 }
@@ -72,9 +72,9 @@ void assert_gen_zero(fluid_synth_t *synth){
     assert(synth->polyphony == synth->nvoice);
     assert(synth->polyphony == 10);
     assert(synth->voice[0]->chan == NO_CHANNEL);
-    assert(synth->voice[0]->amp_reverb == 0);
+    assert(_DSP(synth->voice[0], amp_reverb) == 0);
     assert(float_eq(synth->voice[0]->reverb_send, 0));
-    assert(synth->voice[0]->amp_chorus == 0);
+    assert(_DSP(synth->voice[0], amp_chorus) == 0);
     assert(float_eq(synth->voice[0]->chorus_send, 0));
 #endif
 }
@@ -189,10 +189,10 @@ int main(){
     // voice->chan  = 255 NO_CHANNEL， chan=0， 所以voice里的gen未设置。
 
     gen_song("song_reverb_chorus_Boomwhacker", synth, "example/sf_/GMGSx_1.sf2");
-    assert(synth->voice[0]->amp_reverb > 1e-6);
+    assert(_DSP(synth->voice[0], amp_reverb) > 1e-6);
     assert(synth->voice[0]->gen[GEN_REVERBSEND].nrpn == 800);
     assert(float_eq(synth->voice[0]->reverb_send, 0.8));
-    assert(synth->voice[0]->amp_chorus > 1e-6);
+    assert(_DSP(synth->voice[0], amp_chorus) > 1e-6);
     assert(synth->voice[0]->gen[GEN_CHORUSSEND].nrpn == 700);
     assert(float_eq(synth->voice[0]->chorus_send, 0.7));
     delete_fluid_synth(synth);
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_sfont.h"
+#include "fluid_synth.h"
+#include "fluid_sample_pager.h"
+
+#define BLOCKS 400
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+/* the piano on channels 0 and 2, the boomwhackers on 1 and 3 */
+static fluid_synth_t *new_synth(const char *filename, unsigned int cache_size, int *id,
+                                int *other_id) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 32,
+                                           .midi_channels = 4,
+                                           .sample_cache_size = cache_size);
+    int chan;
+
+    assert(synth != NULL);
+    *id = fluid_synth_sfload(synth, filename, 1);
+    *other_id = fluid_synth_sfload(synth, "example/sf_/Boomwhacker.sf2", 1);
+    assert(*id != FLUID_FAILED && *other_id != FLUID_FAILED);
+    for (chan = 0; chan < 4; chan++) {
+        fluid_synth_program_select(synth, chan, chan % 2 ? *other_id : *id, 0, 0);
+    }
+    return synth;
+}
+
+/* the bytes of the samples the voices play */
+static unsigned int playing_size(fluid_sfont_t *sfont) {
+    fluid_list_t *list;
+    unsigned int size = 0;
+
+    for (list = sfont->sample; list; list = fluid_list_next(list)) {
+        fluid_sample_t *sample = (fluid_sample_t *)fluid_list_get(list);
+        if (sample->refcount > 0) {
+            assert(sample->data != NULL);
+            size += sample->size;
+        }
+    }
+    return size;
+}
+
+/* notes on all channels that start and stop, the samples of the notes
+ * that stopped may go */
+static void play(fluid_synth_t *synth, float *out) {
+    int b, chan;
+
+    for (b = 0; b < BLOCKS; b++) {
+        chan = b % 4;
+        if (b % 20 == 0) fluid_synth_noteon(synth, chan, 36 + (b * 7) % 48, 100);
+        if (b % 20 == 10) fluid_synth_noteoff(synth, chan, 36 + ((b - 10) * 7) % 48);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+}
+
+/* the preset's samples, all paged in or not */
+static bool preset_paged_in(fluid_preset_t *preset) {
+    int k;
+    for (k = 0; k < preset->key_first[128]; k++) {
+        if (preset->pairs[preset->key_pairs[k]].sample->data == NULL) return false;
+    }
+    return true;
+}
+
+/* a paged SoundFont sounds as if it was loaded as a whole, keeps the
+ * samples no voice plays within its cache size and preloads presets */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    float *ref = calloc(2 * LEN, sizeof(float)), *out = calloc(2 * LEN, sizeof(float));
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset;
+    fluid_sample_t *sample;
+    int id, other_id;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    synth = new_synth(filename, 0, &id, &other_id);
+    assert(fluid_synth_get_sfont_by_id(synth, id)->fileapi == NULL);
+    play(synth, ref);
+    delete_fluid_synth(synth);
+
+    /* room for everything: only the samples played are read */
+    synth = new_synth(filename, 0xffffffff, &id, &other_id);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    assert(sfont->fileapi != NULL && sfont->sampledata == NULL);
+    assert(sfont->resident == 0);
+    play(synth, out);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+    printf("sample paging: %u of %u bytes read\n", sfont->resident, sfont->samplesize);
+    assert(sfont->resident > 0 && sfont->resident < sfont->samplesize);
+    delete_fluid_synth(synth);
+
+    /* no room: only the samples playing stay */
+    memset(out, 0, 2 * LEN * sizeof(float));
+    synth = new_synth(filename, 1, &id, &other_id);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    play(synth, out);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+    fluid_synth_noteon(synth, 0, 60, 100);
+    assert(sfont->resident == playing_size(sfont));
+    assert(sfont->resident > 0);
+
+    /* every voice let go of its sample */
+    fluid_synth_system_reset(synth);
+    assert(playing_size(sfont) == 0);
+    fluid_sfont_page_out(sfont);
+    assert(sfont->resident == 0);
+
+    /* nor do voices never started hold one */
+    sample = (fluid_sample_t *)fluid_list_get(sfont->sample);
+    assert(fluid_synth_alloc_voice(synth, sample, 0, 60, 100) != NULL);
+    assert(fluid_synth_alloc_voice(synth, sample, 0, 60, 100) != NULL);
+    assert(sample->refcount == 0);
+    fluid_synth_system_reset(synth);
+    assert(sample->refcount == 0);
+
+    /* a preloaded preset is there before its first note */
+    sfont = fluid_synth_get_sfont_by_id(synth, other_id);
+    fluid_sfont_page_out(sfont);
+    preset = fluid_sfont_get_preset(sfont, 0, 0);
+    assert(!preset_paged_in(preset));
+    assert(fluid_synth_preload(synth, other_id, 0, 0) == FLUID_OK);
+    fluid_synth_preload_wait(synth);
+    assert(preset_paged_in(preset));
+    assert(fluid_synth_preload(synth, other_id, 0, 48) == FLUID_FAILED);
+
+    /* unloaded with presets still queued */
+    fluid_sfont_page_out(sfont);
+    fluid_synth_preload(synth, other_id, 0, 0);
+    fluid_synth_preload(synth, id, 0, 0);
+    assert(fluid_synth_sfunload(synth, other_id, 1) == FLUID_OK);
+    delete_fluid_synth(synth);
+
+    free(ref);
+    free(out);
+    printf("test_sample_paging passed\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_sfont.h"
+#include "fluid_synth.h"
+
+#define BLOCKS 800
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+extern const fluid_fileapi_t default_fileapi;
+
+/* a file that takes its time */
+static int slow_fread(void *buf, int count, void *handle) {
+    usleep(20000);
+    return default_fileapi.fread(buf, count, handle);
+}
+
+static fluid_synth_t *new_synth(const char *filename, unsigned int head_ms, bool offline,
+                                int *id) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 32,
+                                           .midi_channels = 2, .stream_head_ms = head_ms,
+                                           .stream_offline = offline);
+
+    assert(synth != NULL);
+    *id = fluid_synth_sfload(synth, filename, 1);
+    assert(*id != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, *id, 0, 0);
+    fluid_synth_program_select(synth, 1, *id, 0, 0);
+    /* the widest interpolator, bent up to read more points per sample */
+    fluid_synth_set_interp_method(synth, 1, FLUID_INTERP_SINC32);
+    fluid_synth_pitch_bend(synth, 1, 16383);
+    return synth;
+}
+
+/* long notes, released while they play */
+static void play(fluid_synth_t *synth, float *out) {
+    int b, chan;
+
+    for (b = 0; b < BLOCKS; b++) {
+        chan = (b / 40) % 2;
+        if (b % 40 == 0) fluid_synth_noteon(synth, chan, 36 + (b * 7) % 48, 100);
+        if (b % 40 == 30) fluid_synth_noteoff(synth, chan, 36 + ((b - 30) * 7) % 48);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+}
+
+/* samples with only their start and loop in memory */
+static int streamed_samples(fluid_sfont_t *sfont) {
+    fluid_list_t *list;
+    int count = 0;
+
+    for (list = sfont->sample; list; list = fluid_list_next(list)) {
+        fluid_sample_t *sample = (fluid_sample_t *)fluid_list_get(list);
+        if (fluid_sample_is_streamed(sample)) {
+            assert(sample->data == NULL);
+            assert(sample->head_points < sample->size / 2);
+            count++;
+        }
+    }
+    return count;
+}
+
+/* rendered offline, a streamed SoundFont sounds as if it was loaded as a
+ * whole; in real time the points read too late are counted */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    float *ref = calloc(2 * LEN, sizeof(float)), *out = calloc(2 * LEN, sizeof(float));
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    int id;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    synth = new_synth(filename, 0, false, &id);
+    assert(fluid_synth_get_sfont_by_id(synth, id)->fileapi == NULL);
+    play(synth, ref);
+    delete_fluid_synth(synth);
+
+    synth = new_synth(filename, 10, true, &id);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+#ifdef WITH_THREADS
+    assert(sfont->fileapi != NULL && sfont->sampledata == NULL);
+    assert(streamed_samples(sfont) > 0);
+    printf("sample streaming: %u of %u bytes in memory\n", sfont->resident, sfont->samplesize);
+    assert(sfont->resident < sfont->samplesize);
+#else
+    printf("test_sample_stream: loaded as a whole without WITH_THREADS\n");
+#endif
+    play(synth, out);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+    assert(fluid_synth_get_stream_underruns(synth) == 0);
+    delete_fluid_synth(synth);
+
+#ifdef WITH_THREADS
+    {
+        fluid_fileapi_t slow = default_fileapi;
+
+        /* in real time the voices run ahead of a slow file */
+        synth = new_synth(filename, 10, false, &id);
+        slow.fread = slow_fread;
+        fluid_synth_get_sfont_by_id(synth, id)->fileapi = &slow;
+        play(synth, out);
+        printf("sample streaming: %u underruns\n", fluid_synth_get_stream_underruns(synth));
+        assert(fluid_synth_get_stream_underruns(synth) > 0);
+
+        /* unloaded while its samples may still be read */
+        fluid_synth_noteon(synth, 0, 60, 100);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 0, 2, out, 1, 2);
+        assert(fluid_synth_sfunload(synth, id, 1) == FLUID_OK);
+        delete_fluid_synth(synth);
+    }
+#endif
+
+    free(ref);
+    free(out);
+    printf("test_sample_stream passed\n");
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define SAMPLE_RATE 44100
+#define NUM_FRAMES 20000
+
+static fluid_synth_t *new_synth(const char *filename, int env_mode) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .env_mode = env_mode);
+    int sfont;
+
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    return synth;
+}
+
+static int first_nonzero(const float *buf, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        if (buf[i] != 0.0f) return i;
+    }
+    return -1;
+}
+
+static int first_difference(const float *a, const float *b, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        if (a[i] != b[i]) return i;
+    }
+    return -1;
+}
+
+/* a note-on scheduled on a block boundary sounds like one sent between
+ * two calls, also when the previous call left part of a block */
+static void check_aligned(const char *filename) {
+    float *ref = calloc(sizeof(float), NUM_FRAMES);
+    float *buf = calloc(sizeof(float), NUM_FRAMES);
+    fluid_synth_t *synth;
+
+    synth = new_synth(filename, FLUID_ENV_BLOCK);
+    fluid_synth_render_float(synth, 1024, ref, 1);
+    fluid_synth_noteon(synth, 0, 60, 100);
+    fluid_synth_render_float(synth, NUM_FRAMES - 1024, ref + 1024, 1);
+    delete_fluid_synth(synth);
+
+    synth = new_synth(filename, FLUID_ENV_BLOCK);
+    assert(fluid_synth_schedule_noteon(synth, 1024, 0, 60, 100) == FLUID_OK);
+    fluid_synth_render_float(synth, NUM_FRAMES, buf, 1);
+    delete_fluid_synth(synth);
+    assert(first_difference(ref, buf, NUM_FRAMES) < 0);
+
+    /* 10 frames out, the next output frame is 10 */
+    synth = new_synth(filename, FLUID_ENV_BLOCK);
+    fluid_synth_render_float(synth, 10, buf, 1);
+    assert(fluid_synth_schedule_noteon(synth, 1014, 0, 60, 100) == FLUID_OK);
+    fluid_synth_render_float(synth, NUM_FRAMES - 10, buf + 10, 1);
+    delete_fluid_synth(synth);
+    assert(first_difference(ref, buf, NUM_FRAMES) < 0);
+
+    free(ref);
+    free(buf);
+}
+
+static int noteon_onset(const char *filename, int env_mode, unsigned int frame) {
+    float *buf = calloc(sizeof(float), NUM_FRAMES);
+    fluid_synth_t *synth = new_synth(filename, env_mode);
+    int onset;
+
+    assert(fluid_synth_schedule_noteon(synth, frame, 0, 60, 100) == FLUID_OK);
+    fluid_synth_render_float(synth, NUM_FRAMES, buf, 1);
+    delete_fluid_synth(synth);
+    onset = first_nonzero(buf, NUM_FRAMES);
+    free(buf);
+    return onset;
+}
+
+/* a note-on off the block grid starts on its frame: the first sound comes
+ * as long after it as after a note-on at frame 0 (the first sample of the
+ * attack is zero, sample envelopes also wait for the delay section) */
+static void check_noteon(const char *filename, int env_mode) {
+    static const unsigned int frames[] = {1000, 1001, 1063, 5000};
+    int latency = noteon_onset(filename, env_mode, 0);
+    int i, onset;
+
+    for (i = 0; i < (int)FLUID_N_ELEMENTS(frames); i++) {
+        onset = noteon_onset(filename, env_mode, frames[i]);
+        printf("note-on at %u: onset %d, latency %d\n", frames[i], onset, latency);
+        assert(abs(onset - (int)frames[i] - latency) <= 1);
+    }
+}
+
+/* a note-off starts the release on its frame with sample envelopes, on
+ * the nearest block boundary with block envelopes */
+static void check_noteoff(const char *filename, int env_mode, unsigned int frame,
+                          int expected) {
+    float *held = calloc(sizeof(float), NUM_FRAMES);
+    float *buf = calloc(sizeof(float), NUM_FRAMES);
+    fluid_synth_t *synth;
+    int diff;
+
+    synth = new_synth(filename, env_mode);
+    fluid_synth_schedule_noteon(synth, 100, 0, 60, 100);
+    fluid_synth_render_float(synth, NUM_FRAMES, held, 1);
+    delete_fluid_synth(synth);
+
+    synth = new_synth(filename, env_mode);
+    fluid_synth_schedule_noteon(synth, 100, 0, 60, 100);
+    fluid_synth_schedule_noteoff(synth, frame, 0, 60);
+    fluid_synth_render_float(synth, NUM_FRAMES, buf, 1);
+    delete_fluid_synth(synth);
+
+    diff = first_difference(held, buf, NUM_FRAMES);
+    printf("%s envelopes, note-off at %u: release from %d\n",
+           env_mode == FLUID_ENV_SAMPLE ? "sample" : "block", frame, diff);
+    assert(diff >= expected && diff <= expected + 1);
+
+    free(held);
+    free(buf);
+}
+
+/* messages on the same frame play in the order they were queued, and the
+ * queue has a fixed size */
+static void check_queue(const char *filename) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .event_queue_size = 4);
+    float *buf = calloc(sizeof(float), NUM_FRAMES);
+    int sfont = fluid_synth_sfload(synth, filename, 1);
+
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    assert(fluid_synth_schedule_noteoff(synth, 3000, 0, 60) == FLUID_OK);
+    assert(fluid_synth_schedule_noteon(synth, 2000, 0, 60, 100) == FLUID_OK);
+    assert(fluid_synth_schedule_noteoff(synth, 2000, 0, 60) == FLUID_OK);
+    assert(fluid_synth_schedule_noteon(synth, 2000, 0, 60, 100) == FLUID_OK);
+    assert(fluid_synth_schedule_noteon(synth, 2500, 0, 62, 100) == FLUID_FAILED);
+    assert(fluid_synth_schedule_noteon(synth, 2500, 1, 62, 100) == FLUID_FAILED);
+
+    /* the note plays from 2000 until the note-off at 3000 */
+    fluid_synth_render_float(synth, 2500, buf, 1);
+    assert(first_nonzero(buf, 2500) >= 2000);
+    assert(!fluid_synth_is_idle(synth));
+    assert(synth->event_count == 1);
+    fluid_synth_render_float(synth, NUM_FRAMES - 2500, buf + 2500, 1);
+    assert(synth->event_count == 0);
+
+    delete_fluid_synth(synth);
+    free(buf);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    check_aligned(filename);
+    check_noteon(filename, FLUID_ENV_BLOCK);
+    /* 10000 is 16 samples past the boundary at 9984 */
+    check_noteoff(filename, FLUID_ENV_BLOCK, 10000, 9984);
+    check_noteoff(filename, FLUID_ENV_BLOCK, 10040, 10048);
+#ifndef WITH_FIXED
+    check_noteon(filename, FLUID_ENV_SAMPLE);
+    check_noteoff(filename, FLUID_ENV_SAMPLE, 10000, 10000);
+    check_noteoff(filename, FLUID_ENV_SAMPLE, 10037, 10037);
+#endif
+    check_queue(filename);
+
+    printf("test_schedule passed\n");
+    return 0;
+}
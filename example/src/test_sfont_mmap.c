@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_sfont.h"
+#include "fluid_synth.h"
+
+#define BLOCKS 200
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+extern const fluid_fileapi_t default_fileapi;
+
+/* a few notes on the first preset of the file */
+static void play(const char *filename, fluid_fileapi_t *fileapi, float *out) {
+    fluid_synth_t *synth;
+    int id, b;
+
+    fluid_set_default_fileapi(fileapi);
+    synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 16);
+    id = fluid_synth_sfload(synth, filename, 1);
+    assert(id != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, id, 0, 0);
+
+    for (b = 0; b < BLOCKS; b++) {
+        if (b % 50 == 0) fluid_synth_noteon(synth, 0, 48 + b / 10, 100);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+
+    assert(fluid_synth_sfunload(synth, id, 1) == FLUID_OK);
+    delete_fluid_synth(synth);
+}
+
+/* the sample data of a mapped SoundFont is the file itself, and it sounds
+ * as if it had been read */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    fluid_fileapi_t *mmap_fileapi = fluid_get_mmap_fileapi();
+    float *ref = calloc(2 * LEN, sizeof(float)), *out = calloc(2 * LEN, sizeof(float));
+    fluid_sfont_t *sfont;
+    short *data;
+    FILE *file;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    if (mmap_fileapi == NULL) {
+        printf("test_sfont_mmap: no mmap\n");
+        return 0;
+    }
+
+    play(filename, (fluid_fileapi_t *)&default_fileapi, ref);
+    play(filename, mmap_fileapi, out);
+    assert(memcmp(ref, out, 2 * LEN * sizeof(float)) == 0);
+
+    /* a mapping of the file, not a copy */
+    sfont = fluid_soundfont_load(mmap_fileapi, filename);
+    assert(sfont != NULL);
+    assert(sfont->is_rom == 1);
+    assert(sfont->free_sampledata != NULL);
+    data = malloc(sfont->samplesize);
+    file = fopen(filename, "rb");
+    assert(file != NULL);
+    fseek(file, sfont->samplepos, SEEK_SET);
+    assert(fread(data, sfont->samplesize, 1, file) == 1);
+    fclose(file);
+    assert(memcmp(data, sfont->sampledata, sfont->samplesize) == 0);
+    free(data);
+    delete_fluid_sfont(sfont);
+
+    fluid_set_default_fileapi((fluid_fileapi_t *)&default_fileapi);
+    free(ref);
+    free(out);
+    printf("test_sfont_mmap passed\n");
+    return 0;
+}
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#ifdef WITH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "fluidliter.h"
+#include "fluid_sfont.h"
+#include "fluid_synth.h"
+#include "fluid_sfont_registry.h"
+
+#define BLOCKS 200
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+typedef struct {
+    fluid_synth_t *synth;
+    float *out;
+} player_t;
+
+static fluid_synth_t *new_synth(bool share, unsigned int cache_size) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 16,
+                                           .share_sfonts = share,
+                                           .sample_cache_size = cache_size);
+    assert(synth != NULL);
+    return synth;
+}
+
+static void *play(void *data) {
+    player_t *player = data;
+    int b;
+
+    for (b = 0; b < BLOCKS; b++) {
+        if (b % 20 == 0) fluid_synth_noteon(player->synth, 0, 36 + (b * 7) % 48, 100);
+        if (b % 20 == 10) fluid_synth_noteoff(player->synth, 0, 36 + ((b - 10) * 7) % 48);
+        fluid_synth_write_float(player->synth, FLUID_BUFSIZE, player->out,
+                                2 * b * FLUID_BUFSIZE, 2, player->out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+    return NULL;
+}
+
+static int playing(fluid_synth_t *synth) {
+    int i, n = 0;
+
+    for (i = 0; i < synth->nvoice; i++) {
+        n += fluid_voice_is_playing(synth->voice[i]) ? 1 : 0;
+    }
+    return n;
+}
+
+#ifdef WITH_THREADS
+extern const fluid_fileapi_t default_fileapi;
+
+/* a file API that takes its time to open slow_name */
+static fluid_fileapi_t slow_fileapi;
+static const char *slow_name;
+static int slow_opening, slow_loaded;
+
+static void *slow_fopen(fluid_fileapi_t *fileapi, const char *filename) {
+    if (strcmp(filename, slow_name) == 0) {
+        __atomic_store_n(&slow_opening, 1, __ATOMIC_RELEASE);
+        usleep(300000);
+    }
+    return default_fileapi.fopen(fileapi, filename);
+}
+
+static void *slow_load(void *data) {
+    *(fluid_sfont_t **)data = fluid_sfont_registry_load(&slow_fileapi, slow_name, 0);
+    __atomic_store_n(&slow_loaded, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static pthread_barrier_t barrier;
+static const char *shared_name;
+
+/* loads the shared SoundFont along with another synth, and selects its
+ * programs */
+static void *load_and_select(void *data) {
+    fluid_synth_t *synth = data;
+    int prog;
+
+    pthread_barrier_wait(&barrier);
+    assert(fluid_synth_sfload(synth, shared_name, 1) != FLUID_FAILED);
+    for (prog = 0; prog < 128; prog++) {
+        fluid_synth_program_change(synth, 0, prog);
+    }
+    fluid_synth_program_reset(synth);
+    return NULL;
+}
+
+/* loads slow_name on a thread, returns once it opens the file */
+static void start_slow_load(pthread_t *thread, const char *filename, fluid_sfont_t **sfont) {
+    slow_name = filename;
+    __atomic_store_n(&slow_opening, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slow_loaded, 0, __ATOMIC_RELEASE);
+    assert(pthread_create(thread, NULL, slow_load, sfont) == 0);
+    while (!__atomic_load_n(&slow_opening, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+}
+#endif
+
+static void copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb"), *out = fopen(to, "wb");
+    char buf[4096];
+    size_t n;
+
+    assert(in != NULL && out != NULL);
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        assert(fwrite(buf, 1, n, out) == n);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/* synths sharing a SoundFont load it once, play it as their own copy and
+ * keep their own bank offsets; it goes with the last of them */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    const char *copy = "tmp_share.sf2";
+    float *ref = calloc(2 * LEN, sizeof(float));
+    float *out_a = calloc(2 * LEN, sizeof(float)), *out_b = calloc(2 * LEN, sizeof(float));
+    fluid_synth_t *a, *b, *c;
+    player_t pa, pb;
+    int id_a, id_b, id_c, other;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    /* the reference, a SoundFont of its own */
+    c = new_synth(false, 0);
+    id_c = fluid_synth_sfload(c, filename, 1);
+    assert(id_c != FLUID_FAILED);
+    assert(!fluid_synth_get_sfont_by_id(c, id_c)->is_shared);
+    pa.synth = c;
+    pa.out = ref;
+    play(&pa);
+    assert(fluid_sfont_registry_count() == 0);
+
+    a = new_synth(true, 0);
+    b = new_synth(true, 0);
+    other = fluid_synth_sfload(a, "example/sf_/Boomwhacker.sf2", 1);
+    id_a = fluid_synth_sfload(a, filename, 1);
+    id_b = fluid_synth_sfload(b, filename, 1);
+    assert(other != FLUID_FAILED && id_a != FLUID_FAILED && id_a == id_b && id_a != other);
+    assert(fluid_synth_get_sfont_by_id(a, id_a) == fluid_synth_get_sfont_by_id(b, id_b));
+    assert(fluid_synth_get_sfont_by_id(a, id_a)->is_shared);
+    assert(fluid_sfont_registry_count() == 2);
+
+    /* the bank offsets are the synth's */
+    assert(fluid_synth_set_bank_offset(a, id_a, 10) == FLUID_OK);
+    assert(fluid_synth_get_bank_offset(a, id_a) == 10);
+    assert(fluid_synth_get_bank_offset(b, id_b) == 0);
+    assert(fluid_synth_program_select(a, 0, id_a, 10, 0) == FLUID_OK);
+    assert(fluid_synth_program_select(b, 0, id_b, 0, 0) == FLUID_OK);
+
+    /* both play at once, as each would alone */
+    pa.synth = a;
+    pa.out = out_a;
+    pb.synth = b;
+    pb.out = out_b;
+#ifdef WITH_THREADS
+    {
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, play, &pa) == 0);
+        play(&pb);
+        pthread_join(thread, NULL);
+    }
+#else
+    play(&pa);
+    play(&pb);
+#endif
+    assert(memcmp(ref, out_a, 2 * LEN * sizeof(float)) == 0);
+    assert(memcmp(ref, out_b, 2 * LEN * sizeof(float)) == 0);
+
+    /* unloaded by one while it plays, still there for the other */
+    fluid_synth_noteon(a, 0, 60, 100);
+    fluid_synth_noteon(b, 0, 60, 100);
+    assert(fluid_synth_sfunload(a, id_a, 1) == FLUID_OK);
+    assert(playing(a) == 0);
+    assert(playing(b) > 0);
+    assert(fluid_sfont_registry_count() == 2);
+    fluid_synth_system_reset(b);
+    memset(out_b, 0, 2 * LEN * sizeof(float));
+    play(&pb);
+    assert(memcmp(ref, out_b, 2 * LEN * sizeof(float)) == 0);
+    fluid_synth_system_reset(b);
+    assert(fluid_synth_sfunload(b, id_b, 1) == FLUID_OK);
+    assert(fluid_sfont_registry_count() == 1);
+
+    /* a file changed since is loaded again */
+    copy_file(filename, copy);
+    id_a = fluid_synth_sfload(a, copy, 1);
+    copy_file("example/sf_/Boomwhacker.sf2", copy);
+    id_b = fluid_synth_sfload(b, copy, 1);
+    assert(id_a != FLUID_FAILED && id_b != FLUID_FAILED && id_a != id_b);
+    assert(fluid_sfont_registry_count() == 3);
+
+    /* paged SoundFonts are the synth's own */
+    delete_fluid_synth(c);
+    c = new_synth(true, 1);
+    id_c = fluid_synth_sfload(c, filename, 1);
+    assert(id_c != FLUID_FAILED && !fluid_synth_get_sfont_by_id(c, id_c)->is_shared);
+    assert(fluid_sfont_registry_count() == 3);
+
+    delete_fluid_synth(a);
+    delete_fluid_synth(b);
+    delete_fluid_synth(c);
+    assert(fluid_sfont_registry_count() == 0);
+
+#ifdef WITH_THREADS
+    /* loaded and played from on two threads at once, nothing writes to it */
+    {
+        pthread_t thread;
+
+        a = new_synth(true, 0);
+        b = new_synth(true, 0);
+        shared_name = filename;
+        pthread_barrier_init(&barrier, NULL, 2);
+        assert(pthread_create(&thread, NULL, load_and_select, a) == 0);
+        load_and_select(b);
+        pthread_join(thread, NULL);
+        pthread_barrier_destroy(&barrier);
+        assert(fluid_sfont_registry_count() == 1);
+        assert(fluid_list_get(a->sfont) == fluid_list_get(b->sfont));
+        delete_fluid_synth(a);
+        delete_fluid_synth(b);
+        assert(fluid_sfont_registry_count() == 0);
+    }
+
+    /* a file that loads holds up its own users only */
+    {
+        pthread_t thread;
+        fluid_sfont_t *slow_sfont, *sfont;
+
+        slow_fileapi = default_fileapi;
+        slow_fileapi.fopen = slow_fopen;
+        start_slow_load(&thread, filename, &slow_sfont);
+        sfont = fluid_sfont_registry_load(&slow_fileapi, "example/sf_/Boomwhacker.sf2", 0);
+        assert(sfont != NULL && fluid_sfont_registry_new_id() > 0);
+        assert(!__atomic_load_n(&slow_loaded, __ATOMIC_ACQUIRE));
+        assert(fluid_sfont_registry_release(sfont) == FLUID_OK);
+        sfont = fluid_sfont_registry_load(&slow_fileapi, filename, 0);
+        pthread_join(thread, NULL);
+        assert(sfont != NULL && sfont == slow_sfont);
+        assert(fluid_sfont_registry_count() == 1);
+        assert(fluid_sfont_registry_release(sfont) == FLUID_OK);
+        assert(fluid_sfont_registry_release(sfont) == FLUID_OK);
+
+        /* a file that fails to load fails its waiters too */
+        start_slow_load(&thread, "no_such_file.sf2", &slow_sfont);
+        sfont = fluid_sfont_registry_load(&slow_fileapi, "no_such_file.sf2", 0);
+        pthread_join(thread, NULL);
+        assert(sfont == NULL && slow_sfont == NULL);
+        assert(fluid_sfont_registry_count() == 0);
+    }
+#endif
+
+    remove(copy);
+    free(ref);
+    free(out_a);
+    free(out_b);
+    printf("test_sfont_share passed\n");
+    return 0;
+}
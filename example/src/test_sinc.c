@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#ifdef WITH_THREADS
+#include <pthread.h>
+#endif
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_dsp_simd.h"
+
+/* a looped sine of LOOP points */
+#define LOOP 200
+#define AMP 16000.0
+#define BLOCKS 64
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+/* the first output samples see the start of the sample, not the loop */
+#define SKIP 32
+
+#ifndef WITH_FIXED
+static short data[LOOP];
+static fluid_sample_t sample;
+
+/* the sine plays 'cycles' periods per sample point, at 'incr' points per
+ * output sample */
+static void render(int interp, double cycles, double incr, fluid_bus_t *out) {
+    fluid_voice_bank_t *bank = new_fluid_voice_bank(1);
+    fluid_voice_t *voice = new_fluid_voice(bank, 0, 44100, FLUID_BUFSIZE);
+    int i, b, count;
+
+    for (i = 0; i < LOOP; i++) {
+        data[i] = (short)(AMP * sin(2.0 * M_PI * cycles * i));
+    }
+    sample.data = data;
+    voice->sample = &sample;
+    voice->dsp_data = data;
+    voice->gen[GEN_SAMPLEMODE].val = FLUID_LOOP_DURING_RELEASE;
+    voice->start = 0;
+    voice->end = LOOP - 1;
+    voice->loopstart = 0;
+    voice->loopend = LOOP;
+    voice->has_looped = 0;
+    fluid_phase_set_int(_DSP(voice, phase), 0);
+    _DSP(voice, phase_incr) = incr;
+    _DSP(voice, amp) = 1.0f;
+    _DSP(voice, amp_incr) = 0.0f;
+
+    for (b = 0; b < BLOCKS; b++) {
+        voice->dsp_buf = out + b * FLUID_BUFSIZE;
+        voice->dsp_buf_size = FLUID_BUFSIZE;
+        if (interp == FLUID_INTERP_4THORDER) {
+            count = fluid_dsp_float_interpolate_4th_order(voice);
+        } else {
+            count = fluid_dsp_float_interpolate_sinc(voice, interp);
+        }
+        assert(count == FLUID_BUFSIZE);
+    }
+
+    delete_fluid_voice(voice);
+    delete_fluid_voice_bank(bank);
+}
+
+static double rms(const fluid_bus_t *out) {
+    double e = 0;
+    int i;
+    for (i = SKIP; i < LEN; i++) e += (double)out[i] * out[i];
+    return sqrt(e / (LEN - SKIP));
+}
+
+/* the largest difference to the sine at the output rate */
+static double error(const fluid_bus_t *out, double cycles, double incr) {
+    double d, max = 0;
+    int i;
+    for (i = SKIP; i < LEN; i++) {
+        d = fabs(out[i] - AMP * sin(2.0 * M_PI * cycles * fmod(i * incr, LOOP)));
+        if (d > max) max = d;
+    }
+    return max;
+}
+#endif
+
+#ifdef WITH_THREADS
+#define THREADS 4
+
+static pthread_barrier_t barrier;
+
+/* a synth of its own selects the 32 point sinc along with the others and
+ * plays a note with it */
+static void *play_sinc(void *data) {
+    float *out = data;
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .with_chorus = false);
+    int id, b;
+
+    assert(synth != NULL);
+    id = fluid_synth_sfload(synth, "example/sf_/Boomwhacker.sf2", 1);
+    assert(id != FLUID_FAILED);
+    pthread_barrier_wait(&barrier);
+    assert(fluid_synth_set_interp_method(synth, -1, FLUID_INTERP_SINC32) == FLUID_OK);
+    fluid_synth_noteon(synth, 0, 72, 100);
+    for (b = 0; b < BLOCKS; b++) {
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 2 * b * FLUID_BUFSIZE, 2, out,
+                                2 * b * FLUID_BUFSIZE + 1, 2);
+    }
+    delete_fluid_synth(synth);
+    return NULL;
+}
+#endif
+
+/* a sine below the Nyquist frequency comes out as it went in, one above
+ * the Nyquist frequency of the pitch shifted sample is removed instead of
+ * aliased, with and without the vector kernels */
+int main(int argc, char *argv[]) {
+    static const int sincs[] = {FLUID_INTERP_SINC8, FLUID_INTERP_SINC16, FLUID_INTERP_SINC32};
+#ifndef WITH_FIXED
+    /* the largest error of a sine in the pass band, and the alias left in
+     * dB of the sine, by points */
+    static const double max_error[] = {0.01, 0.001, 0.001};
+    static const double max_alias_dB[] = {-15.0, -36.0, -60.0};
+#endif
+    fluid_synth_t *synth = NEW_FLUID_SYNTH();
+    fluid_bus_t *out = calloc(LEN, sizeof(fluid_bus_t)), *ref = calloc(LEN, sizeof(fluid_bus_t));
+    int i;
+
+#ifdef WITH_THREADS
+    /* the synths of several threads select it for the first time at once,
+     * and all play from the same table */
+    {
+        pthread_t threads[THREADS];
+        float *outs = calloc(THREADS * 2 * LEN, sizeof(float));
+
+        pthread_barrier_init(&barrier, NULL, THREADS);
+        for (i = 0; i < THREADS; i++) {
+            assert(pthread_create(&threads[i], NULL, play_sinc, outs + i * 2 * LEN) == 0);
+        }
+        for (i = 0; i < THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        pthread_barrier_destroy(&barrier);
+        for (i = 1; i < THREADS; i++) {
+            assert(memcmp(outs, outs + i * 2 * LEN, 2 * LEN * sizeof(float)) == 0);
+        }
+        free(outs);
+    }
+#endif
+
+    /* the tables are made when a sinc is selected */
+    for (i = 0; i < 3; i++) {
+        assert(fluid_synth_set_interp_method(synth, -1, sincs[i]) == FLUID_OK);
+    }
+
+#ifdef WITH_FIXED
+    printf("test_sinc: 4th order interpolation with WITH_FIXED\n");
+#else
+    {
+        fluid_dsp_simd_t kernels = fluid_dsp_simd;
+        double alias4, alias;
+        int k;
+
+        /* 0.7 of the Nyquist frequency of the sample, an octave up */
+        render(FLUID_INTERP_4THORDER, 0.35, 2.0, ref);
+        alias4 = 20 * log10(rms(ref) / AMP);
+        for (i = 0; i < 3; i++) {
+            /* in the pass band, at a fraction of a point */
+            render(sincs[i], 0.1, 1.25, out);
+            printf("sinc %d: error %g", sincs[i], error(out, 0.1, 1.25) / AMP);
+            assert(error(out, 0.1, 1.25) < max_error[i] * AMP);
+
+            render(sincs[i], 0.35, 2.0, out);
+            alias = 20 * log10(rms(out) / AMP);
+            printf(", alias %.1f dB (4th order %.1f dB)\n", alias, alias4);
+            assert(alias < max_alias_dB[i]);
+
+            /* the scalar loop sums in another order */
+            fluid_dsp_simd.interp_sinc = NULL;
+            render(sincs[i], 0.1, 1.25, ref);
+            fluid_dsp_simd = kernels;
+            render(sincs[i], 0.1, 1.25, out);
+            for (k = 0; k < LEN; k++) {
+                assert(fabs(out[k] - ref[k]) < 1e-6 * AMP);
+            }
+        }
+    }
+#endif
+
+    delete_fluid_synth(synth);
+    free(out);
+    free(ref);
+    printf("test_sinc passed\n");
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define BLOCKS 64
+#define LEN (BLOCKS * FLUID_BUFSIZE)
+
+static fluid_synth_t *new_synth(const char *filename, double smoothing_time) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 8,
+                                           .smoothing_time = smoothing_time);
+    int sfont;
+
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    fluid_synth_program_select(synth, 0, sfont, 0, 0);
+    return synth;
+}
+
+static fluid_voice_t *playing_voice(fluid_synth_t *synth) {
+    int i;
+    for (i = 0; i < synth->polyphony; i++) {
+        if (_PLAYING(synth->voice[i])) return synth->voice[i];
+    }
+    return NULL;
+}
+
+/* a melody with no controller changes */
+static void play(fluid_synth_t *synth, float *out) {
+    static const int keys[] = {60, 64, 67, 72};
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        fluid_synth_noteon(synth, 0, keys[i], 100);
+        fluid_synth_write_float(synth, LEN / 4, out, 0, 2, out, 1, 2);
+        out += LEN / 2;
+    }
+}
+
+#ifndef WITH_FIXED
+/* a note panned hard left after one block, the right side of every block
+ * relative to the left one */
+static void pan_left(const char *filename, double smoothing_time, float *ratio) {
+    fluid_synth_t *synth = new_synth(filename, smoothing_time);
+    float left[LEN], right[LEN];
+    int b, i;
+
+    fluid_synth_noteon(synth, 0, 60, 110);
+    for (b = 0; b < BLOCKS; b++) {
+        float l = 0, r = 0;
+        if (b == 1) fluid_synth_cc(synth, 0, 10, 0);
+        fluid_synth_write_float(synth, FLUID_BUFSIZE, left, b * FLUID_BUFSIZE, 1, right,
+                                b * FLUID_BUFSIZE, 1);
+        for (i = b * FLUID_BUFSIZE; i < (b + 1) * FLUID_BUFSIZE; i++) {
+            l += fabsf(left[i]);
+            r += fabsf(right[i]);
+        }
+        assert(l > 0);
+        ratio[b] = r / l;
+    }
+    delete_fluid_synth(synth);
+}
+
+/* the pan and the volume ramp where they stepped at the next block */
+static void check_ramps(const char *filename) {
+    float out[2 * FLUID_BUFSIZE * BLOCKS], step[BLOCKS], ramp[BLOCKS];
+    fluid_synth_t *synth;
+    fluid_voice_t *voice;
+    fluid_real_t att;
+    int b, n = (int)(0.05 * 44100 / FLUID_BUFSIZE);
+
+    /* the pan jumps at the block after the change, or glides over 50 ms */
+    pan_left(filename, 0, step);
+    pan_left(filename, 0.05, ramp);
+    assert(step[0] > 0.9 && ramp[0] == step[0]);
+    assert(step[1] < 0.001);
+    assert(ramp[1] > 0.9);
+    for (b = 2; b <= n; b++) {
+        assert(ramp[b] < ramp[b - 1]);
+        assert(ramp[b - 1] - ramp[b] < 0.1);
+    }
+    for (b = n + 2; b < BLOCKS; b++) {
+        assert(ramp[b] < 0.001);
+    }
+
+    /* the volume reaches the envelope block by block */
+    synth = new_synth(filename, 0.05);
+    fluid_synth_noteon(synth, 0, 60, 110);
+    fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 0, 2, out, 1, 2);
+    voice = playing_voice(synth);
+    assert(voice != NULL);
+    att = voice->attenuation;
+    fluid_synth_cc(synth, 0, 7, 20);
+    assert(voice->attenuation > att);
+    fluid_synth_write_float(synth, FLUID_BUFSIZE, out, 0, 2, out, 1, 2);
+    assert(voice->smooth_attenuation.val > att);
+    assert(voice->smooth_attenuation.val < voice->attenuation);
+    fluid_synth_write_float(synth, n * FLUID_BUFSIZE, out, 0, 2, out, 1, 2);
+    assert(voice->smooth_attenuation.val == voice->attenuation);
+
+    /* switched off, the next change applies at once */
+    fluid_synth_set_smoothing_time(synth, 0);
+    assert(voice->smooth_samples == 0);
+    delete_fluid_synth(synth);
+}
+#endif
+
+/* controller changes ramp over the smoothing time instead of stepping at
+ * the next block, and nothing else changes */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    float ref[2 * LEN], smooth[2 * LEN];
+    fluid_synth_t *synth;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    /* without changes the ramps never start */
+    synth = new_synth(filename, 0);
+    play(synth, ref);
+    delete_fluid_synth(synth);
+    synth = new_synth(filename, 0.05);
+    play(synth, smooth);
+    delete_fluid_synth(synth);
+    assert(memcmp(ref, smooth, sizeof(ref)) == 0);
+
+#ifdef WITH_FIXED
+    /* the changes apply at the next block */
+    synth = new_synth(filename, 0.05);
+    fluid_synth_noteon(synth, 0, 60, 110);
+    assert(playing_voice(synth)->smooth_samples == 0);
+    delete_fluid_synth(synth);
+    printf("test_smoothing: no smoothing with WITH_FIXED\n");
+#else
+    check_ramps(filename);
+#endif
+
+    printf("test_smoothing passed\n");
+    return 0;
+}
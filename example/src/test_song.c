@@ -150,6 +150,11 @@ int main(int argc, char *argv[])
     if(is_8bit){
 #ifdef __linux__
         int ret;
+#ifdef WITH_FIXED
+        // 整数渲染：每个采样与浮点参考最多相差 1
+        ret = compare_binary_files("song8.pcm", "example/song8.pcm", false);
+        assert(ret == 0);
+#else
         if(sizeof(fluid_real_t) == 4){
             ret = compare_binary_files("song8.pcm", "example/song8.pcm", true);
             assert(ret <= 3);
@@ -157,6 +162,7 @@ int main(int argc, char *argv[])
             ret = compare_binary_files("song8.pcm", "example/song8.pcm", false);
             assert(ret == 0);
         }
+#endif
 #endif
         system("ffmpeg -hide_banner -y -f u8 -ar 44100 -ac 1 -i song8.pcm -acodec pcm_u8 song8.wav >nul 2>&1");
     }else{
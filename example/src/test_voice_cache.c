@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define BLOCKS 8
+#define ROUNDS 6
+
+static fluid_synth_t *new_synth(const char *filename, int cache_size) {
+    fluid_synth_t *synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = 64,
+                                           .midi_channels = 4,
+                                           .voice_cache_size = cache_size);
+    int sfont, chan;
+
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    for (chan = 0; chan < 4; chan++) {
+        fluid_synth_program_select(synth, chan, sfont, 0, 0);
+    }
+    return synth;
+}
+
+/* a drum-like pattern of repeated notes, with the channel changes that
+ * have to miss the cache in between */
+static void play(fluid_synth_t *synth, float *out) {
+    static const int keys[] = {36, 38, 42, 42, 36, 38, 42, 46};
+    double pitch[12] = {0, 10, -20, 30, 0, 0, 5, 0, 0, -15, 0, 0};
+    int round, i;
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < 8; i++) {
+            fluid_synth_noteon(synth, i % 2, keys[i], 90 + (i % 3) * 10);
+            fluid_synth_noteon(synth, 2, keys[i] + 24, 100);
+            fluid_synth_write_float(synth, BLOCKS * FLUID_BUFSIZE, out, 0, 2, out, 1, 2);
+            out += 2 * BLOCKS * FLUID_BUFSIZE;
+            fluid_synth_noteoff(synth, i % 2, keys[i]);
+            fluid_synth_noteoff(synth, 2, keys[i] + 24);
+        }
+
+        switch (round) {
+        case 0:
+            fluid_synth_set_gain(synth, 0.3f);
+            break;
+        case 1:
+            fluid_synth_cc(synth, 0, 7, 60);
+            fluid_synth_cc(synth, 1, 10, 10);
+            break;
+        case 2:
+            fluid_synth_pitch_bend(synth, 1, 10000);
+            fluid_synth_key_pressure(synth, 0, 42, 90);
+            break;
+        case 3:
+            fluid_synth_set_gen2(synth, 0, GEN_FILTERFC, 6000, 0);
+            fluid_synth_create_octave_tuning(synth, 0, 0, "test", pitch);
+            fluid_synth_activate_tuning(synth, 2, 0, 0, 0);
+            break;
+        case 4:
+            pitch[2] = 25;
+            fluid_synth_create_octave_tuning(synth, 0, 0, "test", pitch);
+            break;
+        }
+    }
+}
+
+/* the voices started from the cache sound exactly like the ones worked
+ * out from the soundfont */
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    size_t len = (size_t)2 * ROUNDS * 8 * BLOCKS * FLUID_BUFSIZE;
+    float *ref = calloc(len, sizeof(float)), *cached = calloc(len, sizeof(float));
+    fluid_synth_t *synth;
+    unsigned int hits, misses;
+    int sizes[2] = {6, 64}, i;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    synth = new_synth(filename, 0);
+    assert(synth->voice_cache == NULL);
+    play(synth, ref);
+    delete_fluid_synth(synth);
+
+    /* one that evicts and one that keeps every note */
+    for (i = 0; i < 2; i++) {
+        synth = new_synth(filename, sizes[i]);
+        memset(cached, 0, len * sizeof(float));
+        play(synth, cached);
+        hits = fluid_voice_cache_hits(synth->voice_cache);
+        misses = fluid_voice_cache_misses(synth->voice_cache);
+        delete_fluid_synth(synth);
+
+        assert(memcmp(ref, cached, len * sizeof(float)) == 0);
+        assert(hits > 0 && misses > 0);
+        printf("cache of %d: %u hits, %u misses\n", sizes[i], hits, misses);
+    }
+
+    free(ref);
+    free(cached);
+    printf("test_voice_cache passed\n");
+    return 0;
+}
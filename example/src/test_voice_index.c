@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define POLYPHONY 256
+#define EXCL_CHANNEL 9
+
+static int list_contains(fluid_voice_link_t *head, fluid_voice_link_t *link) {
+    fluid_voice_link_t *l;
+    for (l = head->next; l != head; l = l->next) {
+        assert(l->next->prev == l);
+        if (l == link) return 1;
+    }
+    return 0;
+}
+
+/* every playing voice is in the lists of its channel and key, and of its
+ * channel's exclusive class voices if it has a class */
+static void check_lists(fluid_synth_t *synth) {
+    int i;
+
+    for (i = 0; i < synth->polyphony; i++) {
+        fluid_voice_t *voice = synth->voice[i];
+        if (!_PLAYING(voice)) continue;
+        assert(list_contains(&synth->chan_voices[voice->chan], &voice->chan_link));
+        assert(list_contains(&synth->key_voices[voice->chan * 128 + voice->key],
+                             &voice->key_link));
+        if (_GEN(voice, GEN_EXCLUSIVECLASS) != 0) {
+            assert(list_contains(&synth->excl_voices[voice->chan], &voice->excl_link));
+        }
+    }
+}
+
+static void render(fluid_synth_t *synth, int blocks) {
+    float buf[2 * FLUID_BUFSIZE];
+    while (blocks-- > 0) fluid_synth_render_float(synth, FLUID_BUFSIZE, buf, 1);
+}
+
+static int count_on(fluid_synth_t *synth, int chan, int key) {
+    int i, n = 0;
+    for (i = 0; i < synth->polyphony; i++) {
+        fluid_voice_t *voice = synth->voice[i];
+        if (_ON(voice) && voice->chan == chan && voice->key == key) n++;
+    }
+    return n;
+}
+
+/* voices of the note not yet in their release */
+static int count_held(fluid_synth_t *synth, int chan, int key) {
+    int i, n = 0;
+    for (i = 0; i < synth->polyphony; i++) {
+        fluid_voice_t *voice = synth->voice[i];
+        if (_ON(voice) && voice->chan == chan && voice->key == key &&
+            voice->volenv_section != FLUID_VOICE_ENVRELEASE) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/* many notes on many channels, released in another order, with the voices
+ * reused for the next round */
+static void check_notes(fluid_synth_t *synth) {
+    int round, chan, key;
+
+    for (round = 0; round < 4; round++) {
+        for (chan = 0; chan < 8; chan++) {
+            for (key = 40 + round; key < 80; key += 3) {
+                fluid_synth_noteon(synth, chan, key, 100);
+            }
+        }
+        check_lists(synth);
+        /* past the minimum note length */
+        render(synth, 32);
+
+        for (key = 79; key >= 40; key--) {
+            for (chan = 0; chan < 8; chan++) {
+                if ((chan + key) % 2 == 0) {
+                    fluid_synth_noteoff(synth, chan, key);
+                    assert(count_on(synth, chan, key) == 0);
+                }
+            }
+        }
+        check_lists(synth);
+        render(synth, 1);
+
+        /* the same note again releases the first one */
+        fluid_synth_noteon(synth, 1, 61, 100);
+        fluid_synth_noteon(synth, 1, 61, 100);
+        assert(count_on(synth, 1, 61) > 0);
+        check_lists(synth);
+
+        fluid_synth_all_notes_off(synth, 3);
+        for (key = 0; key < 128; key++) assert(count_on(synth, 3, key) == 0);
+        fluid_synth_all_sounds_off(synth, 5);
+        check_lists(synth);
+
+        for (chan = 0; chan < 8; chan++) fluid_synth_all_sounds_off(synth, chan);
+        render(synth, 1);
+        /* the stopped voices leave the list on the next lookup */
+        fluid_synth_all_notes_off(synth, 0);
+        assert(synth->chan_voices[0].next == &synth->chan_voices[0]);
+    }
+}
+
+/* a note of an exclusive class stops the playing notes of its class on
+ * the channel, only those. The soundfont has no exclusive classes, the
+ * channel generator puts the notes of the channel in class 1, also those
+ * already playing. */
+static void check_exclusive_class(fluid_synth_t *synth) {
+    fluid_synth_noteon(synth, EXCL_CHANNEL + 1, 46, 100);
+    fluid_synth_noteon(synth, EXCL_CHANNEL, 46, 100);
+    fluid_synth_set_gen2(synth, EXCL_CHANNEL, GEN_EXCLUSIVECLASS, 1, 0);
+    check_lists(synth);
+    render(synth, 1);
+
+    fluid_synth_noteon(synth, EXCL_CHANNEL, 38, 100);
+    check_lists(synth);
+    assert(count_held(synth, EXCL_CHANNEL, 46) == 0);
+    assert(count_held(synth, EXCL_CHANNEL, 38) > 0);
+    render(synth, 1);
+
+    fluid_synth_noteon(synth, EXCL_CHANNEL, 42, 100);
+    check_lists(synth);
+    assert(count_held(synth, EXCL_CHANNEL, 38) == 0);
+    assert(count_held(synth, EXCL_CHANNEL, 42) > 0);
+    assert(count_held(synth, EXCL_CHANNEL + 1, 46) > 0);
+
+    /* back to no class */
+    fluid_synth_set_gen2(synth, EXCL_CHANNEL, GEN_EXCLUSIVECLASS, 0, 0);
+    fluid_synth_noteon(synth, EXCL_CHANNEL, 36, 100);
+    check_lists(synth);
+    assert(synth->excl_voices[EXCL_CHANNEL].next == &synth->excl_voices[EXCL_CHANNEL]);
+    assert(count_held(synth, EXCL_CHANNEL, 42) > 0);
+    assert(count_held(synth, EXCL_CHANNEL, 36) > 0);
+
+    fluid_synth_system_reset(synth);
+    render(synth, 1);
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    fluid_synth_t *synth;
+    int sfont, chan;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = POLYPHONY,
+                            .midi_channels = 16);
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    for (chan = 0; chan < 16; chan++) {
+        fluid_synth_program_select(synth, chan, sfont, 0, 0);
+    }
+
+    check_notes(synth);
+    check_exclusive_class(synth);
+
+    delete_fluid_synth(synth);
+    printf("test_voice_index passed\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+
+#define POLYPHONY 24
+#define NUM_STEPS 4000
+
+/* the voice the linear search of fluid_synth_free_voice_by_kill() used
+ * to pick */
+static fluid_voice_t *expected_victim(fluid_synth_t *synth) {
+    fluid_real_t best_prio = 999999., prio;
+    fluid_voice_t *best = NULL;
+    int i;
+
+    for (i = 0; i < synth->polyphony; i++) {
+        fluid_voice_t *voice = synth->voice[i];
+        if (_AVAILABLE(voice)) return voice;
+
+        prio = 10000.;
+        if (_RELEASED(voice)) prio -= 2000.;
+        if (_SUSTAINED(voice)) prio -= 1000;
+        prio -= (synth->noteid - fluid_voice_get_id(voice));
+        if (voice->volenv_section != FLUID_VOICE_ENVATTACK) {
+            prio += voice->volenv_val * 1000.;
+        }
+        if (prio < best_prio) best = voice, best_prio = prio;
+    }
+    return best;
+}
+
+static fluid_voice_t *first_available(fluid_synth_t *synth) {
+    int i;
+    for (i = 0; i < synth->polyphony; i++) {
+        if (_AVAILABLE(synth->voice[i])) return synth->voice[i];
+    }
+    return NULL;
+}
+
+/* notes, releases, the sustain pedal and rendering in random order; every
+ * note-on takes the first available voice, or steals the voice the
+ * linear search picked */
+static void check_random(fluid_synth_t *synth) {
+    float buf[2 * FLUID_BUFSIZE];
+    int step, stolen = 0;
+
+    srand(1);
+    for (step = 0; step < NUM_STEPS; step++) {
+        int chan = rand() % 4, key = 36 + rand() % 48, op = rand() % 16;
+        fluid_voice_t *expected;
+        unsigned int id;
+
+        if (op < 6) {
+            /* what the note-on does before it allocates */
+            fluid_synth_release_voice_on_same_note(synth, chan, key);
+            expected = first_available(synth);
+            if (expected == NULL) {
+                expected = expected_victim(synth);
+                stolen++;
+            }
+            id = synth->noteid;
+            fluid_synth_noteon(synth, chan, key, 30 + rand() % 98);
+            assert(_PLAYING(expected) && fluid_voice_get_id(expected) == id);
+        } else if (op < 10) {
+            fluid_synth_noteoff(synth, chan, key);
+        } else if (op == 10) {
+            fluid_synth_cc(synth, chan, 64, (rand() % 2) * 127);
+        } else if (op == 11) {
+            /* straight to the queue */
+            expected = expected_victim(synth);
+            assert(fluid_synth_free_voice_by_kill(synth) == expected);
+            assert(_AVAILABLE(expected));
+        } else if (op == 12 && rand() % 8 == 0) {
+            fluid_synth_all_sounds_off(synth, chan);
+        } else {
+            fluid_synth_render_float(synth, FLUID_BUFSIZE, buf, 1);
+        }
+    }
+    printf("%d steps, %d voices stolen\n", NUM_STEPS, stolen);
+    assert(stolen > 0);
+}
+
+/* fewer voices: the ones above the limit are neither used nor stolen */
+static void check_polyphony(fluid_synth_t *synth) {
+    float buf[2 * FLUID_BUFSIZE];
+    int key;
+
+    fluid_synth_system_reset(synth);
+    fluid_synth_set_polyphony(synth, 4);
+    for (key = 60; key < 72; key++) {
+        fluid_synth_noteon(synth, 0, key, 100);
+        fluid_synth_render_float(synth, FLUID_BUFSIZE, buf, 1);
+    }
+    for (key = 4; key < POLYPHONY; key++) assert(_AVAILABLE(synth->voice[key]));
+
+    fluid_synth_set_polyphony(synth, POLYPHONY);
+    fluid_synth_noteon(synth, 0, 80, 100);
+    assert(_PLAYING(synth->voice[4]));
+}
+
+int main(int argc, char *argv[]) {
+    char *filename = "example/sf_/GMGSx_1.sf2";
+    fluid_synth_t *synth;
+    int sfont, chan;
+
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+
+    synth = NEW_FLUID_SYNTH(.with_reverb = false, .polyphony = POLYPHONY,
+                            .midi_channels = 4);
+    assert(synth != NULL);
+    sfont = fluid_synth_sfload(synth, filename, 1);
+    assert(sfont != FLUID_FAILED);
+    for (chan = 0; chan < 4; chan++) {
+        fluid_synth_program_select(synth, chan, sfont, 0, 0);
+    }
+
+    check_random(synth);
+    check_polyphony(synth);
+
+    delete_fluid_synth(synth);
+    printf("test_voice_steal passed\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "fluidliter.h"
+#include "fluid_synth.h"
+#include "fluid_sfont.h"
+
+static fluid_sample_t sample_a, sample_b;
+
+static void add_gen(fluid_list_t **list, int num, float val) {
+    fluid_sf_gen_t *gen = FLUID_NEW(fluid_sf_gen_t);
+    gen->num = num;
+    gen->val = val;
+    *list = fluid_list_append(*list, gen);
+}
+
+static fluid_mod_list_t *add_mod(fluid_mod_list_t **list, int src1, int dest, float amount) {
+    fluid_mod_list_t *mod = FLUID_NEW(fluid_mod_list_t), **last = list;
+    memset(mod, 0, sizeof(*mod));
+    mod->src1 = src1;
+    mod->flags1 = FLUID_MOD_CC;
+    mod->dest = dest;
+    mod->amount = amount;
+    while (*last) last = &(*last)->next;
+    *last = mod;
+    return mod;
+}
+
+static fluid_inst_zone_t *inst_zone(fluid_inst_t *inst, fluid_sample_t *sample, int keylo,
+                                    int keyhi, int vello, int velhi) {
+    fluid_inst_zone_t *zone = new_fluid_inst_zone();
+    zone->sample = sample;
+    zone->keylo = keylo;
+    zone->keyhi = keyhi;
+    zone->vello = vello;
+    zone->velhi = velhi;
+    fluid_inst_add_zone(inst, zone);
+    return zone;
+}
+
+static fluid_zone_pair_t *pairs_of(fluid_preset_t *preset, int key, int vel, int *count) {
+    static fluid_zone_pair_t *found[16];
+    int k;
+
+    *count = 0;
+    for (k = preset->key_first[key]; k < preset->key_first[key + 1]; k++) {
+        fluid_zone_pair_t *pair = &preset->pairs[preset->key_pairs[k]];
+        if (vel >= pair->vello && vel <= pair->velhi) found[(*count)++] = pair;
+    }
+    return *count > 0 ? found[0] : NULL;
+}
+
+static float gen_of(fluid_zone_pair_t *pair, int num, float def) {
+    int i;
+    for (i = 0; i < pair->gen_count; i++) {
+        if (pair->gens[i].num == num) return pair->gens[i].val;
+    }
+    return def;
+}
+
+/* the pairs a note plays, with the generators and modulators of the
+ * instrument and preset levels merged as note-ons did zone by zone */
+int main(int argc, char *argv[]) {
+    fluid_preset_t *preset = new_fluid_preset(NULL);
+    fluid_preset_zone_t *global_pz = new_fluid_preset_zone(), *pz = new_fluid_preset_zone();
+    fluid_inst_t *inst = new_fluid_inst();
+    fluid_inst_zone_t *global_iz = new_fluid_inst_zone(), *iz_low, *iz_high;
+    fluid_mod_list_t *mod_a, *mod_b2;
+    fluid_zone_pair_t *pair;
+    int count;
+
+    /* instrument: the global zone, a low zone, a zone without sample and a
+     * high zone for loud notes (zones are prepended) */
+    fluid_inst_set_global_zone(inst, global_iz);
+    add_gen(&global_iz->sf_gen, GEN_ATTENUATION, 100);
+    add_gen(&global_iz->sf_gen, GEN_PAN, 10);
+    add_mod(&global_iz->mod, 1, GEN_PAN, 5);
+    add_mod(&global_iz->mod, 2, GEN_PAN, 3);
+
+    iz_high = inst_zone(inst, &sample_b, 60, 127, 64, 127);
+    inst_zone(inst, NULL, 64, 127, 0, 63);
+    iz_low = inst_zone(inst, &sample_a, 0, 63, 0, 127);
+    add_gen(&iz_low->sf_gen, GEN_ATTENUATION, 200);
+    mod_a = add_mod(&iz_low->mod, 1, GEN_PAN, 7);
+    add_mod(&iz_low->mod, 4, GEN_FILTERFC, 1);
+    mod_b2 = add_mod(&iz_low->mod, 4, GEN_FILTERFC, 2);
+    add_gen(&iz_high->sf_gen, GEN_EXCLUSIVECLASS, 3);
+
+    /* preset: the global zone and one zone over keys 50 to 100 */
+    fluid_preset_set_global_zone(preset, global_pz);
+    add_gen(&global_pz->sf_gen, GEN_COARSETUNE, 2);
+    add_gen(&global_pz->sf_gen, GEN_ATTENUATION, 1000);
+    add_gen(&global_pz->sf_gen, GEN_SAMPLEMODE, 1);
+    add_mod(&global_pz->mod, 5, GEN_ATTENUATION, 0);
+    pz->inst = inst;
+    pz->keylo = 50;
+    pz->keyhi = 100;
+    add_gen(&pz->sf_gen, GEN_ATTENUATION, 10);
+    add_gen(&pz->sf_gen, GEN_ATTENUATION, 5);
+    add_gen(&pz->sf_gen, GEN_EXCLUSIVECLASS, 9);
+    add_mod(&pz->mod, 6, GEN_ATTENUATION, 4);
+    fluid_preset_add_zone(preset, pz);
+
+    assert(fluid_preset_compile(preset) == FLUID_OK);
+
+    /* outside the preset zone */
+    assert(pairs_of(preset, 40, 100, &count) == NULL && count == 0);
+    assert(pairs_of(preset, 110, 100, &count) == NULL && count == 0);
+
+    pair = pairs_of(preset, 55, 100, &count);
+    assert(count == 1 && pair->sample == &sample_a);
+    /* the zone's own value replaces the global one, the preset zone adds
+     * both of its values and hides the global preset zone's; the global
+     * preset zone adds where the preset zone has nothing, except to the
+     * generators the preset level can't change */
+    assert(gen_of(pair, GEN_ATTENUATION, 0) == 215);
+    assert(gen_of(pair, GEN_PAN, 0) == 10);
+    assert(gen_of(pair, GEN_COARSETUNE, 0) == 2);
+    assert(gen_of(pair, GEN_SAMPLEMODE, 0) == 0);
+    assert(gen_of(pair, GEN_EXCLUSIVECLASS, 0) == 0);
+    /* the global modulator 1 gives way to the zone's, 2 stays; of the
+     * zone's identical modulators the last one; the disabled preset
+     * modulator is skipped */
+    assert(pair->inst_mod_count == 3);
+    assert(pair->mods[0]->src1 == 2 && pair->mods[0]->amount == 3);
+    assert(pair->mods[1] == (fluid_mod_t *)mod_a);
+    assert(pair->mods[2] == (fluid_mod_t *)mod_b2);
+    assert(pair->preset_mod_count == 1);
+    assert(pair->mods[3]->src1 == 6 && pair->mods[3]->amount == 4);
+
+    /* both zones for loud notes, in the order of the instrument */
+    pairs_of(preset, 62, 100, &count);
+    assert(count == 2);
+    pair = pairs_of(preset, 62, 10, &count);
+    assert(count == 1 && pair->sample == &sample_a);
+    pair = pairs_of(preset, 70, 100, &count);
+    assert(count == 1 && pair->sample == &sample_b);
+    assert(gen_of(pair, GEN_ATTENUATION, 0) == 115);
+    assert(gen_of(pair, GEN_EXCLUSIVECLASS, 0) == 3);
+    /* the zone without sample */
+    assert(pairs_of(preset, 70, 10, &count) == NULL && count == 0);
+
+    delete_fluid_preset(preset);
+    printf("test_zone_tables passed\n");
+    return 0;
+}
@@ -66,6 +66,17 @@ typedef struct _fluid_fileapi_t fluid_fileapi_t;
  *
  */
 
+/* How often the volume envelope, the LFOs and the mod envelope advance */
+enum fluid_env_mode {
+    /* Once per block: fastest, the attack and the tremolo are stepped at
+     * the block rate and a note starts on a block boundary */
+    FLUID_ENV_BLOCK = 0,
+    /* Once per sample: the volume envelope and the tremolo ramp smoothly
+     * and start on the exact sample. Pitch and filter still follow the
+     * envelopes once per block */
+    FLUID_ENV_SAMPLE = 1
+};
+
  typedef struct {
     int polyphony;
     double gain;
@@ -73,6 +84,48 @@ typedef struct _fluid_fileapi_t fluid_fileapi_t;
     bool with_reverb;
     bool with_chorus;
     int midi_channels;
+    int render_threads; /* threads rendering the voices of a block, 0 or 1
+                           renders on the caller thread. Needs WITH_THREADS */
+    int block_size;     /* samples per internal block, 0 for the default of
+                           64. Envelopes, LFOs and modulators are updated
+                           once per block: smaller blocks react faster to
+                           events, larger ones render faster */
+    int env_mode;       /* FLUID_ENV_BLOCK or FLUID_ENV_SAMPLE */
+    int event_queue_size; /* events fluid_synth_schedule_*() can queue, 0
+                             for the default of 128 */
+    int event_ring_size; /* messages fluid_synth_post_*() can queue between
+                            two blocks, 0 for none */
+    bool event_ring_multi_producer; /* several threads call
+                                       fluid_synth_post_*() */
+    int voice_cache_size; /* voices of recent note-ons kept to start the
+                             same notes again without working out their
+                             parameters, 0 for none */
+    double smoothing_time; /* seconds a change of volume, pan or send level
+                              by a controller is ramped over, 0 to apply it
+                              at the next block. Needs floating point */
+    bool filter_bypass; /* skip the filter of the voices while it is open:
+                           cutoff above 19 kHz and no resonance. Otherwise
+                           it runs as the anti-aliasing filter. Needs
+                           floating point */
+    unsigned int sample_cache_size; /* bytes of sample data a SoundFont keeps
+                                       in memory: its samples are read when
+                                       they are first played or preloaded,
+                                       and the least recently played are
+                                       dropped beyond this size. 0 loads all
+                                       of it with the SoundFont */
+    unsigned int stream_head_ms; /* milliseconds of every sample (and its
+                                    loop) loaded with a SoundFont, the rest
+                                    is read from the file by a thread while
+                                    it plays. 0 loads all of it. Needs
+                                    WITH_THREADS, wins over
+                                    sample_cache_size */
+    bool stream_offline; /* rendering waits for the streamed samples
+                            instead of playing silence where they are late,
+                            for rendering to a file */
+    bool share_sfonts; /* a SoundFont file another synth of the process
+                          loaded with this set is shared rather than loaded
+                          again. Bank offsets stay per synth. Not for paged
+                          SoundFonts */
 } SynthParams;
 
 /** Creates a new synthesizer object.
@@ -155,6 +208,62 @@ int fluid_synth_sysex(fluid_synth_t *synth, const char *data,
                                      int len, char *response, int *response_len,
                                      int *handled, int dryrun);
 
+/*
+ * Timestamped MIDI channel messages
+ *
+ * The fluid_synth_schedule_*() functions queue a message that plays
+ * 'frame' frames after the next frame the write and render functions
+ * output. A host can queue the messages of a whole buffer and render it
+ * with a single call without losing their timing.
+ *
+ * Note-ons start on their frame. Note-offs start the release on their
+ * frame with FLUID_ENV_SAMPLE, and on the nearest block boundary with
+ * FLUID_ENV_BLOCK. Controllers, pitch bends and program changes take
+ * effect at the start of the block that contains their frame, since the
+ * voices are updated once per block. A frame inside a block that was
+ * already rendered by a previous call plays at the start of the next one.
+ *
+ * Messages on the same frame play in the order they were queued. Returns
+ * FLUID_FAILED if the queue (SynthParams.event_queue_size) is full or an
+ * argument is out of range.
+ */
+int fluid_synth_schedule_noteon(fluid_synth_t *synth, unsigned int frame, int chan,
+                                int key, int vel);
+int fluid_synth_schedule_noteoff(fluid_synth_t *synth, unsigned int frame, int chan,
+                                 int key);
+int fluid_synth_schedule_cc(fluid_synth_t *synth, unsigned int frame, int chan,
+                            int ctrl, int val);
+int fluid_synth_schedule_pitch_bend(fluid_synth_t *synth, unsigned int frame, int chan,
+                                    int val);
+int fluid_synth_schedule_program_change(fluid_synth_t *synth, unsigned int frame,
+                                        int chan, int program);
+
+/*
+ * MIDI channel messages from other threads
+ *
+ * The fluid_synth_*() functions above change the channels and voices
+ * directly and must be called on the thread that renders. The
+ * fluid_synth_post_*() functions may be called on any other thread: they
+ * queue the message in a lock-free ring (SynthParams.event_ring_size),
+ * and the rendering thread plays the queued messages at the start of the
+ * next block. Neither side ever blocks.
+ *
+ * Only one thread may post, unless the synth was created with
+ * SynthParams.event_ring_multi_producer. Returns FLUID_FAILED if the
+ * synth has no ring or the ring is full; full rings are counted by
+ * fluid_synth_get_post_overflows().
+ */
+int fluid_synth_post_noteon(fluid_synth_t *synth, int chan, int key, int vel);
+int fluid_synth_post_noteoff(fluid_synth_t *synth, int chan, int key);
+int fluid_synth_post_cc(fluid_synth_t *synth, int chan, int ctrl, int val);
+int fluid_synth_post_pitch_bend(fluid_synth_t *synth, int chan, int val);
+int fluid_synth_post_program_change(fluid_synth_t *synth, int chan, int program);
+int fluid_synth_post_channel_pressure(fluid_synth_t *synth, int chan, int val);
+int fluid_synth_post_key_pressure(fluid_synth_t *synth, int chan, int key, int val);
+
+/** Messages fluid_synth_post_*() rejected because the ring was full. */
+unsigned int fluid_synth_get_post_overflows(fluid_synth_t *synth);
+
 /** Select a bank. Returns 0 if no error occurred, -1 otherwise. */
 
 int fluid_synth_bank_select(fluid_synth_t *synth, int chan, unsigned int bank);
@@ -250,8 +359,23 @@ void fluid_synth_set_preset_callback(void *callback);
 int fluid_synth_sfload(fluid_synth_t *synth, const char *filename,
                        int reset_presets);
 
+/** Compiles a SoundFont into a bank that fluid_synth_sfload() loads
+    without parsing it: its samples and presets are stored the way the
+    library holds them once loaded, with the sample data. Only a library
+    built with the same options (WITH_FLOAT, pointer size, byte order)
+    loads the bank.
+
+    \param filename The SoundFont, read with the default file API
+    \param bank_file The compiled bank to write
+    \returns 0 if no error, -1 otherwise
+*/
+int fluid_bank_compile(const char *filename, const char *bank_file);
 
-/** Removes a SoundFont from the stack and deallocates it.
+
+/** Removes a SoundFont from the stack and deallocates it. A SoundFont
+    shared with other synths (SynthParams.share_sfonts) is deallocated when
+    the last of them removes it. The voices of the synth playing it are
+    turned off.
 
     \param synth The synthesizer object
     \param id The id of the SoundFont
@@ -261,6 +385,28 @@ int fluid_synth_sfload(fluid_synth_t *synth, const char *filename,
 int fluid_synth_sfunload(fluid_synth_t *synth, unsigned int id,
                                         int reset_presets);
 
+/** Reads the samples of a preset of a SoundFont loaded with
+    SynthParams.sample_cache_size, so that its first notes don't wait for
+    the file. Built with WITH_THREADS they are read on a thread of the
+    synth and the call returns at once, otherwise they are read before it
+    returns.
+
+    \param synth The synthesizer object
+    \param id The id of the SoundFont
+    \param bank The bank number of the preset
+    \param prog The program number of the preset
+    \returns 0 if no error, -1 if there is no such preset
+*/
+int fluid_synth_preload(fluid_synth_t *synth, unsigned int id, unsigned int bank,
+                        unsigned int prog);
+
+/** Waits until the presets passed to fluid_synth_preload() are read */
+void fluid_synth_preload_wait(fluid_synth_t *synth);
+
+/** Returns the number of voice chunks rendered with points of a streamed
+    sample missing, played as silence (SynthParams.stream_head_ms) */
+unsigned int fluid_synth_get_stream_underruns(fluid_synth_t *synth);
+
 /** Add a SoundFont. The SoundFont will be put on top of
     the SoundFont stack.
 
@@ -273,7 +419,8 @@ int fluid_synth_add_sfont(fluid_synth_t *synth,
 
 /** Remove a SoundFont that was previously added using
  *  fluid_synth_add_sfont(). The synthesizer does not delete the
- *  SoundFont; this is responsability of the caller.
+ *  SoundFont; this is responsability of the caller. The voices playing it
+ *  are turned off.
 
     \param synth The synthesizer object
     \param sfont The SoundFont
@@ -373,6 +520,14 @@ void fluid_synth_set_gain(fluid_synth_t *synth, float gain);
 /** Get the master gain */
 float fluid_synth_get_gain(fluid_synth_t *synth);
 
+/** Set the time in seconds the changes of volume, pan and send levels are
+    ramped over (SynthParams.smoothing_time) */
+void fluid_synth_set_smoothing_time(fluid_synth_t *synth, double seconds);
+
+/** Returns the number of voice blocks rendered without the filter
+    (SynthParams.filter_bypass) */
+unsigned int fluid_synth_get_filter_bypass_count(fluid_synth_t *synth);
+
 /** Set the polyphony limit (FluidSynth >= 1.0.6) */
 int fluid_synth_set_polyphony(fluid_synth_t *synth,
                                              int polyphony);
@@ -380,6 +535,12 @@ int fluid_synth_set_polyphony(fluid_synth_t *synth,
 /** Get the polyphony limit (FluidSynth >= 1.0.6) */
 int fluid_synth_get_polyphony(fluid_synth_t *synth);
 
+/** Returns 1 if the synth is idle, 0 otherwise. A synth is idle when no
+    voice is playing and the reverb and chorus tails have decayed below
+    the noise floor. An idle synth renders zeros without running the
+    voices or the effects, the next note wakes it up. */
+int fluid_synth_is_idle(fluid_synth_t *synth);
+
 /** Get the internal buffer size. The internal buffer size if not the
     same thing as the buffer size specified in the
     settings. Internally, the synth *always* uses a specific buffer
@@ -407,7 +568,14 @@ enum fluid_interp {
     FLUID_INTERP_DEFAULT = 4,
     FLUID_INTERP_4THORDER = 4,
     FLUID_INTERP_7THORDER = 7,
-    FLUID_INTERP_HIGHEST=7
+    FLUID_INTERP_HIGHEST=7,
+    /* Band-limited polyphase sinc with 8, 16 or 32 points. The cutoff
+     * follows the pitch, so samples played several octaves up don't
+     * alias. Slow, meant for offline renders; the tables are made when a
+     * channel first selects it. WITH_FIXED uses 4th order instead */
+    FLUID_INTERP_SINC8 = 8,
+    FLUID_INTERP_SINC16 = 16,
+    FLUID_INTERP_SINC32 = 32
 };
 
 /*
@@ -597,6 +765,36 @@ int fluid_synth_write_u8(fluid_synth_t *synth, int len,
 int fluid_synth_write_u8_mono(fluid_synth_t *synth, int len,
                                              uint8_t *out);
 
+/** Render a number of frames into a single interleaved buffer.
+ *
+ *  Unlike fluid_synth_write_s16() and friends, which test the internal
+ *  block position for every frame, these functions render whole internal
+ *  blocks and convert them with vectorized kernels. A partially consumed
+ *  block left over by a previous write or render call is drained first,
+ *  and any unused part of the last block is kept for the next call, so
+ *  both API families can be mixed freely on the same synth.
+ *
+ *  The u8 variant saturates to 0..255, the u12 variant produces the same
+ *  values as fluid_synth_write_u12().
+ *
+ *  \param synth The synthesizer
+ *  \param len The number of frames to generate
+ *  \param out The interleaved output buffer, len * channels samples long
+ *  \param channels 1 for mono (left channel only) or 2 for stereo
+ *  \returns FLUID_OK on success, FLUID_FAILED on invalid arguments
+ */
+int fluid_synth_render_s16(fluid_synth_t *synth, int len, int16_t *out,
+                           int channels);
+
+int fluid_synth_render_u12(fluid_synth_t *synth, int len, uint16_t *out,
+                           int channels);
+
+int fluid_synth_render_u8(fluid_synth_t *synth, int len, uint8_t *out,
+                          int channels);
+
+int fluid_synth_render_float(fluid_synth_t *synth, int len, float *out,
+                             int channels);
+
 /** Generate a number of samples. This function expects two floating
  *  point buffers (left and right channel) that will be filled with
  *  samples.
@@ -694,10 +892,26 @@ struct _fluid_fileapi_t {
 
     /** @return returns current file offset or #FLUID_FAILED on error */
     long (*ftell)(void *handle);
+
+    /**
+     * Releases \c count bytes returned by \c fread_zero_memcpy when the
+     * SoundFont is unloaded. May be NULL if the memory outlives the synth.
+     */
+    void (*free_zero_memcpy)(void *buf, int count);
 };
 
 void fluid_set_default_fileapi(fluid_fileapi_t *fileapi);
 
+/**
+ * A file API that maps the sample data of a SoundFont read-only into memory
+ * instead of reading it, so that processes loading the same file share its
+ * pages. Select it with fluid_set_default_fileapi() before
+ * fluid_synth_sfload().
+ *
+ * @return the file API, or NULL where there is no mmap()
+ */
+fluid_fileapi_t *fluid_get_mmap_fileapi(void);
+
 #define fluid_fileapi_delete(_fileapi)                                         \
     {                                                                          \
         if ((_fileapi) && (_fileapi)->free) (*(_fileapi)->free)(_fileapi);     \
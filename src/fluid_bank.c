@@ -0,0 +1,461 @@
+#include "fluid_bank.h"
+#include "fluid_sample_stream.h"
+
+#define FLUID_BANK_ALIGN(_n) (((_n) + 15) & ~(uint32_t)15)
+
+/* the types whose layout the image has */
+static void fluid_bank_layout(uint16_t *layout) {
+    layout[0] = 0x0102; /* the byte order */
+    layout[1] = sizeof(void *);
+    layout[2] = sizeof(fluid_real_t);
+    layout[3] = sizeof(fluid_list_t);
+    layout[4] = sizeof(fluid_sample_t);
+    layout[5] = sizeof(fluid_preset_t);
+    layout[6] = sizeof(fluid_zone_pair_t);
+    layout[7] = sizeof(fluid_mod_t);
+}
+
+/***************************************************************
+ *
+ *                           COMPILER
+ */
+
+typedef struct _fluid_bank_builder_t {
+    char *image;
+    uint32_t *reloc;
+    uint32_t reloc_count;
+} fluid_bank_builder_t;
+
+/* stores the pointer at 'slot' as the offset 'target' into the image, to
+ * be relocated when it is loaded */
+static void fluid_bank_set_ptr(fluid_bank_builder_t *b, void *slot, uint32_t target) {
+    uintptr_t ptr = target;
+
+    FLUID_MEMCPY(slot, &ptr, sizeof(ptr));
+    b->reloc[b->reloc_count++] = (uint32_t)((char *)slot - b->image);
+}
+
+/* the generators and modulators of the pairs of the preset */
+static void fluid_bank_count(fluid_preset_t *preset, uint32_t *gens, uint32_t *mods) {
+    int i;
+
+    *gens = *mods = 0;
+    for (i = 0; i < preset->pair_count; i++) {
+        *gens += preset->pairs[i].gen_count;
+        *mods += preset->pairs[i].inst_mod_count + preset->pairs[i].preset_mod_count;
+    }
+}
+
+/* the tables of the preset, from 'off' on; returns where they end */
+static uint32_t fluid_bank_add_preset(fluid_bank_builder_t *b, fluid_preset_t *dst,
+                                      fluid_preset_t *preset, uint32_t samples,
+                                      uint32_t off) {
+    uint32_t pairs, keys, gens, mod_ptrs, mods, gen_count, mod_count, i;
+    fluid_zone_pair_t *src, *pair;
+    fluid_sf_gen_t *gen;
+    fluid_mod_t *mod;
+
+    fluid_bank_count(preset, &gen_count, &mod_count);
+    pairs = off;
+    keys = pairs + FLUID_BANK_ALIGN(preset->pair_count * sizeof(fluid_zone_pair_t));
+    gens = keys + FLUID_BANK_ALIGN(preset->key_first[128] * sizeof(uint16_t));
+    mod_ptrs = gens + FLUID_BANK_ALIGN(gen_count * sizeof(fluid_sf_gen_t));
+    mods = mod_ptrs + FLUID_BANK_ALIGN(mod_count * sizeof(fluid_mod_t *));
+    off = mods + FLUID_BANK_ALIGN(mod_count * sizeof(fluid_mod_t));
+
+    FLUID_MEMCPY(dst->name, preset->name, sizeof(dst->name));
+    dst->bank = preset->bank;
+    dst->num = preset->num;
+    dst->pair_count = preset->pair_count;
+    FLUID_MEMCPY(dst->key_first, preset->key_first, sizeof(dst->key_first));
+    fluid_bank_set_ptr(b, &dst->pairs, pairs);
+    fluid_bank_set_ptr(b, &dst->key_pairs, keys);
+    fluid_bank_set_ptr(b, &dst->pair_gens, gens);
+    fluid_bank_set_ptr(b, &dst->pair_mods, mod_ptrs);
+
+    for (i = 0; i < preset->pair_count; i++) {
+        src = &preset->pairs[i];
+        pair = (fluid_zone_pair_t *)(b->image + pairs) + i;
+        pair->keylo = src->keylo;
+        pair->keyhi = src->keyhi;
+        pair->vello = src->vello;
+        pair->velhi = src->velhi;
+        pair->gen_count = src->gen_count;
+        pair->inst_mod_count = src->inst_mod_count;
+        pair->preset_mod_count = src->preset_mod_count;
+        fluid_bank_set_ptr(b, &pair->sample,
+                           samples + src->sample->idx_in_sfont * sizeof(fluid_sample_t));
+        fluid_bank_set_ptr(b, &pair->gens,
+                           gens + (src->gens - preset->pair_gens) * sizeof(fluid_sf_gen_t));
+        fluid_bank_set_ptr(b, &pair->mods,
+                           mod_ptrs + (src->mods - preset->pair_mods) * sizeof(fluid_mod_t *));
+    }
+
+    FLUID_MEMCPY(b->image + keys, preset->key_pairs, preset->key_first[128] * sizeof(uint16_t));
+
+    for (i = 0; i < gen_count; i++) {
+        gen = (fluid_sf_gen_t *)(b->image + gens) + i;
+        gen->num = preset->pair_gens[i].num;
+        gen->val = preset->pair_gens[i].val;
+    }
+
+    /* the modulators are shared with the zones, a pair gets copies */
+    for (i = 0; i < mod_count; i++) {
+        mod = (fluid_mod_t *)(b->image + mods) + i;
+        mod->dest = preset->pair_mods[i]->dest;
+        mod->src1 = preset->pair_mods[i]->src1;
+        mod->flags1 = preset->pair_mods[i]->flags1;
+        mod->src2 = preset->pair_mods[i]->src2;
+        mod->flags2 = preset->pair_mods[i]->flags2;
+        mod->amount = preset->pair_mods[i]->amount;
+        fluid_bank_set_ptr(b, (fluid_mod_t **)(b->image + mod_ptrs) + i,
+                           mods + i * sizeof(fluid_mod_t));
+    }
+    return off;
+}
+
+int fluid_bank_compile(const char *filename, const char *bank_file) {
+    fluid_sfont_t *sfont;
+    fluid_bank_builder_t b = {NULL, NULL, 0};
+    fluid_bank_header_t *header;
+    fluid_preset_t *preset, *dst;
+    fluid_sample_t *sample, *s;
+    fluid_list_t *list, *node;
+    uint32_t samples, sample_list, presets, size, gens, mods, pair_count = 0, mod_count = 0;
+    uint32_t preset_count = 0, i;
+    FILE *out = NULL;
+    static const char zero[16] = {0};
+    int err = FLUID_FAILED;
+
+    sfont = fluid_soundfont_load(fluid_get_default_fileapi(), filename);
+    if (sfont == NULL) {
+        FLUID_LOG(FLUID_ERR, "Couldn't load soundfont file");
+        return FLUID_FAILED;
+    }
+
+    /* sizes */
+    samples = FLUID_BANK_ALIGN(sizeof(fluid_bank_header_t));
+    sample_list = samples + FLUID_BANK_ALIGN(sfont->sample_count * sizeof(fluid_sample_t));
+    presets = sample_list + FLUID_BANK_ALIGN(sfont->sample_count * sizeof(fluid_list_t));
+    for (preset = sfont->preset; preset != NULL; preset = preset->next) {
+        preset_count++;
+    }
+    size = presets + FLUID_BANK_ALIGN(preset_count * sizeof(fluid_preset_t));
+    for (preset = sfont->preset; preset != NULL; preset = preset->next) {
+        fluid_bank_count(preset, &gens, &mods);
+        size += FLUID_BANK_ALIGN(preset->pair_count * sizeof(fluid_zone_pair_t)) +
+                FLUID_BANK_ALIGN(preset->key_first[128] * sizeof(uint16_t)) +
+                FLUID_BANK_ALIGN(gens * sizeof(fluid_sf_gen_t)) +
+                FLUID_BANK_ALIGN(mods * sizeof(fluid_mod_t *)) +
+                FLUID_BANK_ALIGN(mods * sizeof(fluid_mod_t));
+        pair_count += preset->pair_count;
+        mod_count += mods;
+    }
+
+    b.image = FLUID_MALLOC(size);
+    b.reloc = FLUID_ARRAY(uint32_t, 2 * sfont->sample_count + 5 * preset_count +
+                                        3 * pair_count + mod_count + 1);
+    if (b.image == NULL || b.reloc == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    FLUID_MEMSET(b.image, 0, size);
+
+    /* the samples, without their data */
+    for (list = sfont->sample; list; list = fluid_list_next(list)) {
+        sample = (fluid_sample_t *)fluid_list_get(list);
+        i = sample->idx_in_sfont;
+        s = (fluid_sample_t *)(b.image + samples) + i;
+        FLUID_MEMCPY(s->name, sample->name, sizeof(s->name));
+        s->start = sample->start;
+        s->end = sample->end;
+        s->loopstart = sample->loopstart;
+        s->loopend = sample->loopend;
+        s->samplerate = sample->samplerate;
+        s->origpitch = sample->origpitch;
+        s->pitchadj = sample->pitchadj;
+        s->sampletype = sample->sampletype;
+        s->valid = sample->valid;
+        s->idx_in_sfont = sample->idx_in_sfont;
+
+        node = (fluid_list_t *)(b.image + sample_list) + i;
+        fluid_bank_set_ptr(&b, &node->data, samples + i * sizeof(fluid_sample_t));
+        if (i + 1 < sfont->sample_count) {
+            fluid_bank_set_ptr(&b, &node->next, sample_list + (i + 1) * sizeof(fluid_list_t));
+        }
+    }
+
+    /* the presets in their order, each followed by its tables */
+    size = presets + FLUID_BANK_ALIGN(preset_count * sizeof(fluid_preset_t));
+    for (preset = sfont->preset, i = 0; preset != NULL; preset = preset->next, i++) {
+        dst = (fluid_preset_t *)(b.image + presets) + i;
+        if (preset->next != NULL) {
+            fluid_bank_set_ptr(&b, &dst->next, presets + (i + 1) * sizeof(fluid_preset_t));
+        }
+        size = fluid_bank_add_preset(&b, dst, preset, samples, size);
+    }
+
+    header = (fluid_bank_header_t *)b.image;
+    FLUID_MEMCPY(header->magic, FLUID_BANK_MAGIC, sizeof(header->magic));
+    header->version = FLUID_BANK_VERSION;
+    fluid_bank_layout(header->layout);
+    header->image_size = size + b.reloc_count * sizeof(uint32_t);
+    header->reloc = size;
+    header->reloc_count = b.reloc_count;
+    header->samples = sample_list;
+    header->sample_count = sfont->sample_count;
+    header->presets = presets;
+    header->preset_count = preset_count;
+    header->samplepos = FLUID_BANK_ALIGN(header->image_size);
+    header->samplesize = sfont->samplesize;
+
+    out = FLUID_FOPEN(bank_file, "wb");
+    if (out == NULL) {
+        FLUID_LOG(FLUID_ERR, "Unable to open file \"%s\"", bank_file);
+        goto error_recovery;
+    }
+    if (fwrite(b.image, size, 1, out) != 1 ||
+        (b.reloc_count > 0 && fwrite(b.reloc, b.reloc_count * sizeof(uint32_t), 1, out) != 1) ||
+        (header->samplepos > header->image_size &&
+         fwrite(zero, header->samplepos - header->image_size, 1, out) != 1) ||
+        (sfont->samplesize > 0 && fwrite(sfont->sampledata, sfont->samplesize, 1, out) != 1)) {
+        FLUID_LOG(FLUID_ERR, "Failed to write compiled bank \"%s\"", bank_file);
+        goto error_recovery;
+    }
+    err = FLUID_OK;
+
+error_recovery:
+    if (out != NULL && FLUID_FCLOSE(out) != 0) {
+        FLUID_LOG(FLUID_ERR, "Failed to write compiled bank \"%s\"", bank_file);
+        err = FLUID_FAILED;
+    }
+    FLUID_FREE(b.reloc);
+    FLUID_FREE(b.image);
+    delete_fluid_sfont(sfont);
+    return err;
+}
+
+/***************************************************************
+ *
+ *                           LOADER
+ */
+
+int fluid_bank_is_compiled(const char *filename, fluid_fileapi_t *fapi) {
+    char magic[4];
+    void *fd;
+    int compiled;
+
+    fd = fapi->fopen(fapi, filename);
+    if (fd == NULL) {
+        return 0;
+    }
+    compiled = fapi->fread(magic, sizeof(magic), fd) == FLUID_OK &&
+               FLUID_STRNCMP(magic, FLUID_BANK_MAGIC, sizeof(magic)) == 0;
+    fapi->fclose(fd);
+    return compiled;
+}
+
+/* the 'count' items of 'size' bytes at 'ptr' are within the tables of the
+ * image, which end at 'end' */
+static int fluid_bank_in_tables(const char *image, uint32_t end, const void *ptr,
+                                uint32_t count, size_t size) {
+    uintptr_t off = (uintptr_t)ptr - (uintptr_t)image;
+
+    return (uintptr_t)ptr >= (uintptr_t)image && off <= end && count <= (end - off) / size;
+}
+
+/* the tables of the preset stay within the image and its pairs play the
+ * samples of the bank */
+static int fluid_bank_check_preset(const char *image, uint32_t end, fluid_preset_t *preset,
+                                   fluid_sample_t *samples, uint32_t sample_count) {
+    fluid_zone_pair_t *pair;
+    uintptr_t off;
+    int i, k;
+
+    if (!fluid_bank_in_tables(image, end, preset->pairs, preset->pair_count,
+                              sizeof(fluid_zone_pair_t)) ||
+        !fluid_bank_in_tables(image, end, preset->key_pairs, preset->key_first[128],
+                              sizeof(uint16_t))) {
+        return FLUID_FAILED;
+    }
+    for (k = 0; k < 128; k++) {
+        if (preset->key_first[k] > preset->key_first[k + 1]) return FLUID_FAILED;
+    }
+    for (k = 0; k < preset->key_first[128]; k++) {
+        if (preset->key_pairs[k] >= preset->pair_count) return FLUID_FAILED;
+    }
+
+    for (i = 0; i < preset->pair_count; i++) {
+        pair = &preset->pairs[i];
+        off = (uintptr_t)pair->sample - (uintptr_t)samples;
+        if ((uintptr_t)pair->sample < (uintptr_t)samples || off % sizeof(fluid_sample_t) != 0 ||
+            off / sizeof(fluid_sample_t) >= sample_count) {
+            return FLUID_FAILED;
+        }
+        if (!fluid_bank_in_tables(image, end, pair->gens, pair->gen_count,
+                                  sizeof(fluid_sf_gen_t)) ||
+            !fluid_bank_in_tables(image, end, pair->mods,
+                                  pair->inst_mod_count + pair->preset_mod_count,
+                                  sizeof(fluid_mod_t *))) {
+            return FLUID_FAILED;
+        }
+        for (k = 0; k < pair->inst_mod_count + pair->preset_mod_count; k++) {
+            if (!fluid_bank_in_tables(image, end, pair->mods[k], 1, sizeof(fluid_mod_t))) {
+                return FLUID_FAILED;
+            }
+        }
+    }
+    return FLUID_OK;
+}
+
+/* On failure, the image and whatever was loaded with it go with the
+ * SoundFont in delete_fluid_sfont() */
+int fluid_bank_load(fluid_sfont_t *sfont, fluid_fileapi_t *fapi) {
+    fluid_bank_header_t header;
+    uint16_t layout[8];
+    uint32_t *reloc, i;
+    uintptr_t ptr;
+    char *image;
+    fluid_list_t *nodes;
+    fluid_sample_t *samples, *sample;
+    fluid_preset_t *presets, *preset;
+    void *fd;
+
+    fd = fapi->fopen(fapi, sfont->filename);
+    if (fd == NULL) {
+        FLUID_LOG(FLUID_ERR, "Can't open soundfont file");
+        return FLUID_FAILED;
+    }
+    if (fapi->fread(&header, sizeof(header), fd) == FLUID_FAILED) {
+        goto error_recovery;
+    }
+
+    fluid_bank_layout(layout);
+    if (header.version != FLUID_BANK_VERSION ||
+        FLUID_MEMCMP(header.layout, layout, sizeof(layout)) != 0) {
+        FLUID_LOG(FLUID_ERR, "Compiled bank \"%s\" was built by another build of the library",
+                  sfont->filename);
+        goto error_recovery;
+    }
+    if (header.reloc < sizeof(header) || header.reloc > header.image_size ||
+        header.reloc_count > (header.image_size - header.reloc) / sizeof(uint32_t) ||
+        header.sample_count > UINT16_MAX ||
+        header.samples > header.reloc ||
+        header.sample_count > (header.reloc - header.samples) / sizeof(fluid_list_t) ||
+        header.presets > header.reloc ||
+        header.preset_count > (header.reloc - header.presets) / sizeof(fluid_preset_t)) {
+        FLUID_LOG(FLUID_ERR, "Compiled bank \"%s\" is corrupt", sfont->filename);
+        goto error_recovery;
+    }
+
+    /* the tables, in one block */
+    image = FLUID_MALLOC(header.image_size);
+    if (image == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    sfont->image = image;
+    if (fapi->fseek(fd, 0, SEEK_SET) == FLUID_FAILED ||
+        fapi->fread(image, header.image_size, fd) == FLUID_FAILED) {
+        goto error_recovery;
+    }
+    fapi->fclose(fd);
+
+    /* its pointers are offsets into it */
+    reloc = (uint32_t *)(image + header.reloc);
+    for (i = 0; i < header.reloc_count; i++) {
+        if (reloc[i] > header.reloc - sizeof(ptr)) {
+            goto corrupt;
+        }
+        FLUID_MEMCPY(&ptr, image + reloc[i], sizeof(ptr));
+        if (ptr > header.reloc) {
+            goto corrupt;
+        }
+        ptr += (uintptr_t)image;
+        FLUID_MEMCPY(image + reloc[i], &ptr, sizeof(ptr));
+    }
+
+    /* the lists are linked by their counts, the pointers the loader sets
+     * aren't taken from the file */
+    nodes = (fluid_list_t *)(image + header.samples);
+    samples = header.sample_count > 0 ? (fluid_sample_t *)nodes[0].data : NULL;
+    if (header.sample_count > 0 &&
+        !fluid_bank_in_tables(image, header.reloc, samples, header.sample_count,
+                              sizeof(fluid_sample_t))) {
+        goto corrupt;
+    }
+    for (i = 0; i < header.sample_count; i++) {
+        if (nodes[i].data != &samples[i]) {
+            goto corrupt;
+        }
+        nodes[i].next = i + 1 < header.sample_count ? &nodes[i + 1] : NULL;
+        sample = &samples[i];
+        sample->idx_in_sfont = (uint16_t)i;
+        sample->data = NULL;
+        sample->refcount = 0;
+        sample->last_used = 0;
+        sample->head = NULL;
+        sample->head_points = 0;
+        sample->loop = NULL;
+        sample->loop_points = 0;
+        sample->sfont = sfont;
+        sample->amplitude_that_reaches_noise_floor_is_valid = 0;
+    }
+
+    presets = (fluid_preset_t *)(image + header.presets);
+    for (i = 0; i < header.preset_count; i++) {
+        preset = &presets[i];
+        preset->next = i + 1 < header.preset_count ? &presets[i + 1] : NULL;
+        preset->sfont = sfont;
+        preset->global_zone = NULL;
+        preset->zone = NULL;
+        if (fluid_bank_check_preset(image, header.reloc, preset, samples,
+                                    header.sample_count) != FLUID_OK) {
+            goto corrupt;
+        }
+    }
+
+    sfont->samplepos = header.samplepos;
+    sfont->samplesize = header.samplesize;
+    sfont->is_compressed = 0;
+    if ((sfont->cache_size > 0 || sfont->stream_ms > 0) && fapi->fread_zero_memcpy == NULL) {
+        /* the samples are read when they are played */
+        sfont->fileapi = fapi;
+    } else if (fluid_sfont_load_sampledata(sfont, fapi) != FLUID_OK) {
+        return FLUID_FAILED;
+    }
+
+    sfont->sample = header.sample_count > 0 ? nodes : NULL;
+    sfont->sample_count = (uint16_t)header.sample_count;
+    for (i = 0; i < header.sample_count; i++) {
+        sample = &samples[i];
+        if (sfont->fileapi != NULL) {
+            fluid_sample_set_file_pos(sample, sfont);
+        } else {
+            sample->data = sfont->sampledata;
+        }
+#if DEBUG
+        if (sample->data != NULL) fluid_voice_optimize_sample(sample);
+#endif
+    }
+
+    /* a streamed SoundFont keeps the start and the loop of its samples */
+    if (sfont->fileapi != NULL && sfont->stream_ms > 0 &&
+        fluid_sfont_stream_load(sfont) != FLUID_OK) {
+        return FLUID_FAILED;
+    }
+
+    sfont->preset = header.preset_count > 0 ? presets : NULL;
+    for (preset = sfont->preset; preset != NULL; preset = preset->next) {
+        if (preset_callback) preset_callback(preset->bank, preset->num, preset->name);
+    }
+    return FLUID_OK;
+
+corrupt:
+    FLUID_LOG(FLUID_ERR, "Compiled bank \"%s\" is corrupt", sfont->filename);
+    return FLUID_FAILED;
+
+error_recovery:
+    fapi->fclose(fd);
+    return FLUID_FAILED;
+}
@@ -0,0 +1,47 @@
+#ifndef _FLUID_BANK_H
+#define _FLUID_BANK_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_sfont.h"
+
+/*
+ * Compiled banks (fluid_bank_compile()).
+ *
+ * A compiled bank is the image of the tables of a loaded SoundFont: its
+ * samples, its presets and their zone pairs, generators and modulators
+ * as fluid_preset_compile() leaves them, followed by the sample data.
+ * Loading it reads the image in one block and adds its address to the
+ * pointers listed in its relocation table; nothing is parsed and the
+ * tables take no allocation of their own. The presets have no zones,
+ * note-ons only play the pairs.
+ *
+ * The image has the layout of the structures of the library that
+ * compiled it, a library built with other types (WITH_FLOAT, pointer
+ * size, byte order) refuses to load it.
+ */
+
+#define FLUID_BANK_MAGIC "FLBK"
+#define FLUID_BANK_VERSION 1
+
+typedef struct _fluid_bank_header_t {
+    char magic[4];         /* FLUID_BANK_MAGIC */
+    uint32_t version;      /* FLUID_BANK_VERSION */
+    uint16_t layout[8];    /* the sizes of the types in the image */
+    uint32_t image_size;   /* bytes of the image, this header included */
+    uint32_t reloc;        /* the offsets of the pointers in the image */
+    uint32_t reloc_count;
+    uint32_t samples;      /* the list of the samples */
+    uint32_t sample_count;
+    uint32_t presets;      /* the first preset */
+    uint32_t preset_count;
+    uint32_t samplepos;    /* the sample data, in the file */
+    uint32_t samplesize;
+} fluid_bank_header_t;
+
+/* the file is a compiled bank */
+int fluid_bank_is_compiled(const char *filename, fluid_fileapi_t *fapi);
+
+/* loads the compiled bank sfont->filename into the SoundFont */
+int fluid_bank_load(fluid_sfont_t *sfont, fluid_fileapi_t *fapi);
+
+#endif /* _FLUID_BANK_H */
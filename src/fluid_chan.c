@@ -19,6 +19,7 @@ fluid_channel_t *new_fluid_channel(fluid_synth_t *synth, int num) {
     chan->synth = synth;
     chan->channum = num;
     chan->preset = NULL;
+    chan->version = 0;
 
     fluid_channel_init(chan);
     fluid_channel_init_ctrl(chan, 0);
@@ -38,6 +39,7 @@ void fluid_channel_init(fluid_channel_t *chan) {
     chan->tuning = NULL;
     chan->nrpn_select = 0;
     chan->nrpn_active = 0;
+    chan->version++;
 }
 
 /*
@@ -47,6 +49,7 @@ void fluid_channel_init(fluid_channel_t *chan) {
 void fluid_channel_init_ctrl(fluid_channel_t *chan, int is_all_ctrl_off) {
     int i;
 
+    chan->version++;
     chan->channel_pressure = 0;
     chan->pitch_bend = 0x2000; /* Range is 0x4000, pitch bend wheel starts in
                                   centered position */
@@ -166,6 +169,7 @@ int fluid_channel_set_banknum(fluid_channel_t *chan, unsigned int banknum) {
 
 int fluid_channel_cc(fluid_channel_t *chan, int num, int value) {
     chan->cc[num] = value;
+    chan->version++;
 
     switch (num) {
     case SUSTAIN_SWITCH: {
@@ -310,6 +314,7 @@ int fluid_channel_get_cc(fluid_channel_t *chan, int num) {
 
 int fluid_channel_pressure(fluid_channel_t *chan, int val) {
     chan->channel_pressure = val;
+    chan->version++;
     fluid_synth_modulate_voices(chan->synth, chan->channum, 0,
                                 FLUID_MOD_CHANNELPRESSURE);
     return FLUID_OK;
@@ -317,6 +322,7 @@ int fluid_channel_pressure(fluid_channel_t *chan, int val) {
 
 int fluid_channel_pitch_bend(fluid_channel_t *chan, int val) {
     chan->pitch_bend = val;
+    chan->version++;
     fluid_synth_modulate_voices(chan->synth, chan->channum, 0,
                                 FLUID_MOD_PITCHWHEEL);
     return FLUID_OK;
@@ -324,6 +330,7 @@ int fluid_channel_pitch_bend(fluid_channel_t *chan, int val) {
 
 int fluid_channel_pitch_wheel_sens(fluid_channel_t *chan, int val) {
     chan->pitch_wheel_sensitivity = val;
+    chan->version++;
     fluid_synth_modulate_voices(chan->synth, chan->channum, 0,
                                 FLUID_MOD_PITCHWHEELSENS);
     return FLUID_OK;
@@ -339,6 +346,7 @@ int fluid_channel_get_num(fluid_channel_t *chan) {
  */
 void fluid_channel_set_interp_method(fluid_channel_t *chan, uint8_t new_method) {
     chan->interp_method = new_method;
+    chan->version++;
 }
 
 uint8_t fluid_channel_get_interp_method(fluid_channel_t *chan) {
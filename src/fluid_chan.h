@@ -36,6 +36,10 @@ struct _fluid_channel_t {
      * applied to future notes. They are copied to a voice's generators
      * in fluid_voice_init(), wihich calls fluid_gen_init().  */
     fluid_real_t gen[GEN_LAST];
+
+    /* bumped by every change that can alter the voices a note-on starts,
+     * see fluid_voice_cache.h */
+    unsigned int version;
 };
 
 fluid_channel_t *new_fluid_channel(fluid_synth_t *synth, int num);
@@ -62,15 +66,19 @@ uint8_t fluid_channel_get_interp_method(fluid_channel_t *chan);
 
 #define fluid_channel_get_key_pressure(chan, key) ((chan)->key_pressure[key])
 #define fluid_channel_set_key_pressure(chan, key, val)                         \
-    ((chan)->key_pressure[key] = (val))
+    ((chan)->version++, (chan)->key_pressure[key] = (val))
 #define fluid_channel_set_tuning(_c, _t)                                       \
-    { (_c)->tuning = _t; }
+    {                                                                          \
+        (_c)->tuning = _t;                                                     \
+        (_c)->version++;                                                       \
+    }
 #define fluid_channel_has_tuning(_c) ((_c)->tuning != NULL)
 #define fluid_channel_get_tuning(_c) ((_c)->tuning)
 #define fluid_channel_sustained(_c) ((_c)->cc[SUSTAIN_SWITCH] >= 64)
 #define fluid_channel_set_gen(_c, _n, _v)                                  \
     {                                                                          \
         (_c)->gen[_n] = _v;                                                    \
+        (_c)->version++;                                                       \
     }
 #define fluid_channel_get_gen(_c, _n) ((_c)->gen[_n])
 
@@ -80,9 +80,9 @@ void
 fluid_chorus_samplerate_change(fluid_chorus_t *chorus, fluid_real_t sample_rate){}
 
 void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
-                             fluid_real_t *left_out, fluid_real_t *right_out){}
+                             fluid_real_t *left_out, fluid_real_t *right_out, int count){}
 void fluid_chorus_processreplace(fluid_chorus_t *chorus, const fluid_real_t *in,
-                                 fluid_real_t *left_out, fluid_real_t *right_out){}
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int count){}
 #else
 
 /*-----------------------------------------------------------------------------
@@ -770,19 +770,20 @@ fluid_chorus_samplerate_change(fluid_chorus_t *chorus, fluid_real_t sample_rate)
 /**
  * Process chorus by mixing the result in output buffer.
  * @param chorus pointer on chorus unit returned by new_fluid_chorus().
- * @param in, pointer on monophonic input buffer of FLUID_BUFSIZE samples.
+ * @param in, pointer on monophonic input buffer of count samples.
  * @param left_out, right_out, pointers on stereo output buffers of
- *  FLUID_BUFSIZE samples.
+ *  count samples.
+ * @param count, number of samples to process.
  */
 void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
-                             fluid_real_t *left_out, fluid_real_t *right_out)
+                             fluid_real_t *left_out, fluid_real_t *right_out, int count)
 {
     int sample_index;
     int i;
     fluid_real_t d_out[2];               /* output stereo Left and Right  */
 
     /* foreach sample, process output sample then input sample */
-    for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
+    for(sample_index = 0; sample_index < count; sample_index++)
     {
         fluid_real_t out=0.0f; /* block output */
 
@@ -845,20 +846,21 @@ void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
 /**
  * Process chorus by putting the result in output buffer (no mixing).
  * @param chorus pointer on chorus unit returned by new_fluid_chorus().
- * @param in, pointer on monophonic input buffer of FLUID_BUFSIZE samples.
+ * @param in, pointer on monophonic input buffer of count samples.
  * @param left_out, right_out, pointers on stereo output buffers of
- *  FLUID_BUFSIZE samples.
+ *  count samples.
+ * @param count, number of samples to process.
  */
 /* Duplication of code ... (replaces sample data instead of mixing) */
 void fluid_chorus_processreplace(fluid_chorus_t *chorus, const fluid_real_t *in,
-                                 fluid_real_t *left_out, fluid_real_t *right_out)
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int count)
 {
     int sample_index;
     int i;
     fluid_real_t d_out[2];               /* output stereo Left and Right  */
 
     /* foreach sample, process output sample then input sample */
-    for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
+    for(sample_index = 0; sample_index < count; sample_index++)
     {
         fluid_real_t out=0.0f; /* block output */
 
@@ -202,9 +202,9 @@ void
 fluid_chorus_samplerate_change(fluid_chorus_t *chorus, fluid_real_t sample_rate);
 
 void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
-                             fluid_real_t *left_out, fluid_real_t *right_out);
+                             fluid_real_t *left_out, fluid_real_t *right_out, int count);
 void fluid_chorus_processreplace(fluid_chorus_t *chorus, const fluid_real_t *in,
-                                 fluid_real_t *left_out, fluid_real_t *right_out);
+                                 fluid_real_t *left_out, fluid_real_t *right_out, int count);
 
 
 
@@ -0,0 +1,484 @@
+#include "fluidsynth_priv.h"
+#include "fluid_synth.h"
+#include "fluid_voice.h"
+#include "fluid_phase.h"
+
+#ifdef WITH_FIXED
+
+/* Purpose:
+ *
+ * Integer versions of the interpolators of fluid_dsp_float.c and of the
+ * filter and mix pass of fluid_voice.c, for WITH_FIXED. The per-sample
+ * work uses integers only; the parameters are converted from the voice
+ * bank once per block.
+ *
+ * Formats:
+ * - interpolation coefficients: Q14
+ * - amplitude and its increment: Q24
+ * - dsp_buf: 16 bit sample units with FLUID_FIXED_DSP_BITS (8) fractional
+ *   bits
+ * - filter coefficients and their increments: Q28
+ * - send gains: Q24, from dsp_buf units to the Q23 mix bus
+ *
+ * The 7th order and the sinc interpolation fall back to the 4th order one.
+ */
+
+#define FLUID_FIXED_COEFF_BITS 14
+#define FLUID_FIXED_AMP_BITS 24
+#define FLUID_FIXED_FILTER_BITS 28
+#define FLUID_FIXED_GAIN_BITS 24
+
+/* Interpolation tables, same polynomials as fluid_dsp_float_config() */
+static int32_t interp_coeff_linear_fixed[FLUID_INTERP_MAX][2];
+static int32_t interp_coeff_fixed[FLUID_INTERP_MAX][4];
+
+/* Initializes the interpolation tables, integers only. With x = i / 256
+ * every coefficient of the cubic is an integer polynomial in i over 2^25. */
+void fluid_dsp_fixed_config(void) {
+    int64_t x, x2, x3;
+    int64_t c[4];
+    int i, k;
+
+    for (i = 0; i < FLUID_INTERP_MAX; i++) {
+        x = i;
+        x2 = x * x;
+        x3 = x2 * x;
+
+        c[0] = -x * 65536 + 2 * x2 * 256 - x3;            /* x * (-0.5 + x * (1 - 0.5 * x)) */
+        c[1] = ((int64_t)1 << 25) - 5 * x2 * 256 + 3 * x3; /* 1 + x * x * (1.5 * x - 2.5) */
+        c[2] = x * 65536 + 4 * x2 * 256 - 3 * x3;          /* x * (0.5 + x * (2 - 1.5 * x)) */
+        c[3] = x3 - x2 * 256;                              /* 0.5 * x * x * (x - 1) */
+
+        for (k = 0; k < 4; k++) {
+            interp_coeff_fixed[i][k] =
+                (int32_t)((c[k] + (1 << (24 - FLUID_FIXED_COEFF_BITS))) >>
+                          (25 - FLUID_FIXED_COEFF_BITS));
+        }
+
+        interp_coeff_linear_fixed[i][0] = (FLUID_INTERP_MAX - i) << (FLUID_FIXED_COEFF_BITS - 8);
+        interp_coeff_linear_fixed[i][1] = i << (FLUID_FIXED_COEFF_BITS - 8);
+    }
+}
+
+/* fluid_real_t to a signed fixed point number with 'bits' fractional
+ * bits, saturated. Used once per block only. */
+static int32_t fluid_fixed_from_real(fluid_real_t x, int bits) {
+    x *= (fluid_real_t)((int64_t)1 << bits);
+    return x >= 2147483647.0f ? INT32_MAX : (x <= -2147483648.0f ? INT32_MIN : (int32_t)x);
+}
+
+static fluid_real_t fluid_fixed_to_real(int32_t x, int bits) {
+    return (fluid_real_t)x / (fluid_real_t)((int64_t)1 << bits);
+}
+
+/* interpolated value (Q14 sample units) times the amplitude, to dsp_buf */
+static inline int32_t fluid_fixed_amp(int32_t v, int32_t amp) {
+    return (int32_t)(((int64_t)(v >> (FLUID_FIXED_COEFF_BITS - FLUID_FIXED_DSP_BITS)) * amp) >>
+                     FLUID_FIXED_AMP_BITS);
+}
+
+#define FIXED_LINEAR(_c, _p0, _p1) ((_c)[0] * (_p0) + (_c)[1] * (_p1))
+#define FIXED_CUBIC(_c, _p0, _p1, _p2, _p3)                                    \
+    ((_c)[0] * (_p0) + (_c)[1] * (_p1) + (_c)[2] * (_p2) + (_c)[3] * (_p3))
+
+/* No interpolation. Just take the sample, which is closest to
+ * the playback pointer. */
+int fluid_dsp_fixed_interpolate_none(fluid_voice_t *voice) {
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
+    fluid_phase_t dsp_phase_incr;
+    short int *dsp_data = voice->dsp_data;
+    fluid_bus_t *dsp_buf = voice->dsp_buf;
+    int32_t dsp_amp = fluid_fixed_from_real(_DSP(voice, amp), FLUID_FIXED_AMP_BITS);
+    int32_t dsp_amp_incr = fluid_fixed_from_real(_DSP(voice, amp_incr), FLUID_FIXED_AMP_BITS);
+    unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
+    unsigned int dsp_phase_index;
+    unsigned int end_index;
+    int looping;
+
+    /* Convert playback "speed" floating point value to phase index/fract */
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
+
+    /* voice is currently looping? */
+    looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
+              (_SAMPLEMODE(voice) == FLUID_LOOP_UNTIL_RELEASE &&
+               voice->volenv_section < FLUID_VOICE_ENVRELEASE);
+
+    end_index = looping ? voice->loopend - 1 : voice->end;
+
+    while (1) {
+        dsp_phase_index = fluid_phase_index_round(dsp_phase); /* round to nearest point */
+
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont)
+                    << FLUID_FIXED_COEFF_BITS,
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index_round(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        /* break out if not looping (buffer may not be full) */
+        if (!looping) break;
+
+        /* go back to loop start */
+        if (dsp_phase_index > end_index) {
+            fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
+            voice->has_looped = 1;
+        }
+
+        /* break out if filled buffer */
+        if (dsp_i >= dsp_buf_size) break;
+    }
+
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = fluid_fixed_to_real(dsp_amp, FLUID_FIXED_AMP_BITS);
+
+    return (dsp_i);
+}
+
+/* Straight line interpolation.
+ * Returns number of samples processed (usually dsp_buf_size but could be
+ * smaller if end of sample occurs).
+ */
+_RAMFUNC int fluid_dsp_fixed_interpolate_linear(fluid_voice_t *voice) {
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
+    fluid_phase_t dsp_phase_incr;
+    short int *dsp_data = voice->dsp_data;
+    fluid_bus_t *dsp_buf = voice->dsp_buf;
+    int32_t dsp_amp = fluid_fixed_from_real(_DSP(voice, amp), FLUID_FIXED_AMP_BITS);
+    int32_t dsp_amp_incr = fluid_fixed_from_real(_DSP(voice, amp_incr), FLUID_FIXED_AMP_BITS);
+    unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
+    unsigned int dsp_phase_index;
+    unsigned int end_index;
+    int32_t point;
+    const int32_t *coeffs;
+    int looping;
+
+    /* Convert playback "speed" floating point value to phase index/fract */
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
+
+    /* voice is currently looping? */
+    looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
+              (_SAMPLEMODE(voice) == FLUID_LOOP_UNTIL_RELEASE &&
+               voice->volenv_section < FLUID_VOICE_ENVRELEASE);
+
+    /* last index before 2nd interpolation point must be specially handled */
+    end_index = (looping ? voice->loopend - 1 : voice->end) - 1;
+
+    /* 2nd interpolation point to use at end of loop or sample */
+    if (looping)
+        point = READ_SAMPLE(dsp_data, voice->loopstart, voice->sample->idx_in_sfont);
+    else
+        point = READ_SAMPLE(dsp_data, voice->end, voice->sample->idx_in_sfont);
+
+    while (1) {
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+
+        /* interpolate the sequence of sample points */
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
+            coeffs = interp_coeff_linear_fixed[fluid_phase_fract_to_tablerow(dsp_phase)];
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                FIXED_LINEAR(coeffs,
+                             READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont),
+                             READ_SAMPLE(dsp_data, dsp_phase_index + 1, voice->sample->idx_in_sfont)),
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        /* break out if buffer filled */
+        if (dsp_i >= dsp_buf_size) break;
+
+        end_index++; /* we're now interpolating the last point */
+
+        /* interpolate within last point */
+        for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++) {
+            coeffs = interp_coeff_linear_fixed[fluid_phase_fract_to_tablerow(dsp_phase)];
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                FIXED_LINEAR(coeffs,
+                             READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont),
+                             point),
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        if (!looping) break; /* break out if not looping (end of sample) */
+
+        /* go back to loop start (if past */
+        if (dsp_phase_index > end_index) {
+            fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
+            voice->has_looped = 1;
+        }
+
+        /* break out if filled buffer */
+        if (dsp_i >= dsp_buf_size) break;
+
+        end_index--; /* set end back to second to last sample point */
+    }
+
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = fluid_fixed_to_real(dsp_amp, FLUID_FIXED_AMP_BITS);
+
+    return (dsp_i);
+}
+
+/* 4th order (cubic) interpolation.
+ * Returns number of samples processed (usually dsp_buf_size but could be
+ * smaller if end of sample occurs).
+ */
+_RAMFUNC int fluid_dsp_fixed_interpolate_4th_order(fluid_voice_t *voice) {
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
+    fluid_phase_t dsp_phase_incr;
+    short int *dsp_data = voice->dsp_data;
+    fluid_bus_t *dsp_buf = voice->dsp_buf;
+    int32_t dsp_amp = fluid_fixed_from_real(_DSP(voice, amp), FLUID_FIXED_AMP_BITS);
+    int32_t dsp_amp_incr = fluid_fixed_from_real(_DSP(voice, amp_incr), FLUID_FIXED_AMP_BITS);
+    unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
+    unsigned int dsp_phase_index;
+    unsigned int start_index, end_index;
+    int32_t start_point, end_point1, end_point2;
+    const int32_t *coeffs;
+    int looping;
+
+    /* Convert playback "speed" floating point value to phase index/fract */
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
+
+    /* voice is currently looping? */
+    looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
+              (_SAMPLEMODE(voice) == FLUID_LOOP_UNTIL_RELEASE &&
+               voice->volenv_section < FLUID_VOICE_ENVRELEASE);
+
+    /* last index before 4th interpolation point must be specially handled */
+    end_index = (looping ? voice->loopend - 1 : voice->end) - 2;
+
+    if (voice->has_looped) /* set start_index and start point if looped or not */
+    {
+        start_index = voice->loopstart;
+        start_point = READ_SAMPLE(dsp_data, voice->loopend - 1, voice->sample->idx_in_sfont);
+    } else {
+        start_index = voice->start;
+        start_point = READ_SAMPLE(dsp_data, voice->start, voice->sample->idx_in_sfont);
+    }
+
+    /* get points off the end (loop start if looping, duplicate point if end) */
+    if (looping) {
+        end_point1 = READ_SAMPLE(dsp_data, voice->loopstart, voice->sample->idx_in_sfont);
+        end_point2 = READ_SAMPLE(dsp_data, voice->loopstart + 1, voice->sample->idx_in_sfont);
+    } else {
+        end_point1 = READ_SAMPLE(dsp_data, voice->end, voice->sample->idx_in_sfont);
+        end_point2 = end_point1;
+    }
+
+    while (1) {
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+
+        /* interpolate first sample point (start or loop start) if needed */
+        for (; dsp_phase_index == start_index && dsp_i < dsp_buf_size; dsp_i++) {
+            coeffs = interp_coeff_fixed[fluid_phase_fract_to_tablerow(dsp_phase)];
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                FIXED_CUBIC(coeffs, start_point,
+                            READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index + 1, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index + 2, voice->sample->idx_in_sfont)),
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        /* interpolate the sequence of sample points */
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
+            coeffs = interp_coeff_fixed[fluid_phase_fract_to_tablerow(dsp_phase)];
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                FIXED_CUBIC(coeffs,
+                            READ_SAMPLE(dsp_data, dsp_phase_index - 1, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index + 1, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index + 2, voice->sample->idx_in_sfont)),
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        /* break out if buffer filled */
+        if (dsp_i >= dsp_buf_size) break;
+
+        end_index++; /* we're now interpolating the 2nd to last point */
+
+        /* interpolate within 2nd to last point */
+        for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++) {
+            coeffs = interp_coeff_fixed[fluid_phase_fract_to_tablerow(dsp_phase)];
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                FIXED_CUBIC(coeffs,
+                            READ_SAMPLE(dsp_data, dsp_phase_index - 1, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index + 1, voice->sample->idx_in_sfont),
+                            end_point1),
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        end_index++; /* we're now interpolating the last point */
+
+        /* interpolate within the last point */
+        for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++) {
+            coeffs = interp_coeff_fixed[fluid_phase_fract_to_tablerow(dsp_phase)];
+            dsp_buf[dsp_i] = fluid_fixed_amp(
+                FIXED_CUBIC(coeffs,
+                            READ_SAMPLE(dsp_data, dsp_phase_index - 1, voice->sample->idx_in_sfont),
+                            READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont),
+                            end_point1, end_point2),
+                dsp_amp);
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        if (!looping) break; /* break out if not looping (end of sample) */
+
+        /* go back to loop start */
+        if (dsp_phase_index > end_index) {
+            fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
+
+            if (!voice->has_looped) {
+                voice->has_looped = 1;
+                start_index = voice->loopstart;
+                start_point = READ_SAMPLE(dsp_data, voice->loopend - 1, voice->sample->idx_in_sfont);
+            }
+        }
+
+        /* break out if filled buffer */
+        if (dsp_i >= dsp_buf_size) break;
+
+        end_index -= 2; /* set end back to third to last sample point */
+    }
+
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = fluid_fixed_to_real(dsp_amp, FLUID_FIXED_AMP_BITS);
+
+    return (dsp_i);
+}
+
+int fluid_dsp_fixed_interpolate_7th_order(fluid_voice_t *voice) {
+    return fluid_dsp_fixed_interpolate_4th_order(voice);
+}
+
+int fluid_dsp_fixed_interpolate_sinc(fluid_voice_t *voice, int taps) {
+    return fluid_dsp_fixed_interpolate_4th_order(voice);
+}
+
+static inline int32_t fluid_fixed_sat(int64_t x) {
+    return x > INT32_MAX ? INT32_MAX : (x < INT32_MIN ? INT32_MIN : (int32_t)x);
+}
+
+/* out (dsp_buf units) times a send gain, to the Q23 mix bus */
+static inline int32_t fluid_fixed_send(int32_t out, int32_t gain) {
+    return fluid_fixed_sat(((int64_t)out * gain) >> FLUID_FIXED_GAIN_BITS);
+}
+
+/* Purpose:
+ *
+ * The fixed point fluid_voice_effects(): filters the first 'count'
+ * samples of dsp_buf and mixes them to the left and right buses and the
+ * reverb and chorus sends (the sends may be NULL), saturating.
+ */
+_RAMFUNC void fluid_dsp_fixed_effects(fluid_voice_t *voice, int count,
+                                      fluid_bus_t *dsp_left_buf,
+                                      fluid_bus_t *dsp_right_buf,
+                                      fluid_bus_t *dsp_reverb_buf,
+                                      fluid_bus_t *dsp_chorus_buf) {
+    const fluid_bus_t *dsp_buf = voice->dsp_buf;
+    int dsp_filter_coeff_incr_count = _DSP(voice, filter_coeff_incr_count);
+    /* the send gains take dsp_buf units (sample units << DSP_BITS, where
+     * fluid_real_t has sample units) to the bus (1.0 << BUS_BITS) */
+    const int gain_bits = FLUID_FIXED_GAIN_BITS + FLUID_FIXED_BUS_BITS - FLUID_FIXED_DSP_BITS;
+    int32_t hist1 = fluid_fixed_from_real(_DSP(voice, hist1), FLUID_FIXED_DSP_BITS);
+    int32_t hist2 = fluid_fixed_from_real(_DSP(voice, hist2), FLUID_FIXED_DSP_BITS);
+    int32_t a1 = fluid_fixed_from_real(_DSP(voice, a1), FLUID_FIXED_FILTER_BITS);
+    int32_t a2 = fluid_fixed_from_real(_DSP(voice, a2), FLUID_FIXED_FILTER_BITS);
+    int32_t b02 = fluid_fixed_from_real(_DSP(voice, b02), FLUID_FIXED_FILTER_BITS);
+    int32_t b1 = fluid_fixed_from_real(_DSP(voice, b1), FLUID_FIXED_FILTER_BITS);
+    int32_t a1_incr = 0, a2_incr = 0, b02_incr = 0, b1_incr = 0;
+    int32_t amp_left = fluid_fixed_from_real(_DSP(voice, amp_left), gain_bits);
+    int32_t amp_right = fluid_fixed_from_real(_DSP(voice, amp_right), gain_bits);
+    int32_t amp_reverb = fluid_fixed_from_real(_DSP(voice, amp_reverb), gain_bits);
+    int32_t amp_chorus = fluid_fixed_from_real(_DSP(voice, amp_chorus), gain_bits);
+    int reverb = (dsp_reverb_buf != NULL) && (amp_reverb != 0);
+    int chorus = (dsp_chorus_buf != NULL) && (amp_chorus != 0);
+    int32_t centernode, out;
+    int n_incr, i;
+
+    /* While the filter is changing towards its new setting, the increments
+     * are added to the coefficients after each of the first
+     * filter_coeff_incr_count samples. */
+    n_incr = 0;
+    if (dsp_filter_coeff_incr_count > 0) {
+        n_incr = dsp_filter_coeff_incr_count < count ? dsp_filter_coeff_incr_count : count;
+        dsp_filter_coeff_incr_count -= count;
+        a1_incr = fluid_fixed_from_real(_DSP(voice, a1_incr), FLUID_FIXED_FILTER_BITS);
+        a2_incr = fluid_fixed_from_real(_DSP(voice, a2_incr), FLUID_FIXED_FILTER_BITS);
+        b02_incr = fluid_fixed_from_real(_DSP(voice, b02_incr), FLUID_FIXED_FILTER_BITS);
+        b1_incr = fluid_fixed_from_real(_DSP(voice, b1_incr), FLUID_FIXED_FILTER_BITS);
+    }
+
+    for (i = 0; i < count; i++) {
+        /* The filter is implemented in Direct-II form. */
+        centernode = fluid_fixed_sat(
+            (int64_t)dsp_buf[i] -
+            (((int64_t)a1 * hist1 + (int64_t)a2 * hist2) >> FLUID_FIXED_FILTER_BITS));
+        out = fluid_fixed_sat(((int64_t)b02 * ((int64_t)centernode + hist2) +
+                               (int64_t)b1 * hist1) >> FLUID_FIXED_FILTER_BITS);
+        hist2 = hist1;
+        hist1 = centernode;
+
+        if (i < n_incr) {
+            a1 += a1_incr;
+            a2 += a2_incr;
+            b02 += b02_incr;
+            b1 += b1_incr;
+        }
+
+        dsp_left_buf[i] = fluid_fixed_add_sat(dsp_left_buf[i], fluid_fixed_send(out, amp_left));
+        dsp_right_buf[i] = fluid_fixed_add_sat(dsp_right_buf[i], fluid_fixed_send(out, amp_right));
+        if (reverb)
+            dsp_reverb_buf[i] = fluid_fixed_add_sat(dsp_reverb_buf[i],
+                                                    fluid_fixed_send(out, amp_reverb));
+        if (chorus)
+            dsp_chorus_buf[i] = fluid_fixed_add_sat(dsp_chorus_buf[i],
+                                                    fluid_fixed_send(out, amp_chorus));
+    }
+
+    _DSP(voice, hist1) = fluid_fixed_to_real(hist1, FLUID_FIXED_DSP_BITS);
+    _DSP(voice, hist2) = fluid_fixed_to_real(hist2, FLUID_FIXED_DSP_BITS);
+    _DSP(voice, a1) = fluid_fixed_to_real(a1, FLUID_FIXED_FILTER_BITS);
+    _DSP(voice, a2) = fluid_fixed_to_real(a2, FLUID_FIXED_FILTER_BITS);
+    _DSP(voice, b02) = fluid_fixed_to_real(b02, FLUID_FIXED_FILTER_BITS);
+    _DSP(voice, b1) = fluid_fixed_to_real(b1, FLUID_FIXED_FILTER_BITS);
+    _DSP(voice, filter_coeff_incr_count) = dsp_filter_coeff_incr_count;
+}
+
+#endif /* WITH_FIXED */
@@ -2,6 +2,10 @@
 #include "fluid_synth.h"
 #include "fluid_voice.h"
 #include "fluid_phase.h"
+#include "fluid_dsp_simd.h"
+
+/* WITH_FIXED uses the interpolators of fluid_dsp_fixed.c */
+#ifndef WITH_FIXED
 
 /* Purpose:
  *
@@ -9,7 +13,8 @@
  * waveform data).
  *
  * Variables loaded from the voice structure (assigned in fluid_voice_write()):
- * - dsp_data: Pointer to the original waveform data
+ * - dsp_data: Pointer to the original waveform data, for a streamed sample
+ *              the window of it around the phase (voice->dsp_data)
  * - dsp_phase: The position in the original waveform data.
  *              This has an integer and a fractional part (between samples).
  * - dsp_phase_incr: For each output sample, the position in the original
@@ -22,7 +27,7 @@
  *
  * A couple of variables are used internally, their results are discarded:
  * - dsp_i: Index through the output buffer
- * - dsp_buf: Output buffer of floating point values (FLUID_BUFSIZE in length)
+ * - dsp_buf: Output buffer of floating point values (voice->dsp_buf_size in length)
  */
 
 #ifdef GEN_TABLE_RUNTIME
@@ -2635,19 +2640,20 @@ static const fluid_real_t interp_coeff[FLUID_INTERP_MAX][4] = {
  * the playback pointer.  Questionable quality, but very
  * efficient. */
 int fluid_dsp_float_interpolate_none(fluid_voice_t *voice) {
-    fluid_phase_t dsp_phase = voice->phase;
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
     fluid_phase_t dsp_phase_incr;
-    short int *dsp_data = voice->sample->data;
+    short int *dsp_data = voice->dsp_data;
     fluid_real_t *dsp_buf = voice->dsp_buf;
-    fluid_real_t dsp_amp = voice->amp;
-    fluid_real_t dsp_amp_incr = voice->amp_incr;
+    fluid_real_t dsp_amp = _DSP(voice, amp);
+    fluid_real_t dsp_amp_incr = _DSP(voice, amp_incr);
     unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
     unsigned int dsp_phase_index;
     unsigned int end_index;
     int looping;
 
     /* Convert playback "speed" floating point value to phase index/fract */
-    fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
 
     /* voice is currently looping? */
     looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
@@ -2661,7 +2667,15 @@ int fluid_dsp_float_interpolate_none(fluid_voice_t *voice) {
             fluid_phase_index_round(dsp_phase); /* round to nearest point */
 
         /* interpolate sequence of sample points */
-        for (; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++) {
+#ifdef FLUID_DSP_SIMD
+        if (fluid_dsp_simd.interp_none != NULL) {
+            dsp_i = fluid_dsp_simd.interp_none(dsp_data, dsp_buf, dsp_i, dsp_buf_size, &dsp_phase,
+                                           dsp_phase_incr, &dsp_amp, dsp_amp_incr,
+                                           end_index, NULL);
+            dsp_phase_index = fluid_phase_index_round(dsp_phase);
+        }
+#endif
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
             dsp_buf[dsp_i] = dsp_amp * READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont);
 
             /* increment phase and amplitude */
@@ -2681,27 +2695,28 @@ int fluid_dsp_float_interpolate_none(fluid_voice_t *voice) {
         }
 
         /* break out if filled buffer */
-        if (dsp_i >= FLUID_BUFSIZE) break;
+        if (dsp_i >= dsp_buf_size) break;
     }
 
-    voice->phase = dsp_phase;
-    voice->amp = dsp_amp;
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = dsp_amp;
 
     return (dsp_i);
 }
 
 /* Straight line interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * Returns number of samples processed (usually dsp_buf_size but could be
  * smaller if end of sample occurs).
  */
 _RAMFUNC int fluid_dsp_float_interpolate_linear(fluid_voice_t *voice) {
-    fluid_phase_t dsp_phase = voice->phase;
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
     fluid_phase_t dsp_phase_incr;
-    short int *dsp_data = voice->sample->data;
+    short int *dsp_data = voice->dsp_data;
     fluid_real_t *dsp_buf = voice->dsp_buf;
-    fluid_real_t dsp_amp = voice->amp;
-    fluid_real_t dsp_amp_incr = voice->amp_incr;
+    fluid_real_t dsp_amp = _DSP(voice, amp);
+    fluid_real_t dsp_amp_incr = _DSP(voice, amp_incr);
     unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
     unsigned int dsp_phase_index;
     unsigned int end_index;
     short int point;
@@ -2709,7 +2724,7 @@ _RAMFUNC int fluid_dsp_float_interpolate_linear(fluid_voice_t *voice) {
     int looping;
 
     /* Convert playback "speed" floating point value to phase index/fract */
-    fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
 
     /* voice is currently looping? */
     looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
@@ -2730,7 +2745,15 @@ _RAMFUNC int fluid_dsp_float_interpolate_linear(fluid_voice_t *voice) {
         dsp_phase_index = fluid_phase_index(dsp_phase);
 
         /* interpolate the sequence of sample points */
-        for (; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++) {
+#ifdef FLUID_DSP_SIMD
+        if (fluid_dsp_simd.interp_linear != NULL) {
+            dsp_i = fluid_dsp_simd.interp_linear(dsp_data, dsp_buf, dsp_i, dsp_buf_size, &dsp_phase,
+                                           dsp_phase_incr, &dsp_amp, dsp_amp_incr,
+                                           end_index, &interp_coeff_linear[0][0]);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+        }
+#endif
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
             coeffs =
                 interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] =
@@ -2744,12 +2767,12 @@ _RAMFUNC int fluid_dsp_float_interpolate_linear(fluid_voice_t *voice) {
         }
 
         /* break out if buffer filled */
-        if (dsp_i >= FLUID_BUFSIZE) break;
+        if (dsp_i >= dsp_buf_size) break;
 
         end_index++; /* we're now interpolating the last point */
 
         /* interpolate within last point */
-        for (; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++) {
+        for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++) {
             coeffs =
                 interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] = dsp_amp * (coeffs[0] * READ_SAMPLE(dsp_data, dsp_phase_index, voice->sample->idx_in_sfont) +
@@ -2770,29 +2793,30 @@ _RAMFUNC int fluid_dsp_float_interpolate_linear(fluid_voice_t *voice) {
         }
 
         /* break out if filled buffer */
-        if (dsp_i >= FLUID_BUFSIZE) break;
+        if (dsp_i >= dsp_buf_size) break;
 
         end_index--; /* set end back to second to last sample point */
     }
 
-    voice->phase = dsp_phase;
-    voice->amp = dsp_amp;
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = dsp_amp;
 
     return (dsp_i);
 }
 
 /* 4th order (cubic) interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * Returns number of samples processed (usually dsp_buf_size but could be
  * smaller if end of sample occurs).
  */
 _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
-    fluid_phase_t dsp_phase = voice->phase;
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
     fluid_phase_t dsp_phase_incr;
-    short int *dsp_data = voice->sample->data;
+    short int *dsp_data = voice->dsp_data;
     fluid_real_t *dsp_buf = voice->dsp_buf;
-    fluid_real_t dsp_amp = voice->amp;
-    fluid_real_t dsp_amp_incr = voice->amp_incr;
+    fluid_real_t dsp_amp = _DSP(voice, amp);
+    fluid_real_t dsp_amp_incr = _DSP(voice, amp_incr);
     unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
     short int start_point, end_point1, end_point2;
@@ -2800,7 +2824,7 @@ _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
     int looping;
 
     /* Convert playback "speed" floating point value to phase index/fract */
-    fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
 
     /* voice is currently looping? */
     looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
@@ -2834,7 +2858,7 @@ _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
         dsp_phase_index = fluid_phase_index(dsp_phase);
 
         /* interpolate first sample point (start or loop start) if needed */
-        for (; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE;
+        for (; dsp_phase_index == start_index && dsp_i < dsp_buf_size;
              dsp_i++) {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] =
@@ -2850,7 +2874,15 @@ _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
         }
 
         /* interpolate the sequence of sample points */
-        for (; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++) {
+#ifdef FLUID_DSP_SIMD
+        if (fluid_dsp_simd.interp_4th != NULL) {
+            dsp_i = fluid_dsp_simd.interp_4th(dsp_data, dsp_buf, dsp_i, dsp_buf_size, &dsp_phase,
+                                           dsp_phase_incr, &dsp_amp, dsp_amp_incr,
+                                           end_index, &interp_coeff[0][0]);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+        }
+#endif
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] =
                 dsp_amp * (coeffs[0] * READ_SAMPLE(dsp_data, dsp_phase_index - 1, voice->sample->idx_in_sfont) +
@@ -2865,12 +2897,12 @@ _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
         }
 
         /* break out if buffer filled */
-        if (dsp_i >= FLUID_BUFSIZE) break;
+        if (dsp_i >= dsp_buf_size) break;
 
         end_index++; /* we're now interpolating the 2nd to last point */
 
         /* interpolate within 2nd to last point */
-        for (; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++) {
+        for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++) {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] =
                 dsp_amp * (coeffs[0] * READ_SAMPLE(dsp_data, dsp_phase_index - 1, voice->sample->idx_in_sfont) +
@@ -2887,7 +2919,7 @@ _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
         end_index++; /* we're now interpolating the last point */
 
         /* interpolate within the last point */
-        for (; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++) {
+        for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++) {
             coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
             dsp_buf[dsp_i] =
                 dsp_amp * (coeffs[0] * READ_SAMPLE(dsp_data, dsp_phase_index - 1, voice->sample->idx_in_sfont) +
@@ -2914,13 +2946,13 @@ _RAMFUNC int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice) {
         }
 
         /* break out if filled buffer */
-        if (dsp_i >= FLUID_BUFSIZE) break;
+        if (dsp_i >= dsp_buf_size) break;
 
         end_index -= 2; /* set end back to third to last sample point */
     }
 
-    voice->phase = dsp_phase;
-    voice->amp = dsp_amp;
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = dsp_amp;
 
     return (dsp_i);
 }
@@ -4985,17 +5017,18 @@ static const fluid_real_t sinc_table7[256][7] = {
 
 
 /* 7th order interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * Returns number of samples processed (usually dsp_buf_size but could be
  * smaller if end of sample occurs).
  */
 int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
-  fluid_phase_t dsp_phase = voice->phase;
+  fluid_phase_t dsp_phase = _DSP(voice, phase);
   fluid_phase_t dsp_phase_incr;
-  short int *dsp_data = voice->sample->data;
+  short int *dsp_data = voice->dsp_data;
   fluid_real_t *dsp_buf = voice->dsp_buf;
-  fluid_real_t dsp_amp = voice->amp;
-  fluid_real_t dsp_amp_incr = voice->amp_incr;
+  fluid_real_t dsp_amp = _DSP(voice, amp);
+  fluid_real_t dsp_amp_incr = _DSP(voice, amp_incr);
   unsigned int dsp_i = 0;
+  unsigned int dsp_buf_size = voice->dsp_buf_size;
   unsigned int dsp_phase_index;
   unsigned int start_index, end_index;
   short int start_points[3];
@@ -5004,7 +5037,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
   int looping;
 
   /* Convert playback "speed" floating point value to phase index/fract */
-  fluid_phase_set_float (dsp_phase_incr, voice->phase_incr);
+  fluid_phase_set_float (dsp_phase_incr, _DSP(voice, phase_incr));
 
   /* add 1/2 sample to dsp_phase since 7th order interpolation is centered on
    * the 4th sample point */
@@ -5052,7 +5085,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     dsp_phase_index = fluid_phase_index (dsp_phase);
 
     /* interpolate first sample point (start or loop start) if needed */
-    for ( ; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    for ( ; dsp_phase_index == start_index && dsp_i < dsp_buf_size; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5074,7 +5107,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     start_index++;
 
     /* interpolate 2nd to first sample point (start or loop start) if needed */
-    for ( ; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    for ( ; dsp_phase_index == start_index && dsp_i < dsp_buf_size; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5096,7 +5129,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     start_index++;
 
     /* interpolate 3rd to first sample point (start or loop start) if needed */
-    for ( ; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    for ( ; dsp_phase_index == start_index && dsp_i < dsp_buf_size; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5119,7 +5152,16 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
 
 
     /* interpolate the sequence of sample points */
-    for ( ; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
+#ifdef FLUID_DSP_SIMD
+    if (fluid_dsp_simd.interp_7th != NULL)
+    {
+      dsp_i = fluid_dsp_simd.interp_7th (dsp_data, dsp_buf, dsp_i, dsp_buf_size, &dsp_phase,
+                                         dsp_phase_incr, &dsp_amp, dsp_amp_incr,
+                                         end_index, &sinc_table7[0][0]);
+      dsp_phase_index = fluid_phase_index (dsp_phase);
+    }
+#endif
+    for ( ; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5139,12 +5181,12 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     }
 
     /* break out if buffer filled */
-    if (dsp_i >= FLUID_BUFSIZE) break;
+    if (dsp_i >= dsp_buf_size) break;
 
     end_index++;	/* we're now interpolating the 3rd to last point */
 
     /* interpolate within 3rd to last point */
-    for (; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5166,7 +5208,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     end_index++;	/* we're now interpolating the 2nd to last point */
 
     /* interpolate within 2nd to last point */
-    for (; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5188,7 +5230,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     end_index++;	/* we're now interpolating the last point */
 
     /* interpolate within last point */
-    for (; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    for (; dsp_phase_index <= end_index && dsp_i < dsp_buf_size; dsp_i++)
     {
       coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
 
@@ -5225,7 +5267,7 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     }
 
     /* break out if filled buffer */
-    if (dsp_i >= FLUID_BUFSIZE) break;
+    if (dsp_i >= dsp_buf_size) break;
 
     end_index -= 3;	/* set end back to 4th to last sample point */
   }
@@ -5234,8 +5276,8 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
    * the 4th sample point (correct back to real value) */
   fluid_phase_decr (dsp_phase, (fluid_phase_t)0x80000000);
 
-  voice->phase = dsp_phase;
-  voice->amp = dsp_amp;
+  _DSP(voice, phase) = dsp_phase;
+  _DSP(voice, amp) = dsp_amp;
 
   return (dsp_i);
 }
@@ -5244,4 +5286,200 @@ int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice){
     FLUID_LOG(FLUID_WARN, "Downgrade to 4th_order.");
     return fluid_dsp_float_interpolate_4th_order(voice);
 }
-#endif
\ No newline at end of file
+#endif
+
+/*
+ * Polyphase windowed sinc (FLUID_INTERP_SINC8/16/32).
+ *
+ * Row r of a table holds the 'taps' coefficients for the fraction
+ * r / FLUID_INTERP_MAX, applied to the points from index - taps / 2 + 1 to
+ * index + taps / 2. There is a table per band: band k has its cutoff at
+ * FLUID_SINC_ROLLOFF * 2^(-k / FLUID_SINC_BANDS_PER_OCTAVE) of the
+ * Nyquist frequency of the sample, and a block uses the band for its
+ * phase increment, so the pitch shifted sample has nothing above the
+ * output Nyquist frequency. Past the last band, samples alias again.
+ */
+#define FLUID_SINC_ROLLOFF 0.9
+#define FLUID_SINC_BANDS_PER_OCTAVE 4
+#define FLUID_SINC_BANDS (4 * FLUID_SINC_BANDS_PER_OCTAVE + 1)
+
+/* the bands of the 8, 16 and 32 point tables, made on first use by the
+ * synth selecting them and read by the render threads of all synths */
+static fluid_real_t *sinc_tables[3];
+
+static int fluid_dsp_sinc_slot(int taps) {
+    return taps == 8 ? 0 : (taps == 16 ? 1 : 2);
+}
+
+/* Makes the tables of the 'taps' point sinc if they don't exist yet:
+ * FLUID_SINC_BANDS * FLUID_INTERP_MAX rows, each normalized to a gain of 1
+ * at DC. */
+int fluid_dsp_float_sinc_config(int taps) {
+    int half = taps / 2, band, r, j;
+    fluid_real_t *table, *row, *made = NULL;
+    double fc, t, h, sum, w[32];
+
+    if (__atomic_load_n(&sinc_tables[fluid_dsp_sinc_slot(taps)], __ATOMIC_ACQUIRE) != NULL) {
+        return FLUID_OK;
+    }
+
+    table = FLUID_ARRAY(fluid_real_t, FLUID_SINC_BANDS * FLUID_INTERP_MAX * taps);
+    if (table == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for (band = 0; band < FLUID_SINC_BANDS; band++) {
+        fc = FLUID_SINC_ROLLOFF * pow(2.0, -(double)band / FLUID_SINC_BANDS_PER_OCTAVE);
+        for (r = 0; r < FLUID_INTERP_MAX; r++) {
+            row = table + (band * FLUID_INTERP_MAX + r) * taps;
+            sum = 0.0;
+            for (j = 0; j < taps; j++) {
+                /* distance of point j from the playback position, and the
+                 * Blackman window over [-half, half] */
+                t = (j - (half - 1)) - (double)r / FLUID_INTERP_MAX;
+                h = t == 0.0 ? fc : sin(M_PI * fc * t) / (M_PI * t);
+                w[j] = h * (0.42 + 0.5 * cos(M_PI * t / half) + 0.08 * cos(2.0 * M_PI * t / half));
+                sum += w[j];
+            }
+            for (j = 0; j < taps; j++) {
+                row[j] = (fluid_real_t)(w[j] / sum);
+            }
+        }
+    }
+
+    /* published once written; a synth on another thread that made the
+     * same table first keeps its own */
+    if (!__atomic_compare_exchange_n(&sinc_tables[fluid_dsp_sinc_slot(taps)], &made, table, 0,
+                                     __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        FLUID_FREE(table);
+    }
+    return FLUID_OK;
+}
+
+/* the table of the band for the phase increment */
+static const fluid_real_t *fluid_dsp_sinc_table(int taps, fluid_real_t phase_incr) {
+    fluid_real_t *table = __atomic_load_n(&sinc_tables[fluid_dsp_sinc_slot(taps)],
+                                          __ATOMIC_ACQUIRE);
+    int band = 0;
+
+    if (table == NULL) return NULL;
+    if (phase_incr > 1.0f) {
+        band = (int)(FLUID_SINC_BANDS_PER_OCTAVE * log2(phase_incr));
+        if (band >= FLUID_SINC_BANDS) band = FLUID_SINC_BANDS - 1;
+    }
+    return table + band * FLUID_INTERP_MAX * taps;
+}
+
+/* Sample point 'index' for the sinc, wrapped around the loop or clamped
+ * to the start and end of the sample like the other interpolators do. */
+static FLUID_INLINE short fluid_dsp_sinc_point(fluid_voice_t *voice, const short *dsp_data,
+                                               int index, int looping) {
+    int loop = voice->loopend - voice->loopstart;
+
+    if (looping && loop > 0) {
+        while (index >= voice->loopend) index -= loop;
+    } else if (index > voice->end) {
+        index = voice->end;
+    }
+    if (voice->has_looped && loop > 0) {
+        while (index < voice->loopstart) index += loop;
+    } else if (index < voice->start) {
+        index = voice->start;
+    }
+    return READ_SAMPLE(dsp_data, index, voice->sample->idx_in_sfont);
+}
+
+/* Polyphase sinc interpolation with 'taps' points (8, 16 or 32).
+ * Returns number of samples processed (usually dsp_buf_size but could be
+ * smaller if end of sample occurs).
+ */
+int fluid_dsp_float_interpolate_sinc(fluid_voice_t *voice, int taps) {
+    fluid_phase_t dsp_phase = _DSP(voice, phase);
+    fluid_phase_t dsp_phase_incr;
+    short int *dsp_data = voice->dsp_data;
+    fluid_real_t *dsp_buf = voice->dsp_buf;
+    fluid_real_t dsp_amp = _DSP(voice, amp);
+    fluid_real_t dsp_amp_incr = _DSP(voice, amp_incr);
+    unsigned int dsp_i = 0;
+    unsigned int dsp_buf_size = voice->dsp_buf_size;
+    unsigned int dsp_phase_index;
+    int half = taps / 2, first, last, j;
+    unsigned int end_index;
+    const fluid_real_t *table, *coeffs;
+    fluid_real_t v;
+    int looping;
+
+    table = fluid_dsp_sinc_table(taps, _DSP(voice, phase_incr));
+    if (table == NULL) return fluid_dsp_float_interpolate_4th_order(voice);
+
+    /* Convert playback "speed" floating point value to phase index/fract */
+    fluid_phase_set_float(dsp_phase_incr, _DSP(voice, phase_incr));
+
+    /* voice is currently looping? */
+    looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
+              (_SAMPLEMODE(voice) == FLUID_LOOP_UNTIL_RELEASE &&
+               voice->volenv_section < FLUID_VOICE_ENVRELEASE);
+
+    /* last index interpolated before the loop wraps or the sample ends */
+    end_index = looping ? voice->loopend - 1 : voice->end;
+
+    while (1) {
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+
+        /* the indexes whose points are all inside the sample (or the loop),
+         * the others get theirs from fluid_dsp_sinc_point() */
+        first = (voice->has_looped ? voice->loopstart : voice->start) + half - 1;
+        last = (int)end_index - half;
+
+#ifdef FLUID_DSP_SIMD
+        if (fluid_dsp_simd.interp_sinc != NULL && (int)dsp_phase_index >= first &&
+            (int)dsp_phase_index <= last) {
+            dsp_i = fluid_dsp_simd.interp_sinc(dsp_data, dsp_buf, dsp_i, dsp_buf_size, &dsp_phase,
+                                               dsp_phase_incr, &dsp_amp, dsp_amp_incr,
+                                               (unsigned int)last, table, taps);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+        }
+#endif
+        for (; dsp_i < dsp_buf_size && dsp_phase_index <= end_index; dsp_i++) {
+            coeffs = table + fluid_phase_fract_to_tablerow(dsp_phase) * taps;
+            v = 0;
+            if ((int)dsp_phase_index >= first && (int)dsp_phase_index <= last) {
+                for (j = 0; j < taps; j++) {
+                    v += coeffs[j] * READ_SAMPLE(dsp_data, dsp_phase_index - half + 1 + j,
+                                                 voice->sample->idx_in_sfont);
+                }
+            } else {
+                for (j = 0; j < taps; j++) {
+                    v += coeffs[j] * fluid_dsp_sinc_point(voice, dsp_data,
+                                                          (int)dsp_phase_index - half + 1 + j,
+                                                          looping);
+                }
+            }
+            dsp_buf[dsp_i] = dsp_amp * v;
+
+            /* increment phase and amplitude */
+            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            dsp_amp += dsp_amp_incr;
+        }
+
+        if (!looping) break; /* break out if not looping (end of sample) */
+
+        /* go back to loop start */
+        if (dsp_phase_index > end_index) {
+            fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
+            voice->has_looped = 1;
+        }
+
+        /* break out if filled buffer */
+        if (dsp_i >= dsp_buf_size) break;
+    }
+
+    _DSP(voice, phase) = dsp_phase;
+    _DSP(voice, amp) = dsp_amp;
+
+    return (dsp_i);
+}
+
+#endif /* WITH_FIXED */
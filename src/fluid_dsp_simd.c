@@ -0,0 +1,890 @@
+#include "fluid_dsp_simd.h"
+
+fluid_dsp_simd_t fluid_dsp_simd = {FLUID_DSP_SIMD_SCALAR, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+
+#ifdef FLUID_DSP_SIMD
+
+#if defined(FLUID_DSP_SIMD_X86)
+#include <immintrin.h>
+#define FLUID_TARGET_SSE2 __attribute__((target("sse2")))
+#define FLUID_TARGET_AVX2 __attribute__((target("avx2")))
+#define FLUID_SIMD_INLINE static inline __attribute__((always_inline))
+#elif defined(FLUID_DSP_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+/* sample index and table row of each output sample in a group */
+typedef struct {
+    unsigned int idx[FLUID_DSP_SIMD_LANES_MAX];
+    unsigned int row[FLUID_DSP_SIMD_LANES_MAX];
+} fluid_dsp_lanes_t;
+
+/*
+ * Step the phase over the next n output samples the same way the scalar
+ * loop does. The new phase is only committed if the whole group is inside
+ * the sequence of sample points (the phase never decreases, so checking
+ * the last lane is enough).
+ */
+static FLUID_INLINE int fluid_dsp_lanes_setup(fluid_dsp_lanes_t *l, int n,
+                                              int round, fluid_phase_t *phase,
+                                              fluid_phase_t phase_incr,
+                                              unsigned int end_index) {
+    fluid_phase_t p = *phase;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        l->idx[k] = round ? fluid_phase_index_round(p) : fluid_phase_index(p);
+        l->row[k] = fluid_phase_fract_to_tablerow(p);
+        fluid_phase_incr(p, phase_incr);
+    }
+
+    if (l->idx[n - 1] > end_index) return 0;
+
+    *phase = p;
+    return 1;
+}
+
+/* coefficient j of lane k, and the sample at offset off of lane k */
+#define LANE_COEF(table, stride, l, k, j) ((table)[(l)->row[k] * (stride) + (j)])
+#define LANE_SAMPLE(data, l, k, off) ((data)[(int)(l)->idx[k] + (off)])
+
+#if defined(FLUID_DSP_SIMD_X86)
+
+/*********************************************************************
+ * SSE2, 4 output samples per iteration
+ */
+
+/* amplitude of 4 consecutive output samples */
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128 sse2_amp_ramp(float amp, float amp_incr) {
+    return _mm_add_ps(_mm_set1_ps(amp), _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f),
+                                                   _mm_set1_ps(amp_incr)));
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128
+sse2_coef_col(const float *table, int stride, const fluid_dsp_lanes_t *l, int j) {
+    return _mm_set_ps(LANE_COEF(table, stride, l, 3, j), LANE_COEF(table, stride, l, 2, j),
+                      LANE_COEF(table, stride, l, 1, j), LANE_COEF(table, stride, l, 0, j));
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128
+sse2_sample_col(const short *data, const fluid_dsp_lanes_t *l, int off) {
+    return _mm_cvtepi32_ps(_mm_set_epi32(LANE_SAMPLE(data, l, 3, off), LANE_SAMPLE(data, l, 2, off),
+                                         LANE_SAMPLE(data, l, 1, off), LANE_SAMPLE(data, l, 0, off)));
+}
+
+/* 4 consecutive samples as floats */
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128 sse2_load_s16x4(const short *p) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)p);
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+
+/* 2 consecutive samples packed in an int */
+FLUID_SIMD_INLINE int load_s16x2(const short *p) {
+    int v;
+    FLUID_MEMCPY(&v, p, sizeof(v));
+    return v;
+}
+
+/* 2 consecutive coefficients of two table rows */
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128 sse2_load_f32x2x2(const float *lo,
+                                                             const float *hi) {
+    __m128 v = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)lo));
+    return _mm_loadh_pi(v, (const __m64 *)hi);
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 unsigned int
+sse2_none_body(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+               unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr, fluid_real_t *amp,
+               fluid_real_t amp_incr, unsigned int end_index) {
+    fluid_dsp_lanes_t l;
+    __m128 vamp = sse2_amp_ramp(*amp, amp_incr);
+    __m128 vamp_step = _mm_set1_ps(4.0f * amp_incr);
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 1, phase, phase_incr, end_index)) break;
+
+        _mm_storeu_ps(dsp_buf + dsp_i, _mm_mul_ps(vamp, sse2_sample_col(data, &l, 0)));
+        vamp = _mm_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm_cvtss_f32(vamp);
+    return dsp_i;
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 unsigned int
+sse2_linear_body(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                 unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr, fluid_real_t *amp,
+                 fluid_real_t amp_incr, unsigned int end_index, const float *table) {
+    fluid_dsp_lanes_t l;
+    __m128 vamp = sse2_amp_ramp(*amp, amp_incr);
+    __m128 vamp_step = _mm_set1_ps(4.0f * amp_incr);
+    __m128 p01, p23;
+    __m128i s;
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 0, phase, phase_incr, end_index)) break;
+
+        /* the rows and sample pairs of two lanes per register */
+        s = _mm_set_epi32(load_s16x2(data + l.idx[3]), load_s16x2(data + l.idx[2]),
+                          load_s16x2(data + l.idx[1]), load_s16x2(data + l.idx[0]));
+        p01 = _mm_mul_ps(sse2_load_f32x2x2(table + 2 * l.row[0], table + 2 * l.row[1]),
+                         _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)));
+        p23 = _mm_mul_ps(sse2_load_f32x2x2(table + 2 * l.row[2], table + 2 * l.row[3]),
+                         _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16)));
+
+        /* even elements hold the first products, odd ones the second */
+        p01 = _mm_add_ps(_mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0)),
+                         _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_ps(dsp_buf + dsp_i, _mm_mul_ps(vamp, p01));
+        vamp = _mm_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm_cvtss_f32(vamp);
+    return dsp_i;
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 unsigned int
+sse2_4th_body(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+              unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr, fluid_real_t *amp,
+              fluid_real_t amp_incr, unsigned int end_index, const float *table) {
+    fluid_dsp_lanes_t l;
+    __m128 vamp = sse2_amp_ramp(*amp, amp_incr);
+    __m128 vamp_step = _mm_set1_ps(4.0f * amp_incr);
+    __m128 p0, p1, p2, p3;
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 0, phase, phase_incr, end_index)) break;
+
+        /* one row of products per lane, transposed to sum them per lane */
+        p0 = _mm_mul_ps(_mm_loadu_ps(table + 4 * l.row[0]), sse2_load_s16x4(data + l.idx[0] - 1));
+        p1 = _mm_mul_ps(_mm_loadu_ps(table + 4 * l.row[1]), sse2_load_s16x4(data + l.idx[1] - 1));
+        p2 = _mm_mul_ps(_mm_loadu_ps(table + 4 * l.row[2]), sse2_load_s16x4(data + l.idx[2] - 1));
+        p3 = _mm_mul_ps(_mm_loadu_ps(table + 4 * l.row[3]), sse2_load_s16x4(data + l.idx[3] - 1));
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+        p0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(p0, p1), p2), p3);
+        _mm_storeu_ps(dsp_buf + dsp_i, _mm_mul_ps(vamp, p0));
+        vamp = _mm_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm_cvtss_f32(vamp);
+    return dsp_i;
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 unsigned int
+sse2_7th_body(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+              unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr, fluid_real_t *amp,
+              fluid_real_t amp_incr, unsigned int end_index, const float *table) {
+    fluid_dsp_lanes_t l;
+    __m128 vamp = sse2_amp_ramp(*amp, amp_incr);
+    __m128 vamp_step = _mm_set1_ps(4.0f * amp_incr);
+    __m128 acc;
+    int j;
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 0, phase, phase_incr, end_index)) break;
+
+        acc = _mm_mul_ps(sse2_coef_col(table, 7, &l, 0), sse2_sample_col(data, &l, -3));
+        for (j = 1; j < 7; j++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(sse2_coef_col(table, 7, &l, j),
+                                             sse2_sample_col(data, &l, j - 3)));
+        }
+        _mm_storeu_ps(dsp_buf + dsp_i, _mm_mul_ps(vamp, acc));
+        vamp = _mm_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm_cvtss_f32(vamp);
+    return dsp_i;
+}
+
+FLUID_TARGET_SSE2 static unsigned int
+fluid_dsp_sse2_none(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                    fluid_real_t *amp, fluid_real_t amp_incr,
+                    unsigned int end_index, const fluid_real_t *table) {
+    return sse2_none_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                          amp_incr, end_index);
+}
+
+FLUID_TARGET_SSE2 static unsigned int
+fluid_dsp_sse2_linear(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                      unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                      fluid_real_t *amp, fluid_real_t amp_incr,
+                      unsigned int end_index, const fluid_real_t *table) {
+    return sse2_linear_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                            amp_incr, end_index, table);
+}
+
+FLUID_TARGET_SSE2 static unsigned int
+fluid_dsp_sse2_4th(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                   unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                   fluid_real_t *amp, fluid_real_t amp_incr,
+                   unsigned int end_index, const fluid_real_t *table) {
+    return sse2_4th_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                         amp_incr, end_index, table);
+}
+
+FLUID_TARGET_SSE2 static unsigned int
+fluid_dsp_sse2_7th(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                   unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                   fluid_real_t *amp, fluid_real_t amp_incr,
+                   unsigned int end_index, const fluid_real_t *table) {
+    return sse2_7th_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                         amp_incr, end_index, table);
+}
+
+/* the sum of the 4 lanes */
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 float sse2_hsum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+/* one output sample at a time, its points 8 at a time in two vectors */
+FLUID_TARGET_SSE2 static unsigned int
+fluid_dsp_sse2_sinc(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                    fluid_real_t *amp, fluid_real_t amp_incr,
+                    unsigned int end_index, const fluid_real_t *table, int taps) {
+    fluid_phase_t p = *phase;
+    float a = *amp;
+    const short *points;
+    const float *coeffs;
+    __m128 acc0, acc1;
+    int j;
+
+    for (; dsp_i < dsp_end && fluid_phase_index(p) <= end_index; dsp_i++) {
+        points = data + fluid_phase_index(p) - taps / 2 + 1;
+        coeffs = table + fluid_phase_fract_to_tablerow(p) * taps;
+
+        acc0 = _mm_mul_ps(_mm_loadu_ps(coeffs), sse2_load_s16x4(points));
+        acc1 = _mm_mul_ps(_mm_loadu_ps(coeffs + 4), sse2_load_s16x4(points + 4));
+        for (j = 8; j < taps; j += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(coeffs + j),
+                                               sse2_load_s16x4(points + j)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(coeffs + j + 4),
+                                               sse2_load_s16x4(points + j + 4)));
+        }
+        dsp_buf[dsp_i] = a * sse2_hsum(_mm_add_ps(acc0, acc1));
+
+        fluid_phase_incr(p, phase_incr);
+        a += amp_incr;
+    }
+
+    *phase = p;
+    *amp = a;
+    return dsp_i;
+}
+
+/* one sample of the filters of 4 voices, see fluid_voice_effects_pass */
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128 sse2_biquad_step(__m128 x, __m128 *hist1,
+                                                            __m128 *hist2, __m128 a1,
+                                                            __m128 a2, __m128 b02,
+                                                            __m128 b1) {
+    __m128 centernode = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(a1, *hist1)), _mm_mul_ps(a2, *hist2));
+    __m128 out = _mm_add_ps(_mm_mul_ps(b02, _mm_add_ps(centernode, *hist2)),
+                            _mm_mul_ps(b1, *hist1));
+    *hist2 = *hist1;
+    *hist1 = centernode;
+    return out;
+}
+
+/* the coefficient plus its increment in the lanes still ramping after
+ * sample i */
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 __m128 sse2_biquad_ramp(__m128 coef, __m128 incr,
+                                                            __m128i n_incr, int i) {
+    __m128 mask = _mm_castsi128_ps(_mm_cmpgt_epi32(n_incr, _mm_set1_epi32(i)));
+    return _mm_or_ps(_mm_and_ps(mask, _mm_add_ps(coef, incr)), _mm_andnot_ps(mask, coef));
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_SSE2 void sse2_biquad_body(fluid_dsp_biquad_lanes_t *l,
+                                                          int count, const int ramp) {
+    __m128 hist1 = _mm_loadu_ps(l->hist1), hist2 = _mm_loadu_ps(l->hist2);
+    __m128 a1 = _mm_loadu_ps(l->a1), a2 = _mm_loadu_ps(l->a2);
+    __m128 b02 = _mm_loadu_ps(l->b02), b1 = _mm_loadu_ps(l->b1);
+    __m128 a1_incr = _mm_loadu_ps(l->a1_incr), a2_incr = _mm_loadu_ps(l->a2_incr);
+    __m128 b02_incr = _mm_loadu_ps(l->b02_incr), b1_incr = _mm_loadu_ps(l->b1_incr);
+    __m128i n_incr = _mm_loadu_si128((const __m128i *)l->n_incr);
+    float *buf0 = l->buf[0], *buf1 = l->buf[1], *buf2 = l->buf[2], *buf3 = l->buf[3];
+    float out[4];
+    __m128 x[4];
+    int i, j;
+
+#define SSE2_BIQUAD_RAMP(_i)                                                   \
+    if (ramp) {                                                                \
+        a1 = sse2_biquad_ramp(a1, a1_incr, n_incr, _i);                        \
+        a2 = sse2_biquad_ramp(a2, a2_incr, n_incr, _i);                        \
+        b02 = sse2_biquad_ramp(b02, b02_incr, n_incr, _i);                     \
+        b1 = sse2_biquad_ramp(b1, b1_incr, n_incr, _i);                        \
+    }
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        /* x[j]: sample i + j of the 4 voices */
+        x[0] = _mm_loadu_ps(buf0 + i);
+        x[1] = _mm_loadu_ps(buf1 + i);
+        x[2] = _mm_loadu_ps(buf2 + i);
+        x[3] = _mm_loadu_ps(buf3 + i);
+        _MM_TRANSPOSE4_PS(x[0], x[1], x[2], x[3]);
+        for (j = 0; j < 4; j++) {
+            x[j] = sse2_biquad_step(x[j], &hist1, &hist2, a1, a2, b02, b1);
+            SSE2_BIQUAD_RAMP(i + j)
+        }
+        _MM_TRANSPOSE4_PS(x[0], x[1], x[2], x[3]);
+        _mm_storeu_ps(buf0 + i, x[0]);
+        _mm_storeu_ps(buf1 + i, x[1]);
+        _mm_storeu_ps(buf2 + i, x[2]);
+        _mm_storeu_ps(buf3 + i, x[3]);
+    }
+    for (; i < count; i++) {
+        x[0] = _mm_set_ps(buf3[i], buf2[i], buf1[i], buf0[i]);
+        _mm_storeu_ps(out, sse2_biquad_step(x[0], &hist1, &hist2, a1, a2, b02, b1));
+        SSE2_BIQUAD_RAMP(i)
+        buf0[i] = out[0];
+        buf1[i] = out[1];
+        buf2[i] = out[2];
+        buf3[i] = out[3];
+    }
+
+#undef SSE2_BIQUAD_RAMP
+
+    _mm_storeu_ps(l->hist1, hist1);
+    _mm_storeu_ps(l->hist2, hist2);
+    _mm_storeu_ps(l->a1, a1);
+    _mm_storeu_ps(l->a2, a2);
+    _mm_storeu_ps(l->b02, b02);
+    _mm_storeu_ps(l->b1, b1);
+}
+
+FLUID_TARGET_SSE2 static void fluid_dsp_sse2_biquad4(fluid_dsp_biquad_lanes_t *l, int count) {
+    int k;
+
+    for (k = 0; k < 4; k++) {
+        if (l->n_incr[k] > 0) {
+            sse2_biquad_body(l, count, 1);
+            return;
+        }
+    }
+    sse2_biquad_body(l, count, 0);
+}
+
+/*********************************************************************
+ * AVX2, 8 output samples per iteration.
+ *
+ * The tail of a block is finished by the SSE2 bodies, inlined here so
+ * that they are VEX encoded as well (no AVX/SSE transition penalty).
+ */
+
+/* amplitude of 8 consecutive output samples */
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 __m256 avx2_amp_ramp(float amp, float amp_incr) {
+    return _mm256_add_ps(_mm256_set1_ps(amp),
+                         _mm256_mul_ps(_mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f),
+                                       _mm256_set1_ps(amp_incr)));
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 __m256
+avx2_coef_col(const float *table, int stride, const fluid_dsp_lanes_t *l, int j) {
+    __m256i rows = _mm256_loadu_si256((const __m256i *)l->row);
+    __m256i vindex = _mm256_add_epi32(_mm256_mullo_epi32(rows, _mm256_set1_epi32(stride)),
+                                      _mm256_set1_epi32(j));
+    return _mm256_i32gather_ps(table, vindex, 4);
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 __m256
+avx2_sample_col(const short *data, const fluid_dsp_lanes_t *l, int off) {
+    return _mm256_cvtepi32_ps(_mm256_set_epi32(
+        LANE_SAMPLE(data, l, 7, off), LANE_SAMPLE(data, l, 6, off),
+        LANE_SAMPLE(data, l, 5, off), LANE_SAMPLE(data, l, 4, off),
+        LANE_SAMPLE(data, l, 3, off), LANE_SAMPLE(data, l, 2, off),
+        LANE_SAMPLE(data, l, 1, off), LANE_SAMPLE(data, l, 0, off)));
+}
+
+/* products of a table row and 4 consecutive samples, lane k in the low
+ * half and lane k + 4 in the high half */
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 __m256
+avx2_row_products(const float *table, const short *data,
+                  const fluid_dsp_lanes_t *l, int k) {
+    __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(table + 4 * l->row[k])),
+                                    _mm_loadu_ps(table + 4 * l->row[k + 4]), 1);
+    __m128i s0 = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)(data + l->idx[k] - 1)));
+    __m128i s1 = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)(data + l->idx[k + 4] - 1)));
+    __m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(s0), s1, 1);
+    return _mm256_mul_ps(c, _mm256_cvtepi32_ps(s));
+}
+
+FLUID_TARGET_AVX2 static unsigned int
+fluid_dsp_avx2_none(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                    fluid_real_t *amp, fluid_real_t amp_incr,
+                    unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    __m256 vamp = avx2_amp_ramp(*amp, amp_incr);
+    __m256 vamp_step = _mm256_set1_ps(8.0f * amp_incr);
+
+    for (; dsp_i + 8 <= dsp_end; dsp_i += 8) {
+        if (!fluid_dsp_lanes_setup(&l, 8, 1, phase, phase_incr, end_index)) break;
+
+        _mm256_storeu_ps(dsp_buf + dsp_i, _mm256_mul_ps(vamp, avx2_sample_col(data, &l, 0)));
+        vamp = _mm256_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm256_cvtss_f32(vamp);
+    return sse2_none_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                          amp_incr, end_index);
+}
+
+FLUID_TARGET_AVX2 static unsigned int
+fluid_dsp_avx2_linear(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                      unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                      fluid_real_t *amp, fluid_real_t amp_incr,
+                      unsigned int end_index, const fluid_real_t *table) {
+    /* two products per lane do not pay for 8 lane gathers */
+    return sse2_linear_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                            amp_incr, end_index, table);
+}
+
+FLUID_TARGET_AVX2 static unsigned int
+fluid_dsp_avx2_4th(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                   unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                   fluid_real_t *amp, fluid_real_t amp_incr,
+                   unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    __m256 vamp = avx2_amp_ramp(*amp, amp_incr);
+    __m256 vamp_step = _mm256_set1_ps(8.0f * amp_incr);
+    __m256 p0, p1, p2, p3, t0, t1, t2, t3;
+
+    for (; dsp_i + 8 <= dsp_end; dsp_i += 8) {
+        if (!fluid_dsp_lanes_setup(&l, 8, 0, phase, phase_incr, end_index)) break;
+
+        p0 = avx2_row_products(table, data, &l, 0);
+        p1 = avx2_row_products(table, data, &l, 1);
+        p2 = avx2_row_products(table, data, &l, 2);
+        p3 = avx2_row_products(table, data, &l, 3);
+
+        /* 4x4 transpose within each 128 bit half */
+        t0 = _mm256_unpacklo_ps(p0, p1);
+        t1 = _mm256_unpacklo_ps(p2, p3);
+        t2 = _mm256_unpackhi_ps(p0, p1);
+        t3 = _mm256_unpackhi_ps(p2, p3);
+        p0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        p1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        p2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        p3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        p0 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(p0, p1), p2), p3);
+        _mm256_storeu_ps(dsp_buf + dsp_i, _mm256_mul_ps(vamp, p0));
+        vamp = _mm256_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm256_cvtss_f32(vamp);
+    return sse2_4th_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                         amp_incr, end_index, table);
+}
+
+FLUID_TARGET_AVX2 static unsigned int
+fluid_dsp_avx2_7th(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                   unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                   fluid_real_t *amp, fluid_real_t amp_incr,
+                   unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    __m256 vamp = avx2_amp_ramp(*amp, amp_incr);
+    __m256 vamp_step = _mm256_set1_ps(8.0f * amp_incr);
+    __m256 acc;
+    int j;
+
+    for (; dsp_i + 8 <= dsp_end; dsp_i += 8) {
+        if (!fluid_dsp_lanes_setup(&l, 8, 0, phase, phase_incr, end_index)) break;
+
+        acc = _mm256_mul_ps(avx2_coef_col(table, 7, &l, 0), avx2_sample_col(data, &l, -3));
+        for (j = 1; j < 7; j++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(avx2_coef_col(table, 7, &l, j),
+                                                   avx2_sample_col(data, &l, j - 3)));
+        }
+        _mm256_storeu_ps(dsp_buf + dsp_i, _mm256_mul_ps(vamp, acc));
+        vamp = _mm256_add_ps(vamp, vamp_step);
+    }
+
+    *amp = _mm256_cvtss_f32(vamp);
+    return sse2_7th_body(data, dsp_buf, dsp_i, dsp_end, phase, phase_incr, amp,
+                         amp_incr, end_index, table);
+}
+
+/* one output sample at a time, its points 8 at a time */
+FLUID_TARGET_AVX2 static unsigned int
+fluid_dsp_avx2_sinc(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                    fluid_real_t *amp, fluid_real_t amp_incr,
+                    unsigned int end_index, const fluid_real_t *table, int taps) {
+    fluid_phase_t p = *phase;
+    float a = *amp;
+    const short *points;
+    const float *coeffs;
+    __m256 acc;
+    int j;
+
+    for (; dsp_i < dsp_end && fluid_phase_index(p) <= end_index; dsp_i++) {
+        points = data + fluid_phase_index(p) - taps / 2 + 1;
+        coeffs = table + fluid_phase_fract_to_tablerow(p) * taps;
+
+        acc = _mm256_setzero_ps();
+        for (j = 0; j < taps; j += 8) {
+            __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(points + j)));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(coeffs + j),
+                                                   _mm256_cvtepi32_ps(s)));
+        }
+        dsp_buf[dsp_i] = a * sse2_hsum(_mm_add_ps(_mm256_castps256_ps128(acc),
+                                                  _mm256_extractf128_ps(acc, 1)));
+
+        fluid_phase_incr(p, phase_incr);
+        a += amp_incr;
+    }
+
+    *phase = p;
+    *amp = a;
+    return dsp_i;
+}
+
+/* one sample of the filters of 8 voices */
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 __m256 avx2_biquad_step(__m256 x, __m256 *hist1,
+                                                            __m256 *hist2, __m256 a1,
+                                                            __m256 a2, __m256 b02,
+                                                            __m256 b1) {
+    __m256 centernode =
+        _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(a1, *hist1)), _mm256_mul_ps(a2, *hist2));
+    __m256 out = _mm256_add_ps(_mm256_mul_ps(b02, _mm256_add_ps(centernode, *hist2)),
+                               _mm256_mul_ps(b1, *hist1));
+    *hist2 = *hist1;
+    *hist1 = centernode;
+    return out;
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 __m256 avx2_biquad_ramp(__m256 coef, __m256 incr,
+                                                            __m256i n_incr, int i) {
+    __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(n_incr, _mm256_set1_epi32(i)));
+    return _mm256_blendv_ps(coef, _mm256_add_ps(coef, incr), mask);
+}
+
+/* rows to columns: x[j] holds element j of every row */
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 void avx2_transpose8(__m256 *x) {
+    __m256 t0 = _mm256_unpacklo_ps(x[0], x[1]), t1 = _mm256_unpackhi_ps(x[0], x[1]);
+    __m256 t2 = _mm256_unpacklo_ps(x[2], x[3]), t3 = _mm256_unpackhi_ps(x[2], x[3]);
+    __m256 t4 = _mm256_unpacklo_ps(x[4], x[5]), t5 = _mm256_unpackhi_ps(x[4], x[5]);
+    __m256 t6 = _mm256_unpacklo_ps(x[6], x[7]), t7 = _mm256_unpackhi_ps(x[6], x[7]);
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    x[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    x[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    x[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    x[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    x[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    x[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    x[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    x[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+FLUID_SIMD_INLINE FLUID_TARGET_AVX2 void avx2_biquad_body(fluid_dsp_biquad_lanes_t *l,
+                                                          int count, const int ramp) {
+    __m256 hist1 = _mm256_loadu_ps(l->hist1), hist2 = _mm256_loadu_ps(l->hist2);
+    __m256 a1 = _mm256_loadu_ps(l->a1), a2 = _mm256_loadu_ps(l->a2);
+    __m256 b02 = _mm256_loadu_ps(l->b02), b1 = _mm256_loadu_ps(l->b1);
+    __m256 a1_incr = _mm256_loadu_ps(l->a1_incr), a2_incr = _mm256_loadu_ps(l->a2_incr);
+    __m256 b02_incr = _mm256_loadu_ps(l->b02_incr), b1_incr = _mm256_loadu_ps(l->b1_incr);
+    __m256i n_incr = _mm256_loadu_si256((const __m256i *)l->n_incr);
+    float out[8];
+    __m256 x[8];
+    int i, j, k;
+
+#define AVX2_BIQUAD_RAMP(_i)                                                   \
+    if (ramp) {                                                                \
+        a1 = avx2_biquad_ramp(a1, a1_incr, n_incr, _i);                        \
+        a2 = avx2_biquad_ramp(a2, a2_incr, n_incr, _i);                        \
+        b02 = avx2_biquad_ramp(b02, b02_incr, n_incr, _i);                     \
+        b1 = avx2_biquad_ramp(b1, b1_incr, n_incr, _i);                        \
+    }
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        for (k = 0; k < 8; k++) x[k] = _mm256_loadu_ps(l->buf[k] + i);
+        avx2_transpose8(x);
+        for (j = 0; j < 8; j++) {
+            x[j] = avx2_biquad_step(x[j], &hist1, &hist2, a1, a2, b02, b1);
+            AVX2_BIQUAD_RAMP(i + j)
+        }
+        avx2_transpose8(x);
+        for (k = 0; k < 8; k++) _mm256_storeu_ps(l->buf[k] + i, x[k]);
+    }
+    for (; i < count; i++) {
+        for (k = 0; k < 8; k++) out[k] = l->buf[k][i];
+        _mm256_storeu_ps(out, avx2_biquad_step(_mm256_loadu_ps(out), &hist1, &hist2, a1, a2,
+                                               b02, b1));
+        AVX2_BIQUAD_RAMP(i)
+        for (k = 0; k < 8; k++) l->buf[k][i] = out[k];
+    }
+
+#undef AVX2_BIQUAD_RAMP
+
+    _mm256_storeu_ps(l->hist1, hist1);
+    _mm256_storeu_ps(l->hist2, hist2);
+    _mm256_storeu_ps(l->a1, a1);
+    _mm256_storeu_ps(l->a2, a2);
+    _mm256_storeu_ps(l->b02, b02);
+    _mm256_storeu_ps(l->b1, b1);
+}
+
+FLUID_TARGET_AVX2 static void fluid_dsp_avx2_biquad8(fluid_dsp_biquad_lanes_t *l, int count) {
+    int k;
+
+    for (k = 0; k < 8; k++) {
+        if (l->n_incr[k] > 0) {
+            avx2_biquad_body(l, count, 1);
+            return;
+        }
+    }
+    avx2_biquad_body(l, count, 0);
+}
+
+#elif defined(FLUID_DSP_SIMD_NEON)
+
+/*********************************************************************
+ * NEON, 4 output samples per iteration
+ */
+
+/* amplitude of 4 consecutive output samples */
+static FLUID_INLINE float32x4_t neon_amp_ramp(float amp, float amp_incr) {
+    const float ramp[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    return vaddq_f32(vdupq_n_f32(amp), vmulq_f32(vld1q_f32(ramp), vdupq_n_f32(amp_incr)));
+}
+
+static FLUID_INLINE float32x4_t
+neon_coef_col(const float *table, int stride, const fluid_dsp_lanes_t *l, int j) {
+    const float c[4] = {LANE_COEF(table, stride, l, 0, j), LANE_COEF(table, stride, l, 1, j),
+                        LANE_COEF(table, stride, l, 2, j), LANE_COEF(table, stride, l, 3, j)};
+    return vld1q_f32(c);
+}
+
+static FLUID_INLINE float32x4_t
+neon_sample_col(const short *data, const fluid_dsp_lanes_t *l, int off) {
+    const int32_t s[4] = {LANE_SAMPLE(data, l, 0, off), LANE_SAMPLE(data, l, 1, off),
+                          LANE_SAMPLE(data, l, 2, off), LANE_SAMPLE(data, l, 3, off)};
+    return vcvtq_f32_s32(vld1q_s32(s));
+}
+
+/* 4 consecutive samples as floats */
+static FLUID_INLINE float32x4_t neon_load_s16x4(const short *p) {
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+}
+
+static unsigned int
+fluid_dsp_neon_none(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                    fluid_real_t *amp, fluid_real_t amp_incr,
+                    unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    float32x4_t vamp = neon_amp_ramp(*amp, amp_incr);
+    float32x4_t vamp_step = vdupq_n_f32(4.0f * amp_incr);
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 1, phase, phase_incr, end_index)) break;
+
+        vst1q_f32(dsp_buf + dsp_i, vmulq_f32(vamp, neon_sample_col(data, &l, 0)));
+        vamp = vaddq_f32(vamp, vamp_step);
+    }
+
+    *amp = vgetq_lane_f32(vamp, 0);
+    return dsp_i;
+}
+
+static unsigned int
+fluid_dsp_neon_linear(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                      unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                      fluid_real_t *amp, fluid_real_t amp_incr,
+                      unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    float32x4_t vamp = neon_amp_ramp(*amp, amp_incr);
+    float32x4_t vamp_step = vdupq_n_f32(4.0f * amp_incr);
+    float32x4_t acc;
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 0, phase, phase_incr, end_index)) break;
+
+        acc = vmulq_f32(neon_coef_col(table, 2, &l, 0), neon_sample_col(data, &l, 0));
+        acc = vaddq_f32(acc, vmulq_f32(neon_coef_col(table, 2, &l, 1),
+                                       neon_sample_col(data, &l, 1)));
+        vst1q_f32(dsp_buf + dsp_i, vmulq_f32(vamp, acc));
+        vamp = vaddq_f32(vamp, vamp_step);
+    }
+
+    *amp = vgetq_lane_f32(vamp, 0);
+    return dsp_i;
+}
+
+static unsigned int
+fluid_dsp_neon_4th(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                   unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                   fluid_real_t *amp, fluid_real_t amp_incr,
+                   unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    float32x4_t vamp = neon_amp_ramp(*amp, amp_incr);
+    float32x4_t vamp_step = vdupq_n_f32(4.0f * amp_incr);
+    float32x4_t p0, p1, p2, p3;
+    float32x4x2_t t01, t23;
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 0, phase, phase_incr, end_index)) break;
+
+        p0 = vmulq_f32(vld1q_f32(table + 4 * l.row[0]), neon_load_s16x4(data + l.idx[0] - 1));
+        p1 = vmulq_f32(vld1q_f32(table + 4 * l.row[1]), neon_load_s16x4(data + l.idx[1] - 1));
+        p2 = vmulq_f32(vld1q_f32(table + 4 * l.row[2]), neon_load_s16x4(data + l.idx[2] - 1));
+        p3 = vmulq_f32(vld1q_f32(table + 4 * l.row[3]), neon_load_s16x4(data + l.idx[3] - 1));
+
+        /* 4x4 transpose */
+        t01 = vtrnq_f32(p0, p1);
+        t23 = vtrnq_f32(p2, p3);
+        p0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        p1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        p2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        p3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+
+        p0 = vaddq_f32(vaddq_f32(vaddq_f32(p0, p1), p2), p3);
+        vst1q_f32(dsp_buf + dsp_i, vmulq_f32(vamp, p0));
+        vamp = vaddq_f32(vamp, vamp_step);
+    }
+
+    *amp = vgetq_lane_f32(vamp, 0);
+    return dsp_i;
+}
+
+static unsigned int
+fluid_dsp_neon_7th(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                   unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                   fluid_real_t *amp, fluid_real_t amp_incr,
+                   unsigned int end_index, const fluid_real_t *table) {
+    fluid_dsp_lanes_t l;
+    float32x4_t vamp = neon_amp_ramp(*amp, amp_incr);
+    float32x4_t vamp_step = vdupq_n_f32(4.0f * amp_incr);
+    float32x4_t acc;
+    int j;
+
+    for (; dsp_i + 4 <= dsp_end; dsp_i += 4) {
+        if (!fluid_dsp_lanes_setup(&l, 4, 0, phase, phase_incr, end_index)) break;
+
+        acc = vmulq_f32(neon_coef_col(table, 7, &l, 0), neon_sample_col(data, &l, -3));
+        for (j = 1; j < 7; j++) {
+            acc = vaddq_f32(acc, vmulq_f32(neon_coef_col(table, 7, &l, j),
+                                           neon_sample_col(data, &l, j - 3)));
+        }
+        vst1q_f32(dsp_buf + dsp_i, vmulq_f32(vamp, acc));
+        vamp = vaddq_f32(vamp, vamp_step);
+    }
+
+    *amp = vgetq_lane_f32(vamp, 0);
+    return dsp_i;
+}
+
+static unsigned int
+fluid_dsp_neon_sinc(const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+                    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr,
+                    fluid_real_t *amp, fluid_real_t amp_incr,
+                    unsigned int end_index, const fluid_real_t *table, int taps) {
+    fluid_phase_t p = *phase;
+    float a = *amp;
+    const short *points;
+    const float *coeffs;
+    float32x4_t acc0, acc1;
+    float32x2_t sum;
+    int j;
+
+    for (; dsp_i < dsp_end && fluid_phase_index(p) <= end_index; dsp_i++) {
+        points = data + fluid_phase_index(p) - taps / 2 + 1;
+        coeffs = table + fluid_phase_fract_to_tablerow(p) * taps;
+
+        acc0 = vmulq_f32(vld1q_f32(coeffs), neon_load_s16x4(points));
+        acc1 = vmulq_f32(vld1q_f32(coeffs + 4), neon_load_s16x4(points + 4));
+        for (j = 8; j < taps; j += 8) {
+            acc0 = vaddq_f32(acc0, vmulq_f32(vld1q_f32(coeffs + j), neon_load_s16x4(points + j)));
+            acc1 = vaddq_f32(acc1, vmulq_f32(vld1q_f32(coeffs + j + 4),
+                                             neon_load_s16x4(points + j + 4)));
+        }
+        acc0 = vaddq_f32(acc0, acc1);
+        sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+        dsp_buf[dsp_i] = a * vget_lane_f32(vpadd_f32(sum, sum), 0);
+
+        fluid_phase_incr(p, phase_incr);
+        a += amp_incr;
+    }
+
+    *phase = p;
+    *amp = a;
+    return dsp_i;
+}
+
+#endif
+
+/* best level the running CPU supports */
+static int fluid_dsp_simd_detect(void) {
+#if defined(FLUID_DSP_SIMD_X86)
+#if defined(_WIN32)
+    /* not every Windows toolchain ships the cpu model, trust the build flags */
+#if defined(__AVX2__)
+    return FLUID_DSP_SIMD_AVX2;
+#elif defined(__SSE2__)
+    return FLUID_DSP_SIMD_SSE2;
+#endif
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return FLUID_DSP_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return FLUID_DSP_SIMD_SSE2;
+#endif
+#elif defined(FLUID_DSP_SIMD_NEON)
+    return FLUID_DSP_SIMD_NEON;
+#endif
+    return FLUID_DSP_SIMD_SCALAR;
+}
+
+#endif /* FLUID_DSP_SIMD */
+
+int fluid_dsp_simd_config(int level) {
+    fluid_dsp_simd_t simd = {FLUID_DSP_SIMD_SCALAR, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+
+#ifdef FLUID_DSP_SIMD
+    int best = fluid_dsp_simd_detect();
+
+    if (level == FLUID_DSP_SIMD_AUTO || level > best) {
+        level = best;
+    }
+
+    switch (level) {
+#if defined(FLUID_DSP_SIMD_X86)
+    case FLUID_DSP_SIMD_AVX2:
+        simd = (fluid_dsp_simd_t){level, fluid_dsp_avx2_none, fluid_dsp_avx2_linear,
+                                  fluid_dsp_avx2_4th, fluid_dsp_avx2_7th, fluid_dsp_avx2_sinc,
+                                  fluid_dsp_sse2_biquad4, fluid_dsp_avx2_biquad8};
+        break;
+    case FLUID_DSP_SIMD_SSE2:
+        simd = (fluid_dsp_simd_t){level, fluid_dsp_sse2_none, fluid_dsp_sse2_linear,
+                                  fluid_dsp_sse2_4th, fluid_dsp_sse2_7th, fluid_dsp_sse2_sinc,
+                                  fluid_dsp_sse2_biquad4, NULL};
+        break;
+#elif defined(FLUID_DSP_SIMD_NEON)
+    case FLUID_DSP_SIMD_NEON:
+        simd = (fluid_dsp_simd_t){level, fluid_dsp_neon_none, fluid_dsp_neon_linear,
+                                  fluid_dsp_neon_4th, fluid_dsp_neon_7th, fluid_dsp_neon_sinc,
+                                  NULL, NULL};
+        break;
+#endif
+    default:
+        break;
+    }
+#endif
+
+    fluid_dsp_simd = simd;
+    return simd.level;
+}
+
+int fluid_dsp_simd_get_level(void) {
+    return fluid_dsp_simd.level;
+}
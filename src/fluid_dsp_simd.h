@@ -0,0 +1,109 @@
+#ifndef _FLUID_DSP_SIMD_H
+#define _FLUID_DSP_SIMD_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_phase.h"
+
+/*
+ * Vector kernels for the interpolators in fluid_dsp_float.c, and for the
+ * filters in fluid_voice.c (see fluid_dsp_biquad_lanes_t below).
+ *
+ * Only the "interpolate the sequence of sample points" part of each
+ * interpolator is vectorized: it has no wrap-around or end-point special
+ * cases, so 4 or 8 output samples can be computed per iteration. A kernel
+ * stops as soon as the next group would step past end_index, and the
+ * scalar loop in fluid_dsp_float.c finishes the block.
+ *
+ * The interpolation products are summed like the scalar code, but the
+ * amplitude is ramped per lane (amp + k * amp_incr) instead of being
+ * accumulated one sample at a time, so the output differs from the scalar
+ * path by a few float ulps.
+ *
+ * Define FLUID_DSP_SCALAR (make DSP_SCALAR=1) to build the scalar
+ * reference only. Vector kernels need float samples (WITH_FLOAT, not
+ * WITH_FIXED) and direct access to the sample data (no SPI flash).
+ */
+#if defined(WITH_FLOAT) && !defined(WITH_FIXED) && !defined(FLUID_DSP_SCALAR) && !(SPI_FLASH == 1)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLUID_DSP_SIMD 1
+#define FLUID_DSP_SIMD_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FLUID_DSP_SIMD 1
+#define FLUID_DSP_SIMD_NEON 1
+#endif
+#endif
+
+enum fluid_dsp_simd_level {
+    FLUID_DSP_SIMD_AUTO = -1, /* best level supported by the running CPU */
+    FLUID_DSP_SIMD_SCALAR = 0,
+    FLUID_DSP_SIMD_SSE2,
+    FLUID_DSP_SIMD_AVX2,
+    FLUID_DSP_SIMD_NEON
+};
+
+/**
+ * Interpolate from output sample \c dsp_i up to \c dsp_end, advancing
+ * \c phase and \c amp like the scalar loop.
+ * @return index of the first output sample left for the scalar loop
+ */
+typedef unsigned int (*fluid_dsp_simd_interp_t)(
+    const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr, fluid_real_t *amp,
+    fluid_real_t amp_incr, unsigned int end_index, const fluid_real_t *table);
+
+/**
+ * The same for the polyphase sinc: \c table holds \c taps coefficients
+ * per row (a multiple of 8) for the points from the phase index - taps / 2
+ * + 1 on. \c end_index is the last phase index whose points are all
+ * inside the sample. The points are summed in vector lanes, in another
+ * order than the scalar loop.
+ */
+typedef unsigned int (*fluid_dsp_simd_sinc_t)(
+    const short *data, fluid_real_t *dsp_buf, unsigned int dsp_i,
+    unsigned int dsp_end, fluid_phase_t *phase, fluid_phase_t phase_incr, fluid_real_t *amp,
+    fluid_real_t amp_incr, unsigned int end_index, const fluid_real_t *table, int taps);
+
+#define FLUID_DSP_SIMD_LANES_MAX 8
+
+/*
+ * The resonant filters of several voices, one voice per lane. The
+ * recurrence of a biquad can't be vectorized along time, so the kernels
+ * run it across the voices instead: each group of samples is transposed
+ * so that a vector holds the same sample of every voice.
+ *
+ * Lane k filters buf[k][0..count) in place, and ramps its coefficients by
+ * the increments after each of its first n_incr[k] samples. The
+ * operations of every lane are the ones of the scalar filter in
+ * fluid_voice.c, in the same order, so the output is the same.
+ */
+typedef struct {
+    fluid_real_t *buf[FLUID_DSP_SIMD_LANES_MAX];
+    fluid_real_t hist1[FLUID_DSP_SIMD_LANES_MAX], hist2[FLUID_DSP_SIMD_LANES_MAX];
+    fluid_real_t a1[FLUID_DSP_SIMD_LANES_MAX], a2[FLUID_DSP_SIMD_LANES_MAX];
+    fluid_real_t b02[FLUID_DSP_SIMD_LANES_MAX], b1[FLUID_DSP_SIMD_LANES_MAX];
+    fluid_real_t a1_incr[FLUID_DSP_SIMD_LANES_MAX], a2_incr[FLUID_DSP_SIMD_LANES_MAX];
+    fluid_real_t b02_incr[FLUID_DSP_SIMD_LANES_MAX], b1_incr[FLUID_DSP_SIMD_LANES_MAX];
+    int n_incr[FLUID_DSP_SIMD_LANES_MAX];
+} fluid_dsp_biquad_lanes_t;
+
+typedef void (*fluid_dsp_simd_biquad_t)(fluid_dsp_biquad_lanes_t *l, int count);
+
+typedef struct {
+    int level;
+    fluid_dsp_simd_interp_t interp_none;
+    fluid_dsp_simd_interp_t interp_linear;
+    fluid_dsp_simd_interp_t interp_4th;
+    fluid_dsp_simd_interp_t interp_7th;
+    fluid_dsp_simd_sinc_t interp_sinc;
+    fluid_dsp_simd_biquad_t biquad4; /* 4 lanes, NULL if not vectorized */
+    fluid_dsp_simd_biquad_t biquad8; /* 8 lanes, NULL if not vectorized */
+} fluid_dsp_simd_t;
+
+extern fluid_dsp_simd_t fluid_dsp_simd;
+
+/* Select the kernels for \c level, clamped to what the CPU supports.
+ * Returns the level actually selected. */
+int fluid_dsp_simd_config(int level);
+int fluid_dsp_simd_get_level(void);
+
+#endif /* _FLUID_DSP_SIMD_H */
@@ -0,0 +1,196 @@
+#include "fluid_env.h"
+#include "fluid_voice.h"
+
+/* A run of samples over which an envelope or LFO moves linearly. */
+typedef struct {
+    int len;
+    fluid_real_t x0; /* value of the first sample */
+    fluid_real_t dx; /* increment per sample */
+    int end;         /* a single step that ends an envelope section or
+                        turns an LFO around */
+} fluid_env_run_t;
+
+/*
+ * The next run of an envelope, at most max samples long. Steps like
+ * fluid_voice_write: the sections have coeff 1 (ramp by incr) or 0
+ * (constant incr), and the step that leaves [min, max] is clamped and
+ * moves on to the next section.
+ */
+static void fluid_env_next_run(fluid_env_data_t *data, unsigned int *count,
+                               uint8_t *section, fluid_real_t *val, int max,
+                               fluid_env_run_t *run) {
+    fluid_env_data_t *env_data = &data[*section];
+    fluid_real_t x, steps;
+    unsigned int left;
+
+    /* skip to the next section of the envelope if necessary */
+    while (*count >= env_data->count) {
+        if (*section == FLUID_VOICE_ENVDECAY) *val = env_data->min * env_data->coeff;
+        env_data = &data[++*section];
+        *count = 0;
+    }
+
+    left = env_data->count - *count;
+    run->len = left < (unsigned int)max ? (int)left : max;
+    run->end = 0;
+    run->dx = 0.0f;
+
+    x = env_data->coeff * *val + env_data->incr;
+    if (x < env_data->min || x > env_data->max) {
+        run->len = 1;
+        run->end = 1;
+        run->x0 = x < env_data->min ? env_data->min : env_data->max;
+        return;
+    }
+    run->x0 = x;
+
+    if (env_data->coeff == 0.0f || env_data->incr == 0.0f) return;
+
+    /* steps after the first one that stay inside [min, max] */
+    run->dx = env_data->incr;
+    if (run->dx < 0.0f) {
+        steps = (x - env_data->min) / -run->dx;
+    } else {
+        steps = (env_data->max - x) / run->dx;
+    }
+    if (steps + 1 < run->len) run->len = (int)steps + 1;
+}
+
+static void fluid_env_commit(unsigned int *count, uint8_t *section, fluid_real_t *val,
+                             const fluid_env_run_t *run, int len) {
+    if (run->end) {
+        *val = run->x0;
+        ++*section;
+        *count = 1;
+        return;
+    }
+    *val = run->x0 + (len - 1) * run->dx;
+    *count += len;
+}
+
+/* The next run of a triangle LFO, reflected at -1 and 1. It holds its
+ * value until 'delay'. */
+static void fluid_lfo_next_run(fluid_real_t val, fluid_real_t incr, unsigned int ticks,
+                               unsigned int delay, int max, fluid_env_run_t *run) {
+    fluid_real_t x, steps;
+
+    run->len = max;
+    run->end = 0;
+    run->dx = 0.0f;
+
+    if (ticks < delay) {
+        if (delay - ticks < (unsigned int)max) run->len = (int)(delay - ticks);
+        run->x0 = val;
+        return;
+    }
+
+    x = val + incr;
+    if (x > 1.0f || x < -1.0f) {
+        run->len = 1;
+        run->end = 1;
+        run->x0 = x > 1.0f ? 2.0f - x : -2.0f - x;
+        return;
+    }
+    run->x0 = x;
+
+    if (incr == 0.0f) return;
+
+    run->dx = incr;
+    steps = incr > 0.0f ? (1.0f - x) / incr : (x + 1.0f) / -incr;
+    if (steps + 1 < run->len) run->len = (int)steps + 1;
+}
+
+static void fluid_lfo_commit(fluid_real_t *val, fluid_real_t *incr,
+                             const fluid_env_run_t *run, int len) {
+    if (run->end) {
+        *val = run->x0;
+        *incr = -*incr;
+        return;
+    }
+    *val = run->x0 + (len - 1) * run->dx;
+}
+
+/*
+ * out[k] = amp * fluid_cb2amp(cb0 + k * dcb) for k < len, without the
+ * table quantisation. Attenuations below 0 cB are clamped to amp, like
+ * fluid_cb2amp() does.
+ */
+static void fluid_env_exp_ramp(fluid_real_t *out, int len, fluid_real_t amp,
+                               fluid_real_t cb0, fluid_real_t dcb) {
+    fluid_real_t lane[4], step4;
+    fluid_real_t ratio = (fluid_real_t)pow(10.0, dcb / -200.0);
+    int k, j;
+
+    lane[0] = amp * (fluid_real_t)pow(10.0, cb0 / -200.0);
+    for (j = 1; j < 4; j++) lane[j] = lane[j - 1] * ratio;
+    step4 = ratio * ratio * ratio * ratio;
+
+    for (k = 0; k + 4 <= len; k += 4) {
+        for (j = 0; j < 4; j++) {
+            out[k + j] = lane[j];
+            lane[j] *= step4;
+        }
+    }
+    for (j = 0; k < len; k++, j++) out[k] = lane[j];
+
+    for (k = 0; k < len; k++) {
+        if (out[k] > amp) out[k] = amp;
+    }
+}
+
+int fluid_env_write_gain(fluid_voice_t *voice, fluid_real_t *gain, int n,
+                         int offset, fluid_real_t amp) {
+    /* attenuation in cB per unit of the mod LFO */
+    fluid_real_t lfo_cb = -voice->modlfo_to_vol;
+    fluid_env_run_t env, lfo;
+    int pos = 0, lead = 0, len, k;
+    uint8_t section;
+
+    while (pos < n) {
+        fluid_env_next_run(voice->volenv_data, &voice->volenv_count,
+                           &voice->volenv_section, &voice->volenv_val, n - pos, &env);
+        fluid_lfo_next_run(voice->modlfo_val, voice->modlfo_incr,
+                           voice->ticks + offset + pos, voice->modlfo_delay, n - pos, &lfo);
+        len = env.len < lfo.len ? env.len : lfo.len;
+        section = voice->volenv_section;
+
+        if (section == FLUID_VOICE_ENVDELAY || section == FLUID_VOICE_ENVFINISHED) {
+            /* no sound, and the sample doesn't move before the attack */
+            for (k = 0; k < len; k++) gain[pos + k] = 0.0f;
+            if (section == FLUID_VOICE_ENVDELAY && lead == pos) lead += len;
+        } else if (section == FLUID_VOICE_ENVATTACK) {
+            /* linear ramp, times the tremolo */
+            fluid_env_exp_ramp(gain + pos, len, amp, lfo.x0 * lfo_cb, lfo.dx * lfo_cb);
+            for (k = 0; k < len; k++) gain[pos + k] *= env.x0 + k * env.dx;
+        } else {
+            /* the envelope value is linear in dB, like the tremolo */
+            fluid_env_exp_ramp(gain + pos, len, amp,
+                               960.0f * (1.0f - env.x0) + lfo.x0 * lfo_cb,
+                               -960.0f * env.dx + lfo.dx * lfo_cb);
+        }
+
+        fluid_env_commit(&voice->volenv_count, &voice->volenv_section,
+                         &voice->volenv_val, &env, len);
+        fluid_lfo_commit(&voice->modlfo_val, &voice->modlfo_incr, &lfo, len);
+        pos += len;
+    }
+    return lead;
+}
+
+void fluid_env_advance(fluid_voice_t *voice, int n) {
+    fluid_env_run_t run;
+    int pos;
+
+    for (pos = 0; pos < n; pos += run.len) {
+        fluid_env_next_run(voice->modenv_data, &voice->modenv_count,
+                           &voice->modenv_section, &voice->modenv_val, n - pos, &run);
+        fluid_env_commit(&voice->modenv_count, &voice->modenv_section,
+                         &voice->modenv_val, &run, run.len);
+    }
+
+    for (pos = 0; pos < n; pos += run.len) {
+        fluid_lfo_next_run(voice->viblfo_val, voice->viblfo_incr, voice->ticks + pos,
+                           voice->viblfo_delay, n - pos, &run);
+        fluid_lfo_commit(&voice->viblfo_val, &voice->viblfo_incr, &run, run.len);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef _FLUID_ENV_H
+#define _FLUID_ENV_H
+
+#include "fluidsynth_priv.h"
+
+/*
+ * Sample accurate envelopes and LFOs (FLUID_ENV_SAMPLE).
+ *
+ * The voice runs its envelopes and LFOs with one step per sample instead
+ * of one per block (voice->env_step == 1). Between section changes and
+ * LFO turning points every one of them is a straight line, so a block is
+ * split into runs and each run is computed in closed form: a linear ramp
+ * in the attack, an exponential one (linear in dB) in decay and release,
+ * multiplied by the exponential tremolo of the mod LFO. The exponentials
+ * are evaluated as geometric series over 4 lanes.
+ */
+
+/* Advance the volume envelope and the mod LFO by n samples, starting at
+ * voice->ticks + offset, and write the gain of each sample to gain[],
+ * scaled by amp. Returns the number of leading samples still in the
+ * delay section, the sample does not play during those. */
+int fluid_env_write_gain(fluid_voice_t *voice, fluid_real_t *gain, int n,
+                         int offset, fluid_real_t amp);
+
+/* Advance the mod envelope and the vib LFO by n samples. They only steer
+ * pitch and filter, which are set once per block. */
+void fluid_env_advance(fluid_voice_t *voice, int n);
+
+#endif /* _FLUID_ENV_H */
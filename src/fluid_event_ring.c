@@ -0,0 +1,109 @@
+#include "fluid_event_ring.h"
+
+/* keeps the producer and the consumer index on separate cache lines */
+#define FLUID_CACHE_LINE 64
+
+#define ring_load(_p, _order) __atomic_load_n(_p, _order)
+#define ring_store(_p, _v, _order) __atomic_store_n(_p, _v, _order)
+
+typedef struct {
+    unsigned int seq; /* == position: free for the push at that position,
+                         == position + 1: holds the message pushed there */
+    fluid_synth_event_t event;
+} fluid_event_slot_t;
+
+struct _fluid_event_ring_t {
+    fluid_event_slot_t *slots;
+    unsigned int mask; /* size - 1 */
+    int multi_producer;
+
+    char pad0[FLUID_CACHE_LINE];
+    unsigned int head; /* next position to push */
+    unsigned int overflows;
+    char pad1[FLUID_CACHE_LINE];
+    unsigned int tail; /* next position to pop */
+};
+
+fluid_event_ring_t *new_fluid_event_ring(int size, int multi_producer) {
+    fluid_event_ring_t *ring;
+    unsigned int n = 1, i;
+
+    while (n < (unsigned int)size) n <<= 1;
+
+    ring = FLUID_NEW(fluid_event_ring_t);
+    if (ring == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    FLUID_MEMSET(ring, 0, sizeof(fluid_event_ring_t));
+
+    ring->slots = FLUID_ARRAY(fluid_event_slot_t, n);
+    if (ring->slots == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(ring);
+        return NULL;
+    }
+    for (i = 0; i < n; i++) ring->slots[i].seq = i;
+
+    ring->mask = n - 1;
+    ring->multi_producer = multi_producer;
+    return ring;
+}
+
+void delete_fluid_event_ring(fluid_event_ring_t *ring) {
+    if (ring == NULL) return;
+    FLUID_FREE(ring->slots);
+    FLUID_FREE(ring);
+}
+
+int fluid_event_ring_push(fluid_event_ring_t *ring, const fluid_synth_event_t *event) {
+    fluid_event_slot_t *slot;
+    unsigned int pos = ring_load(&ring->head, __ATOMIC_RELAXED);
+    int dif;
+
+    while (1) {
+        slot = &ring->slots[pos & ring->mask];
+        dif = (int)(ring_load(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (dif < 0) {
+            /* the consumer hasn't freed the slot yet: full */
+            __atomic_add_fetch(&ring->overflows, 1, __ATOMIC_RELAXED);
+            return FLUID_FAILED;
+        }
+        if (dif > 0) {
+            /* another producer took this position */
+            pos = ring_load(&ring->head, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (!ring->multi_producer) {
+            ring_store(&ring->head, pos + 1, __ATOMIC_RELAXED);
+            break;
+        }
+        if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+            break;
+        }
+        /* pos now holds the current head, try again */
+    }
+
+    slot->event = *event;
+    ring_store(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return FLUID_OK;
+}
+
+int fluid_event_ring_pop(fluid_event_ring_t *ring, fluid_synth_event_t *event) {
+    unsigned int pos = ring->tail;
+    fluid_event_slot_t *slot = &ring->slots[pos & ring->mask];
+
+    if (ring_load(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) return 0;
+
+    *event = slot->event;
+    /* free for the push one round later */
+    ring_store(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+    ring->tail = pos + 1;
+    return 1;
+}
+
+unsigned int fluid_event_ring_overflows(fluid_event_ring_t *ring) {
+    return ring_load(&ring->overflows, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,44 @@
+#ifndef _FLUID_EVENT_RING_H
+#define _FLUID_EVENT_RING_H
+
+#include "fluidsynth_priv.h"
+
+/* a MIDI channel message, queued by fluid_synth_schedule_*() or
+ * fluid_synth_post_*() */
+typedef struct {
+    unsigned int frame; /* synth->ticks at which it plays, scheduled only */
+    unsigned char type; /* NOTE_ON, NOTE_OFF, CONTROL_CHANGE, ... */
+    unsigned char chan;
+    int param1;
+    int param2;
+} fluid_synth_event_t;
+
+/*
+ * Lock-free ring of channel messages between the threads that call
+ * fluid_synth_post_*() and the thread that renders the synth
+ * (SynthParams.event_ring_size).
+ *
+ * Every slot carries a sequence number that tells whose turn it is, so
+ * neither side ever waits for the other: a full ring rejects the message
+ * and counts an overflow. With multi_producer several threads may push
+ * at the same time, they claim slots with a compare-and-swap; otherwise
+ * only one thread may push. Only one thread may pop.
+ */
+typedef struct _fluid_event_ring_t fluid_event_ring_t;
+
+/* size is rounded up to a power of two */
+fluid_event_ring_t *new_fluid_event_ring(int size, int multi_producer);
+void delete_fluid_event_ring(fluid_event_ring_t *ring);
+
+/* Producers. Returns FLUID_FAILED and counts an overflow if the ring is
+ * full. */
+int fluid_event_ring_push(fluid_event_ring_t *ring, const fluid_synth_event_t *event);
+
+/* Consumer. Returns 1 and the oldest message, or 0 if the ring is
+ * empty. */
+int fluid_event_ring_pop(fluid_event_ring_t *ring, fluid_synth_event_t *event);
+
+/* messages rejected because the ring was full */
+unsigned int fluid_event_ring_overflows(fluid_event_ring_t *ring);
+
+#endif /* _FLUID_EVENT_RING_H */
@@ -0,0 +1,272 @@
+#include "fluid_render_pool.h"
+
+#ifdef WITH_THREADS
+
+#include <pthread.h>
+#include "fluid_synth.h"
+
+/* Fewer playing voices per thread than this are rendered on the caller
+ * thread only, waking up the workers would cost more than it saves. */
+#define FLUID_RENDER_POOL_MIN_VOICES 4
+
+typedef struct {
+    fluid_render_pool_t *pool;
+    pthread_t thread;
+    int started;
+
+    /* the chunk of pool->playing rendered by this thread */
+    int first;
+    int count;
+
+    /* private mix buses of synth->block_size samples */
+    fluid_bus_t *left_buf;
+    fluid_bus_t *right_buf;
+    fluid_bus_t *reverb_buf;
+    fluid_bus_t *chorus_buf;
+} fluid_render_worker_t;
+
+struct _fluid_render_pool_t {
+    fluid_synth_t *synth;
+    int nworkers; /* worker threads, the caller thread comes on top */
+    fluid_render_worker_t *workers;
+
+    /* voices playing in the current block, in voice order */
+    fluid_voice_t **playing;
+
+    /* sends of the current block */
+    int with_reverb;
+    int with_chorus;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    unsigned int generation; /* incremented for every block handed out */
+    int pending;             /* workers still rendering the current block */
+    int quit;
+};
+
+static void fluid_render_worker_write(fluid_render_worker_t *worker) {
+    fluid_render_pool_t *pool = worker->pool;
+    int byte_size = pool->synth->block_size * sizeof(fluid_bus_t);
+    int i;
+
+    FLUID_MEMSET(worker->left_buf, 0, byte_size);
+    FLUID_MEMSET(worker->right_buf, 0, byte_size);
+    if (pool->with_reverb) FLUID_MEMSET(worker->reverb_buf, 0, byte_size);
+    if (pool->with_chorus) FLUID_MEMSET(worker->chorus_buf, 0, byte_size);
+
+    for (i = worker->first; i < worker->first + worker->count; i++) {
+        fluid_voice_write(pool->playing[i], worker->left_buf, worker->right_buf,
+                          pool->with_reverb ? worker->reverb_buf : NULL,
+                          pool->with_chorus ? worker->chorus_buf : NULL);
+    }
+}
+
+static void *fluid_render_worker_run(void *data) {
+    fluid_render_worker_t *worker = data;
+    fluid_render_pool_t *pool = worker->pool;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->quit && pool->generation == generation) {
+            pthread_cond_wait(&pool->start_cond, &pool->mutex);
+        }
+        if (pool->quit) break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (worker->count > 0) {
+            fluid_render_worker_write(worker);
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/*
+ * new_fluid_render_pool
+ *
+ * 'threads' counts the caller thread, threads - 1 workers are started.
+ */
+fluid_render_pool_t *new_fluid_render_pool(fluid_synth_t *synth, int threads) {
+    fluid_render_pool_t *pool;
+    int i;
+
+    if (threads < 2) {
+        FLUID_LOG(FLUID_ERR, "A render pool needs at least 2 threads");
+        return NULL;
+    }
+
+    pool = FLUID_NEW(fluid_render_pool_t);
+    if (pool == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    FLUID_MEMSET(pool, 0, sizeof(fluid_render_pool_t));
+    pool->synth = synth;
+    pool->nworkers = threads - 1;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->playing = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
+    pool->workers = FLUID_ARRAY(fluid_render_worker_t, pool->nworkers);
+    if (pool->playing == NULL || pool->workers == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    FLUID_MEMSET(pool->workers, 0, pool->nworkers * sizeof(fluid_render_worker_t));
+
+    for (i = 0; i < pool->nworkers; i++) {
+        fluid_render_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        /* one allocation for the four buses */
+        worker->left_buf = FLUID_ARRAY(fluid_bus_t, 4 * synth->block_size);
+        if (worker->left_buf == NULL) {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+        worker->right_buf = worker->left_buf + synth->block_size;
+        worker->reverb_buf = worker->right_buf + synth->block_size;
+        worker->chorus_buf = worker->reverb_buf + synth->block_size;
+        if (pthread_create(&worker->thread, NULL, fluid_render_worker_run, worker) != 0) {
+            FLUID_LOG(FLUID_ERR, "Failed to start a render thread");
+            goto error_recovery;
+        }
+        worker->started = 1;
+    }
+
+    return pool;
+
+error_recovery:
+    delete_fluid_render_pool(pool);
+    return NULL;
+}
+
+/*
+ * delete_fluid_render_pool
+ */
+void delete_fluid_render_pool(fluid_render_pool_t *pool) {
+    int i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (pool->workers != NULL) {
+        for (i = 0; i < pool->nworkers; i++) {
+            if (pool->workers[i].started) {
+                pthread_join(pool->workers[i].thread, NULL);
+            }
+            if (pool->workers[i].left_buf != NULL) {
+                FLUID_FREE(pool->workers[i].left_buf);
+            }
+        }
+        FLUID_FREE(pool->workers);
+    }
+
+    if (pool->playing != NULL) {
+        FLUID_FREE(pool->playing);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    FLUID_FREE(pool);
+}
+
+static void fluid_render_pool_add(fluid_bus_t *dst, const fluid_bus_t *src, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+#ifdef WITH_FIXED
+        dst[i] = fluid_fixed_add_sat(dst[i], src[i]);
+#else
+        dst[i] += src[i];
+#endif
+    }
+}
+
+/*
+ * fluid_render_pool_write_voices
+ */
+int fluid_render_pool_write_voices(fluid_render_pool_t *pool,
+                                    fluid_bus_t *reverb_buf,
+                                    fluid_bus_t *chorus_buf) {
+    fluid_synth_t *synth = pool->synth;
+    int nplaying = 0;
+    int nchunks, chunk, first, i;
+
+    for (i = 0; i < synth->polyphony; i++) {
+        if (_PLAYING(synth->voice[i])) {
+            pool->playing[nplaying++] = synth->voice[i];
+        }
+    }
+
+    nchunks = nplaying / FLUID_RENDER_POOL_MIN_VOICES;
+    if (nchunks > pool->nworkers + 1) nchunks = pool->nworkers + 1;
+
+    if (nchunks < 2) {
+        for (i = 0; i < nplaying; i++) {
+            fluid_voice_write(pool->playing[i], synth->left_buf, synth->right_buf,
+                              reverb_buf, chorus_buf);
+        }
+        return nplaying;
+    }
+
+    /* chunk 0 is rendered by the caller, straight into the synth buffers.
+     * The first nplaying % nchunks chunks get one voice more. */
+    chunk = nplaying / nchunks;
+    first = chunk + (nplaying % nchunks > 0);
+    for (i = 0; i < pool->nworkers; i++) {
+        fluid_render_worker_t *worker = &pool->workers[i];
+        worker->first = first;
+        worker->count = i + 1 < nchunks ? chunk + (i + 1 < nplaying % nchunks) : 0;
+        first += worker->count;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->with_reverb = reverb_buf != NULL;
+    pool->with_chorus = chorus_buf != NULL;
+    pool->pending = pool->nworkers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->workers[0].first; i++) {
+        fluid_voice_write(pool->playing[i], synth->left_buf, synth->right_buf,
+                          reverb_buf, chorus_buf);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* sum the buses in chunk order, so the result is deterministic */
+    for (i = 0; i + 1 < nchunks; i++) {
+        fluid_render_worker_t *worker = &pool->workers[i];
+        fluid_render_pool_add(synth->left_buf, worker->left_buf, synth->block_size);
+        if (synth->right_buf != NULL)
+            fluid_render_pool_add(synth->right_buf, worker->right_buf, synth->block_size);
+        if (reverb_buf != NULL)
+            fluid_render_pool_add(reverb_buf, worker->reverb_buf, synth->block_size);
+        if (chorus_buf != NULL)
+            fluid_render_pool_add(chorus_buf, worker->chorus_buf, synth->block_size);
+    }
+    return nplaying;
+}
+
+#endif /* WITH_THREADS */
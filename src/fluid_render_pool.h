@@ -0,0 +1,30 @@
+#ifndef _FLUID_RENDER_POOL_H
+#define _FLUID_RENDER_POOL_H
+
+#include "fluidsynth_priv.h"
+
+/*
+ * Worker threads for the voice loop of fluid_synth_one_block (built with
+ * WITH_THREADS, enabled with SynthParams.render_threads > 1).
+ *
+ * The playing voices of a block are split into contiguous chunks in voice
+ * order, one per thread. Every thread mixes its chunk into a private set
+ * of left/right/reverb/chorus buses, and the caller sums the buses in
+ * chunk order before reverb and chorus run. The result only depends on
+ * the voices, never on thread timing. It differs from the single-threaded
+ * render by float rounding only, because the partial sums are added in a
+ * different order.
+ */
+typedef struct _fluid_render_pool_t fluid_render_pool_t;
+
+fluid_render_pool_t *new_fluid_render_pool(fluid_synth_t *synth, int threads);
+void delete_fluid_render_pool(fluid_render_pool_t *pool);
+
+/* Mix all playing voices into the synth buffers, like the voice loop of
+ * fluid_synth_one_block. reverb_buf and chorus_buf may be NULL. Returns
+ * the number of voices rendered. */
+int fluid_render_pool_write_voices(fluid_render_pool_t *pool,
+                                    fluid_bus_t *reverb_buf,
+                                    fluid_bus_t *chorus_buf);
+
+#endif /* _FLUID_RENDER_POOL_H */
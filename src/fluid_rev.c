@@ -155,10 +155,10 @@ new_fluid_revmodel(fluid_real_t sample_rate_max, fluid_real_t sample_rate){retur
 void delete_fluid_revmodel(fluid_revmodel_t *rev){}
 
 void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
-                               fluid_real_t *left_out, fluid_real_t *right_out){}
+                               fluid_real_t *left_out, fluid_real_t *right_out, int count){}
 
 void fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
-                                   fluid_real_t *left_out, fluid_real_t *right_out){}
+                                   fluid_real_t *left_out, fluid_real_t *right_out, int count){}
 
 void fluid_revmodel_reset(fluid_revmodel_t *rev){}
 
@@ -1148,16 +1148,17 @@ fluid_revmodel_reset(fluid_revmodel_t *rev)
 /*-----------------------------------------------------------------------------
 * fdn reverb process replace.
 * @param rev pointer on reverb.
-* @param in monophonic buffer input (FLUID_BUFSIZE sample).
-* @param left_out stereo left processed output (FLUID_BUFSIZE sample).
-* @param right_out stereo right processed output (FLUID_BUFSIZE sample).
+* @param in monophonic buffer input (count samples).
+* @param left_out stereo left processed output (count samples).
+* @param right_out stereo right processed output (count samples).
+* @param count number of samples to process.
 *
 * The processed reverb is replacing anything there in out.
 * Reverb API.
 -----------------------------------------------------------------------------*/
 void
 fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
-                              fluid_real_t *left_out, fluid_real_t *right_out)
+                              fluid_real_t *left_out, fluid_real_t *right_out, int count)
 {
     int i, k;
 
@@ -1168,7 +1169,7 @@ fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
     fluid_real_t delay_out_s;          /* sample */
     fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
 
-    for(k = 0; k < FLUID_BUFSIZE; k++)
+    for(k = 0; k < count; k++)
     {
         /* stereo output */
         out_left = out_right = 0;
@@ -1271,15 +1272,16 @@ fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
 /*-----------------------------------------------------------------------------
 * fdn reverb process mix.
 * @param rev pointer on reverb.
-* @param in monophonic buffer input (FLUID_BUFSIZE samples).
-* @param left_out stereo left processed output (FLUID_BUFSIZE samples).
-* @param right_out stereo right processed output (FLUID_BUFSIZE samples).
+* @param in monophonic buffer input (count samples).
+* @param left_out stereo left processed output (count samples).
+* @param right_out stereo right processed output (count samples).
+* @param count number of samples to process.
 *
 * The processed reverb is mixed in out with samples already there in out.
 * Reverb API.
 -----------------------------------------------------------------------------*/
 void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
-                               fluid_real_t *left_out, fluid_real_t *right_out)
+                               fluid_real_t *left_out, fluid_real_t *right_out, int count)
 {
     int i, k;
 
@@ -1290,7 +1292,7 @@ void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
     fluid_real_t delay_out_s;          /* sample */
     fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
 
-    for(k = 0; k < FLUID_BUFSIZE; k++)
+    for(k = 0; k < count; k++)
     {
         /* stereo output */
         out_left = out_right = 0;
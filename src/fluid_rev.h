@@ -200,10 +200,10 @@ new_fluid_revmodel(fluid_real_t sample_rate_max, fluid_real_t sample_rate);
 void delete_fluid_revmodel(fluid_revmodel_t *rev);
 
 void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
-                               fluid_real_t *left_out, fluid_real_t *right_out);
+                               fluid_real_t *left_out, fluid_real_t *right_out, int count);
 
 void fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
-                                   fluid_real_t *left_out, fluid_real_t *right_out);
+                                   fluid_real_t *left_out, fluid_real_t *right_out, int count);
 
 void fluid_revmodel_reset(fluid_revmodel_t *rev);
 
@@ -0,0 +1,214 @@
+#include "fluid_sample_pager.h"
+
+#ifdef WITH_THREADS
+#include <pthread.h>
+#endif
+
+int fluid_sample_page_in(fluid_sfont_t *sfont, fluid_sample_t *sample) {
+    fluid_fileapi_t *fapi = sfont->fileapi;
+    short *data, *none = NULL;
+    void *fd;
+
+    sample->last_used = __atomic_add_fetch(&sfont->clock, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&sample->data, __ATOMIC_ACQUIRE) != NULL) {
+        return FLUID_OK;
+    }
+
+    data = FLUID_MALLOC(sample->size);
+    if (data == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    fd = fapi->fopen(fapi, sfont->filename);
+    if (fd == NULL) {
+        FLUID_LOG(FLUID_ERR, "Can't open soundfont file");
+        FLUID_FREE(data);
+        return FLUID_FAILED;
+    }
+    if (fapi->fseek(fd, sample->pos, SEEK_SET) == FLUID_FAILED ||
+        fapi->fread(data, sample->size, fd) == FLUID_FAILED) {
+        FLUID_LOG(FLUID_ERR, "Failed to read sample %s", sample->name);
+        fapi->fclose(fd);
+        FLUID_FREE(data);
+        return FLUID_FAILED;
+    }
+    fapi->fclose(fd);
+
+    /* another thread may have paged it in meanwhile */
+    if (!__atomic_compare_exchange_n(&sample->data, &none, data, 0, __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED)) {
+        FLUID_FREE(data);
+        return FLUID_OK;
+    }
+    __atomic_add_fetch(&sfont->resident, sample->size, __ATOMIC_RELAXED);
+    return FLUID_OK;
+}
+
+int fluid_preset_page_in(fluid_preset_t *preset) {
+    int k;
+
+    if (!fluid_sfont_is_paged(preset->sfont)) {
+        return FLUID_OK;
+    }
+    for (k = 0; k < preset->key_first[128]; k++) {
+        fluid_sample_t *sample = preset->pairs[preset->key_pairs[k]].sample;
+        if (fluid_sample_page_in(preset->sfont, sample) != FLUID_OK) {
+            return FLUID_FAILED;
+        }
+    }
+    return FLUID_OK;
+}
+
+void fluid_sfont_page_out(fluid_sfont_t *sfont) {
+    fluid_list_t *list;
+    fluid_sample_t *sample, *oldest;
+    short *data;
+
+    while (__atomic_load_n(&sfont->resident, __ATOMIC_RELAXED) > sfont->cache_size) {
+        oldest = NULL;
+        for (list = sfont->sample; list; list = fluid_list_next(list)) {
+            sample = (fluid_sample_t *)fluid_list_get(list);
+            if (__atomic_load_n(&sample->data, __ATOMIC_RELAXED) == NULL ||
+                __atomic_load_n(&sample->refcount, __ATOMIC_RELAXED) > 0) {
+                continue;
+            }
+            /* the clock wraps */
+            if (oldest == NULL || (int)(sample->last_used - oldest->last_used) < 0) {
+                oldest = sample;
+            }
+        }
+        if (oldest == NULL) {
+            return;
+        }
+
+        data = __atomic_exchange_n(&oldest->data, NULL, __ATOMIC_ACQ_REL);
+        if (data != NULL) {
+            FLUID_FREE(data);
+            __atomic_sub_fetch(&sfont->resident, oldest->size, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/***************************************************************
+ *
+ *                           PRELOADER
+ */
+
+struct _fluid_sample_preloader_t {
+#ifdef WITH_THREADS
+    pthread_t thread;
+    int started;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    fluid_list_t *queue; /* presets to page in, oldest first */
+    int busy;            /* a preset is being paged in */
+    int quit;
+#else
+    int unused;
+#endif
+};
+
+#ifdef WITH_THREADS
+static void *fluid_sample_preloader_run(void *data) {
+    fluid_sample_preloader_t *preloader = data;
+    fluid_preset_t *preset;
+
+    pthread_mutex_lock(&preloader->mutex);
+    for (;;) {
+        while (!preloader->quit && preloader->queue == NULL) {
+            pthread_cond_wait(&preloader->work_cond, &preloader->mutex);
+        }
+        if (preloader->quit) break;
+        preset = (fluid_preset_t *)fluid_list_get(preloader->queue);
+        preloader->queue = fluid_list_remove(preloader->queue, preset);
+        preloader->busy = 1;
+        pthread_mutex_unlock(&preloader->mutex);
+
+        fluid_preset_page_in(preset);
+
+        pthread_mutex_lock(&preloader->mutex);
+        preloader->busy = 0;
+        if (preloader->queue == NULL) {
+            pthread_cond_broadcast(&preloader->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&preloader->mutex);
+    return NULL;
+}
+#endif
+
+fluid_sample_preloader_t *new_fluid_sample_preloader(void) {
+    fluid_sample_preloader_t *preloader = FLUID_NEW(fluid_sample_preloader_t);
+
+    if (preloader == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    FLUID_MEMSET(preloader, 0, sizeof(fluid_sample_preloader_t));
+
+#ifdef WITH_THREADS
+    pthread_mutex_init(&preloader->mutex, NULL);
+    pthread_cond_init(&preloader->work_cond, NULL);
+    pthread_cond_init(&preloader->done_cond, NULL);
+    if (pthread_create(&preloader->thread, NULL, fluid_sample_preloader_run, preloader) != 0) {
+        FLUID_LOG(FLUID_ERR, "Failed to start the sample preload thread");
+        delete_fluid_sample_preloader(preloader);
+        return NULL;
+    }
+    preloader->started = 1;
+#endif
+    return preloader;
+}
+
+/*
+ * delete_fluid_sample_preloader
+ *
+ * The presets still queued are dropped, the one being paged in is
+ * finished.
+ */
+void delete_fluid_sample_preloader(fluid_sample_preloader_t *preloader) {
+    if (preloader == NULL) {
+        return;
+    }
+
+#ifdef WITH_THREADS
+    pthread_mutex_lock(&preloader->mutex);
+    preloader->quit = 1;
+    pthread_cond_broadcast(&preloader->work_cond);
+    pthread_mutex_unlock(&preloader->mutex);
+    if (preloader->started) {
+        pthread_join(preloader->thread, NULL);
+    }
+
+    delete_fluid_list(preloader->queue);
+    pthread_cond_destroy(&preloader->done_cond);
+    pthread_cond_destroy(&preloader->work_cond);
+    pthread_mutex_destroy(&preloader->mutex);
+#endif
+    FLUID_FREE(preloader);
+}
+
+int fluid_sample_preloader_queue(fluid_sample_preloader_t *preloader, fluid_preset_t *preset) {
+#ifdef WITH_THREADS
+    pthread_mutex_lock(&preloader->mutex);
+    preloader->queue = fluid_list_append(preloader->queue, preset);
+    pthread_cond_signal(&preloader->work_cond);
+    pthread_mutex_unlock(&preloader->mutex);
+    return FLUID_OK;
+#else
+    return fluid_preset_page_in(preset);
+#endif
+}
+
+void fluid_sample_preloader_wait(fluid_sample_preloader_t *preloader) {
+#ifdef WITH_THREADS
+    pthread_mutex_lock(&preloader->mutex);
+    while (preloader->queue != NULL || preloader->busy) {
+        pthread_cond_wait(&preloader->done_cond, &preloader->mutex);
+    }
+    pthread_mutex_unlock(&preloader->mutex);
+#endif
+}
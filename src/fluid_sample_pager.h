@@ -0,0 +1,49 @@
+#ifndef _FLUID_SAMPLE_PAGER_H
+#define _FLUID_SAMPLE_PAGER_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_sfont.h"
+
+/*
+ * The samples of a paged SoundFont (SynthParams.sample_cache_size).
+ *
+ * The sample headers are loaded with the SoundFont, the data of a sample
+ * is read from the file the first time a note-on plays it or a preset
+ * with it is preloaded. Once more than cache_size bytes are paged in, the
+ * samples no voice plays are dropped again, the least recently played
+ * first.
+ *
+ * A sample can be paged in on any thread, its data pointer is set with an
+ * atomic store once the data is read. Samples are only dropped on the
+ * thread that plays the notes, which is the one that starts the voices
+ * holding on to them.
+ */
+
+/* reads the data of the sample unless it's there already, and marks it
+ * as played */
+int fluid_sample_page_in(fluid_sfont_t *sfont, fluid_sample_t *sample);
+
+/* pages in every sample of the preset */
+int fluid_preset_page_in(fluid_preset_t *preset);
+
+/* drops the least recently played samples no voice plays until the
+ * SoundFont is within its cache size, or all left are playing */
+void fluid_sfont_page_out(fluid_sfont_t *sfont);
+
+/*
+ * Pages in the samples of presets on a thread of its own (WITH_THREADS),
+ * so that their first notes don't wait for the file. Built without
+ * threads, the presets are paged in by the caller.
+ */
+typedef struct _fluid_sample_preloader_t fluid_sample_preloader_t;
+
+fluid_sample_preloader_t *new_fluid_sample_preloader(void);
+void delete_fluid_sample_preloader(fluid_sample_preloader_t *preloader);
+
+/* queues the preset, it must stay loaded until the queue is done */
+int fluid_sample_preloader_queue(fluid_sample_preloader_t *preloader, fluid_preset_t *preset);
+
+/* returns when the presets queued so far are paged in */
+void fluid_sample_preloader_wait(fluid_sample_preloader_t *preloader);
+
+#endif /* _FLUID_SAMPLE_PAGER_H */
@@ -0,0 +1,593 @@
+#include "fluid_sample_stream.h"
+#include "fluid_synth.h"
+#include "fluid_voice.h"
+
+#ifdef WITH_THREADS
+#include <pthread.h>
+#endif
+
+#define FLUID_STREAM_MASK (FLUID_STREAM_RING - 1)
+#define FLUID_STREAM_MIN(_a, _b) ((_a) < (_b) ? (_a) : (_b))
+#define FLUID_STREAM_MAX(_a, _b) ((_a) > (_b) ? (_a) : (_b))
+
+/* a window grows beyond this when a chunk plays more points */
+#define FLUID_STREAM_WINDOW 4096
+
+static int fluid_sample_stream_read(fluid_fileapi_t *fapi, void *fd, fluid_sample_t *sample,
+                                    unsigned int first, unsigned int count, short *buf) {
+    if (fapi->fseek(fd, sample->pos + 2 * first, SEEK_SET) == FLUID_FAILED ||
+        fapi->fread(buf, 2 * count, fd) == FLUID_FAILED) {
+        FLUID_LOG(FLUID_ERR, "Failed to read sample %s", sample->name);
+        return FLUID_FAILED;
+    }
+    return FLUID_OK;
+}
+
+static short *fluid_sample_stream_load_part(fluid_fileapi_t *fapi, void *fd,
+                                            fluid_sample_t *sample, unsigned int first,
+                                            unsigned int count) {
+    short *buf = FLUID_ARRAY(short, count);
+
+    if (buf == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    if (fluid_sample_stream_read(fapi, fd, sample, first, count, buf) != FLUID_OK) {
+        FLUID_FREE(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+int fluid_sfont_stream_load(fluid_sfont_t *sfont) {
+    fluid_fileapi_t *fapi = sfont->fileapi;
+    fluid_list_t *list;
+    fluid_sample_t *sample;
+    unsigned int points, head, first, last;
+    void *fd;
+
+    fd = fapi->fopen(fapi, sfont->filename);
+    if (fd == NULL) {
+        FLUID_LOG(FLUID_ERR, "Can't open soundfont file");
+        return FLUID_FAILED;
+    }
+
+    for (list = sfont->sample; list; list = fluid_list_next(list)) {
+        sample = (fluid_sample_t *)fluid_list_get(list);
+        points = sample->size / 2;
+
+        /* the first stream_head_ms, and the loop with the points around it
+         * the interpolators read */
+        head = (unsigned int)((uint64_t)sfont->stream_ms * sample->samplerate / 1000);
+        if (head < 2 * FLUID_STREAM_PAD) head = 2 * FLUID_STREAM_PAD;
+        first = last = 0;
+        if (sample->loopend > sample->loopstart) {
+            first = sample->loopstart > FLUID_STREAM_PAD ? sample->loopstart - FLUID_STREAM_PAD : 0;
+            last = sample->loopend + FLUID_STREAM_PAD;
+            if (last > points) last = points;
+            if (first <= head) {
+                /* a loop near the start is part of the head */
+                if (head < last) head = last;
+                first = last = 0;
+            }
+        }
+        if (head > points) head = points;
+
+        if (2 * (head + last - first) >= points) {
+            sample->data = fluid_sample_stream_load_part(fapi, fd, sample, 0, points);
+            if (sample->data == NULL) goto error_recovery;
+            sfont->resident += sample->size;
+#if DEBUG
+            fluid_voice_optimize_sample(sample);
+#endif
+            continue;
+        }
+
+        sample->head = fluid_sample_stream_load_part(fapi, fd, sample, 0, head);
+        if (sample->head == NULL) goto error_recovery;
+        sample->head_points = head;
+        if (last > first) {
+            sample->loop = fluid_sample_stream_load_part(fapi, fd, sample, first, last - first);
+            if (sample->loop == NULL) goto error_recovery;
+            sample->loop_first = first;
+            sample->loop_points = last - first;
+        }
+        sfont->resident += 2 * (head + last - first);
+#if DEBUG
+        /* the loop is in memory, in the head or on its own */
+        sample->data = sample->loop != NULL ? sample->loop - sample->loop_first : sample->head;
+        fluid_voice_optimize_sample(sample);
+        sample->data = NULL;
+#endif
+    }
+
+    fapi->fclose(fd);
+    return FLUID_OK;
+
+error_recovery:
+    fapi->fclose(fd);
+    return FLUID_FAILED;
+}
+
+/***************************************************************
+ *
+ *                           STREAMER
+ */
+
+struct _fluid_sample_stream_t {
+    fluid_sample_streamer_t *streamer;
+
+    /* set by the voice with the mutex held */
+    fluid_sample_t *sample; /* the sample playing, NULL for none */
+    unsigned int gen;       /* counts the samples played, so that the points
+                               read for the one before are dropped */
+    int error;              /* the file can't be read, or the SoundFont was
+                               forgotten */
+
+    /* the ring has the points from 'want' up to 'end': 'want' is set by the
+     * render thread, 'end' by the streamer thread */
+    unsigned int want;
+    unsigned int end;
+    short *ring;
+
+    /* the points of a chunk that aren't in one resident part */
+    short *window;
+    unsigned int window_points;
+
+    /* the points of the voice while it is mapped */
+    int start, end_point, loopstart, loopend;
+};
+
+struct _fluid_sample_streamer_t {
+    fluid_sample_stream_t *streams;
+    int count;
+    int offline;              /* the render thread waits for the points */
+    unsigned int underruns;   /* chunks rendered with points missing */
+
+#ifdef WITH_THREADS
+    pthread_t thread;
+    int started;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond; /* a ring wants points */
+    pthread_cond_t done_cond; /* points were read */
+    fluid_sfont_t *reading;   /* the SoundFont whose file the thread has open */
+    int quit;
+#endif
+};
+
+#ifdef WITH_THREADS
+/* the stream whose ring is the least ahead of its voice */
+static fluid_sample_stream_t *fluid_sample_streamer_next(fluid_sample_streamer_t *streamer) {
+    fluid_sample_stream_t *stream, *next = NULL;
+    unsigned int want, limit;
+    long lead, least = 0;
+    int i;
+
+    for (i = 0; i < streamer->count; i++) {
+        stream = &streamer->streams[i];
+        if (stream->sample == NULL || stream->error) continue;
+        want = __atomic_load_n(&stream->want, __ATOMIC_RELAXED);
+        limit = stream->sample->size / 2;
+        if (limit > want + FLUID_STREAM_RING) limit = want + FLUID_STREAM_RING;
+        if (stream->end >= limit) continue;
+        lead = (long)stream->end - (long)want;
+        if (next == NULL || lead < least) {
+            next = stream;
+            least = lead;
+        }
+    }
+    return next;
+}
+
+static void *fluid_sample_streamer_run(void *data) {
+    fluid_sample_streamer_t *streamer = data;
+    fluid_sample_stream_t *stream;
+    fluid_sample_t *sample;
+    fluid_fileapi_t *fapi = NULL;
+    void *fd = NULL;
+    unsigned int gen, want, first, count;
+    int ok;
+
+    pthread_mutex_lock(&streamer->mutex);
+    while (!streamer->quit) {
+        stream = fluid_sample_streamer_next(streamer);
+        if (stream == NULL || stream->sample->sfont != streamer->reading) {
+            /* done with the file */
+            if (fd != NULL) {
+                fapi->fclose(fd);
+                fd = NULL;
+            }
+            streamer->reading = NULL;
+            pthread_cond_broadcast(&streamer->done_cond);
+            if (stream == NULL) {
+                pthread_cond_wait(&streamer->work_cond, &streamer->mutex);
+                continue;
+            }
+        }
+
+        sample = stream->sample;
+        gen = stream->gen;
+        want = __atomic_load_n(&stream->want, __ATOMIC_RELAXED);
+        first = stream->end;
+        if (first < want) {
+            /* the voice is past the points read */
+            first = want;
+            __atomic_store_n(&stream->end, first, __ATOMIC_RELAXED);
+        }
+        count = sample->size / 2 - first;
+        if (count > want + FLUID_STREAM_RING - first) count = want + FLUID_STREAM_RING - first;
+        if (count > FLUID_STREAM_CHUNK) count = FLUID_STREAM_CHUNK;
+        if (count > FLUID_STREAM_RING - (first & FLUID_STREAM_MASK)) {
+            count = FLUID_STREAM_RING - (first & FLUID_STREAM_MASK);
+        }
+        streamer->reading = sample->sfont;
+        pthread_mutex_unlock(&streamer->mutex);
+
+        /* the slots written belong to points the voice reads only once
+         * 'end' is past them */
+        if (fd == NULL) {
+            fapi = sample->sfont->fileapi;
+            fd = fapi->fopen(fapi, sample->sfont->filename);
+        }
+        ok = fd != NULL && fluid_sample_stream_read(fapi, fd, sample, first, count,
+                                                    stream->ring + (first & FLUID_STREAM_MASK)) ==
+                               FLUID_OK;
+
+        pthread_mutex_lock(&streamer->mutex);
+        if (stream->gen == gen) {
+            if (ok) {
+                __atomic_store_n(&stream->end, first + count, __ATOMIC_RELEASE);
+            } else {
+                stream->error = 1;
+            }
+        }
+        pthread_cond_broadcast(&streamer->done_cond);
+    }
+    if (fd != NULL) fapi->fclose(fd);
+    pthread_mutex_unlock(&streamer->mutex);
+    return NULL;
+}
+#endif
+
+fluid_sample_streamer_t *new_fluid_sample_streamer(int streams, int offline) {
+#ifdef WITH_THREADS
+    fluid_sample_streamer_t *streamer = FLUID_NEW(fluid_sample_streamer_t);
+    int i;
+
+    if (streamer == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    FLUID_MEMSET(streamer, 0, sizeof(fluid_sample_streamer_t));
+    pthread_mutex_init(&streamer->mutex, NULL);
+    pthread_cond_init(&streamer->work_cond, NULL);
+    pthread_cond_init(&streamer->done_cond, NULL);
+    streamer->offline = offline;
+
+    streamer->streams = FLUID_ARRAY(fluid_sample_stream_t, streams);
+    if (streamer->streams == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    FLUID_MEMSET(streamer->streams, 0, streams * sizeof(fluid_sample_stream_t));
+    streamer->count = streams;
+    for (i = 0; i < streams; i++) {
+        fluid_sample_stream_t *stream = &streamer->streams[i];
+        stream->streamer = streamer;
+        stream->ring = FLUID_ARRAY(short, FLUID_STREAM_RING);
+        stream->window = FLUID_ARRAY(short, FLUID_STREAM_WINDOW);
+        if (stream->ring == NULL || stream->window == NULL) {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+        stream->window_points = FLUID_STREAM_WINDOW;
+    }
+
+    if (pthread_create(&streamer->thread, NULL, fluid_sample_streamer_run, streamer) != 0) {
+        FLUID_LOG(FLUID_ERR, "Failed to start the sample streaming thread");
+        goto error_recovery;
+    }
+    streamer->started = 1;
+    return streamer;
+
+error_recovery:
+    delete_fluid_sample_streamer(streamer);
+    return NULL;
+#else
+    FLUID_LOG(FLUID_ERR, "Sample streaming needs WITH_THREADS");
+    return NULL;
+#endif
+}
+
+void delete_fluid_sample_streamer(fluid_sample_streamer_t *streamer) {
+    int i;
+
+    if (streamer == NULL) {
+        return;
+    }
+
+#ifdef WITH_THREADS
+    pthread_mutex_lock(&streamer->mutex);
+    streamer->quit = 1;
+    pthread_cond_broadcast(&streamer->work_cond);
+    pthread_mutex_unlock(&streamer->mutex);
+    if (streamer->started) {
+        pthread_join(streamer->thread, NULL);
+    }
+    pthread_cond_destroy(&streamer->done_cond);
+    pthread_cond_destroy(&streamer->work_cond);
+    pthread_mutex_destroy(&streamer->mutex);
+#endif
+
+    if (streamer->streams != NULL) {
+        for (i = 0; i < streamer->count; i++) {
+            FLUID_FREE(streamer->streams[i].ring);
+            FLUID_FREE(streamer->streams[i].window);
+        }
+        FLUID_FREE(streamer->streams);
+    }
+    FLUID_FREE(streamer);
+}
+
+fluid_sample_stream_t *fluid_sample_streamer_get(fluid_sample_streamer_t *streamer, int num) {
+    return &streamer->streams[num];
+}
+
+void fluid_sample_streamer_forget_sfont(fluid_sample_streamer_t *streamer,
+                                        fluid_sfont_t *sfont) {
+#ifdef WITH_THREADS
+    int i;
+
+    pthread_mutex_lock(&streamer->mutex);
+    for (i = 0; i < streamer->count; i++) {
+        if (streamer->streams[i].sample != NULL && streamer->streams[i].sample->sfont == sfont) {
+            streamer->streams[i].error = 1;
+        }
+    }
+    /* the file is closed once the thread moves on */
+    while (streamer->reading == sfont) {
+        pthread_cond_wait(&streamer->done_cond, &streamer->mutex);
+    }
+    pthread_mutex_unlock(&streamer->mutex);
+#endif
+}
+
+unsigned int fluid_sample_streamer_underruns(fluid_sample_streamer_t *streamer) {
+    return __atomic_load_n(&streamer->underruns, __ATOMIC_RELAXED);
+}
+
+/***************************************************************
+ *
+ *                           STREAMS
+ */
+
+void fluid_sample_stream_start(fluid_sample_stream_t *stream, fluid_sample_t *sample) {
+#ifdef WITH_THREADS
+    fluid_sample_streamer_t *streamer = stream->streamer;
+
+    pthread_mutex_lock(&streamer->mutex);
+    stream->sample = sample;
+    stream->gen++;
+    stream->error = 0;
+    /* the head is in memory */
+    __atomic_store_n(&stream->want, sample->head_points, __ATOMIC_RELAXED);
+    __atomic_store_n(&stream->end, sample->head_points, __ATOMIC_RELAXED);
+    pthread_cond_signal(&streamer->work_cond);
+    pthread_mutex_unlock(&streamer->mutex);
+#endif
+}
+
+void fluid_sample_stream_stop(fluid_sample_stream_t *stream) {
+#ifdef WITH_THREADS
+    if (stream->sample == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&stream->streamer->mutex);
+    stream->sample = NULL;
+    stream->gen++;
+    pthread_mutex_unlock(&stream->streamer->mutex);
+#endif
+}
+
+/* the voice reads no points below 'want' from the ring anymore, the
+ * thread is woken while the ring is less than half full */
+static void fluid_sample_stream_want(fluid_sample_stream_t *stream, unsigned int want) {
+#ifdef WITH_THREADS
+    unsigned int limit = stream->sample->size / 2;
+
+    if (want > stream->want) {
+        __atomic_store_n(&stream->want, want, __ATOMIC_RELAXED);
+    }
+    if (limit > stream->want + FLUID_STREAM_RING / 2) {
+        limit = stream->want + FLUID_STREAM_RING / 2;
+    }
+    if (__atomic_load_n(&stream->end, __ATOMIC_RELAXED) < limit) {
+        pthread_mutex_lock(&stream->streamer->mutex);
+        pthread_cond_signal(&stream->streamer->work_cond);
+        pthread_mutex_unlock(&stream->streamer->mutex);
+    }
+#endif
+}
+
+/* offline: waits until the ring has the points up to 'until', 0 if it
+ * won't get them */
+static int fluid_sample_stream_wait(fluid_sample_stream_t *stream, unsigned int until) {
+#ifdef WITH_THREADS
+    fluid_sample_streamer_t *streamer = stream->streamer;
+    int ok;
+
+    pthread_mutex_lock(&streamer->mutex);
+    while (__atomic_load_n(&stream->end, __ATOMIC_ACQUIRE) < until && !stream->error &&
+           !streamer->quit) {
+        pthread_cond_signal(&streamer->work_cond);
+        pthread_cond_wait(&streamer->done_cond, &streamer->mutex);
+    }
+    ok = __atomic_load_n(&stream->end, __ATOMIC_ACQUIRE) >= until;
+    pthread_mutex_unlock(&streamer->mutex);
+    return ok;
+#else
+    return 0;
+#endif
+}
+
+/* offline: the points the ring won't have, read by the render thread */
+static int fluid_sample_stream_read_now(fluid_sample_t *sample, unsigned int first,
+                                        unsigned int count, short *buf) {
+    fluid_fileapi_t *fapi = sample->sfont->fileapi;
+    void *fd = fapi->fopen(fapi, sample->sfont->filename);
+    int ok;
+
+    if (fd == NULL) {
+        FLUID_LOG(FLUID_ERR, "Can't open soundfont file");
+        return FLUID_FAILED;
+    }
+    ok = fluid_sample_stream_read(fapi, fd, sample, first, count, buf);
+    fapi->fclose(fd);
+    return ok;
+}
+
+/* copies the points 'lo' to 'hi' into the window, from the resident parts
+ * and the ring */
+static int fluid_sample_stream_gather(fluid_sample_stream_t *stream, fluid_sample_t *sample,
+                                      unsigned int lo, unsigned int hi) {
+    unsigned int q, next, avail, slot, k;
+    unsigned int loop_last = sample->loop_first + sample->loop_points;
+    short *window;
+    int missing = 0;
+
+    if (hi - lo > stream->window_points) {
+        window = FLUID_REALLOC(stream->window, (hi - lo) * sizeof(short));
+        if (window == NULL) {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+        stream->window = window;
+        stream->window_points = hi - lo;
+    }
+    window = stream->window - lo;
+
+    for (q = lo; q < hi; q = next) {
+        if (q < sample->head_points) {
+            next = FLUID_STREAM_MIN(hi, sample->head_points);
+            FLUID_MEMCPY(window + q, sample->head + q, (next - q) * sizeof(short));
+            continue;
+        }
+        if (sample->loop != NULL && q >= sample->loop_first && q < loop_last) {
+            next = FLUID_STREAM_MIN(hi, loop_last);
+            FLUID_MEMCPY(window + q, sample->loop + (q - sample->loop_first),
+                         (next - q) * sizeof(short));
+            continue;
+        }
+        next = hi;
+        if (sample->loop != NULL && q < sample->loop_first && next > sample->loop_first) {
+            next = sample->loop_first;
+        }
+
+        avail = __atomic_load_n(&stream->end, __ATOMIC_ACQUIRE);
+        if (q >= stream->want && q < avail) {
+            next = FLUID_STREAM_MIN(next, avail);
+            slot = q & FLUID_STREAM_MASK;
+            k = FLUID_STREAM_MIN(next - q, FLUID_STREAM_RING - slot);
+            FLUID_MEMCPY(window + q, stream->ring + slot, k * sizeof(short));
+            FLUID_MEMCPY(window + q + k, stream->ring, (next - q - k) * sizeof(short));
+            continue;
+        }
+
+        if (stream->streamer->offline) {
+            if (q >= stream->want && next <= stream->want + FLUID_STREAM_RING &&
+                fluid_sample_stream_wait(stream, next)) {
+                next = q;
+                continue;
+            }
+            if (fluid_sample_stream_read_now(sample, q, next - q, window + q) == FLUID_OK) {
+                continue;
+            }
+        } else if (q < stream->want && next > stream->want) {
+            /* the ring may have the points from 'want' on */
+            next = stream->want;
+        }
+        FLUID_MEMSET(window + q, 0, (next - q) * sizeof(short));
+        missing = 1;
+    }
+
+    if (missing) {
+        __atomic_add_fetch(&stream->streamer->underruns, 1, __ATOMIC_RELAXED);
+    }
+    return FLUID_OK;
+}
+
+int fluid_sample_stream_map(fluid_voice_t *voice, unsigned int count) {
+    fluid_sample_stream_t *stream = voice->stream;
+    fluid_sample_t *sample = voice->sample;
+    long points = sample->size / 2;
+    long pos = fluid_phase_index(_DSP(voice, phase));
+    long reach = pos + (long)(_DSP(voice, phase_incr) * count) + 2;
+    long lo, hi;
+    unsigned int want;
+    int looping;
+
+    looping = _SAMPLEMODE(voice) == FLUID_LOOP_DURING_RELEASE ||
+              (_SAMPLEMODE(voice) == FLUID_LOOP_UNTIL_RELEASE &&
+               voice->volenv_section < FLUID_VOICE_ENVRELEASE);
+
+    /* the points the chunk plays */
+    if (looping && (voice->has_looped || reach + FLUID_STREAM_PAD >= voice->loopend)) {
+        /* it may wrap around the loop */
+        lo = FLUID_STREAM_MIN(pos, voice->loopstart);
+        hi = FLUID_STREAM_MAX(pos + 1, voice->loopend);
+    } else if (!looping && voice->has_looped && pos <= voice->loopstart + FLUID_STREAM_PAD) {
+        /* released at the start of the loop, the end of it is still read */
+        lo = FLUID_STREAM_MIN(pos, voice->loopstart);
+        hi = FLUID_STREAM_MAX(reach, voice->loopend);
+    } else {
+        lo = looping ? pos : FLUID_STREAM_MIN(pos, voice->end);
+        hi = reach;
+    }
+    lo -= FLUID_STREAM_PAD;
+    hi += FLUID_STREAM_PAD;
+    if (lo < 0) lo = 0;
+    if (hi > points) hi = points;
+
+    /* the points out of reach are only read, never played */
+    stream->start = voice->start;
+    stream->end_point = voice->end;
+    stream->loopstart = voice->loopstart;
+    stream->loopend = voice->loopend;
+    if (voice->start < lo || voice->start >= hi) voice->start = lo;
+    if (voice->loopstart < lo || voice->loopstart >= hi) voice->loopstart = lo;
+    if (voice->end < lo || voice->end >= hi) voice->end = hi - 1;
+    if (voice->loopend < lo || voice->loopend > hi) voice->loopend = hi - 1;
+
+    /* looping in the resident loop, the ring reads what follows it for
+     * the release */
+    want = lo;
+    if (looping && voice->has_looped && sample->loop != NULL && lo >= sample->loop_first &&
+        hi <= sample->loop_first + sample->loop_points) {
+        want = sample->loop_first + sample->loop_points;
+    }
+    fluid_sample_stream_want(stream, want);
+
+    if (hi <= sample->head_points) {
+        voice->dsp_data = sample->head;
+    } else if (sample->loop != NULL && lo >= sample->loop_first &&
+               hi <= sample->loop_first + sample->loop_points) {
+        voice->dsp_data = sample->loop - sample->loop_first;
+    } else {
+        if (fluid_sample_stream_gather(stream, sample, lo, hi) != FLUID_OK) {
+            fluid_sample_stream_unmap(voice);
+            return FLUID_FAILED;
+        }
+        voice->dsp_data = stream->window - lo;
+    }
+    return FLUID_OK;
+}
+
+void fluid_sample_stream_unmap(fluid_voice_t *voice) {
+    fluid_sample_stream_t *stream = voice->stream;
+
+    voice->start = stream->start;
+    voice->end = stream->end_point;
+    voice->loopstart = stream->loopstart;
+    voice->loopend = stream->loopend;
+}
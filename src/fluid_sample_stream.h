@@ -0,0 +1,66 @@
+#ifndef _FLUID_SAMPLE_STREAM_H
+#define _FLUID_SAMPLE_STREAM_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_sfont.h"
+
+/*
+ * The samples of a streamed SoundFont (SynthParams.stream_head_ms).
+ *
+ * Only the first stream_head_ms of every sample and its loop stay in
+ * memory, read with the SoundFont. The rest is read while the sample
+ * plays: every voice has a stream, a ring of the points ahead of its
+ * phase that a thread of the streamer keeps filled from the file. The
+ * interpolators read through voice->dsp_data, which
+ * fluid_sample_stream_map() points at the resident part or a window of
+ * the voice with the points of the chunk about to be rendered.
+ *
+ * A point the ring doesn't have in time is an underrun and plays as
+ * zero, unless the streamer is offline: then the render thread waits
+ * for it and the output is the same as with the whole sample loaded.
+ * Samples whose resident parts would be half of them or more are loaded
+ * as a whole.
+ */
+
+/* points around the chunk that the interpolators may read: the taps of
+ * the 32 point sinc and the points wrapped around a loop */
+#define FLUID_STREAM_PAD 48
+/* points of the ring of a stream, a power of 2 */
+#define FLUID_STREAM_RING 16384
+/* points read from the file at a time */
+#define FLUID_STREAM_CHUNK 4096
+
+#define fluid_sample_is_streamed(_s) ((_s)->head != NULL)
+
+/* reads the resident parts of the samples of a streamed SoundFont */
+int fluid_sfont_stream_load(fluid_sfont_t *sfont);
+
+typedef struct _fluid_sample_streamer_t fluid_sample_streamer_t;
+
+/* 'streams' streams, one per voice. Needs WITH_THREADS */
+fluid_sample_streamer_t *new_fluid_sample_streamer(int streams, int offline);
+void delete_fluid_sample_streamer(fluid_sample_streamer_t *streamer);
+
+fluid_sample_stream_t *fluid_sample_streamer_get(fluid_sample_streamer_t *streamer, int num);
+
+/* stops reading the samples of the SoundFont, before it is deleted */
+void fluid_sample_streamer_forget_sfont(fluid_sample_streamer_t *streamer,
+                                        fluid_sfont_t *sfont);
+
+/* chunks rendered with points missing */
+unsigned int fluid_sample_streamer_underruns(fluid_sample_streamer_t *streamer);
+
+/* the voice starts playing a streamed sample from its start, or stops */
+void fluid_sample_stream_start(fluid_sample_stream_t *stream, fluid_sample_t *sample);
+void fluid_sample_stream_stop(fluid_sample_stream_t *stream);
+
+/*
+ * Sets voice->dsp_data for the next 'count' samples of the voice. Its
+ * start, end and loop points that the chunk can't reach are moved into
+ * the points it has until fluid_sample_stream_unmap(), so that the
+ * interpolators only read those.
+ */
+int fluid_sample_stream_map(fluid_voice_t *voice, unsigned int count);
+void fluid_sample_stream_unmap(fluid_voice_t *voice);
+
+#endif /* _FLUID_SAMPLE_STREAM_H */
@@ -1,5 +1,14 @@
 #include "fluid_sfont.h"
 #include "fluid_gen.h"
+#include "fluid_synth.h"
+#include "fluid_sample_pager.h"
+#include "fluid_sample_stream.h"
+#include "fluid_bank.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #ifdef FLUID_NO_LOG
 #define gerr(...)  (FAIL)
@@ -27,6 +36,10 @@ int gerr(int ev, char *fmt, ...) {
 
 
 
+/* the zero points the SoundFont spec puts after every sample, a paged
+ * sample keeps them for the interpolation past its end */
+#define FLUID_SAMPLE_GUARD_POINTS 46
+
 /***************************************************************
  *
  *                           SFONT LOADER
@@ -79,7 +92,54 @@ fluid_fileapi_t *fluid_get_default_fileapi(void) {
     return fluid_default_fileapi;
 }
 
+#ifdef __linux__
+/* maps the sample data from the current position on, the mapping starts at
+ * the page the data starts in */
+static void *mmap_fread_zero_memcpy(int count, void *handle) {
+    long pos = FLUID_FTELL((FILE *)handle);
+    long page = sysconf(_SC_PAGESIZE);
+    long ofs = pos % page;
+    char *map;
+
+    map = mmap(NULL, count + ofs, PROT_READ, MAP_SHARED, fileno((FILE *)handle), pos - ofs);
+    if (map == MAP_FAILED) {
+        FLUID_LOG(FLUID_ERR, _("Failed to map %d bytes of sample data"), count);
+        return NULL;
+    }
+    /* the voices read it at random, but soon: start reading it in */
+    madvise(map, count + ofs, MADV_WILLNEED);
+
+    if (safe_fseek(handle, count, SEEK_CUR) == FLUID_FAILED) {
+        munmap(map, count + ofs);
+        return NULL;
+    }
+    return map + ofs;
+}
+
+static void mmap_free_zero_memcpy(void *buf, int count) {
+    long ofs = (uintptr_t)buf % sysconf(_SC_PAGESIZE);
+    munmap((char *)buf - ofs, count + ofs);
+}
+
+static const fluid_fileapi_t mmap_fileapi = {
+    NULL,       default_fopen,  safe_fread,    mmap_fread_zero_memcpy,
+    safe_fseek, default_fclose, default_ftell, mmap_free_zero_memcpy};
+#endif
+
+fluid_fileapi_t *fluid_get_mmap_fileapi(void) {
+#ifdef __linux__
+    return (fluid_fileapi_t *)&mmap_fileapi;
+#else
+    return NULL;
+#endif
+}
+
 fluid_sfont_t *fluid_soundfont_load(fluid_fileapi_t *fileapi, const char *filename) {
+    return fluid_soundfont_load_paged(fileapi, filename, 0);
+}
+
+static fluid_sfont_t *fluid_soundfont_load_with(fluid_fileapi_t *fileapi, const char *filename,
+                                                unsigned int cache_size, unsigned int stream_ms) {
     fluid_sfont_t *sfont = FLUID_NEW(fluid_sfont_t);
     if (sfont == NULL) {
         FLUID_LOG(FLUID_ERR, "Out of memory");
@@ -90,8 +150,18 @@ fluid_sfont_t *fluid_soundfont_load(fluid_fileapi_t *fileapi, const char *filena
     sfont->samplepos = 0;
     sfont->samplesize = 0;
     sfont->sample = NULL;
+    sfont->sample_count = 0;
     sfont->sampledata = NULL;
     sfont->preset = NULL;
+    sfont->is_rom = 0;
+    sfont->free_sampledata = NULL;
+    sfont->fileapi = NULL;
+    sfont->cache_size = cache_size;
+    sfont->resident = 0;
+    sfont->clock = 0;
+    sfont->stream_ms = stream_ms;
+    sfont->image = NULL;
+    sfont->is_shared = 0;
 
     if (fluid_sfont_load(sfont, filename, fileapi) == FLUID_FAILED) {
         delete_fluid_sfont(sfont);
@@ -101,6 +171,16 @@ fluid_sfont_t *fluid_soundfont_load(fluid_fileapi_t *fileapi, const char *filena
     return sfont;
 }
 
+fluid_sfont_t *fluid_soundfont_load_paged(fluid_fileapi_t *fileapi, const char *filename,
+                                          unsigned int cache_size) {
+    return fluid_soundfont_load_with(fileapi, filename, cache_size, 0);
+}
+
+fluid_sfont_t *fluid_soundfont_load_streamed(fluid_fileapi_t *fileapi, const char *filename,
+                                             unsigned int head_ms) {
+    return fluid_soundfont_load_with(fileapi, filename, 0, head_ms);
+}
+
 /***************************************************************
  *
  *                           PUBLIC INTERFACE
@@ -115,23 +195,35 @@ int delete_fluid_sfont(fluid_sfont_t *sfont) {
     }
 
     for (list = sfont->sample; list; list = fluid_list_next(list)) {
-        delete_fluid_sample((fluid_sample_t *)fluid_list_get(list));
+        fluid_sample_t *sample = (fluid_sample_t *)fluid_list_get(list);
+        if (sfont->fileapi != NULL) {
+            FLUID_FREE(sample->data);
+            FLUID_FREE(sample->head);
+            FLUID_FREE(sample->loop);
+        }
+        if (sfont->image == NULL) {
+            delete_fluid_sample(sample);
+        }
     }
 
-    if (sfont->sample) {
+    if (sfont->sample && sfont->image == NULL) {
         delete_fluid_list(sfont->sample);
     }
 
     if (sfont->sampledata != NULL && !sfont->is_rom) {
         FLUID_FREE(sfont->sampledata);
+    } else if (sfont->sampledata != NULL && sfont->free_sampledata != NULL) {
+        sfont->free_sampledata(sfont->sampledata, sfont->samplesize);
     }
 
-    preset = sfont->preset;
+    /* the samples and presets of a compiled bank are part of its image */
+    preset = sfont->image == NULL ? sfont->preset : NULL;
     while (preset != NULL) {
         sfont->preset = preset->next;
         delete_fluid_preset(preset);
         preset = sfont->preset;
     }
+    FLUID_FREE(sfont->image);
 
     FLUID_FREE(sfont);
     return FLUID_OK;
@@ -156,6 +248,11 @@ int fluid_sfont_load(fluid_sfont_t *sfont, const char *filename, fluid_fileapi_t
 
     sfont->filename = FLUID_STRDUP(filename);
 
+    /* a compiled bank has its tables ready */
+    if (fluid_bank_is_compiled(filename, fapi)) {
+        return fluid_bank_load(sfont, fapi);
+    }
+
     /* The actual loading is done in the sfont and sffile files */
     sfdata = sfload_file(filename, fapi);
     if (sfdata == NULL) {
@@ -169,8 +266,14 @@ int fluid_sfont_load(fluid_sfont_t *sfont, const char *filename, fluid_fileapi_t
     sfont->samplesize = sfdata->samplesize;
     sfont->is_compressed = sfdata->is_compressed;
 
-    /* load sample data in one block */
-    if (fluid_sfont_load_sampledata(sfont, fapi) != FLUID_OK) goto err_exit;
+    if ((sfont->cache_size > 0 || sfont->stream_ms > 0) && fapi->fread_zero_memcpy == NULL &&
+        !sfont->is_compressed) {
+        /* the samples are read when they are played */
+        sfont->fileapi = fapi;
+    } else if (fluid_sfont_load_sampledata(sfont, fapi) != FLUID_OK) {
+        /* load sample data in one block */
+        goto err_exit;
+    }
 
     /* Create all the sample headers */
     p = sfdata->sample;
@@ -184,11 +287,17 @@ int fluid_sfont_load(fluid_sfont_t *sfont, const char *filename, fluid_fileapi_t
 
         fluid_sfont_add_sample(sfont, sample);
 #if DEBUG
-        fluid_voice_optimize_sample(sample);
+        if (sample->data != NULL) fluid_voice_optimize_sample(sample);
 #endif
         p = fluid_list_next(p);
     }
 
+    /* a streamed SoundFont keeps the start and the loop of its samples */
+    if (sfont->fileapi != NULL && sfont->stream_ms > 0 &&
+        fluid_sfont_stream_load(sfont) != FLUID_OK) {
+        goto err_exit;
+    }
+
     /* Load all the presets */
     p = sfdata->preset;
     while (p != NULL) {
@@ -267,9 +376,17 @@ int fluid_sfont_load_sampledata(fluid_sfont_t *sfont, fluid_fileapi_t *fapi) {
         return FLUID_FAILED;
     }
 
-    if (fapi->fread_zero_memcpy != NULL) {
+    /* compressed sample data has to be unpacked into ram */
+    if (fapi->fread_zero_memcpy != NULL && !sfont->is_compressed) {
         sfont->sampledata = fapi->fread_zero_memcpy(sfont->samplesize, fd);
-        sfont->is_rom = 1; 
+        if (sfont->sampledata == NULL) {
+            FLUID_LOG(FLUID_ERR, "Failed to read sample data");
+            fapi->fclose(fd);
+            return FLUID_FAILED;
+        }
+        sfont->is_rom = 1;
+        sfont->free_sampledata = fapi->free_zero_memcpy;
+        fapi->fclose(fd);
     } else {
         sfont->is_rom = 0;
         sfont->sampledata = (short *)FLUID_MALLOC_SF(sfont->samplesize);
@@ -359,6 +476,11 @@ fluid_preset_t *new_fluid_preset(fluid_sfont_t *sfont) {
     preset->num = 0;
     preset->global_zone = NULL;
     preset->zone = NULL;
+    preset->pairs = NULL;
+    preset->pair_count = 0;
+    preset->key_pairs = NULL;
+    preset->pair_gens = NULL;
+    preset->pair_mods = NULL;
     return preset;
 }
 
@@ -379,6 +501,10 @@ int delete_fluid_preset(fluid_preset_t *preset) {
         }
         zone = preset->zone;
     }
+    FLUID_FREE(preset->pairs);
+    FLUID_FREE(preset->key_pairs);
+    FLUID_FREE(preset->pair_gens);
+    FLUID_FREE(preset->pair_mods);
     FLUID_FREE(preset);
     return err;
 }
@@ -399,230 +525,288 @@ fluid_preset_t *fluid_preset_next(fluid_preset_t *preset) {
     return preset->next;
 }
 
-int fluid_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key,
-                           int vel) {
-    fluid_preset_zone_t *preset_zone, *global_preset_zone;
-    fluid_inst_t *inst;
-    fluid_inst_zone_t *inst_zone, *global_inst_zone;
-    fluid_sample_t *sample;
-    fluid_voice_t *voice;
-    fluid_mod_list_t *mod;
-    fluid_mod_list_t *mod_list[FLUID_NUM_MOD]; /* list for 'sorting' preset modulators */
-    int mod_list_count;
+/* generators the preset level doesn't offset, SF2.01 section 8.5 */
+static int fluid_preset_gen_excluded(int num) {
+    return (num == GEN_STARTADDROFS) || (num == GEN_ENDADDROFS) ||
+           (num == GEN_STARTLOOPADDROFS) || (num == GEN_ENDLOOPADDROFS) ||
+           (num == GEN_STARTADDRCOARSEOFS) || (num == GEN_ENDADDRCOARSEOFS) ||
+           (num == GEN_STARTLOOPADDRCOARSEOFS) || (num == GEN_KEYNUM) ||
+           (num == GEN_VELOCITY) || (num == GEN_ENDLOOPADDRCOARSEOFS) ||
+           (num == GEN_SAMPLEMODE) || (num == GEN_EXCLUSIVECLASS) ||
+           (num == GEN_OVERRIDEROOTKEY);
+}
+
+/*
+ * fluid_zone_merge_gens
+ *
+ * The generator values of a voice of the pair: the defaults, replaced by
+ * the instrument zone or else the global instrument zone, then offset by
+ * the preset zone or else the global preset zone. Same arithmetic as
+ * setting them on the voice one by one, in the same order.
+ */
+static void fluid_zone_merge_gens(fluid_preset_zone_t *preset_zone,
+                                  fluid_preset_zone_t *global_preset_zone,
+                                  fluid_inst_zone_t *inst_zone,
+                                  fluid_inst_zone_t *global_inst_zone,
+                                  fluid_real_t *val) {
+    uint8_t excluded[GEN_LAST] = {0};
+    fluid_sf_gen_t *gen;
+    fluid_list_t *p;
     int i;
 
-    global_preset_zone = fluid_preset_get_global_zone(preset);
-
-    /* run thru all the zones of this preset */
-    preset_zone = fluid_preset_get_zone(preset);
-    while (preset_zone != NULL) {
-        /* check if the note falls into the key and velocity range of this
-         * preset */
-        if (fluid_preset_zone_inside_range(preset_zone, key, vel)) {
-            inst = fluid_preset_zone_get_inst(preset_zone);
-            global_inst_zone = fluid_inst_get_global_zone(inst);
-
-            /* run thru all the zones of this instrument */
-            inst_zone = fluid_inst_get_zone(inst);
-            while (inst_zone != NULL) {
-                /* make sure this instrument zone has a valid sample */
-                sample = fluid_inst_zone_get_sample(inst_zone);
-                if (sample == NULL) {
-                    inst_zone = fluid_inst_zone_next(inst_zone);
-                    continue;
-                }
+    for (i = 0; i < GEN_LAST; i++) val[i] = fluid_gen_info[i].def;
 
-                /* check if the note falls into the key and velocity range of
-                 * this instrument */
-                if (fluid_inst_zone_inside_range(inst_zone, key, vel) && (sample != NULL)) {
-                    /* this is a good zone. allocate a new synthesis process and
-                     * initialize it */
-                    voice = fluid_synth_alloc_voice(synth, sample, chan, key, vel);
-                    if (voice == NULL) {
-                        return FLUID_FAILED;
-                    }
+    /* Instrument level, generators */
+    for (p = inst_zone->sf_gen; p != NULL; p = fluid_list_next(p)) {
+        gen = (fluid_sf_gen_t *)p->data;
+        val[gen->num] = gen->val;
+        excluded[gen->num] = 1;
+    }
+    if (global_inst_zone) {
+        for (p = global_inst_zone->sf_gen; p != NULL; p = fluid_list_next(p)) {
+            gen = (fluid_sf_gen_t *)p->data;
+            if (!excluded[gen->num]) val[gen->num] = gen->val;
+        }
+    }
 
-                    /* Instrument level, generators */
-                    if (1) {
-                        uint8_t inst_excluded[GEN_LAST] = {0};
-                        fluid_sf_gen_t *gen;
-                        fluid_list_t *p;
-
-                        p = inst_zone->sf_gen;
-                        while (p != NULL) {
-                            gen = (fluid_sf_gen_t *)p->data;
-                            uint8_t i = gen->num;
-                            fluid_voice_gen_set(voice, i, gen->val);
-                            inst_excluded[i] = 1;
-                            p = fluid_list_next(p);
-                        }
-
-                        if (global_inst_zone) {
-                            p = global_inst_zone->sf_gen;
-                            while (p != NULL) {
-                                gen = (fluid_sf_gen_t *)p->data;
-                                uint8_t i = gen->num;
-                                if (!inst_excluded[i]) fluid_voice_gen_set(voice, i, gen->val);
-
-                                p = fluid_list_next(p);
-                            }
-                        }
-                    }
-                    /* global instrument zone, modulators: Put them all into a
-                     * list. */
+    /* Preset level, generators */
+    FLUID_MEMSET(excluded, 0, sizeof(excluded));
+    for (p = preset_zone->sf_gen; p != NULL; p = fluid_list_next(p)) {
+        gen = (fluid_sf_gen_t *)p->data;
+        if (!fluid_preset_gen_excluded(gen->num)) {
+            val[gen->num] += gen->val;
+            excluded[gen->num] = 1;
+        }
+    }
+    if (global_preset_zone) {
+        for (p = global_preset_zone->sf_gen; p != NULL; p = fluid_list_next(p)) {
+            gen = (fluid_sf_gen_t *)p->data;
+            if (!fluid_preset_gen_excluded(gen->num) && !excluded[gen->num]) {
+                val[gen->num] += gen->val;
+            }
+        }
+    }
+}
+
+/*
+ * fluid_zone_merge_mods
+ *
+ * The modulators of the global zone and then of the zone, without the
+ * global ones identical to a local one (SF 2.01 page 69, 'bullet' 8 and
+ * second-last bullet). Returns how many were stored in 'mods', or only
+ * counts them if 'mods' is NULL.
+ */
+static int fluid_zone_merge_mods(fluid_mod_list_t *global_mod, fluid_mod_list_t *local_mod,
+                                 int skip_disabled, fluid_mod_t **mods) {
+    fluid_mod_list_t *mod, *m;
+    int count = 0;
+
+    for (mod = global_mod; mod != NULL; mod = mod->next) {
+        for (m = local_mod; m != NULL; m = m->next) {
+            if (fluid_mod_test_identity((fluid_mod_t *)m, (fluid_mod_t *)mod)) break;
+        }
+        if (m != NULL) continue;
+        /* disabled preset modulators can be skipped, instrument ones
+         * CANNOT */
+        if (skip_disabled && mod->amount == 0) continue;
+        if (mods) mods[count] = (fluid_mod_t *)mod;
+        count++;
+    }
 
-                    mod_list_count = 0;
+    for (mod = local_mod; mod != NULL; mod = mod->next) {
+        /* identical modulators of the zone: the last one stays */
+        for (m = mod->next; m != NULL; m = m->next) {
+            if (fluid_mod_test_identity((fluid_mod_t *)m, (fluid_mod_t *)mod)) break;
+        }
+        if (m != NULL) continue;
+        if (skip_disabled && mod->amount == 0) continue;
+        if (mods) mods[count] = (fluid_mod_t *)mod;
+        count++;
+    }
+    return count;
+}
 
-                    if (global_inst_zone) {
-                        mod = global_inst_zone->mod;
-                        while (mod) {
-                            mod_list[mod_list_count++] = mod;
-                            mod = mod->next;
-                        }
-                    }
+#define zone_max(a, b) ((a) > (b) ? (a) : (b))
+#define zone_min(a, b) ((a) < (b) ? (a) : (b))
 
-                    /* local instrument zone, modulators.
-                     * Replace modulators with the same definition in the list:
-                     * SF 2.01 page 69, 'bullet' 8
-                     */
-                    mod = inst_zone->mod;
-                    while (mod) {
-                        /* 'Identical' modulators will be deleted by setting
-                         * their list entry to NULL.  The list length is known,
-                         * NULL entries will be ignored later.  SF2.01
-                         * section 9.5.1 page 69, 'bullet' 3 defines
-                         * 'identical'.  */
-
-                        for (i = 0; i < mod_list_count; i++) {
-                            if (mod_list[i] &&
-                                fluid_mod_test_identity((fluid_mod_t *)mod,
-                                                        (fluid_mod_t *)mod_list[i])) {
-                                mod_list[i] = NULL;
-                            }
-                        }
-
-                        /* Finally add the new modulator to to the list. */
-                        mod_list[mod_list_count++] = mod;
-                        mod = mod->next;
-                    }
+/* runs _body for every preset zone _pz and instrument zone _iz that play
+ * together on some key and velocity, in the order note-ons play them */
+#define fluid_preset_foreach_pair(_preset, _pz, _iz, _body)                                        \
+    for (_pz = fluid_preset_get_zone(_preset); _pz != NULL; _pz = fluid_preset_zone_next(_pz))     \
+        for (_iz = _pz->inst ? fluid_inst_get_zone(_pz->inst) : NULL; _iz != NULL;                 \
+             _iz = fluid_inst_zone_next(_iz))                                                      \
+            if (fluid_inst_zone_get_sample(_iz) != NULL &&                                         \
+                zone_max(_pz->keylo, _iz->keylo) <= zone_min(_pz->keyhi, _iz->keyhi) &&            \
+                zone_max(_pz->vello, _iz->vello) <= zone_min(_pz->velhi, _iz->velhi)) {            \
+                _body                                                                              \
+            }
 
-                    /* Add instrument modulators (global / local) to the voice.
-                     */
-                    for (i = 0; i < mod_list_count; i++) {
-                        mod = mod_list[i];
-                        if (mod != NULL) { /* disabled modulators CANNOT be skipped. */
-
-                            /* Instrument modulators -supersede- existing
-                             * (default) modulators.  SF 2.01 page 69, 'bullet'
-                             * 6 */
-                            fluid_voice_add_mod(voice, (fluid_mod_t *)mod, FLUID_VOICE_OVERWRITE);
-                        }
-                    }
+/*
+ * fluid_preset_compile
+ *
+ * Flattens the zones of the preset into the pairs a note-on plays, with
+ * their generators and modulators merged, and indexes them by key. Note-on
+ * then only checks the velocity of the pairs of its key.
+ */
+int fluid_preset_compile(fluid_preset_t *preset) {
+    fluid_preset_zone_t *pz, *global_pz = fluid_preset_get_global_zone(preset);
+    fluid_inst_zone_t *iz, *global_iz;
+    fluid_zone_pair_t *pair;
+    fluid_real_t val[GEN_LAST];
+    int npairs = 0, ngens = 0, nmods = 0, nkeys = 0;
+    int i, k, n;
+
+    /* sizes */
+    fluid_preset_foreach_pair(preset, pz, iz, {
+        global_iz = fluid_inst_get_global_zone(fluid_preset_zone_get_inst(pz));
+        fluid_zone_merge_gens(pz, global_pz, iz, global_iz, val);
+        for (i = 0; i < GEN_LAST; i++) {
+            if (val[i] != fluid_gen_info[i].def) ngens++;
+        }
+        nmods += fluid_zone_merge_mods(global_iz ? global_iz->mod : NULL, iz->mod, 0, NULL);
+        nmods += fluid_zone_merge_mods(global_pz ? global_pz->mod : NULL, pz->mod, 1, NULL);
+        nkeys += zone_min(pz->keyhi, iz->keyhi) - zone_max(pz->keylo, iz->keylo) + 1;
+        npairs++;
+    })
+    if (npairs > 0xffff || nkeys > 0xffff) {
+        FLUID_LOG(FLUID_ERR, "Preset %s has too many zones", preset->name);
+        return FLUID_FAILED;
+    }
 
-                    /* Preset level, generators */
-
-                    if (1) {
-                        uint8_t preset_excluded[GEN_LAST] = {0};
-                        fluid_sf_gen_t *gen;
-                        fluid_list_t *p;
-
-                        p = preset_zone->sf_gen;
-                        while (p != NULL) {
-                            gen = (fluid_sf_gen_t *)p->data;
-                            uint8_t i = gen->num;
-                            if ((i != GEN_STARTADDROFS) && (i != GEN_ENDADDROFS) &&
-                                (i != GEN_STARTLOOPADDROFS) && (i != GEN_ENDLOOPADDROFS) &&
-                                (i != GEN_STARTADDRCOARSEOFS) && (i != GEN_ENDADDRCOARSEOFS) &&
-                                (i != GEN_STARTLOOPADDRCOARSEOFS) && (i != GEN_KEYNUM) &&
-                                (i != GEN_VELOCITY) && (i != GEN_ENDLOOPADDRCOARSEOFS) &&
-                                (i != GEN_SAMPLEMODE) && (i != GEN_EXCLUSIVECLASS) &&
-                                (i != GEN_OVERRIDEROOTKEY)) {
-                                fluid_voice_gen_incr(voice, i, gen->val);
-                                preset_excluded[i] = 1;
-                            }
-                            p = fluid_list_next(p);
-                        }
-
-                        if (global_preset_zone) {
-                            p = global_preset_zone->sf_gen;
-                            while (p != NULL) {
-                                gen = (fluid_sf_gen_t *)p->data;
-                                uint8_t i = gen->num;
-                                if ((i != GEN_STARTADDROFS) && (i != GEN_ENDADDROFS) &&
-                                    (i != GEN_STARTLOOPADDROFS) && (i != GEN_ENDLOOPADDROFS) &&
-                                    (i != GEN_STARTADDRCOARSEOFS) && (i != GEN_ENDADDRCOARSEOFS) &&
-                                    (i != GEN_STARTLOOPADDRCOARSEOFS) && (i != GEN_KEYNUM) &&
-                                    (i != GEN_VELOCITY) && (i != GEN_ENDLOOPADDRCOARSEOFS) &&
-                                    (i != GEN_SAMPLEMODE) && (i != GEN_EXCLUSIVECLASS) &&
-                                    (i != GEN_OVERRIDEROOTKEY)) {
-                                    if (!preset_excluded[i])
-                                        fluid_voice_gen_incr(voice, i, gen->val);
-                                }
-                                p = fluid_list_next(p);
-                            } // end while
-                        } // end if
-                    }
+    FLUID_FREE(preset->pairs);
+    FLUID_FREE(preset->key_pairs);
+    FLUID_FREE(preset->pair_gens);
+    FLUID_FREE(preset->pair_mods);
+    preset->pairs = FLUID_ARRAY(fluid_zone_pair_t, npairs + 1);
+    preset->key_pairs = FLUID_ARRAY(uint16_t, nkeys + 1);
+    preset->pair_gens = FLUID_ARRAY(fluid_sf_gen_t, ngens + 1);
+    preset->pair_mods = FLUID_ARRAY(fluid_mod_t *, nmods + 1);
+    if (preset->pairs == NULL || preset->key_pairs == NULL || preset->pair_gens == NULL ||
+        preset->pair_mods == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
 
-                    /* Global preset zone, modulators: put them all into a
-                     * list. */
-                    mod_list_count = 0;
-                    if (global_preset_zone) {
-                        mod = global_preset_zone->mod;
-                        while (mod) {
-                            mod_list[mod_list_count++] = mod;
-                            mod = mod->next;
-                        }
-                    }
+    preset->pair_count = npairs;
+    pair = preset->pairs;
+    ngens = nmods = 0;
+    fluid_preset_foreach_pair(preset, pz, iz, {
+        global_iz = fluid_inst_get_global_zone(fluid_preset_zone_get_inst(pz));
+        pair->sample = fluid_inst_zone_get_sample(iz);
+        pair->keylo = zone_max(pz->keylo, iz->keylo);
+        pair->keyhi = zone_min(pz->keyhi, iz->keyhi);
+        pair->vello = zone_max(pz->vello, iz->vello);
+        pair->velhi = zone_min(pz->velhi, iz->velhi);
+
+        fluid_zone_merge_gens(pz, global_pz, iz, global_iz, val);
+        pair->gens = &preset->pair_gens[ngens];
+        pair->gen_count = 0;
+        for (i = 0; i < GEN_LAST; i++) {
+            if (val[i] != fluid_gen_info[i].def) {
+                pair->gens[pair->gen_count].num = i;
+                pair->gens[pair->gen_count++].val = val[i];
+            }
+        }
+        ngens += pair->gen_count;
+
+        pair->mods = &preset->pair_mods[nmods];
+        pair->inst_mod_count = fluid_zone_merge_mods(global_iz ? global_iz->mod : NULL, iz->mod,
+                                                     0, pair->mods);
+        pair->preset_mod_count =
+            fluid_zone_merge_mods(global_pz ? global_pz->mod : NULL, pz->mod, 1,
+                                  pair->mods + pair->inst_mod_count);
+        nmods += pair->inst_mod_count + pair->preset_mod_count;
+        pair++;
+    })
+
+    /* the pairs of every key, in playing order */
+    n = 0;
+    for (k = 0; k < 128; k++) {
+        preset->key_first[k] = n;
+        for (i = 0; i < npairs; i++) {
+            if (preset->pairs[i].keylo <= k && k <= preset->pairs[i].keyhi) {
+                preset->key_pairs[n++] = i;
+            }
+        }
+    }
+    preset->key_first[128] = n;
+    return FLUID_OK;
+}
 
-                    /* Process the modulators of the local preset zone.  Kick
-                     * out all identical modulators from the global preset zone
-                     * (SF 2.01 page 69, second-last bullet) */
-
-                    mod = preset_zone->mod;
-                    while (mod) {
-                        for (i = 0; i < mod_list_count; i++) {
-                            if (mod_list[i] &&
-                                fluid_mod_test_identity((fluid_mod_t *)mod,
-                                                        (fluid_mod_t *)mod_list[i])) {
-                                mod_list[i] = NULL;
-                            }
-                        }
-
-                        /* Finally add the new modulator to the list. */
-                        mod_list[mod_list_count++] = mod;
-                        mod = mod->next;
-                    }
+int fluid_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key,
+                           int vel) {
+    fluid_voice_cache_t *cache = synth->voice_cache;
+    const fluid_voice_snapshot_t *snapshot;
+    fluid_zone_pair_t *pair;
+    fluid_voice_t *voice;
+    int i, k;
 
-                    /* Add preset modulators (global / local) to the voice. */
-                    for (i = 0; i < mod_list_count; i++) {
-                        mod = mod_list[i];
-                        if ((mod != NULL) &&
-                            (mod->amount != 0)) { // disabled modulators can be skipped.
-                            /* Preset modulators -add- to existing instrument /
-                             * default modulators.  SF2.01 page 70 first bullet
-                             * on page */
-                            fluid_voice_add_mod(voice, (fluid_mod_t *)mod, FLUID_VOICE_ADD);
-                        }
-                    }
+    if (key < 0 || key > 127) {
+        return FLUID_OK;
+    }
 
-                    /* add the synthesis process to the synthesis loop. */
-                    fluid_synth_start_voice(synth, voice);
+    /* the zone pairs the key falls into, the velocity still has to */
+    for (k = preset->key_first[key]; k < preset->key_first[key + 1]; k++) {
+        pair = &preset->pairs[preset->key_pairs[k]];
+        if (vel < pair->vello || vel > pair->velhi) {
+            continue;
+        }
 
-                    /* Store the ID of the first voice that was created by this
-                     * noteon event. Exclusive class may only terminate older
-                     * voices. That avoids killing voices, which have just been
-                     * created. (a noteon event can create several voice
-                     * processes with the same exclusive class - for example
-                     * when using stereo samples)
-                     */
-                }
+        /* a paged sample is read now unless it was preloaded */
+        if (fluid_sfont_is_paged(preset->sfont) &&
+            fluid_sample_page_in(preset->sfont, pair->sample) != FLUID_OK) {
+            continue;
+        }
 
-                inst_zone = fluid_inst_zone_next(inst_zone);
+        /* the same note played before with the channel as it is now
+         * starts the same voice */
+        snapshot = cache != NULL ? fluid_voice_cache_get(cache, pair, synth->channel[chan],
+                                                         key, vel)
+                                 : NULL;
+        if (snapshot != NULL) {
+            voice = fluid_synth_alloc_voice_from(synth, snapshot, pair->sample, chan, key, vel);
+            if (voice == NULL) {
+                return FLUID_FAILED;
             }
+            fluid_synth_start_voice_from(synth, voice, snapshot);
+            continue;
+        }
+
+        /* allocate a new synthesis process and initialize it */
+        voice = fluid_synth_alloc_voice(synth, pair->sample, chan, key, vel);
+        if (voice == NULL) {
+            return FLUID_FAILED;
+        }
+
+        /* the generators of both levels, merged */
+        for (i = 0; i < pair->gen_count; i++) {
+            fluid_voice_gen_set(voice, pair->gens[i].num, pair->gens[i].val);
+        }
+
+        /* Instrument modulators -supersede- existing (default) modulators.
+         * SF 2.01 page 69, 'bullet' 6 */
+        for (i = 0; i < pair->inst_mod_count; i++) {
+            fluid_voice_add_mod(voice, pair->mods[i], FLUID_VOICE_OVERWRITE);
+        }
+
+        /* Preset modulators -add- to existing instrument / default
+         * modulators.  SF2.01 page 70 first bullet on page */
+        for (; i < pair->inst_mod_count + pair->preset_mod_count; i++) {
+            fluid_voice_add_mod(voice, pair->mods[i], FLUID_VOICE_ADD);
+        }
+
+        /* add the synthesis process to the synthesis loop. */
+        fluid_synth_start_voice(synth, voice);
+
+        if (cache != NULL) {
+            fluid_voice_cache_put(cache, pair, synth->channel[chan], key, vel, voice);
         }
-        preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
+    /* the voices just started hold on to their samples */
+    if (fluid_sfont_is_paged(preset->sfont)) {
+        fluid_sfont_page_out(preset->sfont);
+    }
     return FLUID_OK;
 }
 
@@ -669,7 +853,7 @@ int fluid_preset_import_sfont(fluid_preset_t *preset, SFPreset *sfpreset,
         p = fluid_list_next(p);
         count++;
     }
-    return FLUID_OK;
+    return fluid_preset_compile(preset);
 }
 
 
@@ -1302,13 +1486,33 @@ int delete_fluid_sample(fluid_sample_t *sample) {
 }
 
 
+void fluid_sample_set_file_pos(fluid_sample_t *sample, fluid_sfont_t *sfont) {
+    /* a sample of its own, with the zero points that follow it */
+    unsigned int left = sample->start < sfont->samplesize / 2
+                            ? sfont->samplesize / 2 - sample->start
+                            : 0;
+    unsigned int points = sample->end - sample->start + 1 + FLUID_SAMPLE_GUARD_POINTS;
+    if (points > left) points = left;
+    sample->data = NULL;
+    sample->pos = sfont->samplepos + 2 * sample->start;
+    sample->size = 2 * points;
+    sample->end -= sample->start;
+    sample->loopstart -= sample->start;
+    sample->loopend -= sample->start;
+    sample->start = 0;
+}
+
 int fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample, fluid_sfont_t *sfont) {
     strncpy(sample->name, sfsample->name, sizeof(sample->name));
+    sample->sfont = sfont;
     sample->data = sfont->sampledata;
     sample->start = sfsample->start;
-    sample->end = sfsample->start + sfsample->end;
-    sample->loopstart = sfsample->start + sfsample->loopstart;
-    sample->loopend = sfsample->start + sfsample->loopend;
+    sample->end = sample->start + sfsample->end;
+    sample->loopstart = sample->start + sfsample->loopstart;
+    sample->loopend = sample->start + sfsample->loopend;
+    if (sfont->fileapi != NULL) {
+        fluid_sample_set_file_pos(sample, sfont);
+    }
     sample->samplerate = sfsample->samplerate;
     sample->origpitch = sfsample->origpitch;
     sample->pitchadj = sfsample->pitchadj;
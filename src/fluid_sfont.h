@@ -423,6 +423,7 @@ typedef struct _fluid_preset_t fluid_preset_t;
 typedef struct _fluid_preset_zone_t fluid_preset_zone_t;
 typedef struct _fluid_inst_t fluid_inst_t;
 typedef struct _fluid_inst_zone_t fluid_inst_zone_t;
+typedef struct _fluid_zone_pair_t fluid_zone_pair_t;
 
 
 struct _fluid_sfont_t {
@@ -437,6 +438,26 @@ struct _fluid_sfont_t {
     uint16_t sample_count;      /* how many samples in this soundfont */
     char is_rom;                 /* is the sample data loaded in rom */
     char is_compressed;          /* is the sample data compressed */
+    void (*free_sampledata)(void *buf, int count); /* releases the sample data
+                                                      in rom, if not NULL */
+
+    /* paged soundfonts read the data of every sample when it is played,
+     * see fluid_sample_pager.h */
+    fluid_fileapi_t *fileapi;  /* reads the samples, NULL if the sample data
+                                  is loaded as a whole */
+    unsigned int cache_size;   /* bytes of sample data kept when no voice
+                                  plays them */
+    unsigned int resident;     /* bytes of sample data paged in, or kept by
+                                  a streamed SoundFont */
+    unsigned int clock;        /* counts the samples played, for the least
+                                  recently used */
+    unsigned int stream_ms;    /* milliseconds of every sample a streamed
+                                  SoundFont keeps, 0 if it's paged, see
+                                  fluid_sample_stream.h */
+    void *image;               /* the tables of a compiled bank, which hold
+                                  its samples and presets, see fluid_bank.h */
+    char is_shared;            /* owned by the registry of the SoundFonts the
+                                  synths share, see fluid_sfont_registry.h */
 
     unsigned int id;
 };
@@ -457,7 +478,19 @@ struct _fluid_sample_t {
     uint8_t sampletype;
     uint8_t valid;
     uint16_t idx_in_sfont;
-    short *data;
+    short *data;             /* NULL while a paged sample isn't loaded */
+    unsigned int pos;        /* where a paged sample starts in the file */
+    unsigned int size;       /* bytes of a paged sample */
+    unsigned int last_used;  /* the sfont clock when it was last played */
+    int refcount;            /* voices playing the sample */
+    short *head;             /* the first head_points of a streamed sample,
+                                NULL if it's not streamed */
+    unsigned int head_points;
+    short *loop;             /* the loop_points from loop_first of a streamed
+                                sample, NULL if it has no loop */
+    unsigned int loop_first;
+    unsigned int loop_points;
+    fluid_sfont_t *sfont;    /* the SoundFont it is read from */
 
     /** The amplitude, that will lower the level of the sample's loop to
         the noise floor. Needed for note turnoff optimization, will be
@@ -467,6 +500,13 @@ struct _fluid_sample_t {
     double amplitude_that_reaches_noise_floor;
 };
 
+/* a voice holds a reference from fluid_voice_start() to fluid_voice_off(),
+ * which also runs on the render threads */
+#define fluid_sfont_is_paged(_sf) ((_sf)->fileapi != NULL && (_sf)->stream_ms == 0)
+
+#define fluid_sample_incr_ref(_s) __atomic_add_fetch(&(_s)->refcount, 1, __ATOMIC_RELAXED)
+#define fluid_sample_decr_ref(_s) __atomic_sub_fetch(&(_s)->refcount, 1, __ATOMIC_RELAXED)
+
 /*
 
   Public interface
@@ -477,6 +517,19 @@ fluid_fileapi_t *fluid_get_default_fileapi(void);
 fluid_sfont_t *fluid_soundfont_load(fluid_fileapi_t *fileapi,
                                       const char *filename);
 
+/* with cache_size > 0 the samples are paged in as they are played, unless
+ * the file API maps the file or the samples are compressed */
+fluid_sfont_t *fluid_soundfont_load_paged(fluid_fileapi_t *fileapi,
+                                          const char *filename,
+                                          unsigned int cache_size);
+
+/* with head_ms > 0 only the first head_ms of the samples and their loops
+ * are loaded, the rest is streamed as they play, unless the file API maps
+ * the file or the samples are compressed */
+fluid_sfont_t *fluid_soundfont_load_streamed(fluid_fileapi_t *fileapi,
+                                             const char *filename,
+                                             unsigned int head_ms);
+
 
 int delete_fluid_sfont(fluid_sfont_t *sfont);
 int fluid_sfont_load(fluid_sfont_t *sfont, const char *file,
@@ -494,6 +547,9 @@ int fluid_sfont_add_preset(fluid_sfont_t *sfont,
                               fluid_preset_t *preset);
 fluid_sample_t *fluid_sfont_get_sample(fluid_sfont_t *sfont, char *s);
 
+/* fluid_synth_set_preset_callback() */
+extern void (*preset_callback)(unsigned int bank, unsigned int num, char *name);
+
 struct _fluid_preset_t {
     fluid_preset_t *next;
     fluid_sfont_t *sfont;          /* the soundfont this preset belongs to */
@@ -502,9 +558,37 @@ struct _fluid_preset_t {
     unsigned int num;                 /* the preset number */
     fluid_preset_zone_t *global_zone; /* the global zone of the preset */
     fluid_preset_zone_t *zone;        /* the chained list of preset zones */
+
+    /* the zones compiled by fluid_preset_compile() */
+    fluid_zone_pair_t *pairs;       /* in the order the zones are played */
+    uint16_t pair_count;
+    uint16_t key_first[129];        /* pairs of key k: key_pairs[key_first[k]]
+                                       up to key_pairs[key_first[k + 1]] */
+    uint16_t *key_pairs;
+    fluid_sf_gen_t *pair_gens;
+    fluid_mod_t **pair_mods;
 };
 
 
+/*
+ * A preset zone and an instrument zone that play together: one voice of
+ * a note-on. The generators are merged, the instrument values with the
+ * preset offsets added, and the modulators de-duplicated when the preset
+ * is loaded.
+ */
+struct _fluid_zone_pair_t {
+    fluid_sample_t *sample;
+    uint8_t keylo; /* both zones' ranges */
+    uint8_t keyhi;
+    uint8_t vello;
+    uint8_t velhi;
+    uint8_t gen_count;  /* generators not at their default value */
+    fluid_sf_gen_t *gens;
+    int inst_mod_count; /* added with FLUID_VOICE_OVERWRITE */
+    int preset_mod_count; /* then added with FLUID_VOICE_ADD */
+    fluid_mod_t **mods;
+};
+
 fluid_preset_t *new_fluid_preset(fluid_sfont_t *sfont);
 int delete_fluid_preset(fluid_preset_t *preset);
 fluid_preset_t *fluid_preset_next(fluid_preset_t *preset);
@@ -519,6 +603,7 @@ fluid_preset_zone_t *fluid_preset_get_global_zone(fluid_preset_t *preset);
 int fluid_preset_get_banknum(fluid_preset_t *preset);
 int fluid_preset_get_num(fluid_preset_t *preset);
 char *fluid_preset_get_name(fluid_preset_t *preset);
+int fluid_preset_compile(fluid_preset_t *preset);
 int fluid_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
                            int chan, int key, int vel);
 
@@ -578,6 +663,9 @@ fluid_sample_t *new_fluid_sample(void);
 int delete_fluid_sample(fluid_sample_t *sample);
 int fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample,
                               fluid_sfont_t *sfont);
+/* a sample of a paged or streamed SoundFont is read into memory of its
+ * own: its points are counted from its start, at sample->pos in the file */
+void fluid_sample_set_file_pos(fluid_sample_t *sample, fluid_sfont_t *sfont);
 
 
 
@@ -0,0 +1,191 @@
+#include "fluid_sfont_registry.h"
+
+#ifdef WITH_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define FLUID_SFONT_STAT 1
+#endif
+
+typedef struct _fluid_sfont_entry_t {
+    fluid_sfont_t *sfont; /* NULL while it loads, or if it failed to */
+    char *filename;
+    fluid_fileapi_t *fileapi;
+    unsigned int stream_ms;
+    int users;   /* the synths that loaded it and didn't unload it yet, or
+                    wait for it to load */
+    int loading; /* its first user loads it, outside of the lock */
+
+    /* the file it was loaded from, if the path names one */
+    int has_stat;
+    unsigned long long dev;
+    unsigned long long ino;
+    long long size;
+    long long mtime;
+} fluid_sfont_entry_t;
+
+static fluid_list_t *fluid_sfont_registry = NULL;
+static unsigned int fluid_sfont_registry_id = 0;
+
+#ifdef WITH_THREADS
+static pthread_mutex_t fluid_sfont_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fluid_sfont_registry_loaded = PTHREAD_COND_INITIALIZER;
+#define fluid_sfont_registry_lock() pthread_mutex_lock(&fluid_sfont_registry_mutex)
+#define fluid_sfont_registry_unlock() pthread_mutex_unlock(&fluid_sfont_registry_mutex)
+#define fluid_sfont_registry_wait()                                                                \
+    pthread_cond_wait(&fluid_sfont_registry_loaded, &fluid_sfont_registry_mutex)
+#define fluid_sfont_registry_signal() pthread_cond_broadcast(&fluid_sfont_registry_loaded)
+#else
+#define fluid_sfont_registry_lock()
+#define fluid_sfont_registry_unlock()
+#define fluid_sfont_registry_wait()
+#define fluid_sfont_registry_signal()
+#endif
+
+/* the identity of the file of the path, if it is one */
+static void fluid_sfont_entry_stat(fluid_sfont_entry_t *entry, const char *filename) {
+#ifdef FLUID_SFONT_STAT
+    struct stat st;
+
+    if (stat(filename, &st) == 0) {
+        entry->has_stat = 1;
+        entry->dev = st.st_dev;
+        entry->ino = st.st_ino;
+        entry->size = st.st_size;
+        entry->mtime = st.st_mtime;
+        return;
+    }
+#endif
+    entry->has_stat = 0;
+}
+
+static int fluid_sfont_entry_matches(fluid_sfont_entry_t *entry, fluid_sfont_entry_t *key,
+                                     const char *filename) {
+    if (entry->fileapi != key->fileapi || entry->stream_ms != key->stream_ms ||
+        FLUID_STRCMP(entry->filename, filename) != 0 ||
+        entry->has_stat != key->has_stat) {
+        return 0;
+    }
+    return !key->has_stat || (entry->dev == key->dev && entry->ino == key->ino &&
+                              entry->size == key->size && entry->mtime == key->mtime);
+}
+
+static void delete_fluid_sfont_entry(fluid_sfont_entry_t *entry) {
+    FLUID_FREE(entry->filename);
+    FLUID_FREE(entry);
+}
+
+/* a user less of an entry that failed to load, its last one frees it */
+static fluid_sfont_t *fluid_sfont_entry_failed(fluid_sfont_entry_t *entry) {
+    if (--entry->users == 0) {
+        delete_fluid_sfont_entry(entry);
+    }
+    return NULL;
+}
+
+fluid_sfont_t *fluid_sfont_registry_load(fluid_fileapi_t *fileapi, const char *filename,
+                                         unsigned int stream_ms) {
+    fluid_sfont_entry_t key, *entry;
+    fluid_sfont_t *sfont;
+    fluid_list_t *list;
+
+    key.fileapi = fileapi;
+    key.stream_ms = stream_ms;
+    fluid_sfont_entry_stat(&key, filename);
+
+    fluid_sfont_registry_lock();
+    for (list = fluid_sfont_registry; list; list = fluid_list_next(list)) {
+        entry = (fluid_sfont_entry_t *)fluid_list_get(list);
+        if (fluid_sfont_entry_matches(entry, &key, filename)) {
+            /* only the users of the same file wait for it */
+            entry->users++;
+            while (entry->loading) {
+                fluid_sfont_registry_wait();
+            }
+            sfont = entry->sfont != NULL ? entry->sfont : fluid_sfont_entry_failed(entry);
+            fluid_sfont_registry_unlock();
+            return sfont;
+        }
+    }
+
+    entry = FLUID_NEW(fluid_sfont_entry_t);
+    if (entry != NULL) {
+        *entry = key;
+        entry->filename = FLUID_STRDUP(filename);
+    }
+    if (entry == NULL || entry->filename == NULL) {
+        fluid_sfont_registry_unlock();
+        FLUID_FREE(entry);
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    entry->sfont = NULL;
+    entry->users = 1;
+    entry->loading = 1;
+    fluid_sfont_registry = fluid_list_prepend(fluid_sfont_registry, entry);
+    fluid_sfont_registry_unlock();
+
+    /* the other SoundFonts load and unload meanwhile */
+    sfont = stream_ms > 0 ? fluid_soundfont_load_streamed(fileapi, filename, stream_ms)
+                          : fluid_soundfont_load(fileapi, filename);
+
+    fluid_sfont_registry_lock();
+    entry->loading = 0;
+    if (sfont != NULL) {
+        entry->sfont = sfont;
+        sfont->id = ++fluid_sfont_registry_id;
+        sfont->is_shared = 1;
+    } else {
+        /* the users waiting for it get nothing, the next ones try again */
+        fluid_sfont_registry = fluid_list_remove(fluid_sfont_registry, entry);
+        fluid_sfont_entry_failed(entry);
+    }
+    fluid_sfont_registry_signal();
+    fluid_sfont_registry_unlock();
+    return sfont;
+}
+
+int fluid_sfont_registry_release(fluid_sfont_t *sfont) {
+    fluid_sfont_entry_t *entry = NULL;
+    fluid_list_t *list;
+
+    fluid_sfont_registry_lock();
+    for (list = fluid_sfont_registry; list; list = fluid_list_next(list)) {
+        entry = (fluid_sfont_entry_t *)fluid_list_get(list);
+        if (entry->sfont == sfont) break;
+    }
+    if (list == NULL) {
+        fluid_sfont_registry_unlock();
+        FLUID_LOG(FLUID_ERR, "SoundFont %d isn't shared", sfont->id);
+        return FLUID_FAILED;
+    }
+    if (--entry->users > 0) {
+        fluid_sfont_registry_unlock();
+        return FLUID_OK;
+    }
+    fluid_sfont_registry = fluid_list_remove(fluid_sfont_registry, entry);
+    fluid_sfont_registry_unlock();
+
+    delete_fluid_sfont_entry(entry);
+    return delete_fluid_sfont(sfont);
+}
+
+unsigned int fluid_sfont_registry_new_id(void) {
+    unsigned int id;
+
+    fluid_sfont_registry_lock();
+    id = ++fluid_sfont_registry_id;
+    fluid_sfont_registry_unlock();
+    return id;
+}
+
+int fluid_sfont_registry_count(void) {
+    int count;
+
+    fluid_sfont_registry_lock();
+    count = fluid_list_size(fluid_sfont_registry);
+    fluid_sfont_registry_unlock();
+    return count;
+}
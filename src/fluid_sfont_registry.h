@@ -0,0 +1,43 @@
+#ifndef _FLUID_SFONT_REGISTRY_H
+#define _FLUID_SFONT_REGISTRY_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_sfont.h"
+
+/*
+ * The SoundFonts the synths of the process share (SynthParams.share_sfonts).
+ *
+ * A SoundFont is registered under its path, the file API that reads it
+ * and, where the path names a file, the device, inode, size and
+ * modification time of the file: a file changed since is loaded anew. The
+ * synths loading it get the same fluid_sfont_t with the same id, the last
+ * one to unload it deletes it. Its presets and samples don't change once
+ * it is loaded; the synths keep their voices, bank offsets and caches for
+ * it to themselves.
+ *
+ * Paged SoundFonts aren't shared, which of their samples stay in memory
+ * follows the notes of one synth. A streamed one is shared by the synths
+ * with the same stream_head_ms.
+ *
+ * Built with WITH_THREADS, synths on any thread may load and unload
+ * SoundFonts. The first user of a file loads it outside of the lock of
+ * the registry, the other users of the same file wait for it while the
+ * other files load and unload.
+ */
+
+/* the SoundFont of the file with another user, loaded if it had none;
+ * NULL if it failed to load */
+fluid_sfont_t *fluid_sfont_registry_load(fluid_fileapi_t *fileapi, const char *filename,
+                                         unsigned int stream_ms);
+
+/* one user less, the last one deletes the SoundFont */
+int fluid_sfont_registry_release(fluid_sfont_t *sfont);
+
+/* an id no SoundFont of the registry has, for the other SoundFonts of the
+ * synths sharing theirs */
+unsigned int fluid_sfont_registry_new_id(void);
+
+/* the SoundFonts registered */
+int fluid_sfont_registry_count(void);
+
+#endif /* _FLUID_SFONT_REGISTRY_H */
@@ -3,13 +3,36 @@
 #include "fluid_synth.h"
 #include "fluid_chan.h"
 #include "fluid_tuning.h"
+#include "fluid_dsp_simd.h"
 
+#if defined(__SSE2__) && defined(WITH_FLOAT) && !defined(WITH_FIXED)
+#include <emmintrin.h>
+#define FLUID_RENDER_SSE2 1
+#endif
 
 static FLUID_INLINE unsigned int fluid_synth_get_min_note_length_LOCAL(fluid_synth_t *synth)
 {
     return (unsigned int)(10 * synth->sample_rate / 1000.0f);
 }
 
+/* a change of all channels, the cached voices no longer apply */
+static void fluid_synth_clear_voice_cache(fluid_synth_t *synth)
+{
+    if (synth->voice_cache != NULL) {
+        fluid_voice_cache_clear(synth->voice_cache);
+    }
+}
+
+/* the smoothing time in samples of the output rate */
+static void fluid_synth_update_smoothing(fluid_synth_t *synth)
+{
+    int i, samples = (int)(synth->smoothing_time * synth->sample_rate + 0.5);
+
+    for (i = 0; i < synth->nvoice; i++) {
+        fluid_voice_set_smoothing(synth->voice[i], samples);
+    }
+}
+
 void
 fluid_synth_set_sample_rate(fluid_synth_t *synth, float sample_rate)
 {
@@ -23,6 +46,8 @@ fluid_synth_set_sample_rate(fluid_synth_t *synth, float sample_rate)
     {
         fluid_voice_set_output_rate(synth->voice[i], sample_rate);
     }
+    fluid_synth_update_smoothing(synth);
+    fluid_synth_clear_voice_cache(synth);
 }
 
 
@@ -38,6 +63,8 @@ static int fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data,
                                          int len, char *response,
                                          int *response_len, int avail_response,
                                          int *handled, int dryrun);
+static void fluid_synth_update_voice(fluid_synth_t *synth, fluid_voice_t *voice);
+static int fluid_synth_delete_sfont(fluid_sfont_t *sfont);
 
 /* default modulators
  * SF2.01 page 52 ff:
@@ -92,8 +119,15 @@ void fluid_synth_init() {
 
 #ifdef GEN_TABLE_RUNTIME
     fluid_conversion_config();
+#ifndef WITH_FIXED
     fluid_dsp_float_config();
 #endif
+#endif
+#ifdef WITH_FIXED
+    fluid_dsp_fixed_config();
+#endif
+
+    fluid_dsp_simd_config(FLUID_DSP_SIMD_AUTO);
 
     /* SF2.01 page 53 section 8.4.1: MIDI Note-On Velocity to Initial
      * Attenuation */
@@ -252,6 +286,46 @@ void fluid_synth_init() {
                          12700.0); /* Amount: 12700 cents */
 }
 
+/*
+ * The lookup lists of the voices
+ *
+ * A voice is linked into the lists of its channel and key, and of its
+ * channel's exclusive class voices, when it starts. It isn't unlinked when
+ * it stops, fluid_voice_off() also runs on the render threads; the
+ * lookups unlink the voices that don't play anymore as they go, and a
+ * voice that starts again moves to its new lists.
+ */
+static void fluid_voice_list_init(fluid_voice_link_t *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void fluid_voice_unlink(fluid_voice_link_t *link) {
+    if (link->next == NULL) return;
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = NULL;
+    link->prev = NULL;
+}
+
+static void fluid_voice_link(fluid_voice_link_t *head, fluid_voice_link_t *link) {
+    fluid_voice_unlink(link);
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+/* Runs the statement that follows for every playing voice in the list
+ * 'head' of links '_field', which may stop 'voice'. */
+#define fluid_synth_foreach_voice(voice, head, _field)                                             \
+    for (fluid_voice_link_t *_link = (head)->next, *_next; _link != (head); _link = _next)         \
+        if (_next = _link->next, voice = fluid_voice_from_link(_link, _field), !_PLAYING(voice)) { \
+            fluid_voice_unlink(_link);                                                             \
+        } else
+
+#define fluid_synth_key_voices(synth, chan, key) (&(synth)->key_voices[(chan) * 128 + ((key) & 127)])
+
 fluid_synth_t *new_fluid_synth(SynthParams sp) {
     int i;
     fluid_synth_t *synth;
@@ -277,7 +351,34 @@ fluid_synth_t *new_fluid_synth(SynthParams sp) {
     synth->polyphony = sp.polyphony;
     synth->gain = sp.gain;
     synth->midi_channels = sp.midi_channels;
+    synth->block_size = sp.block_size > 0 ? sp.block_size : FLUID_BUFSIZE;
+    if (synth->block_size < FLUID_MIN_BUFSIZE || synth->block_size > FLUID_MAX_BUFSIZE) {
+        FLUID_LOG(FLUID_WARN, "Block size %d out of range [%d, %d], clamped",
+                  synth->block_size, FLUID_MIN_BUFSIZE, FLUID_MAX_BUFSIZE);
+        fluid_clip(synth->block_size, FLUID_MIN_BUFSIZE, FLUID_MAX_BUFSIZE);
+    }
+#ifdef WITH_FIXED
+    if (sp.env_mode == FLUID_ENV_SAMPLE) {
+        /* the per-sample gain would be floating point again */
+        FLUID_LOG(FLUID_WARN, "Sample accurate envelopes need floating point, "
+                              "using block envelopes");
+        sp.env_mode = FLUID_ENV_BLOCK;
+    }
+    if (sp.smoothing_time > 0.0) {
+        /* the ramps would be floating point again */
+        FLUID_LOG(FLUID_WARN, "Parameter smoothing needs floating point, disabled");
+        sp.smoothing_time = 0.0;
+    }
+    if (sp.filter_bypass) {
+        /* the crossfade would be floating point again */
+        FLUID_LOG(FLUID_WARN, "Filter bypass needs floating point, disabled");
+        sp.filter_bypass = false;
+    }
+#endif
+    synth->smoothing_time = sp.smoothing_time > 0.0 ? sp.smoothing_time : 0.0;
     synth->min_note_length_ticks = fluid_synth_get_min_note_length_LOCAL(synth);
+    synth->event_queue_size =
+        sp.event_queue_size > 0 ? sp.event_queue_size : FLUID_EVENT_QUEUE_SIZE;
 
     /* as soon as the synth is created it starts playing. */
     synth->state = FLUID_SYNTH_PLAYING;
@@ -285,6 +386,70 @@ fluid_synth_t *new_fluid_synth(SynthParams sp) {
     synth->noteid = 0;
     synth->ticks = 0;
     synth->tuning = NULL;
+    /* no voices yet and the effect units start out cleared */
+    synth->silent_samples = 0;
+    synth->idle = true;
+
+    synth->events = FLUID_ARRAY(fluid_synth_event_t, synth->event_queue_size);
+    if (synth->events == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    if (sp.event_ring_size > 0) {
+        synth->event_ring = new_fluid_event_ring(sp.event_ring_size,
+                                                 sp.event_ring_multi_producer);
+        if (synth->event_ring == NULL) {
+            goto error_recovery;
+        }
+    }
+
+    if (sp.voice_cache_size > 0) {
+        synth->voice_cache = new_fluid_voice_cache(sp.voice_cache_size);
+        if (synth->voice_cache == NULL) {
+            goto error_recovery;
+        }
+    }
+
+    synth->sample_cache_size = sp.sample_cache_size;
+    if (sp.sample_cache_size > 0) {
+        synth->preloader = new_fluid_sample_preloader();
+        if (synth->preloader == NULL) {
+            goto error_recovery;
+        }
+    }
+
+    synth->stream_head_ms = sp.stream_head_ms;
+    if (sp.stream_head_ms > 0) {
+#ifdef WITH_THREADS
+        synth->streamer = new_fluid_sample_streamer(synth->polyphony, sp.stream_offline);
+        if (synth->streamer == NULL) {
+            goto error_recovery;
+        }
+#else
+        FLUID_LOG(FLUID_WARN, "Built without WITH_THREADS, the samples are not streamed");
+        synth->stream_head_ms = 0;
+#endif
+    }
+
+    synth->share_sfonts = sp.share_sfonts;
+
+    /* the lookup lists of the voices, empty */
+    synth->chan_voices = FLUID_ARRAY(fluid_voice_link_t, synth->midi_channels);
+    synth->key_voices = FLUID_ARRAY(fluid_voice_link_t, synth->midi_channels * 128);
+    synth->excl_voices = FLUID_ARRAY(fluid_voice_link_t, synth->midi_channels);
+    if (synth->chan_voices == NULL || synth->key_voices == NULL ||
+        synth->excl_voices == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    for (i = 0; i < synth->midi_channels; i++) {
+        fluid_voice_list_init(&synth->chan_voices[i]);
+        fluid_voice_list_init(&synth->excl_voices[i]);
+    }
+    for (i = 0; i < synth->midi_channels * 128; i++) {
+        fluid_voice_list_init(&synth->key_voices[i]);
+    }
 
     /* allocate all channel objects */
     synth->channel = FLUID_ARRAY(fluid_channel_t *, synth->midi_channels);
@@ -301,16 +466,57 @@ fluid_synth_t *new_fluid_synth(SynthParams sp) {
 
     /* allocate all synthesis processes */
     synth->nvoice = synth->polyphony;
+    synth->voice_bank = new_fluid_voice_bank(synth->nvoice);
+    if (synth->voice_bank == NULL) {
+        goto error_recovery;
+    }
     synth->voice = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
     if (synth->voice == NULL) {
         goto error_recovery;
     }
     for (i = 0; i < synth->nvoice; i++) {
-        synth->voice[i] = new_fluid_voice(synth->sample_rate);
+        synth->voice[i] = new_fluid_voice(synth->voice_bank, i, synth->sample_rate,
+                                         synth->block_size);
         if (synth->voice[i] == NULL) {
             goto error_recovery;
         }
+        fluid_voice_set_env_mode(synth->voice[i], sp.env_mode);
+        fluid_voice_set_filter_bypass(synth->voice[i], sp.filter_bypass);
+        if (synth->streamer != NULL) {
+            synth->voice[i]->stream = fluid_sample_streamer_get(synth->streamer, i);
+        }
+    }
+    fluid_synth_update_smoothing(synth);
+    synth->free_voices = FLUID_ARRAY(uint32_t, (synth->nvoice + 31) / 32);
+    synth->steal_queue = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
+    if (synth->free_voices == NULL || synth->steal_queue == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+    synth->voices_stale = true;
+
+    if (sp.render_threads > 1) {
+#ifdef WITH_THREADS
+        synth->render_pool = new_fluid_render_pool(synth, sp.render_threads);
+        if (synth->render_pool == NULL) {
+            goto error_recovery;
+        }
+#else
+        FLUID_LOG(FLUID_WARN, "Built without WITH_THREADS, rendering on one thread");
+#endif
+    }
+
+#ifdef FLUID_DSP_SIMD
+    /* the filters of the voices run side by side, in blocks of one chunk */
+    if (synth->render_pool == NULL && synth->block_size <= FLUID_BUFSIZE) {
+        synth->dry_buf = FLUID_ARRAY(fluid_real_t, synth->nvoice * synth->block_size);
+        synth->dry_voices = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
+        if (synth->dry_buf == NULL || synth->dry_voices == NULL) {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
     }
+#endif
 
     /* Allocate the sample buffers */
     synth->left_buf = NULL;
@@ -322,44 +528,55 @@ fluid_synth_t *new_fluid_synth(SynthParams sp) {
 
     /* Left and right audio buffers */
 
-    synth->left_buf = FLUID_ARRAY(fluid_real_t, FLUID_BUFSIZE);
-    synth->right_buf = FLUID_ARRAY(fluid_real_t, FLUID_BUFSIZE);
+    synth->left_buf = FLUID_ARRAY(fluid_bus_t, synth->block_size);
+    synth->right_buf = FLUID_ARRAY(fluid_bus_t, synth->block_size);
 
     if ((synth->left_buf == NULL) || (synth->right_buf == NULL)) {
         FLUID_LOG(FLUID_ERR, "Out of memory");
         goto error_recovery;
     }
 
-    FLUID_MEMSET(synth->left_buf, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
-    FLUID_MEMSET(synth->right_buf, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+    FLUID_MEMSET(synth->left_buf, 0, synth->block_size * sizeof(fluid_bus_t));
+    FLUID_MEMSET(synth->right_buf, 0, synth->block_size * sizeof(fluid_bus_t));
 
     if(synth->with_reverb){
-        synth->fx_left_buf = FLUID_ARRAY(fluid_real_t, FLUID_BUFSIZE);
-        synth->fx_right_buf = FLUID_ARRAY(fluid_real_t, FLUID_BUFSIZE);
+        synth->fx_left_buf = FLUID_ARRAY(fluid_bus_t, synth->block_size);
+        synth->fx_right_buf = FLUID_ARRAY(fluid_bus_t, synth->block_size);
 
         if ((synth->fx_left_buf == NULL) || (synth->fx_right_buf == NULL)) {
             FLUID_LOG(FLUID_ERR, "Out of memory");
             goto error_recovery;
         }
 
-        FLUID_MEMSET(synth->fx_left_buf, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
-        FLUID_MEMSET(synth->fx_right_buf, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        FLUID_MEMSET(synth->fx_left_buf, 0, synth->block_size * sizeof(fluid_bus_t));
+        FLUID_MEMSET(synth->fx_right_buf, 0, synth->block_size * sizeof(fluid_bus_t));
     }
 
     if(synth->with_chorus){
-        synth->fx_left_buf2 = FLUID_ARRAY(fluid_real_t, FLUID_BUFSIZE);
-        synth->fx_right_buf2 = FLUID_ARRAY(fluid_real_t, FLUID_BUFSIZE);
+        synth->fx_left_buf2 = FLUID_ARRAY(fluid_bus_t, synth->block_size);
+        synth->fx_right_buf2 = FLUID_ARRAY(fluid_bus_t, synth->block_size);
 
         if ((synth->fx_left_buf2 == NULL) || (synth->fx_right_buf2 == NULL)) {
             FLUID_LOG(FLUID_ERR, "Out of memory");
             goto error_recovery;
         }
 
-        FLUID_MEMSET(synth->fx_left_buf2, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
-        FLUID_MEMSET(synth->fx_right_buf2, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        FLUID_MEMSET(synth->fx_left_buf2, 0, synth->block_size * sizeof(fluid_bus_t));
+        FLUID_MEMSET(synth->fx_right_buf2, 0, synth->block_size * sizeof(fluid_bus_t));
+    }
+
+#ifdef WITH_FIXED
+    synth->fx_scratch = NULL;
+    if (synth->with_reverb || synth->with_chorus) {
+        synth->fx_scratch = FLUID_ARRAY(fluid_real_t, 3 * synth->block_size);
+        if (synth->fx_scratch == NULL) {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
     }
+#endif
 
-    synth->cur = FLUID_BUFSIZE;
+    synth->cur = synth->block_size;
 
     /* allocate the reverb module */
     if (synth->with_reverb) {
@@ -410,6 +627,9 @@ int delete_fluid_synth(fluid_synth_t *synth) {
 
     synth->state = FLUID_SYNTH_STOPPED;
 
+    /* the preloader reads the samples of the SoundFonts */
+    delete_fluid_sample_preloader(synth->preloader);
+
     /* turn off all voices, needed to unload SoundFont data */
     if (synth->voice != NULL) {
         for (i = 0; i < synth->nvoice; i++) {
@@ -418,10 +638,13 @@ int delete_fluid_synth(fluid_synth_t *synth) {
         }
     }
 
-    /* delete all the SoundFonts */
+    /* the streamer reads the samples of the SoundFonts */
+    delete_fluid_sample_streamer(synth->streamer);
+
+    /* delete all the SoundFonts, or let go of the shared ones */
     for (list = synth->sfont; list; list = fluid_list_next(list)) {
         sfont = (fluid_sfont_t *)fluid_list_get(list);
-        delete_fluid_sfont(sfont);
+        fluid_synth_delete_sfont(sfont);
     }
 
     delete_fluid_list(synth->sfont);
@@ -443,6 +666,11 @@ int delete_fluid_synth(fluid_synth_t *synth) {
         FLUID_FREE(synth->channel);
     }
 
+#ifdef WITH_THREADS
+    /* stop the workers before the voices go away */
+    delete_fluid_render_pool(synth->render_pool);
+#endif
+
     if (synth->voice != NULL) {
         for (i = 0; i < synth->nvoice; i++) {
             if (synth->voice[i] != NULL) {
@@ -451,6 +679,7 @@ int delete_fluid_synth(fluid_synth_t *synth) {
         }
         FLUID_FREE(synth->voice);
     }
+    delete_fluid_voice_bank(synth->voice_bank);
 
     /* free all the sample buffers */
     if (synth->left_buf != NULL) {
@@ -469,6 +698,40 @@ int delete_fluid_synth(fluid_synth_t *synth) {
         FLUID_FREE(synth->fx_right_buf);
     }
 
+#ifdef WITH_FIXED
+    if (synth->fx_scratch != NULL) {
+        FLUID_FREE(synth->fx_scratch);
+    }
+#endif
+
+    if (synth->events != NULL) {
+        FLUID_FREE(synth->events);
+    }
+    delete_fluid_event_ring(synth->event_ring);
+    delete_fluid_voice_cache(synth->voice_cache);
+
+    if (synth->chan_voices != NULL) {
+        FLUID_FREE(synth->chan_voices);
+    }
+    if (synth->key_voices != NULL) {
+        FLUID_FREE(synth->key_voices);
+    }
+    if (synth->excl_voices != NULL) {
+        FLUID_FREE(synth->excl_voices);
+    }
+    if (synth->free_voices != NULL) {
+        FLUID_FREE(synth->free_voices);
+    }
+    if (synth->steal_queue != NULL) {
+        FLUID_FREE(synth->steal_queue);
+    }
+    if (synth->dry_buf != NULL) {
+        FLUID_FREE(synth->dry_buf);
+    }
+    if (synth->dry_voices != NULL) {
+        FLUID_FREE(synth->dry_voices);
+    }
+
     /* release the reverb module */
     if (synth->reverb != NULL) {
         delete_fluid_revmodel(synth->reverb);
@@ -529,13 +792,15 @@ _RAMFUNC int fluid_synth_noteon(fluid_synth_t *synth, int chan, int key, int vel
 }
 
 _RAMFUNC int fluid_synth_noteoff(fluid_synth_t *synth, int chan, int key) {
-    int i;
     fluid_voice_t *voice;
     int status = FLUID_FAILED;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (_ON(voice) && (voice->chan == chan) && (voice->key == key)) {
+    if ((chan < 0) || (chan >= synth->midi_channels)) {
+        return FLUID_FAILED;
+    }
+
+    fluid_synth_foreach_voice(voice, fluid_synth_key_voices(synth, chan, key), key_link) {
+        if (_ON(voice) && (voice->key == key)) {
             #if DEBUG
                 int used_voices = 0;
                 int k;
@@ -552,26 +817,148 @@ _RAMFUNC int fluid_synth_noteoff(fluid_synth_t *synth, int chan, int key) {
                               synth->sample_rate,
                           voice->ticks, used_voices);
             #endif
-            fluid_voice_noteoff(voice);
+            fluid_voice_noteoff_at(voice, synth->event_offset);
+            fluid_synth_update_voice(synth, voice);
             status = FLUID_OK;
         } /* if voice on */
-    }     /* for all voices */
+    }     /* for the voices of the key */
     return status;
 }
 
+/*
+ * fluid_synth_schedule
+ *
+ * Queues a channel message 'frame' frames after the next output frame,
+ * after the queued messages on the same or earlier frames.
+ */
+static int fluid_synth_schedule(fluid_synth_t *synth, unsigned int frame, int type,
+                                int chan, int param1, int param2) {
+    fluid_synth_event_t *event;
+    int i;
+
+    if ((chan < 0) || (chan >= synth->midi_channels)) {
+        FLUID_LOG(FLUID_WARN, "Channel out of range");
+        return FLUID_FAILED;
+    }
+    if (synth->event_count >= synth->event_queue_size) {
+        FLUID_LOG(FLUID_WARN, "Event queue full");
+        return FLUID_FAILED;
+    }
+
+    /* the next output frame is the first one of the block remainder */
+    frame += synth->ticks - (synth->block_size - synth->cur);
+
+    for (i = synth->event_count; i > 0; i--) {
+        if ((int)(synth->events[i - 1].frame - frame) <= 0) break;
+        synth->events[i] = synth->events[i - 1];
+    }
+
+    event = &synth->events[i];
+    event->frame = frame;
+    event->type = (unsigned char)type;
+    event->chan = (unsigned char)chan;
+    event->param1 = param1;
+    event->param2 = param2;
+    synth->event_count++;
+    return FLUID_OK;
+}
+
+int fluid_synth_schedule_noteon(fluid_synth_t *synth, unsigned int frame, int chan,
+                                int key, int vel) {
+    return fluid_synth_schedule(synth, frame, NOTE_ON, chan, key, vel);
+}
+
+int fluid_synth_schedule_noteoff(fluid_synth_t *synth, unsigned int frame, int chan,
+                                 int key) {
+    return fluid_synth_schedule(synth, frame, NOTE_OFF, chan, key, 0);
+}
+
+int fluid_synth_schedule_cc(fluid_synth_t *synth, unsigned int frame, int chan,
+                            int ctrl, int val) {
+    return fluid_synth_schedule(synth, frame, CONTROL_CHANGE, chan, ctrl, val);
+}
+
+int fluid_synth_schedule_pitch_bend(fluid_synth_t *synth, unsigned int frame, int chan,
+                                    int val) {
+    return fluid_synth_schedule(synth, frame, PITCH_BEND, chan, val, 0);
+}
+
+int fluid_synth_schedule_program_change(fluid_synth_t *synth, unsigned int frame,
+                                        int chan, int program) {
+    return fluid_synth_schedule(synth, frame, PROGRAM_CHANGE, chan, program, 0);
+}
+
+/*
+ * fluid_synth_post
+ *
+ * Queues a channel message for the rendering thread, see
+ * fluid_synth_post_noteon() in fluidliter.h.
+ */
+static int fluid_synth_post(fluid_synth_t *synth, int type, int chan, int param1,
+                            int param2) {
+    fluid_synth_event_t event;
+
+    if (synth->event_ring == NULL) {
+        FLUID_LOG(FLUID_WARN, "No event ring, see SynthParams.event_ring_size");
+        return FLUID_FAILED;
+    }
+    if ((chan < 0) || (chan >= synth->midi_channels)) {
+        FLUID_LOG(FLUID_WARN, "Channel out of range");
+        return FLUID_FAILED;
+    }
+
+    event.frame = 0;
+    event.type = (unsigned char)type;
+    event.chan = (unsigned char)chan;
+    event.param1 = param1;
+    event.param2 = param2;
+    return fluid_event_ring_push(synth->event_ring, &event);
+}
+
+int fluid_synth_post_noteon(fluid_synth_t *synth, int chan, int key, int vel) {
+    return fluid_synth_post(synth, NOTE_ON, chan, key, vel);
+}
+
+int fluid_synth_post_noteoff(fluid_synth_t *synth, int chan, int key) {
+    return fluid_synth_post(synth, NOTE_OFF, chan, key, 0);
+}
+
+int fluid_synth_post_cc(fluid_synth_t *synth, int chan, int ctrl, int val) {
+    return fluid_synth_post(synth, CONTROL_CHANGE, chan, ctrl, val);
+}
+
+int fluid_synth_post_pitch_bend(fluid_synth_t *synth, int chan, int val) {
+    return fluid_synth_post(synth, PITCH_BEND, chan, val, 0);
+}
+
+int fluid_synth_post_program_change(fluid_synth_t *synth, int chan, int program) {
+    return fluid_synth_post(synth, PROGRAM_CHANGE, chan, program, 0);
+}
+
+int fluid_synth_post_channel_pressure(fluid_synth_t *synth, int chan, int val) {
+    return fluid_synth_post(synth, CHANNEL_PRESSURE, chan, val, 0);
+}
+
+int fluid_synth_post_key_pressure(fluid_synth_t *synth, int chan, int key, int val) {
+    return fluid_synth_post(synth, KEY_PRESSURE, chan, key, val);
+}
+
+unsigned int fluid_synth_get_post_overflows(fluid_synth_t *synth) {
+    return synth->event_ring != NULL ? fluid_event_ring_overflows(synth->event_ring) : 0;
+}
+
 /*
  * fluid_synth_damp_voices
  */
 int fluid_synth_damp_voices(fluid_synth_t *synth, int chan) {
-    int i;
     fluid_voice_t *voice;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if ((voice->chan == chan) && _SUSTAINED(voice)) {
+    fluid_synth_foreach_voice(voice, &synth->chan_voices[chan], chan_link) {
+        if (_SUSTAINED(voice)) {
             FLUID_LOG(FLUID_INFO, "turned off sustained note: chan=%d, key=%d, vel=%d\n",
                 voice->chan, voice->key, voice->vel);
             fluid_voice_noteoff(voice);
+            fluid_synth_update_voice(synth, voice);
         }
     }
 
@@ -881,14 +1268,11 @@ static int fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data,
  * put all notes on this channel into released state.
  */
 int fluid_synth_all_notes_off(fluid_synth_t *synth, int chan) {
-    int i;
     fluid_voice_t *voice;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (_PLAYING(voice) && (voice->chan == chan)) {
-            fluid_voice_noteoff(voice);
-        }
+    fluid_synth_foreach_voice(voice, &synth->chan_voices[chan], chan_link) {
+        fluid_voice_noteoff(voice);
+        fluid_synth_update_voice(synth, voice);
     }
     return FLUID_OK;
 }
@@ -899,14 +1283,11 @@ int fluid_synth_all_notes_off(fluid_synth_t *synth, int chan) {
  * immediately stop all notes on this channel.
  */
 int fluid_synth_all_sounds_off(fluid_synth_t *synth, int chan) {
-    int i;
     fluid_voice_t *voice;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (_PLAYING(voice) && (voice->chan == chan)) {
-            fluid_voice_off(voice);
-        }
+    fluid_synth_foreach_voice(voice, &synth->chan_voices[chan], chan_link) {
+        fluid_voice_off(voice);
+        fluid_synth_update_voice(synth, voice);
     }
     return FLUID_OK;
 }
@@ -927,6 +1308,7 @@ int fluid_synth_system_reset(fluid_synth_t *synth) {
             fluid_voice_off(voice);
         }
     }
+    synth->voices_stale = true;
 
     for (i = 0; i < synth->midi_channels; i++) {
         fluid_channel_reset(synth->channel[i]);
@@ -946,14 +1328,10 @@ int fluid_synth_system_reset(fluid_synth_t *synth) {
  */
 int fluid_synth_modulate_voices(fluid_synth_t *synth, int chan, int is_cc,
                                 int ctrl) {
-    int i;
     fluid_voice_t *voice;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (voice->chan == chan) {
-            fluid_voice_modulate(voice, is_cc, ctrl);
-        }
+    fluid_synth_foreach_voice(voice, &synth->chan_voices[chan], chan_link) {
+        fluid_voice_modulate(voice, is_cc, ctrl);
     }
     return FLUID_OK;
 }
@@ -966,14 +1344,10 @@ int fluid_synth_modulate_voices(fluid_synth_t *synth, int chan, int is_cc,
  * controller have been reset to their default value).
  */
 int fluid_synth_modulate_voices_all(fluid_synth_t *synth, int chan) {
-    int i;
     fluid_voice_t *voice;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (voice->chan == chan) {
-            fluid_voice_modulate_all(voice);
-        }
+    fluid_synth_foreach_voice(voice, &synth->chan_voices[chan], chan_link) {
+        fluid_voice_modulate_all(voice);
     }
     return FLUID_OK;
 }
@@ -1027,12 +1401,9 @@ int fluid_synth_key_pressure(fluid_synth_t *synth, int chan, int key, int val) {
     // fluid_synth_update_key_pressure_LOCAL
     {
         fluid_voice_t *voice;
-        int i;
-
-        for (i = 0; i < synth->polyphony; i++) {
-            voice = synth->voice[i];
 
-            if (voice->chan == chan && voice->key == key) {
+        fluid_synth_foreach_voice(voice, fluid_synth_key_voices(synth, chan, key), key_link) {
+            if (voice->key == key) {
                 result = fluid_voice_modulate(voice, 0, FLUID_MOD_KEYPRESSURE);
                 if (result != FLUID_OK) break;
             }
@@ -1176,8 +1547,9 @@ fluid_preset_t *fluid_synth_find_preset(fluid_synth_t *synth,
         offset = fluid_synth_get_bank_offset(synth, fluid_sfont_get_id(sfont));
         preset = fluid_sfont_get_preset(sfont, banknum - offset, prognum);
 
+        /* its sfont is set when it is loaded, a shared preset isn't
+         * written to */
         if (preset != NULL) {
-            preset->sfont = sfont; /* FIXME */
             return preset;
         }
 
@@ -1398,6 +1770,7 @@ void fluid_synth_set_gain(fluid_synth_t *synth, float gain) {
 
     fluid_clip(gain, 0.0f, 10.0f);
     synth->gain = gain;
+    fluid_synth_clear_voice_cache(synth);
 
     for (i = 0; i < synth->polyphony; i++) {
         fluid_voice_t *voice = synth->voice[i];
@@ -1407,6 +1780,27 @@ void fluid_synth_set_gain(fluid_synth_t *synth, float gain) {
     }
 }
 
+void fluid_synth_set_smoothing_time(fluid_synth_t *synth, double seconds) {
+#ifdef WITH_FIXED
+    if (seconds > 0.0) {
+        FLUID_LOG(FLUID_WARN, "Parameter smoothing needs floating point, disabled");
+    }
+    seconds = 0.0;
+#endif
+    synth->smoothing_time = seconds > 0.0 ? seconds : 0.0;
+    fluid_synth_update_smoothing(synth);
+}
+
+unsigned int fluid_synth_get_filter_bypass_count(fluid_synth_t *synth) {
+    unsigned int count = 0;
+    int i;
+
+    for (i = 0; i < synth->nvoice; i++) {
+        count += synth->voice[i]->filter_bypass_blocks;
+    }
+    return count;
+}
+
 /*
  * fluid_synth_get_gain
  */
@@ -1430,6 +1824,7 @@ int fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony) {
     }
 
     synth->polyphony = polyphony;
+    synth->voices_stale = true;
 
     return FLUID_OK;
 }
@@ -1442,7 +1837,7 @@ int fluid_synth_get_polyphony(fluid_synth_t *synth) {
 }
 
 int fluid_synth_get_internal_bufsize(fluid_synth_t *synth) {
-    return FLUID_BUFSIZE;
+    return synth->block_size;
 }
 
 /*
@@ -1467,8 +1862,8 @@ int fluid_synth_write_float(fluid_synth_t *synth, int len, void *lout, int loff,
     int i, j, k, l;
     float *left_out = (float *)lout;
     float *right_out = (float *)rout;
-    fluid_real_t *left_in = synth->left_buf;
-    fluid_real_t *right_in = synth->right_buf;
+    fluid_bus_t *left_in = synth->left_buf;
+    fluid_bus_t *right_in = synth->right_buf;
 
     /* make sure we're playing */
     if (synth->state != FLUID_SYNTH_PLAYING) {
@@ -1479,13 +1874,13 @@ int fluid_synth_write_float(fluid_synth_t *synth, int len, void *lout, int loff,
 
     for (i = 0, j = loff, k = roff; i < len; i++, l++, j += lincr, k += rincr) {
         /* fill up the buffers as needed */
-        if (l == FLUID_BUFSIZE) {
+        if (l == synth->block_size) {
             fluid_synth_one_block(synth, 0);
             l = 0;
         }
 
-        left_out[j] = (float)left_in[l];
-        if (right_out != NULL) right_out[k] = (float)right_in[l];
+        left_out[j] = (float)fluid_bus_to_real(left_in[l]);
+        if (right_out != NULL) right_out[k] = (float)fluid_bus_to_real(right_in[l]);
     }
 
     synth->cur = l;
@@ -1512,6 +1907,26 @@ round_clip_to_i16(float x)
     return (int16_t)i;
 }
 
+#ifdef WITH_FIXED
+/* Q23 bus to 16 bit, scaled like the floating point path */
+static FLUID_INLINE int16_t
+fluid_bus_to_s16(fluid_bus_t x)
+{
+    int32_t i = (int32_t)(((int64_t)x * 32766 + (1 << 22)) >> FLUID_FIXED_BUS_BITS);
+    return (int16_t)(i > 32767 ? 32767 : (i < -32768 ? -32768 : i));
+}
+
+static FLUID_INLINE uint8_t
+fluid_bus_to_u8(fluid_bus_t x)
+{
+    int32_t i = (int32_t)(((int64_t)x * 127 + (1 << 22)) >> FLUID_FIXED_BUS_BITS);
+    return (uint8_t)((i > 127 ? 127 : (i < -128 ? -128 : i)) + 128);
+}
+#else
+#define fluid_bus_to_s16(_x) round_clip_to_i16((_x) * 32766.0f)
+#define fluid_bus_to_u8(_x) ((uint8_t)round_clip_to_i16((_x) * 127.0f) + 128)
+#endif
+
 
 int fluid_synth_write_u8_mono(fluid_synth_t *synth, int len, uint8_t *out) {
     return fluid_synth_write_u8(synth, len, out, 1);
@@ -1531,8 +1946,8 @@ int fluid_synth_write_u8(fluid_synth_t *synth, int len, uint8_t *out,
         right_out = NULL;
     }
 
-    fluid_real_t *left_in = synth->left_buf;
-    fluid_real_t *right_in = synth->right_buf;
+    fluid_bus_t *left_in = synth->left_buf;
+    fluid_bus_t *right_in = synth->right_buf;
 
     /* make sure we're playing */
     if (synth->state != FLUID_SYNTH_PLAYING) {
@@ -1544,12 +1959,12 @@ int fluid_synth_write_u8(fluid_synth_t *synth, int len, uint8_t *out,
     for (i = 0, j = loff, k = roff; i < len;
          i++, cur++, j += lincr, k += rincr) {
         /* fill up the buffers as needed */
-        if (cur == FLUID_BUFSIZE) {
+        if (cur == synth->block_size) {
             fluid_synth_one_block(synth, 0);
             cur = 0;
         }
-        left_out[j] = (uint8_t)round_clip_to_i16(left_in[cur] * 127.0f) + 128;
-        if (right_out != NULL) right_out[k] = (uint8_t)round_clip_to_i16(right_in[cur] * 127.0f) + 128;
+        left_out[j] = fluid_bus_to_u8(left_in[cur]);
+        if (right_out != NULL) right_out[k] = fluid_bus_to_u8(right_in[cur]);
     }
 
     synth->cur = cur;
@@ -1581,67 +1996,489 @@ int fluid_synth_write_u12(fluid_synth_t *synth, int len, uint16_t *out,
     return ret;
 }
 
-int fluid_synth_write_s16_mono(fluid_synth_t *synth, int len, void *lout) {
-    return fluid_synth_write_s16(synth, len, lout, 0, 1, NULL, 0, 0);
-}
-
-/**
- * Synthesize a block of 16 bit audio samples to audio buffers.
- * @param synth FluidSynth instance
- * @param len Count of audio frames to synthesize
- * @param lout Array of 16 bit words to store left channel of audio
- * @param loff Offset index in 'lout' for first sample
- * @param lincr Increment between samples stored to 'lout'
- * @param rout Array of 16 bit words to store right channel of audio
- * @param roff Offset index in 'rout' for first sample
- * @param rincr Increment between samples stored to 'rout'
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- *
- * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
- * lincr = 2, rincr = 2).
+/*
+ * Block render kernels.
  *
- * @note Should only be called from synthesis thread.
- * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
- * @note Dithering is performed when converting from internal floating point to
- * 16 bit audio.
+ * Each kernel converts n frames of the internal left/right buffers into
+ * interleaved output with 1 or 2 channels. They are free of per-frame
+ * branches on synth->cur so that the compiler can vectorize them, and an
+ * explicit SSE2 path is used for the s16 conversion when available.
  */
-_RAMFUNC int fluid_synth_write_s16(fluid_synth_t *synth, int len, void *lout, int loff,
-                          int lincr, void *rout, int roff, int rincr) {
-    int i, j, k, cur;
-    int16_t *left_out = (int16_t *)lout;
-    int16_t *right_out = (int16_t *)rout;
-    fluid_real_t *left_in = synth->left_buf;
-    fluid_real_t *right_in = synth->right_buf;
+typedef void (*fluid_render_conv_t)(const fluid_bus_t *left,
+                                    const fluid_bus_t *right, void *out,
+                                    int n, int channels);
 
-    /* make sure we're playing */
-    if (synth->state != FLUID_SYNTH_PLAYING) {
-        return 0;
-    }
+/* Same rounding and saturation as round_clip_to_i16(), without branches. */
+static FLUID_INLINE int32_t
+round_clamp_to_i32(float x, float min, float max)
+{
+    x = (x < min) ? min : ((x > max) ? max : x);
+    return (int32_t)((x >= 0.0f) ? x + 0.5f : x - 0.5f);
+}
 
-    cur = synth->cur;
+/* one sample of the mix bus to 16 or 8 bit output, saturated */
+#ifdef WITH_FIXED
+#define FLUID_CONV_S16(_x) fluid_bus_to_s16(_x)
+#define FLUID_CONV_U8(_x) fluid_bus_to_u8(_x)
+#else
+#define FLUID_CONV_S16(_x)                                                     \
+    (int16_t)round_clamp_to_i32((float)((_x) * 32766.0f), -32768.0f, 32767.0f)
+#define FLUID_CONV_U8(_x)                                                      \
+    (uint8_t)(round_clamp_to_i32((float)((_x) * 127.0f), -128.0f, 127.0f) + 128)
+#endif
 
-    for (i = 0, j = loff, k = roff; i < len;
-         i++, cur++, j += lincr, k += rincr) {
-        /* fill up the buffers as needed */
-        if (cur == FLUID_BUFSIZE) {
-            fluid_synth_one_block(synth, 0);
-            cur = 0;
-            cooperative_task();
+static void fluid_render_conv_float(const fluid_bus_t *left,
+                                    const fluid_bus_t *right, void *out,
+                                    int n, int channels) {
+    int i;
+    float *dst = (float *)out;
+
+    if (channels == 1) {
+        for (i = 0; i < n; i++) dst[i] = (float)fluid_bus_to_real(left[i]);
+    } else {
+        for (i = 0; i < n; i++) {
+            dst[2 * i] = (float)fluid_bus_to_real(left[i]);
+            dst[2 * i + 1] = (float)fluid_bus_to_real(right[i]);
         }
-        left_out[j] = round_clip_to_i16(left_in[cur] * 32766.0f);
-        if (right_out != NULL) right_out[k] = (int16_t)round_clip_to_i16(right_in[cur] * 32766.0f);
     }
-
-    synth->cur = cur;
-    return 0;
 }
 
+#ifdef FLUID_RENDER_SSE2
+/* convert 4 samples, saturating into [-32768, 32767] */
+static FLUID_INLINE __m128i fluid_render_sse2_s16x4(const float *in) {
+    const __m128 scale = _mm_set1_ps(32766.0f);
+    const __m128 vmin = _mm_set1_ps(-32768.0f);
+    const __m128 vmax = _mm_set1_ps(32767.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(in), scale);
+
+    x = _mm_min_ps(_mm_max_ps(x, vmin), vmax);
+    /* round half away from zero, like round_clip_to_i16() */
+    x = _mm_add_ps(x, _mm_or_ps(half, _mm_and_ps(x, sign)));
+    return _mm_cvttps_epi32(x);
+}
+#endif
+
+static void fluid_render_conv_s16(const fluid_bus_t *left,
+                                  const fluid_bus_t *right, void *out, int n,
+                                  int channels) {
+    int i = 0;
+    int16_t *dst = (int16_t *)out;
+
+#ifdef FLUID_RENDER_SSE2
+    if (channels == 1) {
+        for (; i + 8 <= n; i += 8) {
+            __m128i lo = fluid_render_sse2_s16x4(left + i);
+            __m128i hi = fluid_render_sse2_s16x4(left + i + 4);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+        }
+    } else {
+        for (; i + 4 <= n; i += 4) {
+            __m128i l = fluid_render_sse2_s16x4(left + i);
+            __m128i r = fluid_render_sse2_s16x4(right + i);
+            __m128i lr = _mm_packs_epi32(l, r); /* l0..l3 r0..r3 */
+            lr = _mm_unpacklo_epi16(lr, _mm_srli_si128(lr, 8));
+            _mm_storeu_si128((__m128i *)(dst + 2 * i), lr);
+        }
+    }
+#endif
+
+    if (channels == 1) {
+        for (; i < n; i++)
+            dst[i] = FLUID_CONV_S16(left[i]);
+    } else {
+        for (; i < n; i++) {
+            dst[2 * i] = FLUID_CONV_S16(left[i]);
+            dst[2 * i + 1] = FLUID_CONV_S16(right[i]);
+        }
+    }
+}
+
+static void fluid_render_conv_u12(const fluid_bus_t *left,
+                                  const fluid_bus_t *right, void *out, int n,
+                                  int channels) {
+    int i;
+    uint16_t *dst = (uint16_t *)out;
+
+    /* same quantisation as fluid_synth_write_u12(): s16 >> 4, biased */
+    fluid_render_conv_s16(left, right, out, n, channels);
+    for (i = 0; i < n * channels; i++) {
+        dst[i] = (uint16_t)(((int16_t)dst[i] >> 4) + 2048);
+    }
+}
+
+static void fluid_render_conv_u8(const fluid_bus_t *left,
+                                 const fluid_bus_t *right, void *out, int n,
+                                 int channels) {
+    int i;
+    uint8_t *dst = (uint8_t *)out;
+
+    if (channels == 1) {
+        for (i = 0; i < n; i++)
+            dst[i] = FLUID_CONV_U8(left[i]);
+    } else {
+        for (i = 0; i < n; i++) {
+            dst[2 * i] = FLUID_CONV_U8(left[i]);
+            dst[2 * i + 1] = FLUID_CONV_U8(right[i]);
+        }
+    }
+}
+
+/*
+ * fluid_synth_render
+ *
+ * Drains what is left of the current block, then converts whole
+ * blocks straight into the caller's buffer, and finally
+ * leaves the remainder of the last block in synth->cur for the next call.
+ */
+static int fluid_synth_render(fluid_synth_t *synth, int len, void *out,
+                              int channels, int sample_size,
+                              fluid_render_conv_t conv) {
+    int n, done = 0, cur;
+    char *dst = (char *)out;
+    int frame_size = sample_size * channels;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(out != NULL || len == 0, FLUID_FAILED);
+
+    if (channels != 1 && channels != 2) {
+        FLUID_LOG(FLUID_ERR, "Unsupported channel count %d", channels);
+        return FLUID_FAILED;
+    }
+
+    /* make sure we're playing */
+    if (synth->state != FLUID_SYNTH_PLAYING) {
+        return FLUID_OK;
+    }
+
+    cur = synth->cur;
+
+    while (done < len) {
+        if (cur == synth->block_size) {
+            fluid_synth_one_block(synth, 0);
+            cur = 0;
+            cooperative_task();
+        }
+
+        n = synth->block_size - cur;
+        if (n > len - done) n = len - done;
+
+        conv(synth->left_buf + cur, synth->right_buf + cur,
+             dst + done * frame_size, n, channels);
+
+        cur += n;
+        done += n;
+    }
+
+    synth->cur = cur;
+    return FLUID_OK;
+}
+
+_RAMFUNC int fluid_synth_render_s16(fluid_synth_t *synth, int len,
+                                    int16_t *out, int channels) {
+    return fluid_synth_render(synth, len, out, channels, sizeof(int16_t),
+                              fluid_render_conv_s16);
+}
+
+int fluid_synth_render_u12(fluid_synth_t *synth, int len, uint16_t *out,
+                           int channels) {
+    return fluid_synth_render(synth, len, out, channels, sizeof(uint16_t),
+                              fluid_render_conv_u12);
+}
+
+int fluid_synth_render_u8(fluid_synth_t *synth, int len, uint8_t *out,
+                          int channels) {
+    return fluid_synth_render(synth, len, out, channels, sizeof(uint8_t),
+                              fluid_render_conv_u8);
+}
+
+int fluid_synth_render_float(fluid_synth_t *synth, int len, float *out,
+                             int channels) {
+    return fluid_synth_render(synth, len, out, channels, sizeof(float),
+                              fluid_render_conv_float);
+}
+
+int fluid_synth_write_s16_mono(fluid_synth_t *synth, int len, void *lout) {
+    return fluid_synth_write_s16(synth, len, lout, 0, 1, NULL, 0, 0);
+}
+
+/**
+ * Synthesize a block of 16 bit audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of 16 bit words to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of 16 bit words to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
+ * lincr = 2, rincr = 2).
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ * @note Dithering is performed when converting from internal floating point to
+ * 16 bit audio.
+ */
+_RAMFUNC int fluid_synth_write_s16(fluid_synth_t *synth, int len, void *lout, int loff,
+                          int lincr, void *rout, int roff, int rincr) {
+    int i, j, k, cur;
+    int16_t *left_out = (int16_t *)lout;
+    int16_t *right_out = (int16_t *)rout;
+    fluid_bus_t *left_in = synth->left_buf;
+    fluid_bus_t *right_in = synth->right_buf;
+
+    /* make sure we're playing */
+    if (synth->state != FLUID_SYNTH_PLAYING) {
+        return 0;
+    }
+
+    cur = synth->cur;
+
+    for (i = 0, j = loff, k = roff; i < len;
+         i++, cur++, j += lincr, k += rincr) {
+        /* fill up the buffers as needed */
+        if (cur == synth->block_size) {
+            fluid_synth_one_block(synth, 0);
+            cur = 0;
+            cooperative_task();
+        }
+        left_out[j] = fluid_bus_to_s16(left_in[cur]);
+        if (right_out != NULL) right_out[k] = (int16_t)fluid_bus_to_s16(right_in[cur]);
+    }
+
+    synth->cur = cur;
+    return 0;
+}
+
+/* Output below this level counts as silence (-140 dBFS, under the LSB of
+ * 24 bit PCM). That is below the LSB of the Q23 bus of WITH_FIXED. */
+#ifdef WITH_FIXED
+#define FLUID_SYNTH_SILENCE_LEVEL 0
+#else
+#define FLUID_SYNTH_SILENCE_LEVEL 1e-7f
+#endif
+
+/* Samples of silent output without voices before the synth goes idle.
+ * This is longer than the delay lines of the chorus (MAX_SAMPLES) and of
+ * the reverb, so all that is left in them has been heard below the noise
+ * floor at least once. */
+#define FLUID_SYNTH_SILENCE_SAMPLES (2 * MAX_SAMPLES)
+
+static int fluid_synth_buf_silent(const fluid_bus_t *buf, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        if (buf[i] > FLUID_SYNTH_SILENCE_LEVEL || buf[i] < -FLUID_SYNTH_SILENCE_LEVEL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * fluid_synth_update_idle
+ *
+ * Called at the end of a block with the number of voices it rendered.
+ * The output of a block without voices is the reverb and chorus tail
+ * only. Once that has stayed below FLUID_SYNTH_SILENCE_LEVEL long enough
+ * the effect units are cleared and the synth goes idle.
+ */
+static void fluid_synth_update_idle(fluid_synth_t *synth, int nplaying,
+                                    int do_not_mix_fx_to_out) {
+    int len = synth->block_size;
+    int silent;
+
+    if (nplaying > 0) {
+        synth->silent_samples = 0;
+        return;
+    }
+
+    silent = fluid_synth_buf_silent(synth->left_buf, len)
+        && (synth->right_buf == NULL || fluid_synth_buf_silent(synth->right_buf, len));
+    if (silent && do_not_mix_fx_to_out) {
+        if (synth->enable_reverb) {
+            silent = fluid_synth_buf_silent(synth->fx_left_buf, len)
+                && fluid_synth_buf_silent(synth->fx_right_buf, len);
+        }
+        if (silent && synth->enable_chorus) {
+            silent = fluid_synth_buf_silent(synth->fx_left_buf2, len)
+                && fluid_synth_buf_silent(synth->fx_right_buf2, len);
+        }
+    }
+
+    if (!silent) {
+        synth->silent_samples = 0;
+        return;
+    }
+
+    synth->silent_samples += len;
+    if (synth->silent_samples >= FLUID_SYNTH_SILENCE_SAMPLES) {
+        /* drop what is left below the noise floor, so the tail doesn't
+         * come back when the synth wakes up */
+        if (synth->chorus != NULL) fluid_chorus_reset(synth->chorus);
+        if (synth->reverb != NULL) fluid_revmodel_reset(synth->reverb);
+        synth->idle = true;
+    }
+}
+
+#ifdef WITH_FIXED
+/*
+ * fluid_synth_fx_fixed
+ *
+ * The reverb and the chorus run in fluid_real_t. Their send bus is
+ * converted for them, and their output is converted back to the Q23
+ * buses. This is all the floating point per sample left in a WITH_FIXED
+ * build: on parts without an FPU, create the synth without reverb and
+ * chorus, or build with EMPTY_REVERB and EMPTY_CHORUS.
+ */
+static void fluid_synth_fx_fixed(fluid_synth_t *synth, fluid_bus_t *reverb_buf,
+                                 fluid_bus_t *chorus_buf, int do_not_mix_fx_to_out) {
+    int n = synth->block_size;
+    fluid_real_t *in = synth->fx_scratch;
+    fluid_real_t *left = in + n;
+    fluid_real_t *right = left + n;
+    fluid_bus_t *send, *out_left, *out_right;
+    int fx, i;
+
+    for (fx = 0; fx < 2; fx++) {
+        send = fx == 0 ? reverb_buf : chorus_buf;
+        if (send == NULL) continue;
+
+        for (i = 0; i < n; i++) in[i] = fluid_bus_to_real(send[i]);
+        if (fx == 0) {
+            fluid_revmodel_processreplace(synth->reverb, in, left, right, n);
+        } else {
+            fluid_chorus_processreplace(synth->chorus, in, left, right, n);
+        }
+
+        if (do_not_mix_fx_to_out) {
+            out_left = fx == 0 ? synth->fx_left_buf : synth->fx_left_buf2;
+            out_right = fx == 0 ? synth->fx_right_buf : synth->fx_right_buf2;
+            for (i = 0; i < n; i++) {
+                out_left[i] = fluid_real_to_bus(left[i]);
+                out_right[i] = fluid_real_to_bus(right[i]);
+            }
+        } else {
+            for (i = 0; i < n; i++) {
+                synth->left_buf[i] = fluid_fixed_add_sat(synth->left_buf[i],
+                                                         fluid_real_to_bus(left[i]));
+                synth->right_buf[i] = fluid_fixed_add_sat(synth->right_buf[i],
+                                                          fluid_real_to_bus(right[i]));
+            }
+        }
+    }
+}
+#endif
+
+/*
+ * fluid_synth_play_event
+ */
+static void fluid_synth_play_event(fluid_synth_t *synth, const fluid_synth_event_t *event) {
+    switch (event->type) {
+    case NOTE_ON:
+        fluid_synth_noteon(synth, event->chan, event->param1, event->param2);
+        break;
+    case NOTE_OFF:
+        fluid_synth_noteoff(synth, event->chan, event->param1);
+        break;
+    case CONTROL_CHANGE:
+        fluid_synth_cc(synth, event->chan, event->param1, event->param2);
+        break;
+    case PITCH_BEND:
+        fluid_synth_pitch_bend(synth, event->chan, event->param1);
+        break;
+    case PROGRAM_CHANGE:
+        fluid_synth_program_change(synth, event->chan, event->param1);
+        break;
+    case CHANNEL_PRESSURE:
+        fluid_synth_channel_pressure(synth, event->chan, event->param1);
+        break;
+    case KEY_PRESSURE:
+        fluid_synth_key_pressure(synth, event->chan, event->param1, event->param2);
+        break;
+    }
+}
+
+/*
+ * fluid_synth_play_events
+ *
+ * Plays the messages posted by other threads, then the timestamped events
+ * that fall into the block about to be rendered, with synth->event_offset
+ * set to their frame in the block.
+ */
+static void fluid_synth_play_events(fluid_synth_t *synth) {
+    fluid_synth_event_t *event;
+    fluid_synth_event_t posted;
+    int i, offset;
+
+    if (synth->event_ring != NULL) {
+        while (fluid_event_ring_pop(synth->event_ring, &posted)) {
+            fluid_synth_play_event(synth, &posted);
+        }
+    }
+
+    for (i = 0; i < synth->event_count; i++) {
+        event = &synth->events[i];
+        offset = (int)(event->frame - synth->ticks);
+        if (offset >= synth->block_size) break;
+
+        synth->event_offset = offset > 0 ? offset : 0;
+        fluid_synth_play_event(synth, event);
+    }
+    synth->event_offset = 0;
+
+    synth->event_count -= i;
+    if (i > 0 && synth->event_count > 0) {
+        FLUID_MEMMOVE(synth->events, synth->events + i,
+                      synth->event_count * sizeof(fluid_synth_event_t));
+    }
+}
+
+#ifdef FLUID_DSP_SIMD
+/*
+ * fluid_synth_write_dry
+ *
+ * Writes the playing voices in the three steps of fluid_voice_write_dry(),
+ * so that their filters run side by side in the lanes of the vector
+ * kernels. Returns the number of voices played.
+ */
+static int fluid_synth_write_dry(fluid_synth_t *synth, fluid_real_t *reverb_buf,
+                                 fluid_real_t *chorus_buf) {
+    fluid_voice_t *voice;
+    int i, n = 0, nplaying = 0;
+
+    for (i = 0; i < synth->polyphony; i++) {
+        voice = synth->voice[i];
+
+        if (_PLAYING(voice)) {
+            fluid_voice_write_dry(voice, synth->dry_buf + i * synth->block_size);
+            if (voice->dry_count > 0) synth->dry_voices[n++] = voice;
+            nplaying++;
+            cooperative_task();
+        }
+    }
+
+    fluid_voice_filter_dry(synth->dry_voices, n);
+    for (i = 0; i < n; i++) {
+        fluid_voice_mix_dry(synth->dry_voices[i], synth->left_buf, synth->right_buf,
+                            reverb_buf, chorus_buf);
+    }
+    return nplaying;
+}
+#endif
+
 _RAMFUNC int fluid_synth_one_block(fluid_synth_t *synth, int do_not_mix_fx_to_out) {
     int i;
     fluid_voice_t *voice;
-    fluid_real_t *reverb_buf;
-    fluid_real_t *chorus_buf;
-    int byte_size = FLUID_BUFSIZE * sizeof(fluid_real_t);
+    fluid_bus_t *reverb_buf;
+    fluid_bus_t *chorus_buf;
+    int byte_size = synth->block_size * sizeof(fluid_bus_t);
+    int nplaying = 0;
+
+    if (synth->event_count > 0 || synth->event_ring != NULL) fluid_synth_play_events(synth);
 
     FLUID_MEMSET(synth->left_buf, 0, byte_size);
     if (synth->right_buf != NULL) FLUID_MEMSET(synth->right_buf, 0, byte_size);
@@ -1655,6 +2492,16 @@ _RAMFUNC int fluid_synth_one_block(fluid_synth_t *synth, int do_not_mix_fx_to_ou
         FLUID_MEMSET(synth->fx_right_buf2, 0, byte_size);
     }
 
+    /* Nothing is playing and the reverb and chorus tails have died out,
+     * the block stays silent. fluid_synth_start_voice wakes the synth. */
+    if (synth->idle) {
+        synth->ticks += synth->block_size;
+        return 0;
+    }
+
+    /* the envelopes move on and voices end */
+    synth->voices_stale = true;
+
     /* Set up the reverb / chorus buffers only, when the effect is
      * enabled on synth level.  Nonexisting buffers are detected in the
      * DSP loop. Not sending the reverb / chorus signal saves some time
@@ -1663,16 +2510,32 @@ _RAMFUNC int fluid_synth_one_block(fluid_synth_t *synth, int do_not_mix_fx_to_ou
     chorus_buf = synth->enable_chorus ? synth->fx_left_buf2 : NULL;
 
     /* call all playing synthesis processes */
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
+#ifdef WITH_THREADS
+    if (synth->render_pool != NULL) {
+        nplaying = fluid_render_pool_write_voices(synth->render_pool, reverb_buf, chorus_buf);
+    } else
+#endif
+#ifdef FLUID_DSP_SIMD
+    if (synth->dry_buf != NULL) {
+        nplaying = fluid_synth_write_dry(synth, reverb_buf, chorus_buf);
+    } else
+#endif
+    {
+        for (i = 0; i < synth->polyphony; i++) {
+            voice = synth->voice[i];
 
-        if (_PLAYING(voice)) {
-            fluid_voice_write(voice, synth->left_buf, synth->right_buf,
-                              reverb_buf, chorus_buf);
-            cooperative_task();
+            if (_PLAYING(voice)) {
+                fluid_voice_write(voice, synth->left_buf, synth->right_buf,
+                                  reverb_buf, chorus_buf);
+                nplaying++;
+                cooperative_task();
+            }
         }
     }
 
+#ifdef WITH_FIXED
+    fluid_synth_fx_fixed(synth, reverb_buf, chorus_buf, do_not_mix_fx_to_out);
+#else
     /* if multi channel output, don't mix the output of the chorus and
        reverb in the final output. The effects outputs are send
        separately. */
@@ -1682,122 +2545,250 @@ _RAMFUNC int fluid_synth_one_block(fluid_synth_t *synth, int do_not_mix_fx_to_ou
         if (reverb_buf) {
             fluid_revmodel_processreplace(synth->reverb, reverb_buf,
                                           synth->fx_left_buf,
-                                          synth->fx_right_buf);
+                                          synth->fx_right_buf, synth->block_size);
         }
         /* send to chorus */
         if (chorus_buf) {
           fluid_chorus_processreplace(synth->chorus, chorus_buf,
-                                    synth->fx_left_buf2, synth->fx_right_buf2);
+                                    synth->fx_left_buf2, synth->fx_right_buf2,
+                                    synth->block_size);
         }
 
     } else {
         /* send to reverb */
         if (reverb_buf) {
             fluid_revmodel_processmix(synth->reverb, reverb_buf,
-                                      synth->left_buf, synth->right_buf);
+                                      synth->left_buf, synth->right_buf,
+                                      synth->block_size);
         }
         /* send to chorus */
         if (chorus_buf) {
           fluid_chorus_processmix(synth->chorus, chorus_buf,
-                                synth->left_buf, synth->right_buf);
+                                synth->left_buf, synth->right_buf,
+                                synth->block_size);
         }
     }
+#endif
+
+    fluid_synth_update_idle(synth, nplaying, do_not_mix_fx_to_out);
 
-    synth->ticks += FLUID_BUFSIZE;
+    synth->ticks += synth->block_size;
     return 0;
 }
 
 /*
- * fluid_synth_free_voice_by_kill
+ * fluid_synth_steal_prio
  *
- * selects a voice for killing. the selection algorithm is a refinement
- * of the algorithm previously in fluid_synth_alloc_voice.
+ * How 'important' a voice is, the voice with the lowest priority is
+ * stolen first. The age counts from synth->steal_base instead of the
+ * current note id, that shifts the priorities of all the voices alike.
  */
-fluid_voice_t *fluid_synth_free_voice_by_kill(fluid_synth_t *synth) {
+static double fluid_synth_steal_prio(fluid_synth_t *synth, fluid_voice_t *voice) {
+    /* Start with an arbitrary number */
+    double prio = 10000.;
+
+    /* Is this voice on the drum channel?
+     * Then it is very important.
+     * Also, forget about the released-note condition:
+     * Typically, drum notes are triggered only very briefly, they run most
+     * of the time in release phase.
+     */
+    if (_RELEASED(voice)) {
+        /* The key for this voice has been released. Consider it much less
+         * important than a voice, which is still held.
+         */
+        prio -= 2000.;
+    }
+
+    if (_SUSTAINED(voice)) {
+        /* The sustain pedal is held down on this channel.
+         * Consider it less important than non-sustained channels.
+         * This decision is somehow subjective. But usually the sustain
+         * pedal is used to play 'more-voices-than-fingers', so it shouldn't
+         * hurt if we kill one voice.
+         */
+        prio -= 1000;
+    }
+
+    /* We are not enthusiastic about releasing voices, which have just been
+     * started. Otherwise hitting a chord may result in killing notes
+     * belonging to that very same chord. So subtract the age of the voice
+     * from the priority - an older voice is just a little bit less
+     * important than a younger voice. This is a number between roughly 0
+     * and 100.*/
+    prio -= (int)(synth->steal_base - fluid_voice_get_id(voice));
+
+    /* take a rough estimate of loudness into account. Louder voices are
+     * more important. */
+    if (voice->volenv_section != FLUID_VOICE_ENVATTACK) {
+        prio += voice->volenv_val * 1000.;
+    }
+    return prio;
+}
+
+/* Voices of equal priority are stolen in the order of the voice array. */
+#define fluid_steal_before(a, b)                                                                   \
+    ((a)->steal_prio < (b)->steal_prio ||                                                          \
+     ((a)->steal_prio == (b)->steal_prio && (a)->slot < (b)->slot))
+
+static void fluid_synth_steal_place(fluid_synth_t *synth, fluid_voice_t *voice, int pos) {
+    synth->steal_queue[pos] = voice;
+    voice->steal_pos = pos;
+}
+
+static void fluid_synth_steal_sift_up(fluid_synth_t *synth, fluid_voice_t *voice) {
+    int pos = voice->steal_pos;
+
+    while (pos > 0 && fluid_steal_before(voice, synth->steal_queue[(pos - 1) / 2])) {
+        fluid_synth_steal_place(synth, synth->steal_queue[(pos - 1) / 2], pos);
+        pos = (pos - 1) / 2;
+    }
+    fluid_synth_steal_place(synth, voice, pos);
+}
+
+static void fluid_synth_steal_sift_down(fluid_synth_t *synth, fluid_voice_t *voice) {
+    int pos = voice->steal_pos;
+    int child;
+
+    while ((child = 2 * pos + 1) < synth->steal_count) {
+        if (child + 1 < synth->steal_count &&
+            fluid_steal_before(synth->steal_queue[child + 1], synth->steal_queue[child])) {
+            child++;
+        }
+        if (!fluid_steal_before(synth->steal_queue[child], voice)) break;
+        fluid_synth_steal_place(synth, synth->steal_queue[child], pos);
+        pos = child;
+    }
+    fluid_synth_steal_place(synth, voice, pos);
+}
+
+/*
+ * fluid_synth_refresh_voices
+ *
+ * Rebuilds the free voices and the steal queue after the voices have
+ * changed on their own, while rendering (envelopes, voices that ended)
+ * or after many voices were turned off at once. Between two blocks they
+ * are kept up to date voice by voice.
+ */
+static void fluid_synth_refresh_voices(fluid_synth_t *synth) {
     int i;
-    fluid_real_t best_prio = 999999.;
-    fluid_real_t this_voice_prio;
     fluid_voice_t *voice;
-    int best_voice_index = -1;
 
-    for (i = 0; i < synth->polyphony; i++) {
+    FLUID_MEMSET(synth->free_voices, 0, ((synth->nvoice + 31) / 32) * sizeof(uint32_t));
+    synth->steal_count = 0;
+    synth->steal_base = synth->noteid;
+
+    for (i = 0; i < synth->nvoice; i++) {
         voice = synth->voice[i];
+        voice->steal_pos = -1;
+        if (i >= synth->polyphony) continue;
 
-        /* safeguard against an available voice. */
         if (_AVAILABLE(voice)) {
-            return voice;
+            synth->free_voices[i / 32] |= 1u << (i % 32);
+        } else {
+            voice->steal_prio = fluid_synth_steal_prio(synth, voice);
+            fluid_synth_steal_place(synth, voice, synth->steal_count++);
         }
+    }
+    for (i = synth->steal_count / 2 - 1; i >= 0; i--) {
+        fluid_synth_steal_sift_down(synth, synth->steal_queue[i]);
+    }
+    synth->voices_stale = false;
+}
 
-        /* Determine, how 'important' a voice is.
-         * Start with an arbitrary number */
-        this_voice_prio = 10000.;
-
-        /* Is this voice on the drum channel?
-         * Then it is very important.
-         * Also, forget about the released-note condition:
-         * Typically, drum notes are triggered only very briefly, they run most
-         * of the time in release phase.
-         */
-        if (_RELEASED(voice)) {
-            /* The key for this voice has been released. Consider it much less
-             * important than a voice, which is still held.
-             */
-            this_voice_prio -= 2000.;
+/*
+ * fluid_synth_update_voice
+ *
+ * Keeps the free voices and the steal queue up to date after a voice was
+ * started, released or killed between two blocks.
+ */
+static void fluid_synth_update_voice(fluid_synth_t *synth, fluid_voice_t *voice) {
+    int slot = voice->slot;
+
+    if (synth->voices_stale || slot >= synth->polyphony) return;
+
+    if (_AVAILABLE(voice)) {
+        synth->free_voices[slot / 32] |= 1u << (slot % 32);
+        if (voice->steal_pos >= 0) {
+            /* the last one takes its place */
+            fluid_voice_t *last = synth->steal_queue[--synth->steal_count];
+            if (last != voice) {
+                fluid_synth_steal_place(synth, last, voice->steal_pos);
+                fluid_synth_steal_sift_up(synth, last);
+                fluid_synth_steal_sift_down(synth, last);
+            }
+            voice->steal_pos = -1;
         }
+        return;
+    }
 
-        if (_SUSTAINED(voice)) {
-            /* The sustain pedal is held down on this channel.
-             * Consider it less important than non-sustained channels.
-             * This decision is somehow subjective. But usually the sustain
-             * pedal is used to play 'more-voices-than-fingers', so it shouldn't
-             * hurt if we kill one voice.
-             */
-            this_voice_prio -= 1000;
-        }
+    synth->free_voices[slot / 32] &= ~(1u << (slot % 32));
+    voice->steal_prio = fluid_synth_steal_prio(synth, voice);
+    if (voice->steal_pos < 0) {
+        fluid_synth_steal_place(synth, voice, synth->steal_count++);
+    }
+    fluid_synth_steal_sift_up(synth, voice);
+    fluid_synth_steal_sift_down(synth, voice);
+}
 
-        /* We are not enthusiastic about releasing voices, which have just been
-         * started. Otherwise hitting a chord may result in killing notes
-         * belonging to that very same chord. So subtract the age of the voice
-         * from the priority - an older voice is just a little bit less
-         * important than a younger voice. This is a number between roughly 0
-         * and 100.*/
-        this_voice_prio -= (synth->noteid - fluid_voice_get_id(voice));
+/* the available voice with the lowest index, NULL if all are playing */
+static fluid_voice_t *fluid_synth_first_free_voice(fluid_synth_t *synth) {
+    int i;
+    uint32_t free;
 
-        /* take a rough estimate of loudness into account. Louder voices are
-         * more important. */
-        if (voice->volenv_section != FLUID_VOICE_ENVATTACK) {
-            this_voice_prio += voice->volenv_val * 1000.;
+    if (synth->voices_stale) {
+        fluid_synth_refresh_voices(synth);
+    }
+
+    for (i = 0; i < synth->polyphony; i += 32) {
+        free = synth->free_voices[i / 32];
+        if (free != 0) {
+            return synth->voice[i + __builtin_ctz(free)];
         }
+    }
+    return NULL;
+}
 
-        /* check if this voice has less priority than the previous candidate. */
-        if (this_voice_prio < best_prio)
-            best_voice_index = i, best_prio = this_voice_prio;
+/*
+ * fluid_synth_free_voice_by_kill
+ *
+ * selects a voice for killing. the selection algorithm is a refinement
+ * of the algorithm previously in fluid_synth_alloc_voice: the voice with
+ * the lowest priority, see fluid_synth_steal_prio(), kept first in the
+ * steal queue.
+ */
+fluid_voice_t *fluid_synth_free_voice_by_kill(fluid_synth_t *synth) {
+    fluid_voice_t *voice;
+
+    /* safeguard against an available voice. */
+    voice = fluid_synth_first_free_voice(synth);
+    if (voice != NULL) {
+        return voice;
     }
 
-    if (best_voice_index < 0) {
+    if (synth->steal_count == 0) {
         return NULL;
     }
 
-    voice = synth->voice[best_voice_index];
+    voice = synth->steal_queue[0];
     fluid_voice_off(voice);
+    fluid_synth_update_voice(synth, voice);
 
     return voice;
 }
 
-fluid_voice_t *fluid_synth_alloc_voice(fluid_synth_t *synth,
-                                       fluid_sample_t *sample, int chan,
-                                       int key, int vel) {
-    fluid_voice_t *voice = NULL;
-    fluid_channel_t *channel = NULL;
+/* a free voice for a note-on, or a stolen one */
+static fluid_voice_t *fluid_synth_take_voice(fluid_synth_t *synth, int chan, int key) {
+    fluid_voice_t *voice;
 
-    /* check if there's an available synthesis process */
-    for (int i = 0; i < synth->polyphony; i++) {
-        if (_AVAILABLE(synth->voice[i])) {
-            voice = synth->voice[i];
-            break;
-        }
+    if (chan < 0) {
+        FLUID_LOG(FLUID_WARN, "Channel should be valid");
+        return NULL;
     }
 
+    /* check if there's an available synthesis process */
+    voice = fluid_synth_first_free_voice(synth);
+
     /* No success yet? Then stop a running voice. */
     if (voice == NULL) {
         voice = fluid_synth_free_voice_by_kill(synth);
@@ -1807,6 +2798,17 @@ fluid_voice_t *fluid_synth_alloc_voice(fluid_synth_t *synth,
         FLUID_LOG(FLUID_WARN,
                   "Failed to allocate a synthesis process. (chan=%d,key=%d)",
                   chan, key);
+    }
+    return voice;
+}
+
+fluid_voice_t *fluid_synth_alloc_voice(fluid_synth_t *synth,
+                                       fluid_sample_t *sample, int chan,
+                                       int key, int vel) {
+    fluid_voice_t *voice = fluid_synth_take_voice(synth, chan, key);
+    fluid_channel_t *channel = NULL;
+
+    if (voice == NULL) {
         return NULL;
     }
 
@@ -1828,12 +2830,7 @@ fluid_voice_t *fluid_synth_alloc_voice(fluid_synth_t *synth,
                   sample->origpitch);
     #endif
 
-    if (chan >= 0) {
-        channel = synth->channel[chan];
-    } else {
-        FLUID_LOG(FLUID_WARN, "Channel should be valid");
-        return NULL;
-    }
+    channel = synth->channel[chan];
 
     if (fluid_voice_init(voice, sample, channel, key, vel, synth->storeid,
                          synth->ticks, synth->gain) != FLUID_OK) {
@@ -1865,6 +2862,20 @@ fluid_voice_t *fluid_synth_alloc_voice(fluid_synth_t *synth,
     return voice;
 }
 
+fluid_voice_t *fluid_synth_alloc_voice_from(fluid_synth_t *synth,
+                                            const fluid_voice_snapshot_t *snapshot,
+                                            fluid_sample_t *sample, int chan, int key,
+                                            int vel) {
+    fluid_voice_t *voice = fluid_synth_take_voice(synth, chan, key);
+
+    if (voice == NULL) {
+        return NULL;
+    }
+    fluid_voice_init_from(voice, snapshot, sample, synth->channel[chan], key, vel,
+                          synth->storeid, synth->ticks);
+    return voice;
+}
+
 /*
  * fluid_synth_kill_by_exclusive_class
  */
@@ -1880,7 +2891,7 @@ void fluid_synth_kill_by_exclusive_class(fluid_synth_t *synth,
         class excl_class.
     */
 
-    int i;
+    fluid_voice_t *existing_voice;
     int excl_class = _GEN(new_voice, GEN_EXCLUSIVECLASS);
 
     /* Check if the voice belongs to an exclusive class. In that case,
@@ -1896,20 +2907,11 @@ void fluid_synth_kill_by_exclusive_class(fluid_synth_t *synth,
 
     /* Kill all notes on the same channel with the same exclusive class */
 
-    for (i = 0; i < synth->polyphony; i++) {
-        fluid_voice_t *existing_voice = synth->voice[i];
-
-        /* Existing voice does not play? Leave it alone. */
-        if (!_PLAYING(existing_voice)) {
-            continue;
-        }
-
-        /* An exclusive class is valid for a whole channel (or preset).
-         * Is the voice on a different channel? Leave it alone. */
-        if (existing_voice->chan != new_voice->chan) {
-            continue;
-        }
-
+    /* An exclusive class is valid for a whole channel (or preset), the
+     * list holds the playing voices of the channel with an exclusive
+     * class. */
+    fluid_synth_foreach_voice(existing_voice, &synth->excl_voices[new_voice->chan],
+                              excl_link) {
         /* Existing voice has a different (or no) exclusive class? Leave it
          * alone. */
         if ((int)_GEN(existing_voice, GEN_EXCLUSIVECLASS) != excl_class) {
@@ -1929,18 +2931,74 @@ void fluid_synth_kill_by_exclusive_class(fluid_synth_t *synth,
         //     (int)fluid_voice_get_id(existing_voice));
 
         fluid_voice_kill_excl(existing_voice);
+        fluid_synth_update_voice(synth, existing_voice);
     };
 }
 
 void fluid_synth_start_voice(fluid_synth_t *synth, fluid_voice_t *voice) {
+    fluid_synth_start_voice_from(synth, voice, NULL);
+}
+
+void fluid_synth_start_voice_from(fluid_synth_t *synth, fluid_voice_t *voice,
+                                  const fluid_voice_snapshot_t *snapshot) {
     /* Find the exclusive class of this voice. If set, kill all voices
      * that match the exclusive class and are younger than the first
      * voice process created by this noteon event. */
     fluid_synth_kill_by_exclusive_class(synth, voice);
 
-    /* Start the new voice */
+    fluid_voice_link(&synth->chan_voices[voice->chan], &voice->chan_link);
+    fluid_voice_link(fluid_synth_key_voices(synth, voice->chan, voice->key), &voice->key_link);
+    if (_GEN(voice, GEN_EXCLUSIVECLASS) != 0) {
+        fluid_voice_link(&synth->excl_voices[voice->chan], &voice->excl_link);
+    } else {
+        fluid_voice_unlink(&voice->excl_link);
+    }
+
+    /* Start the new voice, on the frame of a timestamped note-on */
+
+    voice->start_offset = synth->event_offset;
+    if (snapshot != NULL) {
+        fluid_voice_start_from(voice, snapshot);
+    } else {
+        fluid_voice_start(voice);
+    }
+    fluid_synth_update_voice(synth, voice);
+
+    synth->silent_samples = 0;
+    synth->idle = false;
+}
+
+/*
+ * fluid_synth_is_idle
+ */
+int fluid_synth_is_idle(fluid_synth_t *synth) {
+    fluid_return_val_if_fail(synth != NULL, 0);
+    return synth->idle ? 1 : 0;
+}
+
+/* the ids of the SoundFonts of a synth sharing them come from the registry,
+ * so that they don't clash with the ids of the shared ones */
+static unsigned int fluid_synth_new_sfont_id(fluid_synth_t *synth) {
+    return synth->share_sfonts ? fluid_sfont_registry_new_id() : ++synth->sfont_id;
+}
+
+/* the voices playing the samples of a SoundFont about to go stop now */
+static void fluid_synth_sfont_voices_off(fluid_synth_t *synth, fluid_sfont_t *sfont) {
+    fluid_voice_t *voice;
+    int i;
+
+    for (i = 0; i < synth->nvoice; i++) {
+        voice = synth->voice[i];
+        if (fluid_voice_is_playing(voice) && voice->sample != NULL &&
+            voice->sample->sfont == sfont) {
+            fluid_voice_off(voice);
+            fluid_synth_update_voice(synth, voice);
+        }
+    }
+}
 
-    fluid_voice_start(voice);
+static int fluid_synth_delete_sfont(fluid_sfont_t *sfont) {
+    return sfont->is_shared ? fluid_sfont_registry_release(sfont) : delete_fluid_sfont(sfont);
 }
 
 int fluid_synth_sfload(fluid_synth_t *synth, const char *filename,
@@ -1952,10 +3010,22 @@ int fluid_synth_sfload(fluid_synth_t *synth, const char *filename,
         return FLUID_FAILED;
     }
 
-    sfont = fluid_soundfont_load(fluid_get_default_fileapi(), filename);
+    if (synth->share_sfonts && (synth->stream_head_ms > 0 || synth->sample_cache_size == 0)) {
+        sfont = fluid_sfont_registry_load(fluid_get_default_fileapi(), filename,
+                                          synth->stream_head_ms);
+    } else if (synth->stream_head_ms > 0) {
+        sfont = fluid_soundfont_load_streamed(fluid_get_default_fileapi(), filename,
+                                              synth->stream_head_ms);
+    } else {
+        sfont = fluid_soundfont_load_paged(fluid_get_default_fileapi(), filename,
+                                           synth->sample_cache_size);
+    }
     if (sfont == NULL) return -1;
 
-    sfont->id = ++synth->sfont_id;
+    /* a shared SoundFont has the id the registry gave it */
+    if (!sfont->is_shared) {
+        sfont->id = fluid_synth_new_sfont_id(synth);
+    }
     synth->sfont = fluid_list_prepend(synth->sfont, sfont);
 
     if (reset_presets) {
@@ -1979,6 +3049,14 @@ int fluid_synth_sfunload(fluid_synth_t *synth, unsigned int id,
 
     /* remove the SoundFont from the list */
     synth->sfont = fluid_list_remove(synth->sfont, sfont);
+    fluid_synth_sfont_voices_off(synth, sfont);
+    /* the cache refers to the zones of its presets, the preloader may
+     * read their samples */
+    fluid_synth_clear_voice_cache(synth);
+    fluid_synth_preload_wait(synth);
+    if (synth->streamer != NULL) {
+        fluid_sample_streamer_forget_sfont(synth->streamer, sfont);
+    }
 
     /* reset the presets for all channels */
     if (reset_presets) {
@@ -1986,12 +3064,45 @@ int fluid_synth_sfunload(fluid_synth_t *synth, unsigned int id,
     } else {
         fluid_synth_update_presets(synth);
     }
-    return delete_fluid_sfont(sfont);
+    return fluid_synth_delete_sfont(sfont);
 }
 
 
+int fluid_synth_preload(fluid_synth_t *synth, unsigned int id, unsigned int bank,
+                        unsigned int prog) {
+    fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, id);
+    fluid_preset_t *preset;
+
+    if (!sfont) {
+        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
+        return FLUID_FAILED;
+    }
+    preset = fluid_sfont_get_preset(sfont, bank, prog);
+    if (preset == NULL) {
+        FLUID_LOG(FLUID_ERR, "There is no preset with bank number %d and preset number %d "
+                             "in SoundFont %d", bank, prog, id);
+        return FLUID_FAILED;
+    }
+
+    /* a SoundFont added without a cache size is paged in here */
+    if (synth->preloader == NULL) {
+        return fluid_preset_page_in(preset);
+    }
+    return fluid_sample_preloader_queue(synth->preloader, preset);
+}
+
+void fluid_synth_preload_wait(fluid_synth_t *synth) {
+    if (synth->preloader != NULL) {
+        fluid_sample_preloader_wait(synth->preloader);
+    }
+}
+
+unsigned int fluid_synth_get_stream_underruns(fluid_synth_t *synth) {
+    return synth->streamer != NULL ? fluid_sample_streamer_underruns(synth->streamer) : 0;
+}
+
 int fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont) {
-    sfont->id = ++synth->sfont_id;
+    sfont->id = fluid_synth_new_sfont_id(synth);
 
     /* insert the sfont as the first one on the list */
     synth->sfont = fluid_list_prepend(synth->sfont, sfont);
@@ -2009,6 +3120,12 @@ void fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont) {
     int sfont_id = fluid_sfont_get_id(sfont);
 
     synth->sfont = fluid_list_remove(synth->sfont, sfont);
+    fluid_synth_sfont_voices_off(synth, sfont);
+    fluid_synth_clear_voice_cache(synth);
+    fluid_synth_preload_wait(synth);
+    if (synth->streamer != NULL) {
+        fluid_sample_streamer_forget_sfont(synth->streamer, sfont);
+    }
 
     /* remove a possible bank offset */
     fluid_synth_remove_bank_offset(synth, sfont_id);
@@ -2100,14 +3217,13 @@ void fluid_synth_get_voicelist(fluid_synth_t *synth, fluid_voice_t *buf[],
  */
 void fluid_synth_release_voice_on_same_note(fluid_synth_t *synth, int chan,
                                             int key) {
-    int i;
     fluid_voice_t *voice;
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (_PLAYING(voice) && (voice->chan == chan) && (voice->key == key) &&
+    fluid_synth_foreach_voice(voice, fluid_synth_key_voices(synth, chan, key), key_link) {
+        if ((voice->key == key) &&
             (fluid_voice_get_id(voice) != synth->noteid)) {
-            fluid_voice_noteoff(voice);
+            fluid_voice_noteoff_at(voice, synth->event_offset);
+            fluid_synth_update_voice(synth, voice);
         }
     }
 }
@@ -2115,10 +3231,18 @@ void fluid_synth_release_voice_on_same_note(fluid_synth_t *synth, int chan,
 /* Purpose:
  * Sets the interpolation method to use on channel chan.
  * If chan is < 0, then set the interpolation method on all channels.
+ * The tables of a sinc are made here the first time it is selected.
  */
 int fluid_synth_set_interp_method(fluid_synth_t *synth, int chan,
                                   uint8_t interp_method) {
     int i;
+#ifndef WITH_FIXED
+    if ((interp_method == FLUID_INTERP_SINC8 || interp_method == FLUID_INTERP_SINC16 ||
+         interp_method == FLUID_INTERP_SINC32) &&
+        fluid_dsp_float_sinc_config(interp_method) != FLUID_OK) {
+        return FLUID_FAILED;
+    }
+#endif
     for (i = 0; i < synth->midi_channels; i++) {
         if (synth->channel[i] == NULL) {
             FLUID_LOG(FLUID_ERR, "Channels don't exist (yet)!");
@@ -2208,6 +3332,7 @@ int fluid_synth_create_key_tuning(fluid_synth_t *synth, int bank, int prog,
     }
     if (pitch) {
         fluid_tuning_set_all(tuning, pitch);
+        fluid_synth_clear_voice_cache(synth);
     }
     return FLUID_OK;
 }
@@ -2229,6 +3354,7 @@ int fluid_synth_create_octave_tuning(fluid_synth_t *synth, int bank, int prog,
         return FLUID_FAILED;
     }
     fluid_tuning_set_octave(tuning, pitch);
+    fluid_synth_clear_voice_cache(synth);
     return FLUID_OK;
 }
 
@@ -2278,6 +3404,7 @@ int fluid_synth_tune_notes(fluid_synth_t *synth, int bank, int prog, int len,
     for (i = 0; i < len; i++) {
         fluid_tuning_set_pitch(tuning, key[i], pitch[i]);
     }
+    fluid_synth_clear_voice_cache(synth);
 
     return FLUID_OK;
 }
@@ -2423,7 +3550,6 @@ int fluid_synth_set_gen(fluid_synth_t *synth, int chan, int param, float value)
 
  */
 int fluid_synth_set_gen2(fluid_synth_t *synth, int chan, int param, float value, int normalized) {
-    int i;
     fluid_voice_t *voice;
     float v;
 
@@ -2441,10 +3567,15 @@ int fluid_synth_set_gen2(fluid_synth_t *synth, int chan, int param, float value,
 
     fluid_channel_set_gen(synth->channel[chan], param, v);
 
-    for (i = 0; i < synth->polyphony; i++) {
-        voice = synth->voice[i];
-        if (voice->chan == chan) {
-            fluid_voice_set_param(voice, param, v);
+    fluid_synth_foreach_voice(voice, &synth->chan_voices[chan], chan_link) {
+        fluid_voice_set_param(voice, param, v);
+        /* moves the voice into or out of the exclusive class voices */
+        if (param == GEN_EXCLUSIVECLASS && _GEN(voice, GEN_EXCLUSIVECLASS) != 0) {
+            if (voice->excl_link.next == NULL) {
+                fluid_voice_link(&synth->excl_voices[chan], &voice->excl_link);
+            }
+        } else if (param == GEN_EXCLUSIVECLASS) {
+            fluid_voice_unlink(&voice->excl_link);
         }
     }
 
@@ -2504,6 +3635,7 @@ int fluid_synth_stop(fluid_synth_t *synth, unsigned int id) {
         if (_ON(voice) && (fluid_voice_get_id(voice) == id)) {
             count++;
             fluid_voice_noteoff(voice);
+            fluid_synth_update_voice(synth, voice);
             status = FLUID_OK;
         }
     }
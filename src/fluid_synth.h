@@ -11,6 +11,12 @@
 #include "fluid_rev.h"
 #include "fluid_chorus.h"
 #include "fluid_voice.h"
+#include "fluid_render_pool.h"
+#include "fluid_event_ring.h"
+#include "fluid_voice_cache.h"
+#include "fluid_sample_pager.h"
+#include "fluid_sample_stream.h"
+#include "fluid_sfont_registry.h"
 
 /***************************************************************
  *
@@ -45,6 +51,9 @@ enum fluid_synth_status {
 
 typedef struct _fluid_bank_offset_t fluid_bank_offset_t;
 
+/* default capacity of the timestamped event queue */
+#define FLUID_EVENT_QUEUE_SIZE 128
+
 struct _fluid_bank_offset_t {
     int sfont_id;
     int offset;
@@ -65,6 +74,25 @@ struct _fluid_synth_t {
     fluid_channel_t **channel; /** the channels */
     int nvoice;                /** the length of the synthesis process array */
     fluid_voice_t **voice;     /** the synthesis processes */
+    fluid_voice_bank_t *voice_bank; /** per-block DSP state of the voices */
+    /** heads of the lookup lists of the playing voices, by channel, by
+        channel and key (chan * 128 + key % 128) and by channel for the
+        voices with an exclusive class */
+    fluid_voice_link_t *chan_voices;
+    fluid_voice_link_t *key_voices;
+    fluid_voice_link_t *excl_voices;
+    uint32_t *free_voices;       /** bit i set: voice[i] is available */
+    fluid_voice_t **steal_queue; /** binary heap of the playing voices, the
+                                     first one is stolen next */
+    int steal_count;
+    unsigned int steal_base; /** note id the ages in the steal queue count from */
+    bool voices_stale; /** voices may have changed while rendering since
+                           free_voices and steal_queue were built */
+    fluid_render_pool_t *render_pool; /** worker threads, NULL to render on the caller */
+    fluid_real_t *dry_buf; /** block_size samples per voice for
+                               fluid_voice_write_dry(), NULL to write the
+                               voices in one step */
+    fluid_voice_t **dry_voices; /** the voices with samples in dry_buf */
     unsigned int noteid; /** the id is incremented for every new note. it's used
                             for noteoff's  */
     unsigned int storeid;
@@ -72,15 +100,20 @@ struct _fluid_synth_t {
     /**< Shadow of chorus parameter: chorus number, level, speed, depth, type */
     double chorus_param[FLUID_CHORUS_PARAM_LAST];
 
-    fluid_real_t *left_buf;
-    fluid_real_t *right_buf;
-    fluid_real_t *fx_left_buf;
-    fluid_real_t *fx_right_buf;
-    fluid_real_t *fx_left_buf2;
-    fluid_real_t *fx_right_buf2;
+    fluid_bus_t *left_buf;
+    fluid_bus_t *right_buf;
+    fluid_bus_t *fx_left_buf;
+    fluid_bus_t *fx_right_buf;
+    fluid_bus_t *fx_left_buf2;
+    fluid_bus_t *fx_right_buf2;
+#ifdef WITH_FIXED
+    fluid_real_t *fx_scratch; /** 3 blocks: the reverb and chorus run in
+                                 fluid_real_t, see fluid_synth_fx_fixed */
+#endif
 
     fluid_revmodel_t *reverb;
     fluid_chorus_t *chorus;
+    int block_size; /** samples per block, the length of the audio buffers */
     int cur; /** the current sample in the audio buffers to be output */
 
     fluid_tuning_t ***tuning;   /** 128 banks of 128 programs for the tunings */
@@ -93,6 +126,35 @@ struct _fluid_synth_t {
     bool with_chorus;
     bool enable_reverb;  /** activate reverb in runtime */
     bool enable_chorus;
+
+    fluid_synth_event_t *events; /** timestamped events, ordered by frame */
+    int event_count;
+    int event_queue_size;
+    int event_offset; /** frame in the block of the event being played, 0
+                          for events sent with fluid_synth_noteon() etc. */
+    fluid_event_ring_t *event_ring; /** messages posted by other threads,
+                                        NULL without SynthParams.event_ring_size */
+    fluid_voice_cache_t *voice_cache; /** the voices of recent note-ons, NULL
+                                          without SynthParams.voice_cache_size */
+    unsigned int sample_cache_size;   /** bytes of sample data a paged SoundFont
+                                          keeps, 0 to load it all */
+    fluid_sample_preloader_t *preloader; /** pages in the presets of
+                                             fluid_synth_preload(), NULL
+                                             without sample_cache_size */
+    unsigned int stream_head_ms;         /** milliseconds of every sample a
+                                             streamed SoundFont keeps, 0 to
+                                             load it all */
+    fluid_sample_streamer_t *streamer;   /** reads the streamed samples of
+                                             the voices, NULL without
+                                             stream_head_ms */
+    bool share_sfonts;                   /** loads SoundFonts through the
+                                             registry of the process */
+    double smoothing_time; /** seconds the voices ramp the changes of their
+                               mix gains and attenuation over */
+
+    int silent_samples; /** samples of consecutive blocks without voices and with silent output */
+    bool idle;         /** no voices and the effect tails have decayed, the
+                           blocks are zeroed without running the effects */
 };
 
 /** returns 1 if the value has been set, 0 otherwise */
@@ -133,6 +195,15 @@ int fluid_synth_modulate_voices(fluid_synth_t *synth, int chan, int is_cc,
 int fluid_synth_modulate_voices_all(fluid_synth_t *synth, int chan);
 int fluid_synth_damp_voices(fluid_synth_t *synth, int chan);
 int fluid_synth_kill_voice(fluid_synth_t *synth, fluid_voice_t *voice);
+fluid_voice_t *fluid_synth_free_voice_by_kill(fluid_synth_t *synth);
+/* fluid_synth_alloc_voice() and fluid_synth_start_voice() for a voice
+ * cached by fluid_voice_cache_put(), see fluid_voice_cache.h */
+fluid_voice_t *fluid_synth_alloc_voice_from(fluid_synth_t *synth,
+                                            const fluid_voice_snapshot_t *snapshot,
+                                            fluid_sample_t *sample, int chan, int key,
+                                            int vel);
+void fluid_synth_start_voice_from(fluid_synth_t *synth, fluid_voice_t *voice,
+                                  const fluid_voice_snapshot_t *snapshot);
 void fluid_synth_kill_by_exclusive_class(fluid_synth_t *synth,
                                          fluid_voice_t *voice);
 void fluid_synth_release_voice_on_same_note(fluid_synth_t *synth, int chan,
@@ -5,6 +5,9 @@
 #include "fluid_chan.h"
 #include "fluid_conv.h"
 #include "fluid_synth.h"
+#include "fluid_env.h"
+#include "fluid_dsp_simd.h"
+#include "fluid_sample_stream.h"
 
 /* used for filter turn off optimization - if filter cutoff is above the
    specified value and filter q is below the other value, turn filter off */
@@ -24,27 +27,142 @@
 /* min vol envelope release (to stop clicks) in SoundFont timecents */
 #define FLUID_MIN_VOLENVRELEASE -7200.0f /* ~16ms */
 
+#ifdef WITH_FIXED
+#define fluid_voice_effects fluid_dsp_fixed_effects
+#else
 // removed inline
 static void fluid_voice_effects(fluid_voice_t *voice, int count,
                                 fluid_real_t *dsp_left_buf,
                                 fluid_real_t *dsp_right_buf,
                                 fluid_real_t *dsp_reverb_buf,
                                 fluid_real_t* dsp_chorus_buf);
+#endif
+
+/*
+ * new_fluid_voice_bank
+ */
+fluid_voice_bank_t *new_fluid_voice_bank(int size) {
+    fluid_voice_bank_t *bank;
+
+    bank = FLUID_NEW(fluid_voice_bank_t);
+    if (bank == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    FLUID_MEMSET(bank, 0, sizeof(fluid_voice_bank_t));
+    bank->size = size;
+
+#define BANK_ARRAY(_field, _t)                                                 \
+    bank->_field = FLUID_ARRAY(_t, size);                                      \
+    if (bank->_field == NULL) goto error_recovery;                             \
+    FLUID_MEMSET(bank->_field, 0, size * sizeof(_t));
+
+    BANK_ARRAY(phase, fluid_phase_t)
+    BANK_ARRAY(phase_incr, fluid_real_t)
+    BANK_ARRAY(amp, fluid_real_t)
+    BANK_ARRAY(amp_incr, fluid_real_t)
+    BANK_ARRAY(hist1, fluid_real_t)
+    BANK_ARRAY(hist2, fluid_real_t)
+    BANK_ARRAY(b02, fluid_real_t)
+    BANK_ARRAY(b1, fluid_real_t)
+    BANK_ARRAY(a1, fluid_real_t)
+    BANK_ARRAY(a2, fluid_real_t)
+    BANK_ARRAY(b02_incr, fluid_real_t)
+    BANK_ARRAY(b1_incr, fluid_real_t)
+    BANK_ARRAY(a1_incr, fluid_real_t)
+    BANK_ARRAY(a2_incr, fluid_real_t)
+    BANK_ARRAY(filter_coeff_incr_count, int)
+    BANK_ARRAY(amp_left, fluid_real_t)
+    BANK_ARRAY(amp_right, fluid_real_t)
+    BANK_ARRAY(amp_reverb, fluid_real_t)
+    BANK_ARRAY(amp_chorus, fluid_real_t)
+#undef BANK_ARRAY
+
+    return bank;
+
+error_recovery:
+    FLUID_LOG(FLUID_ERR, "Out of memory");
+    delete_fluid_voice_bank(bank);
+    return NULL;
+}
 
-fluid_voice_t *new_fluid_voice(fluid_real_t output_rate) {
+/*
+ * delete_fluid_voice_bank
+ */
+void delete_fluid_voice_bank(fluid_voice_bank_t *bank) {
+    if (bank == NULL) {
+        return;
+    }
+
+#define BANK_FREE(_field)                                                      \
+    if (bank->_field != NULL) FLUID_FREE(bank->_field);
+
+    BANK_FREE(phase)
+    BANK_FREE(phase_incr)
+    BANK_FREE(amp)
+    BANK_FREE(amp_incr)
+    BANK_FREE(hist1)
+    BANK_FREE(hist2)
+    BANK_FREE(b02)
+    BANK_FREE(b1)
+    BANK_FREE(a1)
+    BANK_FREE(a2)
+    BANK_FREE(b02_incr)
+    BANK_FREE(b1_incr)
+    BANK_FREE(a1_incr)
+    BANK_FREE(a2_incr)
+    BANK_FREE(filter_coeff_incr_count)
+    BANK_FREE(amp_left)
+    BANK_FREE(amp_right)
+    BANK_FREE(amp_reverb)
+    BANK_FREE(amp_chorus)
+#undef BANK_FREE
+
+    FLUID_FREE(bank);
+}
+
+/*
+ * new_fluid_voice
+ *
+ * The per-block DSP state of the voice lives in slot 'slot' of 'bank'.
+ * Every fluid_voice_write() renders 'block_size' samples.
+ */
+fluid_voice_t *new_fluid_voice(fluid_voice_bank_t *bank, int slot,
+                               fluid_real_t output_rate, int block_size) {
     fluid_voice_t *voice;
+
+    if (bank == NULL || slot < 0 || slot >= bank->size) {
+        FLUID_LOG(FLUID_ERR, "Invalid voice bank slot %d", slot);
+        return NULL;
+    }
+
     voice = FLUID_NEW(fluid_voice_t);
     if (voice == NULL) {
         FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
+    voice->bank = bank;
+    voice->slot = slot;
     voice->status = FLUID_VOICE_CLEAN;
     voice->chan = NO_CHANNEL;
     voice->key = 0;
     voice->vel = 0;
     voice->channel = NULL;
     voice->sample = NULL;
+    voice->stream = NULL;
     voice->output_rate = output_rate;
+    voice->block_size = block_size;
+    voice->env_step = block_size;
+    voice->smooth_samples = 0;
+    voice->filter_bypass = 0;
+    voice->filter_bypassed = 0;
+    voice->filter_fading = 0;
+    voice->filter_wet = 1.0f;
+    voice->filter_bypass_blocks = 0;
+    voice->chan_link.next = NULL;
+    voice->key_link.next = NULL;
+    voice->excl_link.next = NULL;
+    voice->steal_pos = -1;
 
     /* The 'sustain' and 'finished' segments of the volume / modulation
      * envelope are constant. They are never affected by any modulator
@@ -89,14 +207,10 @@ int delete_fluid_voice(fluid_voice_t *voice) {
     return FLUID_OK;
 }
 
-/* fluid_voice_init
- *
- * Initialize the synthesis process
- */
-int fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
-                     fluid_channel_t *channel, int key, int vel,
-                     unsigned int id, unsigned int start_time,
-                     fluid_real_t gain) {
+/* The 'working memory' of a voice for a new note, see fluid_voice_init() */
+static void fluid_voice_init_state(fluid_voice_t *voice, fluid_sample_t *sample,
+                                   fluid_channel_t *channel, int key, int vel,
+                                   unsigned int id, unsigned int start_time) {
     /* Note: The voice parameters will be initialized later, when the
      * generators have been retrieved from the sound font. Here, only
      * the 'working memory' of the voice (position in envelopes, history
@@ -109,22 +223,29 @@ int fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     voice->channel = channel;
     voice->mod_count = 0;
     voice->sample = sample;
+    if (voice->stream != NULL && sample != NULL && fluid_sample_is_streamed(sample)) {
+        fluid_sample_stream_start(voice->stream, sample);
+    }
     voice->start_time = start_time;
     voice->ticks = 0;
     voice->noteoff_ticks = 0;
+    voice->start_offset = 0;
     voice->has_looped = 0; /* Will be set during voice_write when the 2nd loop
                               point is reached */
     voice->last_fres = -1; /* The filter coefficients have to be calculated
                               later in the DSP loop. */
     voice->filter_startup = 1; /* Set the filter immediately, don't fade between
                                   old and new settings */
+    voice->filter_bypassed = 0;
+    voice->filter_fading = 0;
+    voice->filter_wet = 1.0f;
     voice->interp_method = fluid_channel_get_interp_method(voice->channel);
 
     /* vol env initialization */
     voice->volenv_count = 0;
     voice->volenv_section = 0;
     voice->volenv_val = 0.0f;
-    voice->amp = 0.0f; /* The last value of the volume envelope, used to
+    _DSP(voice, amp) = 0.0f; /* The last value of the volume envelope, used to
                           calculate the volume increment during
                           processing */
 
@@ -142,8 +263,19 @@ int fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     voice->viblfo_val = 0.0f; /* Fixme: See mod lfo */
 
     /* Clear sample history in filter */
-    voice->hist1 = 0;
-    voice->hist2 = 0;
+    _DSP(voice, hist1) = 0;
+    _DSP(voice, hist2) = 0;
+}
+
+/* fluid_voice_init
+ *
+ * Initialize the synthesis process
+ */
+int fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
+                     fluid_channel_t *channel, int key, int vel,
+                     unsigned int id, unsigned int start_time,
+                     fluid_real_t gain) {
+    fluid_voice_init_state(voice, sample, channel, key, vel, id, start_time);
 
     /* Set all the generators to their default value, according to SF
      * 2.01 section 8.1.3 (page 48). The value of NRPN messages are
@@ -190,45 +322,120 @@ fluid_real_t fluid_voice_gen_value(fluid_voice_t *voice, int num) {
 }
 
 /*
- * fluid_voice_write
- *
- * This is where it all happens. This function is called by the
- * synthesizer to generate the sound samples. The synthesizer passes
- * four audio buffers: left, right, reverb out, and chorus out.
+ * fluid_voice_below_noise_floor
  *
- * The biggest part of this function sets the correct values for all
- * the dsp parameters (all the control data boil down to only a few
- * dsp parameters). The dsp routine is #included in several places
- * (fluid_dsp_core.c).
+ * We turn off a voice, if the volume has dropped low enough. Only valid
+ * after the attack, while volenv_val can only drop.
  */
-_RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
-                      fluid_real_t *dsp_right_buf,
-                      fluid_real_t *dsp_reverb_buf, fluid_real_t *dsp_chorus_buf) {
-    fluid_real_t fres;
-    fluid_real_t target_amp; /* target amplitude */
-    int count;
+static int fluid_voice_below_noise_floor(fluid_voice_t *voice) {
+    fluid_real_t amplitude_that_reaches_noise_floor;
+    fluid_real_t amp_max;
 
-    fluid_real_t dsp_buf[FLUID_BUFSIZE];
-    fluid_env_data_t *env_data;
-    fluid_real_t x;
+    /* A voice can be turned off, when an estimate for the volume
+     * (upper bound) falls below that volume, that will drop the
+     * sample below the noise floor.
+     */
 
-    /* make sure we're playing and that we have sample data */
-    if (!_PLAYING(voice)) return FLUID_OK;
+    /* If the loop amplitude is known, we can use it if the voice loop is
+     * within the sample loop
+     */
 
-    /******************* sample **********************/
+    /* Is the playing pointer already in the loop? */
+    if (voice->has_looped)
+        amplitude_that_reaches_noise_floor =
+            voice->amplitude_that_reaches_noise_floor_loop;
+    else
+        amplitude_that_reaches_noise_floor =
+            voice->amplitude_that_reaches_noise_floor_nonloop;
+
+    /* voice->attenuation_min is a lower boundary for the attenuation
+     * now and in the future (possibly 0 in the worst case).  Now the
+     * amplitude of sample and volenv cannot exceed amp_max (since
+     * volenv_val can only drop):
+     */
 
-    if (voice->sample == NULL) {
-        fluid_voice_off(voice);
-        return FLUID_OK;
+    amp_max = fluid_cb2amp(voice->min_attenuation_cB) * voice->volenv_val;
+
+    /* And if amp_max is already smaller than the known amplitude,
+     * which will attenuate the sample below the noise floor, then we
+     * can safely turn off the voice. Duh. */
+    return amp_max < amplitude_that_reaches_noise_floor;
+}
+
+/* the attenuation the volume envelope uses */
+#define fluid_voice_attenuation(voice)                                         \
+    ((voice)->smooth_samples > 0 ? (voice)->smooth_attenuation.val : (voice)->attenuation)
+
+static FLUID_INLINE void fluid_smooth_jump(fluid_smooth_t *s, fluid_real_t val) {
+    s->val = s->target = val;
+    s->incr = 0.0f;
+    s->count = 0;
+}
+
+/* ramps from the value in use to 'target' in n samples */
+static FLUID_INLINE void fluid_smooth_start(fluid_smooth_t *s, fluid_real_t target, int n) {
+    s->target = target;
+    s->incr = (target - s->val) / n;
+    s->count = n;
+}
+
+static FLUID_INLINE void fluid_smooth_advance(fluid_smooth_t *s, int n) {
+    if (s->count == 0) return;
+    if (n >= s->count) {
+        fluid_smooth_jump(s, s->target);
+    } else {
+        s->val += s->incr * n;
+        s->count -= n;
     }
+}
 
-    if (voice->noteoff_ticks != 0 && voice->ticks >= voice->noteoff_ticks) {
-        fluid_voice_noteoff(voice);
+/* the parameters in use are the ones fluid_voice_update_param() set */
+static void fluid_voice_smooth_reset(fluid_voice_t *voice) {
+    fluid_smooth_jump(&voice->smooth_left, _DSP(voice, amp_left));
+    fluid_smooth_jump(&voice->smooth_right, _DSP(voice, amp_right));
+    fluid_smooth_jump(&voice->smooth_reverb, _DSP(voice, amp_reverb));
+    fluid_smooth_jump(&voice->smooth_chorus, _DSP(voice, amp_chorus));
+    fluid_smooth_jump(&voice->smooth_attenuation, voice->attenuation);
+}
+
+/*
+ * fluid_voice_smooth
+ *
+ * With smooth_samples, a controller doesn't change the mix gains and the
+ * attenuation at once: fluid_voice_update_param() only sets their targets
+ * and this starts the ramps to them, once per block. The mix gains share
+ * one ramp, so a pan moves the power between the sides in step, and go in
+ * fluid_voice_effects() sample by sample; the attenuation moves block by
+ * block with the amplitude ramp of the volume envelope.
+ */
+static void fluid_voice_smooth(fluid_voice_t *voice) {
+    int n = voice->smooth_samples;
+
+    if (_DSP(voice, amp_left) != voice->smooth_left.target ||
+        _DSP(voice, amp_right) != voice->smooth_right.target ||
+        _DSP(voice, amp_reverb) != voice->smooth_reverb.target ||
+        _DSP(voice, amp_chorus) != voice->smooth_chorus.target) {
+        fluid_smooth_start(&voice->smooth_left, _DSP(voice, amp_left), n);
+        fluid_smooth_start(&voice->smooth_right, _DSP(voice, amp_right), n);
+        fluid_smooth_start(&voice->smooth_reverb, _DSP(voice, amp_reverb), n);
+        fluid_smooth_start(&voice->smooth_chorus, _DSP(voice, amp_chorus), n);
     }
+    if (voice->attenuation != voice->smooth_attenuation.target) {
+        fluid_smooth_start(&voice->smooth_attenuation, voice->attenuation, n);
+    }
+}
 
-    /* Range checking for sample- and loop-related parameters
-     * Initial phase is calculated here*/
-    fluid_voice_check_sample_sanity(voice);
+/*
+ * fluid_voice_block_env
+ *
+ * Advances the envelopes and LFOs by one step (FLUID_ENV_BLOCK) and sets
+ * the amplitude ramp of the block. Returns 0 if the voice doesn't sound
+ * in this block.
+ */
+static int fluid_voice_block_env(fluid_voice_t *voice) {
+    fluid_real_t target_amp; /* target amplitude */
+    fluid_env_data_t *env_data;
+    fluid_real_t x;
 
     /******************* vol env **********************/
 
@@ -262,7 +469,7 @@ _RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
 
     if (voice->volenv_section == FLUID_VOICE_ENVFINISHED) {
         fluid_voice_off(voice);
-        return FLUID_OK;
+        return 0;
     }
 
     /******************* mod env **********************/
@@ -327,73 +534,191 @@ _RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
      */
 
     if (voice->volenv_section == FLUID_VOICE_ENVDELAY)
-        goto post_process; /* The volume amplitude is in hold phase. No sound is
-                              produced. */
+        return 0; /* The volume amplitude is in hold phase. No sound is
+                     produced. */
 
     if (voice->volenv_section == FLUID_VOICE_ENVATTACK) {
         /* the envelope is in the attack section: ramp linearly to max value.
          * A positive modlfo_to_vol should increase volume (negative
          * attenuation).
          */
-        target_amp = fluid_cb2amp(voice->attenuation) *
+        target_amp = fluid_cb2amp(fluid_voice_attenuation(voice)) *
                      fluid_cb2amp(voice->modlfo_val * -voice->modlfo_to_vol) *
                      voice->volenv_val;
     } else {
-        fluid_real_t amplitude_that_reaches_noise_floor;
-        fluid_real_t amp_max;
-
-        target_amp = fluid_cb2amp(voice->attenuation) *
+        target_amp = fluid_cb2amp(fluid_voice_attenuation(voice)) *
                      fluid_cb2amp(960.0f * (1.0f - voice->volenv_val) +
                                   voice->modlfo_val * -voice->modlfo_to_vol);
 
-        /* We turn off a voice, if the volume has dropped low enough. */
+        if (fluid_voice_below_noise_floor(voice)) {
+            fluid_voice_off(voice);
+            return 0;
+        }
+    }
 
-        /* A voice can be turned off, when an estimate for the volume
-         * (upper bound) falls below that volume, that will drop the
-         * sample below the noise floor.
-         */
+    /* Volume increment to go from voice->amp to target_amp in the samples
+     * the voice plays in this block */
+    _DSP(voice, amp_incr) =
+        (target_amp - _DSP(voice, amp)) / (voice->block_size - voice->start_offset);
 
-        /* If the loop amplitude is known, we can use it if the voice loop is
-         * within the sample loop
-         */
+    /* no volume and not changing? - No need to process */
+    if ((_DSP(voice, amp) == 0.0f) && (_DSP(voice, amp_incr) == 0.0f)) return 0;
 
-        /* Is the playing pointer already in the loop? */
-        if (voice->has_looped)
-            amplitude_that_reaches_noise_floor =
-                voice->amplitude_that_reaches_noise_floor_loop;
-        else
-            amplitude_that_reaches_noise_floor =
-                voice->amplitude_that_reaches_noise_floor_nonloop;
-
-        /* voice->attenuation_min is a lower boundary for the attenuation
-         * now and in the future (possibly 0 in the worst case).  Now the
-         * amplitude of sample and volenv cannot exceed amp_max (since
-         * volenv_val can only drop):
-         */
+    return 1;
+}
 
-        amp_max = fluid_cb2amp(voice->min_attenuation_cB) * voice->volenv_val;
+/*
+ * fluid_voice_chunk_gain
+ *
+ * fluid_env_write_gain() for the n samples of a chunk, 'offset' samples
+ * after voice->ticks. A note-off due inside the chunk starts the release
+ * on its sample.
+ */
+static int fluid_voice_chunk_gain(fluid_voice_t *voice, fluid_real_t *gain, int n,
+                                  int offset) {
+    fluid_real_t amp = fluid_cb2amp(fluid_voice_attenuation(voice));
+    int at = (int)(voice->noteoff_ticks - voice->ticks) - offset;
+    int lead;
+
+    if (voice->noteoff_ticks == 0 || at <= 0 || at >= n) {
+        return fluid_env_write_gain(voice, gain, n, offset, amp);
+    }
 
-        /* And if amp_max is already smaller than the known amplitude,
-         * which will attenuate the sample below the noise floor, then we
-         * can safely turn off the voice. Duh. */
-        if (amp_max < amplitude_that_reaches_noise_floor) {
-            fluid_voice_off(voice);
-            goto post_process;
+    lead = fluid_env_write_gain(voice, gain, at, offset, amp);
+    voice->noteoff_ticks = 0;
+    fluid_voice_noteoff(voice);
+    if (lead == at) {
+        return at + fluid_env_write_gain(voice, gain + at, n - at, offset + at, amp);
+    }
+    fluid_env_write_gain(voice, gain + at, n - at, offset + at, amp);
+    return lead;
+}
+
+/*
+ * fluid_voice_render
+ *
+ * This is where it all happens. This function is called by the
+ * synthesizer to generate the sound samples. The synthesizer passes
+ * four audio buffers: left, right, reverb out, and chorus out.
+ *
+ * The biggest part of this function sets the correct values for all
+ * the dsp parameters (all the control data boil down to only a few
+ * dsp parameters). The dsp routine is #included in several places
+ * (fluid_dsp_core.c).
+ *
+ * With 'dry' (fluid_voice_write_dry()), the chunks are interpolated into
+ * dry at their place in the block and left there for
+ * fluid_voice_filter_dry() and fluid_voice_mix_dry().
+ */
+/* the filter is open and skipped, dsp_buf keeps the dry samples */
+#define fluid_voice_filter_skipped(voice)                                      \
+    ((voice)->filter_bypassed && !(voice)->filter_fading)
+
+/* the filter runs as usual, it isn't fading in or out */
+#define fluid_voice_filter_steady(voice)                                       \
+    (!(voice)->filter_bypassed && !(voice)->filter_fading)
+
+/*
+ * fluid_voice_check_bypass
+ *
+ * The filter is open when the cutoff is above the audible range and there
+ * is no resonance peak. An open filter fades out over one block and is
+ * then skipped; when modulation closes it again it starts from rest and
+ * fades in over one block. The state only changes here, between blocks.
+ */
+static void fluid_voice_check_bypass(fluid_voice_t *voice, fluid_real_t fres) {
+    bool open = fres > FLUID_MAX_AUDIBLE_FILTER_FC && voice->q_dB < FLUID_MIN_AUDIBLE_FILTER_Q;
+
+    if (open != voice->filter_bypassed) {
+        if (open && voice->filter_startup) {
+            /* open from the start, there is nothing to fade out */
+            voice->filter_wet = 0.0f;
+        } else {
+            if (!open && !voice->filter_fading) {
+                /* the coefficients are set directly, without fading from
+                 * the old ones */
+                _DSP(voice, hist1) = 0;
+                _DSP(voice, hist2) = 0;
+                voice->filter_startup = 1;
+                voice->last_fres = -1;
+            }
+            voice->filter_fading = 1;
         }
+        voice->filter_bypassed = open;
+    } else if (voice->filter_fading && voice->filter_wet == (open ? 0.0f : 1.0f)) {
+        voice->filter_fading = 0;
     }
+    if (fluid_voice_filter_skipped(voice)) voice->filter_bypass_blocks++;
+}
 
-    /* Volume increment to go from voice->amp to target_amp in FLUID_BUFSIZE
-     * steps */
-    voice->amp_incr = (target_amp - voice->amp) / FLUID_BUFSIZE;
+_RAMFUNC static int fluid_voice_render(fluid_voice_t *voice, fluid_bus_t *dsp_left_buf,
+                                       fluid_bus_t *dsp_right_buf,
+                                       fluid_bus_t *dsp_reverb_buf,
+                                       fluid_bus_t *dsp_chorus_buf, fluid_bus_t *dry) {
+    fluid_real_t fres;
+    int count, done, n, lead, first, streamed;
 
-    /* no volume and not changing? - No need to process */
-    if ((voice->amp == 0.0f) && (voice->amp_incr == 0.0f)) goto post_process;
+    fluid_bus_t dsp_buf[FLUID_BUFSIZE];
+    fluid_real_t gain[FLUID_BUFSIZE]; /* FLUID_ENV_SAMPLE */
+
+    /* make sure we're playing and that we have sample data */
+    if (!_PLAYING(voice)) return FLUID_OK;
+
+    /* a voice started by a timestamped note-on sounds from sample 'first'
+     * of its first block on */
+    first = voice->start_offset;
+
+    /******************* sample **********************/
+
+    if (voice->sample == NULL) {
+        fluid_voice_off(voice);
+        return FLUID_OK;
+    }
+    /* the interpolators read dsp_data, for a streamed sample it is mapped
+     * chunk by chunk */
+    voice->dsp_data = voice->sample->data;
+    streamed = voice->dsp_data == NULL && voice->stream != NULL &&
+               fluid_sample_is_streamed(voice->sample);
+    if (voice->dsp_data == NULL && !streamed) {
+        fluid_voice_off(voice);
+        return FLUID_OK;
+    }
+
+    if (voice->noteoff_ticks != 0 && voice->ticks >= voice->noteoff_ticks) {
+        voice->noteoff_ticks = 0;
+        fluid_voice_noteoff(voice);
+    }
+
+    /* Range checking for sample- and loop-related parameters
+     * Initial phase is calculated here*/
+    fluid_voice_check_sample_sanity(voice);
+
+    if (voice->smooth_samples > 0) fluid_voice_smooth(voice);
+
+    if (voice->env_step == 1) {
+        /* FLUID_ENV_SAMPLE: the volume envelope and the mod LFO advance
+         * sample by sample in fluid_env_write_gain() while the block is
+         * rendered, the interpolators run at unity gain */
+        if (voice->volenv_section == FLUID_VOICE_ENVFINISHED) {
+            fluid_voice_off(voice);
+            return FLUID_OK;
+        }
+        if (voice->volenv_section > FLUID_VOICE_ENVATTACK &&
+            fluid_voice_below_noise_floor(voice)) {
+            fluid_voice_off(voice);
+            goto post_process;
+        }
+        _DSP(voice, amp) = 1.0f;
+        _DSP(voice, amp_incr) = 0.0f;
+    } else if (!fluid_voice_block_env(voice)) {
+        goto post_process;
+    }
 
     /* Calculate the number of samples, that the DSP loop advances
      * through the original waveform with each step in the output
      * buffer. It is the ratio between the frequencies of original
      * waveform and output waveform.*/
-    voice->phase_incr =
+    _DSP(voice, phase_incr) =
         fluid_ct2hz_real(voice->pitch +
                          voice->modlfo_val * voice->modlfo_to_pitch +
                          voice->viblfo_val * voice->viblfo_to_pitch +
@@ -402,7 +727,7 @@ _RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
 
     /* if phase_incr is not advancing, set it to the minimum fraction value
      * (prevent stuckage) */
-    if (voice->phase_incr == 0) voice->phase_incr = 1;
+    if (_DSP(voice, phase_incr) == 0) _DSP(voice, phase_incr) = 1;
 
     /*************** resonant filter ******************/
 
@@ -429,8 +754,13 @@ _RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
     else if (fres < 5)
         fres = 5;
 
+    /* With filter_bypass, the filter is skipped while it is open. The
+     * clamped frequency is tested, so at lower sampling rates it stays the
+     * anti-aliasing filter. */
+    if (voice->filter_bypass) fluid_voice_check_bypass(voice, fres);
+
     /* if filter enabled and there is a significant frequency change.. */
-    if ((fabs(fres - voice->last_fres) > 0.01)) {
+    if (!fluid_voice_filter_skipped(voice) && (fabs(fres - voice->last_fres) > 0.01)) {
         /* The filter coefficients have to be recalculated (filter
          * parameters have changed). Recalculation for various reasons is
          * forced by setting last_fres to -1.  The flag filter_startup
@@ -472,74 +802,417 @@ _RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
             /* The filter is calculated, because the voice was started up.
              * In this case set the filter coefficients without delay.
              */
-            voice->a1 = a1_temp;
-            voice->a2 = a2_temp;
-            voice->b02 = b02_temp;
-            voice->b1 = b1_temp;
-            voice->filter_coeff_incr_count = 0;
+            _DSP(voice, a1) = a1_temp;
+            _DSP(voice, a2) = a2_temp;
+            _DSP(voice, b02) = b02_temp;
+            _DSP(voice, b1) = b1_temp;
+            _DSP(voice, filter_coeff_incr_count) = 0;
             voice->filter_startup = 0;
             // FLUID_LOG(FLUID_DBG, "Setting initial filter coefficients.");
         } else {
             /* The filter frequency is changed.  Calculate an increment
              * factor, so that the new setting is reached after one buffer
-             * length. x_incr is added to the current value FLUID_BUFSIZE
+             * length. x_incr is added to the current value block_size
              * times. The length is arbitrarily chosen. Longer than one
              * buffer will sacrifice some performance, though.  Note: If
              * the filter is still too 'grainy', then increase this number
              * at will.
              */
 
-#define FILTER_TRANSITION_SAMPLES (FLUID_BUFSIZE)
+#define FILTER_TRANSITION_SAMPLES (voice->block_size)
 
-            voice->a1_incr = (a1_temp - voice->a1) / FILTER_TRANSITION_SAMPLES;
-            voice->a2_incr = (a2_temp - voice->a2) / FILTER_TRANSITION_SAMPLES;
-            voice->b02_incr =
-                (b02_temp - voice->b02) / FILTER_TRANSITION_SAMPLES;
-            voice->b1_incr = (b1_temp - voice->b1) / FILTER_TRANSITION_SAMPLES;
+            _DSP(voice, a1_incr) =
+                (a1_temp - _DSP(voice, a1)) / FILTER_TRANSITION_SAMPLES;
+            _DSP(voice, a2_incr) =
+                (a2_temp - _DSP(voice, a2)) / FILTER_TRANSITION_SAMPLES;
+            _DSP(voice, b02_incr) =
+                (b02_temp - _DSP(voice, b02)) / FILTER_TRANSITION_SAMPLES;
+            _DSP(voice, b1_incr) =
+                (b1_temp - _DSP(voice, b1)) / FILTER_TRANSITION_SAMPLES;
             /* Have to add the increments filter_coeff_incr_count times. */
-            voice->filter_coeff_incr_count = FILTER_TRANSITION_SAMPLES;
+            _DSP(voice, filter_coeff_incr_count) = FILTER_TRANSITION_SAMPLES;
         }
         voice->last_fres = fres;
     }
 
     /*********************** run the dsp chain ************************
-     * The sample is mixed with the output buffer.
-     * The buffer has to be filled from 0 to FLUID_BUFSIZE-1.
-     * Depending on the position in the loop and the loop size, this
-     * may require several runs. */
+     * The sample is mixed with the output buffers.
+     * The block is rendered in chunks of up to FLUID_BUFSIZE samples
+     * through dsp_buf, with the parameters set above. Depending on the
+     * position in the loop and the loop size, a chunk may require
+     * several runs of the interpolator. */
 
     voice->dsp_buf = dsp_buf;
 
-    switch (voice->interp_method) {
-    case FLUID_INTERP_NONE:
-        count = fluid_dsp_float_interpolate_none(voice);
-        break;
-    case FLUID_INTERP_LINEAR:
-        count = fluid_dsp_float_interpolate_linear(voice);
-        break;
-    case FLUID_INTERP_4THORDER:
-    default:
-        count = fluid_dsp_float_interpolate_4th_order(voice);
-        break;
-    case FLUID_INTERP_7THORDER:
-        count = fluid_dsp_float_interpolate_7th_order (voice);
-        break;
-    }
+    for (done = first; done < voice->block_size; done += n) {
+        n = voice->block_size - done;
+        if (n > FLUID_BUFSIZE) n = FLUID_BUFSIZE;
+        lead = 0;
+        if (voice->env_step == 1) {
+            /* the sample starts when the delay section ends */
+            lead = fluid_voice_chunk_gain(voice, gain, n, done - first);
+            if (lead == n) continue;
+        }
+        voice->dsp_buf_size = n - lead;
+        if (dry != NULL) voice->dsp_buf = dry + done + lead;
+        if (streamed && fluid_sample_stream_map(voice, voice->dsp_buf_size) != FLUID_OK) {
+            fluid_voice_off(voice);
+            break;
+        }
 
-    if (count > 0)
-        fluid_voice_effects(voice, count, dsp_left_buf, dsp_right_buf,
-                            dsp_reverb_buf, dsp_chorus_buf);
+        switch (voice->interp_method) {
+        case FLUID_INTERP_NONE:
+            count = fluid_dsp_interpolate_none(voice);
+            break;
+        case FLUID_INTERP_LINEAR:
+            count = fluid_dsp_interpolate_linear(voice);
+            break;
+        case FLUID_INTERP_4THORDER:
+        default:
+            count = fluid_dsp_interpolate_4th_order(voice);
+            break;
+        case FLUID_INTERP_7THORDER:
+            count = fluid_dsp_interpolate_7th_order(voice);
+            break;
+        case FLUID_INTERP_SINC8:
+        case FLUID_INTERP_SINC16:
+        case FLUID_INTERP_SINC32:
+            count = fluid_dsp_interpolate_sinc(voice, voice->interp_method);
+            break;
+        }
+        if (streamed) fluid_sample_stream_unmap(voice);
 
-    /* turn off voice if short count (sample ended and not looping) */
-    if (count < FLUID_BUFSIZE) {
-        fluid_voice_off(voice);
+#ifndef WITH_FIXED
+        if (voice->env_step == 1) {
+            int k;
+            for (k = 0; k < count; k++) voice->dsp_buf[k] *= gain[lead + k];
+        }
+#endif
+
+        if (count > 0 && dry != NULL) {
+            /* blocks of one chunk, the samples are in one piece */
+            voice->dry_start = done + lead;
+            voice->dry_count = count;
+        } else if (count > 0)
+            fluid_voice_effects(voice, count, dsp_left_buf + done + lead,
+                                dsp_right_buf ? dsp_right_buf + done + lead : NULL,
+                                dsp_reverb_buf ? dsp_reverb_buf + done + lead : NULL,
+                                dsp_chorus_buf ? dsp_chorus_buf + done + lead : NULL);
+
+        /* turn off voice if short count (sample ended and not looping) or
+         * if the release ended within the chunk */
+        if (count < n - lead || voice->volenv_section == FLUID_VOICE_ENVFINISHED) {
+            fluid_voice_off(voice);
+            break;
+        }
     }
 
+    if (voice->env_step == 1) fluid_env_advance(voice, voice->block_size - first);
+
 post_process:
-    voice->ticks += FLUID_BUFSIZE;
+    fluid_smooth_advance(&voice->smooth_attenuation, voice->block_size - first);
+    voice->ticks += voice->block_size - first;
+    voice->start_offset = 0;
     return FLUID_OK;
 }
 
+_RAMFUNC int fluid_voice_write(fluid_voice_t *voice, fluid_bus_t *dsp_left_buf,
+                      fluid_bus_t *dsp_right_buf,
+                      fluid_bus_t *dsp_reverb_buf, fluid_bus_t *dsp_chorus_buf) {
+    return fluid_voice_render(voice, dsp_left_buf, dsp_right_buf, dsp_reverb_buf,
+                              dsp_chorus_buf, NULL);
+}
+
+#ifndef WITH_FIXED
+
+/* biquad state of a voice, kept in locals while a block is processed */
+typedef struct {
+    fluid_real_t hist1, hist2;
+    fluid_real_t a1, a2, b02, b1;
+    fluid_real_t a1_incr, a2_incr, b02_incr, b1_incr;
+} fluid_voice_filter_t;
+
+/* send gains and destinations of a block, the increments ramp the gains
+ * while the voice smooths a change (see fluid_voice_smooth) */
+typedef struct {
+    fluid_real_t amp_left, amp_right, amp_reverb, amp_chorus;
+    fluid_real_t left_incr, right_incr, reverb_incr, chorus_incr;
+    fluid_real_t *left_buf, *right_buf, *reverb_buf, *chorus_buf;
+} fluid_voice_mix_t;
+
+/*
+ * One pass over dsp_buf[start..end): filter every sample, then add it to
+ * all the destinations. The flags are constant at every call site, so
+ * each combination compiles to its own loop without branches on them.
+ *
+ * - filter: run the filter, otherwise dsp_buf holds filtered samples
+ * - mix: add the samples to the destinations, otherwise they go back to
+ *   dsp_buf (the filter of fluid_voice_filter_dry())
+ * - coeff_incr: add the coefficient increments after every sample
+ * - gain_incr: add the gain increments after every sample
+ * - centered: the voice is centered, amp_left is used for both sides.
+ *   Otherwise the sides with a gain of 0 are skipped.
+ * - reverb, chorus: the send buffer is there and the gain is not 0
+ */
+static inline __attribute__((always_inline)) void
+fluid_voice_effects_pass(fluid_voice_filter_t *f, fluid_voice_mix_t *m,
+                         fluid_real_t *dsp_buf, int start, int end,
+                         const int filter, const int mix,
+                         const int coeff_incr, const int gain_incr,
+                         const int centered, const int reverb, const int chorus) {
+    fluid_real_t hist1 = filter ? f->hist1 : 0, hist2 = filter ? f->hist2 : 0;
+    fluid_real_t a1 = filter ? f->a1 : 0, a2 = filter ? f->a2 : 0;
+    fluid_real_t b02 = filter ? f->b02 : 0, b1 = filter ? f->b1 : 0;
+    fluid_real_t amp_left = mix ? m->amp_left : 0, amp_right = mix ? m->amp_right : 0;
+    fluid_real_t amp_reverb = mix ? m->amp_reverb : 0, amp_chorus = mix ? m->amp_chorus : 0;
+    int left = mix && (centered || amp_left != 0.0 || m->left_incr != 0.0);
+    int right = mix && (centered || amp_right != 0.0 || m->right_incr != 0.0);
+    fluid_real_t centernode, out, v;
+    int i;
+
+    for (i = start; i < end; i++) {
+        if (filter) {
+            /* The filter is implemented in Direct-II form. */
+            centernode = dsp_buf[i] - a1 * hist1 - a2 * hist2;
+            out = b02 * (centernode + hist2) + b1 * hist1;
+            hist2 = hist1;
+            hist1 = centernode;
+
+            if (coeff_incr) {
+                a1 += f->a1_incr;
+                a2 += f->a2_incr;
+                b02 += f->b02_incr;
+                b1 += f->b1_incr;
+            }
+        } else {
+            out = dsp_buf[i];
+        }
+
+        if (!mix) {
+            dsp_buf[i] = out;
+            continue;
+        }
+
+        if (centered) {
+            v = amp_left * out;
+            m->left_buf[i] += v;
+            m->right_buf[i] += v;
+        } else {
+            if (left) m->left_buf[i] += amp_left * out;
+            if (right) m->right_buf[i] += amp_right * out;
+        }
+        if (reverb) m->reverb_buf[i] += amp_reverb * out;
+        if (chorus) m->chorus_buf[i] += amp_chorus * out;
+
+        if (gain_incr) {
+            amp_left += m->left_incr;
+            amp_right += m->right_incr;
+            amp_reverb += m->reverb_incr;
+            amp_chorus += m->chorus_incr;
+        }
+    }
+
+    if (filter) {
+        f->hist1 = hist1;
+        f->hist2 = hist2;
+        f->a1 = a1;
+        f->a2 = a2;
+        f->b02 = b02;
+        f->b1 = b1;
+    }
+    if (mix) {
+        m->amp_left = amp_left;
+        m->amp_right = amp_right;
+        m->amp_reverb = amp_reverb;
+        m->amp_chorus = amp_chorus;
+    }
+}
+
+/* The passes over a chunk: the filter ramps over its first n_incr
+ * samples, the gains over the first n_ramp. */
+static inline __attribute__((always_inline)) void
+fluid_voice_effects_chunk(fluid_voice_filter_t *f, fluid_voice_mix_t *m,
+                          fluid_real_t *dsp_buf, int n_incr, int n_ramp, int count,
+                          const int filter, const int mix, const int centered,
+                          const int reverb, const int chorus) {
+    int both = n_incr < n_ramp ? n_incr : n_ramp;
+    int i = 0;
+
+#define PASS(_start, _end, _coeff_incr, _gain_incr)                            \
+    fluid_voice_effects_pass(f, m, dsp_buf, _start, _end, filter, mix,         \
+                             filter && (_coeff_incr), mix && (_gain_incr),     \
+                             centered, reverb, chorus)
+
+    if (n_ramp > 0) {
+        if (both > 0) PASS(0, both, 1, 1);
+        if (n_incr > both) {
+            PASS(both, n_incr, 1, 0);
+            i = n_incr;
+        } else {
+            PASS(both, n_ramp, 0, 1);
+            i = n_ramp;
+        }
+    } else if (n_incr > 0) {
+        PASS(0, n_incr, 1, 0);
+        i = n_incr;
+    }
+    PASS(i, count, 0, 0);
+
+#undef PASS
+}
+
+/* The filter of the voice for the next count samples. Returns the
+ * samples its coefficients ramp over. */
+static FLUID_INLINE int fluid_voice_filter_load(fluid_voice_t *voice, fluid_voice_filter_t *f,
+                                                int count) {
+    int dsp_filter_coeff_incr_count = _DSP(voice, filter_coeff_incr_count);
+
+    f->hist1 = _DSP(voice, hist1);
+    f->hist2 = _DSP(voice, hist2);
+    f->a1 = _DSP(voice, a1);
+    f->a2 = _DSP(voice, a2);
+    f->b02 = _DSP(voice, b02);
+    f->b1 = _DSP(voice, b1);
+    f->a1_incr = _DSP(voice, a1_incr);
+    f->a2_incr = _DSP(voice, a2_incr);
+    f->b02_incr = _DSP(voice, b02_incr);
+    f->b1_incr = _DSP(voice, b1_incr);
+
+    /* Check for denormal number (too close to zero). */
+    if (fabs(f->hist1) < 1e-20)
+        f->hist1 = 0.0f; /* FIXME JMG - Is this even needed? */
+
+    /* While the filter is changing towards its new setting, the increments
+     * are added to the coefficients after each of the first
+     * filter_coeff_incr_count samples. */
+    if (dsp_filter_coeff_incr_count > 0) {
+        return dsp_filter_coeff_incr_count < count ? dsp_filter_coeff_incr_count : count;
+    }
+    return 0;
+}
+
+static FLUID_INLINE void fluid_voice_filter_store(fluid_voice_t *voice,
+                                                  const fluid_voice_filter_t *f, int count) {
+    _DSP(voice, hist1) = f->hist1;
+    _DSP(voice, hist2) = f->hist2;
+    _DSP(voice, a1) = f->a1;
+    _DSP(voice, a2) = f->a2;
+    _DSP(voice, b02) = f->b02;
+    _DSP(voice, b1) = f->b1;
+    if (_DSP(voice, filter_coeff_incr_count) > 0) {
+        _DSP(voice, filter_coeff_incr_count) -= count;
+    }
+}
+
+/* The gains of the voice for the next count samples. Returns the variant
+ * of fluid_voice_effects_pass to mix with (centered | reverb << 1 |
+ * chorus << 2), and in n_ramp the samples the gains ramp over. */
+static FLUID_INLINE int fluid_voice_mix_load(fluid_voice_t *voice, fluid_voice_mix_t *m,
+                                             int count, fluid_real_t *dsp_left_buf,
+                                             fluid_real_t *dsp_right_buf,
+                                             fluid_real_t *dsp_reverb_buf,
+                                             fluid_real_t *dsp_chorus_buf, int *n_ramp) {
+    int centered, reverb, chorus;
+
+    *n_ramp = 0;
+    if (voice->smooth_samples > 0) {
+        m->amp_left = voice->smooth_left.val;
+        m->amp_right = voice->smooth_right.val;
+        m->amp_reverb = voice->smooth_reverb.val;
+        m->amp_chorus = voice->smooth_chorus.val;
+        m->left_incr = voice->smooth_left.incr;
+        m->right_incr = voice->smooth_right.incr;
+        m->reverb_incr = voice->smooth_reverb.incr;
+        m->chorus_incr = voice->smooth_chorus.incr;
+        *n_ramp = voice->smooth_left.count < count ? voice->smooth_left.count : count;
+    } else {
+        m->amp_left = _DSP(voice, amp_left);
+        m->amp_right = _DSP(voice, amp_right);
+        m->amp_reverb = _DSP(voice, amp_reverb);
+        m->amp_chorus = _DSP(voice, amp_chorus);
+    }
+    if (*n_ramp == 0) {
+        m->left_incr = m->right_incr = m->reverb_incr = m->chorus_incr = 0.0f;
+    }
+    if (fluid_voice_filter_skipped(voice)) {
+        /* the gain of the filter in its pass band, see GEN_FILTERQ */
+        m->amp_left *= voice->filter_gain;
+        m->amp_right *= voice->filter_gain;
+        m->amp_reverb *= voice->filter_gain;
+        m->amp_chorus *= voice->filter_gain;
+        m->left_incr *= voice->filter_gain;
+        m->right_incr *= voice->filter_gain;
+        m->reverb_incr *= voice->filter_gain;
+        m->chorus_incr *= voice->filter_gain;
+    }
+    m->left_buf = dsp_left_buf;
+    m->right_buf = dsp_right_buf;
+    m->reverb_buf = dsp_reverb_buf;
+    m->chorus_buf = dsp_chorus_buf;
+
+    /* The voice panning generator has a range of -500 .. 500.  If it is
+     * centered, it's close to 0.  amp_left and amp_right are then the
+     * same, and we can save one multiplication per voice and sample,
+     * unless the sides are still ramping to it.
+     * Reverb and chorus buffers may be NULL. */
+    centered = (-0.5 < voice->pan) && (voice->pan < 0.5) && *n_ramp == 0;
+    reverb = (dsp_reverb_buf != NULL) && (m->amp_reverb != 0.0 || m->reverb_incr != 0.0);
+    chorus = (dsp_chorus_buf != NULL) && (m->amp_chorus != 0 || m->chorus_incr != 0);
+    return centered | reverb << 1 | chorus << 2;
+}
+
+static FLUID_INLINE void fluid_voice_mix_store(fluid_voice_t *voice, int count) {
+    if (voice->smooth_samples > 0) {
+        fluid_smooth_advance(&voice->smooth_left, count);
+        fluid_smooth_advance(&voice->smooth_right, count);
+        fluid_smooth_advance(&voice->smooth_reverb, count);
+        fluid_smooth_advance(&voice->smooth_chorus, count);
+    }
+}
+
+/* The filter while it fades out or in: dsp_buf gets the dry samples
+ * crossfaded with the filtered ones. Once it is skipped, dsp_buf is left
+ * as it is and the mix applies the gain of the filter. */
+static void fluid_voice_filter_fade(fluid_voice_t *voice, fluid_real_t *dsp_buf, int count) {
+    fluid_real_t wet[FLUID_BUFSIZE];
+    fluid_real_t w = voice->filter_wet, incr = 1.0f / voice->block_size;
+    fluid_real_t gain = voice->filter_gain, dry;
+    fluid_voice_filter_t f;
+    int i, n_incr;
+
+    if (fluid_voice_filter_skipped(voice)) return;
+    if (voice->filter_bypassed) incr = -incr;
+
+    FLUID_MEMCPY(wet, dsp_buf, count * sizeof(fluid_real_t));
+    n_incr = fluid_voice_filter_load(voice, &f, count);
+    fluid_voice_effects_chunk(&f, NULL, wet, n_incr, 0, count, 1, 0, 0, 0, 0);
+    fluid_voice_filter_store(voice, &f, count);
+
+    for (i = 0; i < count; i++) {
+        w += incr;
+        fluid_clip(w, 0.0f, 1.0f);
+        dry = gain * dsp_buf[i];
+        dsp_buf[i] = dry + w * (wet[i] - dry);
+    }
+    voice->filter_wet = w;
+}
+
+#define EFFECTS_PASS(_filter, _c, _r, _ch)                                     \
+    case (_c) | (_r) << 1 | (_ch) << 2:                                        \
+        fluid_voice_effects_chunk(&f, &m, dsp_buf, n_incr, n_ramp, count, _filter, 1, _c, \
+                                  _r, _ch);                                    \
+        break;
+
+#define EFFECTS_PASSES(_filter)                                                \
+    EFFECTS_PASS(_filter, 0, 0, 0)                                             \
+    EFFECTS_PASS(_filter, 1, 0, 0)                                             \
+    EFFECTS_PASS(_filter, 0, 1, 0)                                             \
+    EFFECTS_PASS(_filter, 1, 1, 0)                                             \
+    EFFECTS_PASS(_filter, 0, 0, 1)                                             \
+    EFFECTS_PASS(_filter, 1, 0, 1)                                             \
+    EFFECTS_PASS(_filter, 0, 1, 1)                                             \
+    EFFECTS_PASS(_filter, 1, 1, 1)
+
 /* Purpose:
  *
  * - filters (applies a lowpass filter with variable cutoff frequency and
@@ -547,145 +1220,169 @@ post_process:
  * - mixes the processed sample to left and right output using the pan setting
  * - sends the processed sample to chorus and reverb
  *
+ * All of it is done in a single pass over the block, see
+ * fluid_voice_effects_pass. The variant for the pan and the sends in use is
+ * selected once per block. While the filter fades or is skipped (see
+ * fluid_voice_check_bypass), the pass only mixes.
+ *
  * Variable description:
- * - dsp_data: Pointer to the original waveform data
  * - dsp_left_buf: The generated signal goes here, left channel
  * - dsp_right_buf: right channel
  * - dsp_reverb_buf: Send to reverb unit
  * - dsp_chorus_buf: Send to chorus unit
- * - dsp_a1: Coefficient for the filter
- * - dsp_a2: same
- * - dsp_b0: same
- * - dsp_b1: same
- * - dsp_b2: same
  * - voice holds the voice structure
- *
- * A couple of variables are used internally, their results are discarded:
- * - dsp_i: Index through the output buffer
- * - dsp_phase_fractional: The fractional part of dsp_phase
- * - dsp_coeff: A table of four coefficients, depending on the fractional phase.
- *              Used to interpolate between samples.
- * - dsp_process_buffer: Holds the processed signal between stages
- * - dsp_centernode: delay line for the IIR filter
- * - dsp_hist1: same
- * - dsp_hist2: same
- *
  */
 _RAMFUNC static void fluid_voice_effects(fluid_voice_t *voice, int count,
                                 fluid_real_t *dsp_left_buf,
                                 fluid_real_t *dsp_right_buf,
                                 fluid_real_t* dsp_reverb_buf, 
                                 fluid_real_t* dsp_chorus_buf) {
-    /* IIR filter sample history */
-    fluid_real_t dsp_hist1 = voice->hist1;
-    fluid_real_t dsp_hist2 = voice->hist2;
-
-    /* IIR filter coefficients */
-    fluid_real_t dsp_a1 = voice->a1;
-    fluid_real_t dsp_a2 = voice->a2;
-    fluid_real_t dsp_b02 = voice->b02;
-    fluid_real_t dsp_b1 = voice->b1;
-    fluid_real_t dsp_a1_incr = voice->a1_incr;
-    fluid_real_t dsp_a2_incr = voice->a2_incr;
-    fluid_real_t dsp_b02_incr = voice->b02_incr;
-    fluid_real_t dsp_b1_incr = voice->b1_incr;
-    int dsp_filter_coeff_incr_count = voice->filter_coeff_incr_count;
-
     fluid_real_t *dsp_buf = voice->dsp_buf;
+    fluid_voice_filter_t f;
+    fluid_voice_mix_t m;
+    int n_incr, n_ramp;
+
+    if (!fluid_voice_filter_steady(voice)) {
+        fluid_voice_filter_fade(voice, dsp_buf, count);
+        n_incr = 0;
+        switch (fluid_voice_mix_load(voice, &m, count, dsp_left_buf, dsp_right_buf,
+                                     dsp_reverb_buf, dsp_chorus_buf, &n_ramp)) {
+            EFFECTS_PASSES(0)
+        }
+        fluid_voice_mix_store(voice, count);
+        return;
+    }
 
-    fluid_real_t dsp_centernode;
-    int dsp_i;
-    float v;
+    n_incr = fluid_voice_filter_load(voice, &f, count);
+    switch (fluid_voice_mix_load(voice, &m, count, dsp_left_buf, dsp_right_buf,
+                                 dsp_reverb_buf, dsp_chorus_buf, &n_ramp)) {
+        EFFECTS_PASSES(1)
+    }
+    fluid_voice_mix_store(voice, count);
+    fluid_voice_filter_store(voice, &f, count);
+}
 
-    /* filter (implement the voice filter according to SoundFont standard) */
+#ifdef FLUID_DSP_SIMD
 
-    /* Check for denormal number (too close to zero). */
-    if (fabs(dsp_hist1) < 1e-20)
-        dsp_hist1 = 0.0f; /* FIXME JMG - Is this even needed? */
+int fluid_voice_write_dry(fluid_voice_t *voice, fluid_real_t *dry) {
+    voice->dry_count = 0;
+    return fluid_voice_render(voice, NULL, NULL, NULL, NULL, dry);
+}
 
-    /* Two versions of the filter loop. One, while the filter is
-     * changing towards its new setting. The other, if the filter
-     * doesn't change.
-     */
+/* the filter of one voice over its dry samples */
+static void fluid_voice_filter_one(fluid_voice_t *voice) {
+    fluid_voice_filter_t f;
+    int count = voice->dry_count;
+    int n_incr = fluid_voice_filter_load(voice, &f, count);
 
-    if (dsp_filter_coeff_incr_count > 0) {
-        /* Increment is added to each filter coefficient filter_coeff_incr_count
-         * times. */
-        for (dsp_i = 0; dsp_i < count; dsp_i++) {
-            /* The filter is implemented in Direct-II form. */
-            dsp_centernode =
-                dsp_buf[dsp_i] - dsp_a1 * dsp_hist1 - dsp_a2 * dsp_hist2;
-            dsp_buf[dsp_i] =
-                dsp_b02 * (dsp_centernode + dsp_hist2) + dsp_b1 * dsp_hist1;
-            dsp_hist2 = dsp_hist1;
-            dsp_hist1 = dsp_centernode;
-
-            if (dsp_filter_coeff_incr_count-- > 0) {
-                dsp_a1 += dsp_a1_incr;
-                dsp_a2 += dsp_a2_incr;
-                dsp_b02 += dsp_b02_incr;
-                dsp_b1 += dsp_b1_incr;
-            }
-        }  /* for dsp_i */
-    } else /* The filter parameters are constant.  This is duplicated to save
-              time. */
-    {
-        for (dsp_i = 0; dsp_i < count;
-             dsp_i++) { /* The filter is implemented in Direct-II form. */
-            dsp_centernode =
-                dsp_buf[dsp_i] - dsp_a1 * dsp_hist1 - dsp_a2 * dsp_hist2;
-            dsp_buf[dsp_i] =
-                dsp_b02 * (dsp_centernode + dsp_hist2) + dsp_b1 * dsp_hist1;
-            dsp_hist2 = dsp_hist1;
-            dsp_hist1 = dsp_centernode;
-        }
+    fluid_voice_effects_chunk(&f, NULL, voice->dsp_buf, n_incr, 0, count, 1, 0, 0, 0, 0);
+    fluid_voice_filter_store(voice, &f, count);
+}
+
+/* the filters of 'lanes' voices with the same dry samples, side by side */
+static void fluid_voice_filter_lanes(fluid_voice_t **voices, int lanes,
+                                     fluid_dsp_simd_biquad_t biquad) {
+    fluid_dsp_biquad_lanes_t l;
+    fluid_voice_filter_t f;
+    int k, count = voices[0]->dry_count;
+
+    for (k = 0; k < lanes; k++) {
+        l.n_incr[k] = fluid_voice_filter_load(voices[k], &f, count);
+        l.buf[k] = voices[k]->dsp_buf;
+        l.hist1[k] = f.hist1;
+        l.hist2[k] = f.hist2;
+        l.a1[k] = f.a1;
+        l.a2[k] = f.a2;
+        l.b02[k] = f.b02;
+        l.b1[k] = f.b1;
+        l.a1_incr[k] = f.a1_incr;
+        l.a2_incr[k] = f.a2_incr;
+        l.b02_incr[k] = f.b02_incr;
+        l.b1_incr[k] = f.b1_incr;
     }
 
-    /* pan (Copy the signal to the left and right output buffer) The voice
-     * panning generator has a range of -500 .. 500.  If it is centered,
-     * it's close to 0.  voice->amp_left and voice->amp_right are then the
-     * same, and we can save one multiplication per voice and sample.
-     */
-    if ((-0.5 < voice->pan) && (voice->pan < 0.5)) {
-        /* The voice is centered. Use voice->amp_left twice. */
-        for (dsp_i = 0; dsp_i < count; dsp_i++) {
-            v = voice->amp_left * dsp_buf[dsp_i];
-            dsp_left_buf[dsp_i] += v;
-            dsp_right_buf[dsp_i] += v;
+    biquad(&l, count);
+
+    for (k = 0; k < lanes; k++) {
+        f.hist1 = l.hist1[k];
+        f.hist2 = l.hist2[k];
+        f.a1 = l.a1[k];
+        f.a2 = l.a2[k];
+        f.b02 = l.b02[k];
+        f.b1 = l.b1[k];
+        fluid_voice_filter_store(voices[k], &f, count);
+    }
+}
+
+/*
+ * fluid_voice_filter_dry
+ *
+ * The voices that rendered the whole block are filtered by the vector
+ * kernels, 8 or 4 at a time, the others and the rest one by one. The
+ * voices with the filter skipped are left out.
+ */
+void fluid_voice_filter_dry(fluid_voice_t **voices, int n) {
+    fluid_voice_t *full[FLUID_DSP_SIMD_LANES_MAX];
+    int lanes = fluid_dsp_simd.biquad8 != NULL ? 8 : 4;
+    int i, k, nfull = 0;
+
+    for (i = 0; i < n; i++) {
+        fluid_voice_t *voice = voices[i];
+
+        if (voice->dry_count == 0) continue;
+        if (!fluid_voice_filter_steady(voice)) {
+            fluid_voice_filter_fade(voice, voice->dsp_buf, voice->dry_count);
+            continue;
         }
-    } else /* The voice is not centered. Stereo samples have one side zero. */
-    {
-        if (voice->amp_left != 0.0) {
-            for (dsp_i = 0; dsp_i < count; dsp_i++)
-                dsp_left_buf[dsp_i] += voice->amp_left * dsp_buf[dsp_i];
+        if (fluid_dsp_simd.biquad4 == NULL || voice->dry_start != 0 ||
+            voice->dry_count != voice->block_size) {
+            fluid_voice_filter_one(voice);
+            continue;
         }
-        if (voice->amp_right != 0.0) {
-            for (dsp_i = 0; dsp_i < count; dsp_i++)
-                dsp_right_buf[dsp_i] += voice->amp_right * dsp_buf[dsp_i];
+
+        full[nfull++] = voice;
+        if (nfull == lanes) {
+            fluid_voice_filter_lanes(full, lanes,
+                                     lanes == 8 ? fluid_dsp_simd.biquad8 : fluid_dsp_simd.biquad4);
+            nfull = 0;
         }
     }
 
-    /* reverb send. Buffer may be NULL. */
-    if ((dsp_reverb_buf != NULL) && (voice->amp_reverb != 0.0)) {
-        for (dsp_i = 0; dsp_i < count; dsp_i++)
-            dsp_reverb_buf[dsp_i] += voice->amp_reverb * dsp_buf[dsp_i];
+    for (k = 0; nfull - k >= 4; k += 4) {
+        fluid_voice_filter_lanes(full + k, 4, fluid_dsp_simd.biquad4);
     }
+    for (; k < nfull; k++) {
+        fluid_voice_filter_one(full[k]);
+    }
+}
 
-   /* chorus send. Buffer may be NULL. */
-   if ((dsp_chorus_buf != NULL) && (voice->amp_chorus != 0)){
-       for (dsp_i = 0; dsp_i < count; dsp_i++)
-           dsp_chorus_buf[dsp_i] += voice->amp_chorus * dsp_buf[dsp_i];
-   }
-
-    voice->hist1 = dsp_hist1;
-    voice->hist2 = dsp_hist2;
-    voice->a1 = dsp_a1;
-    voice->a2 = dsp_a2;
-    voice->b02 = dsp_b02;
-    voice->b1 = dsp_b1;
-    voice->filter_coeff_incr_count = dsp_filter_coeff_incr_count;
+_RAMFUNC void fluid_voice_mix_dry(fluid_voice_t *voice, fluid_real_t *dsp_left_buf,
+                                  fluid_real_t *dsp_right_buf, fluid_real_t *dsp_reverb_buf,
+                                  fluid_real_t *dsp_chorus_buf) {
+    fluid_real_t *dsp_buf = voice->dsp_buf;
+    int count = voice->dry_count, start = voice->dry_start;
+    int n_incr = 0, n_ramp;
+    fluid_voice_filter_t f;
+    fluid_voice_mix_t m;
+
+    if (count == 0) return;
+
+    switch (fluid_voice_mix_load(voice, &m, count, dsp_left_buf + start,
+                                 dsp_right_buf ? dsp_right_buf + start : NULL,
+                                 dsp_reverb_buf ? dsp_reverb_buf + start : NULL,
+                                 dsp_chorus_buf ? dsp_chorus_buf + start : NULL, &n_ramp)) {
+        EFFECTS_PASSES(0)
+    }
+    fluid_voice_mix_store(voice, count);
 }
 
+#endif /* FLUID_DSP_SIMD */
+
+#undef EFFECTS_PASSES
+#undef EFFECTS_PASS
+
+#endif /* WITH_FIXED */
+
 /*
  * fluid_voice_get_channel
  */
@@ -702,14 +1399,58 @@ void fluid_voice_start(fluid_voice_t *voice) {
      * used for the first time.*/
 
     fluid_voice_calculate_runtime_synthesis_parameters(voice);
+    fluid_voice_smooth_reset(voice);
 
     /* Force setting of the phase at the first DSP loop run
      * This cannot be done earlier, because it depends on modulators.*/
     voice->check_sample_sanity_flag = FLUID_SAMPLESANITY_STARTUP;
 
+    /* held until fluid_voice_off(), a voice never started holds nothing */
+    if (voice->sample != NULL) fluid_sample_incr_ref(voice->sample);
     voice->status = FLUID_VOICE_ON;
 }
 
+int fluid_voice_init_from(fluid_voice_t *voice, const fluid_voice_snapshot_t *snapshot,
+                          fluid_sample_t *sample, fluid_channel_t *channel, int key, int vel,
+                          unsigned int id, unsigned int start_time) {
+    fluid_voice_init_state(voice, sample, channel, key, vel, id, start_time);
+
+    /* the generators already hold the output of the modulators, the gain
+     * is among the parameters */
+    FLUID_MEMCPY(voice->gen, snapshot->gen, sizeof(voice->gen));
+    FLUID_MEMCPY(voice->mod, snapshot->mod, sizeof(voice->mod));
+    voice->mod_count = snapshot->mod_count;
+
+    return FLUID_OK;
+}
+
+void fluid_voice_start_from(fluid_voice_t *voice, const fluid_voice_snapshot_t *snapshot) {
+    voice->key = snapshot->key;
+    voice->vel = snapshot->vel;
+    FLUID_MEMCPY(&voice->pitch, snapshot->params, sizeof(snapshot->params));
+    _DSP(voice, amp_left) = snapshot->amp_left;
+    _DSP(voice, amp_right) = snapshot->amp_right;
+    _DSP(voice, amp_reverb) = snapshot->amp_reverb;
+    _DSP(voice, amp_chorus) = snapshot->amp_chorus;
+
+    voice->check_sample_sanity_flag = FLUID_SAMPLESANITY_STARTUP;
+    if (voice->sample != NULL) fluid_sample_incr_ref(voice->sample);
+    voice->status = FLUID_VOICE_ON;
+}
+
+void fluid_voice_save(fluid_voice_t *voice, fluid_voice_snapshot_t *snapshot) {
+    snapshot->key = voice->key;
+    snapshot->vel = voice->vel;
+    FLUID_MEMCPY(snapshot->gen, voice->gen, sizeof(snapshot->gen));
+    FLUID_MEMCPY(snapshot->mod, voice->mod, sizeof(snapshot->mod));
+    snapshot->mod_count = voice->mod_count;
+    FLUID_MEMCPY(snapshot->params, &voice->pitch, sizeof(snapshot->params));
+    snapshot->amp_left = _DSP(voice, amp_left);
+    snapshot->amp_right = _DSP(voice, amp_right);
+    snapshot->amp_reverb = _DSP(voice, amp_reverb);
+    snapshot->amp_chorus = _DSP(voice, amp_chorus);
+}
+
 /*
  * fluid_voice_calculate_runtime_synthesis_parameters
  *
@@ -720,6 +1461,61 @@ void fluid_voice_start(fluid_voice_t *voice) {
  * conversion will be done in the DSP function. This is the case, for
  * example, for the pitch since it is modulated by the controllers in
  * cents. */
+static void fluid_voice_add_mod_source(fluid_voice_t *voice, int src, int flags) {
+    if (flags & FLUID_MOD_CC) {
+        if (src < 128) voice->mod_cc_src[src >> 5] |= 1u << (src & 31);
+    } else if (src < 32) {
+        voice->mod_gc_src |= 1u << src;
+    }
+}
+
+/* does a modulator of the voice read the controller, as in
+ * fluid_mod_has_source() */
+#define fluid_voice_has_mod_source(voice, cc, ctrl)                                               \
+    ((cc) != 0 ? (ctrl) < 128 && ((voice)->mod_cc_src[(ctrl) >> 5] >> ((ctrl) & 31) & 1)       \
+               : (ctrl) < 32 && ((voice)->mod_gc_src >> (ctrl) & 1))
+
+/* Builds the graph fluid_voice_modulate() follows from a controller to
+ * the modulators that read it and on to their destination generators.
+ * The modulators of a generator are chained in the order of the voice,
+ * so their outputs add up as in
+ * fluid_voice_calculate_runtime_synthesis_parameters(). */
+static void fluid_voice_link_mods(fluid_voice_t *voice) {
+    int i, k;
+
+    FLUID_MEMSET(voice->mod_cc_src, 0, sizeof(voice->mod_cc_src));
+    voice->mod_gc_src = 0;
+
+    for (i = 0; i < voice->mod_count; i++) {
+        fluid_mod_t *mod = &voice->mod[i];
+
+        fluid_voice_add_mod_source(voice, mod->src1, mod->flags1);
+        fluid_voice_add_mod_source(voice, mod->src2, mod->flags2);
+
+        voice->mod_dest_first[i] = (int8_t)i;
+        voice->mod_dest_next[i] = -1;
+        for (k = i - 1; k >= 0; k--) {
+            if (fluid_mod_has_dest(&voice->mod[k], mod->dest)) {
+                voice->mod_dest_first[i] = voice->mod_dest_first[k];
+                voice->mod_dest_next[k] = (int8_t)i;
+                break;
+            }
+        }
+    }
+}
+
+/* the sum of the last outputs of the modulators of the destination of
+ * modulator i */
+static FLUID_INLINE fluid_real_t fluid_voice_mod_sum(fluid_voice_t *voice, int i) {
+    fluid_real_t modval = 0.0;
+    int k;
+
+    for (k = voice->mod_dest_first[i]; k >= 0; k = voice->mod_dest_next[k]) {
+        modval += voice->mod_val[k];
+    }
+    return modval;
+}
+
 int fluid_voice_calculate_runtime_synthesis_parameters(fluid_voice_t *voice) {
     int i;
 
@@ -795,12 +1591,14 @@ int fluid_voice_calculate_runtime_synthesis_parameters(fluid_voice_t *voice) {
      * fluid_gen_set_default_values.
      */
 
+    fluid_voice_link_mods(voice);
     for (i = 0; i < voice->mod_count; i++) {
         fluid_mod_t *mod = &voice->mod[i];
         fluid_real_t modval = fluid_mod_get_value(mod, voice->channel, voice);
         int dest_gen_index = mod->dest;
         fluid_gen_t *dest_gen = &voice->gen[dest_gen_index];
         dest_gen->mod += modval;
+        voice->mod_val[i] = modval;
         // fluid_dump_modulator(mod);
     }
 
@@ -902,11 +1700,11 @@ int calculate_hold_decay_buffers(fluid_voice_t *voice, int gen_base,
     }
 
     seconds = fluid_tc2sec(timecents);
-    /* Each DSP loop processes FLUID_BUFSIZE samples. */
+    /* Each envelope step covers env_step samples. */
 
     /* round to next full number of buffers */
     buffers = (int)(((fluid_real_t)voice->output_rate * seconds) /
-                        (fluid_real_t)FLUID_BUFSIZE +
+                        (fluid_real_t)voice->env_step +
                     0.5);
 
     return buffers;
@@ -941,9 +1739,9 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
     case GEN_PAN:
         /* range checking is done in the fluid_pan function */
         voice->pan = _GEN(voice, GEN_PAN);
-        voice->amp_left =
+        _DSP(voice, amp_left) =
             fluid_pan(voice->pan, 1) * voice->synth_gain / 32768.0f;
-        voice->amp_right =
+        _DSP(voice, amp_right) =
             fluid_pan(voice->pan, 0) * voice->synth_gain / 32768.0f;
         break;
 
@@ -972,14 +1770,14 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
         /* The generator unit is 'tenths of a percent'. */
         voice->reverb_send = _GEN(voice, GEN_REVERBSEND) / 1000.0f;
         fluid_clip(voice->reverb_send, 0.0, 1.0);
-        voice->amp_reverb = voice->reverb_send * voice->synth_gain / 32768.0f;
+        _DSP(voice, amp_reverb) = voice->reverb_send * voice->synth_gain / 32768.0f;
         break;
 
     case GEN_CHORUSSEND:
         /* The generator unit is 'tenths of a percent'. */
         voice->chorus_send = _GEN(voice, GEN_CHORUSSEND) / 1000.0f;
         fluid_clip(voice->chorus_send, 0.0, 1.0);
-        voice->amp_chorus = voice->chorus_send * voice->synth_gain / 32768.0f;
+        _DSP(voice, amp_chorus) = voice->chorus_send * voice->synth_gain / 32768.0f;
         break;
 
     case GEN_OVERRIDEROOTKEY:
@@ -1025,6 +1823,7 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
 
         /* Range: SF2.01 section 8.1.3 # 8 (convert from cB to dB => /10) */
         fluid_clip(q_dB, 0.0f, 96.0f);
+        voice->q_dB = (fluid_real_t)q_dB;
 
         /* Short version: Modify the Q definition in a way, that a Q of 0
          * dB leads to no resonance hump in the freq. response.
@@ -1088,27 +1887,27 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
         break;
 
     case GEN_MODLFOFREQ:
-        /* - the frequency is converted into a delta value, per buffer of
-         * FLUID_BUFSIZE samples
+        /* - the frequency is converted into a delta value, per step of
+         * env_step samples
          * - the delay into a sample delay
          */
         x = _GEN(voice, GEN_MODLFOFREQ);
         fluid_clip(x, -16000.0f, 4500.0f);
         voice->modlfo_incr =
-            (4.0f * FLUID_BUFSIZE * fluid_act2hz(x) / voice->output_rate);
+            (4.0f * voice->env_step * fluid_act2hz(x) / voice->output_rate);
         break;
 
     case GEN_VIBLFOFREQ:
         /* vib lfo
          *
-         * - the frequency is converted into a delta value, per buffer of
-         * FLUID_BUFSIZE samples
+         * - the frequency is converted into a delta value, per step of
+         * env_step samples
          * - the delay into a sample delay
          */
         x = _GEN(voice, GEN_VIBLFOFREQ);
         fluid_clip(x, -16000.0f, 4500.0f);
         voice->viblfo_incr =
-            (4.0f * FLUID_BUFSIZE * fluid_act2hz(x) / voice->output_rate);
+            (4.0f * voice->env_step * fluid_act2hz(x) / voice->output_rate);
         break;
 
     case GEN_VIBLFODELAY:
@@ -1219,12 +2018,14 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
 
         /* Conversion functions differ in range limit */
 #define NUM_BUFFERS_DELAY(_v)                                                  \
-    (unsigned int)(voice->output_rate * fluid_tc2sec_delay(_v) / FLUID_BUFSIZE)
+    (unsigned int)(voice->output_rate * fluid_tc2sec_delay(_v) /               \
+                   voice->env_step)
 #define NUM_BUFFERS_ATTACK(_v)                                                 \
-    (unsigned int)(voice->output_rate * fluid_tc2sec_attack(_v) / FLUID_BUFSIZE)
+    (unsigned int)(voice->output_rate * fluid_tc2sec_attack(_v) /              \
+                   voice->env_step)
 #define NUM_BUFFERS_RELEASE(_v)                                                \
     (unsigned int)(voice->output_rate * fluid_tc2sec_release(_v) /             \
-                   FLUID_BUFSIZE)
+                   voice->env_step)
 
         /* volume envelope
          *
@@ -1375,7 +2176,9 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
  *
  * - For every changed generator, calculate its new value. This is the
  * sum of its original value plus the values of al the attached
- * modulators.
+ * modulators. Only the modulators with the controller as a source are
+ * evaluated again, the others keep their last output. The generators
+ * are reached through the graph fluid_voice_link_mods() builds.
  *
  * - For every changed generator, convert its value to the correct
  * unit of the corresponding DSP parameter
@@ -1387,83 +2190,62 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen) {
  * @param ctrl the control number
  * */
 int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl) {
-    int i, k;
-    fluid_mod_t *mod;
-    int gen;
-    fluid_real_t modval;
+    int i, first;
+    unsigned int done = 0; /* destinations updated, by their first modulator */
 
     /*    printf("Chan=%d, CC=%d, Src=%d, Val=%d\n", voice->channel->channum,
      * cc, ctrl, val); */
 
+    if (!fluid_voice_has_mod_source(voice, cc, ctrl)) {
+        return FLUID_OK;
+    }
+
+    /* step 1: find all the modulators that have the changed controller
+     * as input source, only their output changes. */
     for (i = 0; i < voice->mod_count; i++) {
-        mod = &voice->mod[i];
+        if (fluid_mod_has_source(&voice->mod[i], cc, ctrl)) {
+            voice->mod_val[i] = fluid_mod_get_value(&voice->mod[i], voice->channel, voice);
+        }
+    }
 
-        /* step 1: find all the modulators that have the changed controller
-         * as input source. */
-        if (fluid_mod_has_source(mod, cc, ctrl)) {
-            gen = fluid_mod_get_dest(mod);
-            modval = 0.0;
-
-            /* step 2: for every changed modulator, calculate the modulation
-             * value of its associated generator */
-            for (k = 0; k < voice->mod_count; k++) {
-                if (fluid_mod_has_dest(&voice->mod[k], gen)) {
-                    modval += fluid_mod_get_value(&voice->mod[k],
-                                                  voice->channel, voice);
-                }
-            }
+    /* step 2: for every changed modulator, sum up the outputs of the
+     * modulators of its generator, once for each generator */
+    for (i = 0; i < voice->mod_count; i++) {
+        first = voice->mod_dest_first[i];
+        if (!fluid_mod_has_source(&voice->mod[i], cc, ctrl) || (done & (1u << first))) {
+            continue;
+        }
+        done |= 1u << first;
 
-            fluid_gen_set_mod(&voice->gen[gen], modval);
+        fluid_gen_set_mod(&voice->gen[voice->mod[i].dest], fluid_voice_mod_sum(voice, i));
 
-            /* step 3: now that we have the new value of the generator,
-             * recalculate the parameter values that are derived from the
-             * generator */
-            fluid_voice_update_param(voice, gen);
-        }
+        /* step 3: now that we have the new value of the generator,
+         * recalculate the parameter values that are derived from the
+         * generator */
+        fluid_voice_update_param(voice, voice->mod[i].dest);
     }
     return FLUID_OK;
 }
 
-/**
- * fluid_voice_modulate_all
- *
- * Update all the modulators. This function is called after a
- * ALL_CTRL_OFF MIDI message has been received (CC 121).
- *
- */
 int fluid_voice_modulate_all(fluid_voice_t *voice) {
-    fluid_mod_t *mod;
-    int i, k, gen;
-    fluid_real_t modval;
-
-    /* Loop through all the modulators.
+    int i;
 
-       FIXME: we should loop through the set of generators instead of
-       the set of modulators. We risk to call 'fluid_voice_update_param'
-       several times for the same generator if several modulators have
-       that generator as destination. It's not an error, just a wast of
-       energy (think polution, global warming, unhappy musicians,
-       ...) */
+    for (i = 0; i < voice->mod_count; i++) {
+        voice->mod_val[i] = fluid_mod_get_value(&voice->mod[i], voice->channel, voice);
+    }
 
+    /* Loop through the generators, in the order of their first
+     * modulator. */
     for (i = 0; i < voice->mod_count; i++) {
-        mod = &voice->mod[i];
-        gen = fluid_mod_get_dest(mod);
-        modval = 0.0;
-
-        /* Accumulate the modulation values of all the modulators with
-         * destination generator 'gen' */
-        for (k = 0; k < voice->mod_count; k++) {
-            if (fluid_mod_has_dest(&voice->mod[k], gen)) {
-                modval +=
-                    fluid_mod_get_value(&voice->mod[k], voice->channel, voice);
-            }
+        if (voice->mod_dest_first[i] != i) {
+            continue;
         }
 
-        fluid_gen_set_mod(&voice->gen[gen], modval);
+        fluid_gen_set_mod(&voice->gen[voice->mod[i].dest], fluid_voice_mod_sum(voice, i));
 
         /* Update the parameter values that are depend on the generator
          * 'gen' */
-        fluid_voice_update_param(voice, gen);
+        fluid_voice_update_param(voice, voice->mod[i].dest);
     }
 
     return FLUID_OK;
@@ -1511,6 +2293,24 @@ _RAMFUNC int fluid_voice_noteoff(fluid_voice_t *voice) {
     return FLUID_OK;
 }
 
+/*
+ * fluid_voice_noteoff_at
+ *
+ * A note-off 'offset' samples into the next block. With sample envelopes
+ * the release starts on that sample, with block envelopes on the nearest
+ * block boundary.
+ */
+int fluid_voice_noteoff_at(fluid_voice_t *voice, int offset) {
+    /* samples after the start of the voice, which may start in this block */
+    offset -= voice->start_offset;
+
+    if (voice->env_step != 1 && offset < voice->block_size / 2) offset = 0;
+    if (offset <= 0) return fluid_voice_noteoff(voice);
+
+    voice->noteoff_ticks = voice->ticks + offset;
+    return FLUID_OK;
+}
+
 /*
  * fluid_voice_kill_excl
  *
@@ -1560,6 +2360,11 @@ int fluid_voice_kill_excl(fluid_voice_t *voice) {
  * anymore by the DSP loop.
  */
 _RAMFUNC int fluid_voice_off(fluid_voice_t *voice) {
+    /* a paged sample can be dropped once no voice plays it */
+    if (!_AVAILABLE(voice) && voice->sample != NULL) {
+        fluid_sample_decr_ref(voice->sample);
+    }
+    if (voice->stream != NULL) fluid_sample_stream_stop(voice->stream);
     voice->chan = NO_CHANNEL;
     voice->volenv_section = FLUID_VOICE_ENVFINISHED;
     voice->volenv_count = 0;
@@ -1818,7 +2623,7 @@ void fluid_voice_check_sample_sanity(fluid_voice_t *voice) {
 
         /* Set the initial phase of the voice (using the result from the
      start offset modulators). */
-        fluid_phase_set_int(voice->phase, voice->start);
+        fluid_phase_set_int(_DSP(voice, phase), voice->start);
     } /* if startup */
 
     /* Is this voice run in loop mode, or does it run straight to the
@@ -1837,11 +2642,11 @@ void fluid_voice_check_sample_sanity(fluid_voice_t *voice) {
          * the sample, enter the loop and proceed as expected => no
          * actions required.
          */
-        int index_in_sample = fluid_phase_index(voice->phase);
+        int index_in_sample = fluid_phase_index(_DSP(voice, phase));
         if (index_in_sample >= voice->loopend) {
             /* FLUID_LOG(FLUID_DBG, "Loop / sample sanity check: Phase after 2nd
              * loop point!"); */
-            fluid_phase_set_int(voice->phase, voice->loopstart);
+            fluid_phase_set_int(_DSP(voice, phase), voice->loopstart);
         }
     }
     /*    FLUID_LOG(FLUID_DBG, "Loop / sample sanity check: Sample from %i to
@@ -1869,10 +2674,10 @@ int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain) {
     }
 
     voice->synth_gain = gain;
-    voice->amp_left = fluid_pan(voice->pan, 1) * gain / 32768.0f;
-    voice->amp_right = fluid_pan(voice->pan, 0) * gain / 32768.0f;
-    voice->amp_reverb = voice->reverb_send * gain / 32768.0f;
-    voice->amp_chorus = voice->chorus_send * gain / 32768.0f;
+    _DSP(voice, amp_left) = fluid_pan(voice->pan, 1) * gain / 32768.0f;
+    _DSP(voice, amp_right) = fluid_pan(voice->pan, 0) * gain / 32768.0f;
+    _DSP(voice, amp_reverb) = voice->reverb_send * gain / 32768.0f;
+    _DSP(voice, amp_chorus) = voice->chorus_send * gain / 32768.0f;
 
     return FLUID_OK;
 }
@@ -1949,4 +2754,53 @@ fluid_voice_set_output_rate(fluid_voice_t *voice, fluid_real_t value)
         fluid_voice_off(voice);
     }
     voice->output_rate = value;
-}
\ No newline at end of file
+}
+
+/* Steps the envelopes and LFOs once per block (FLUID_ENV_BLOCK) or once
+ * per sample (FLUID_ENV_SAMPLE). Like the output rate, it can only change
+ * while the voice is off. */
+void
+fluid_voice_set_env_mode(fluid_voice_t *voice, int mode)
+{
+    if(fluid_voice_is_playing(voice))
+    {
+        fluid_voice_off(voice);
+    }
+    voice->env_step = (mode == FLUID_ENV_SAMPLE) ? 1 : voice->block_size;
+}
+
+/* Ramps the changes of the mix gains and the attenuation over 'samples'
+ * samples, or applies them at the next block with 0. A ramp under way
+ * ends at once. */
+void
+fluid_voice_set_smoothing(fluid_voice_t *voice, int samples)
+{
+    voice->smooth_samples = samples > 0 ? samples : 0;
+    if(fluid_voice_is_playing(voice))
+    {
+        fluid_voice_smooth_reset(voice);
+    }
+}
+
+/* Skips the filter while the cutoff is above the audible range and the
+ * filter has no resonance peak, with a crossfade of one block when it
+ * starts or stops being skipped (see fluid_voice_check_bypass). */
+void
+fluid_voice_set_filter_bypass(fluid_voice_t *voice, int bypass)
+{
+    voice->filter_bypass = bypass != 0;
+    if(!voice->filter_bypass && fluid_voice_filter_skipped(voice))
+    {
+        /* back to the filter at once, from rest */
+        _DSP(voice, hist1) = 0;
+        _DSP(voice, hist2) = 0;
+        voice->filter_startup = 1;
+        voice->last_fres = -1;
+    }
+    if(!voice->filter_bypass)
+    {
+        voice->filter_bypassed = 0;
+        voice->filter_fading = 0;
+        voice->filter_wet = 1.0f;
+    }
+}
@@ -3,6 +3,7 @@
 #define _FLUID_VOICE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "fluid_phase.h"
 #include "fluid_gen.h"
 #include "fluid_mod.h"
@@ -39,6 +40,73 @@ enum fluid_voice_envelope_index_t {
     FLUID_VOICE_ENVLAST
 };
 
+/*
+ * Per-block DSP state of all the voices of a synth, as one array per
+ * field indexed by the voice slot. The render loop only touches these
+ * arrays (and a few voice fields), so it walks contiguous memory instead
+ * of the large voice structs, and the same field of neighbouring voices
+ * can be processed as one vector.
+ */
+struct _fluid_voice_bank_t {
+    int size; /* number of voice slots */
+
+    /* sample playback */
+    fluid_phase_t *phase;     /* the phase of the sample wave */
+    fluid_real_t *phase_incr; /* the phase increment for the next 64 samples */
+    fluid_real_t *amp;        /* current linear amplitude */
+    fluid_real_t *amp_incr;   /* amplitude increment value */
+
+    /* resonant filter */
+    fluid_real_t *hist1, *hist2; /* Sample history for the IIR filter */
+
+    /* filter coefficients */
+    /* The coefficients are normalized to a0. */
+    /* b0 and b2 are identical => b02 */
+    fluid_real_t *b02; /* b0 / a0 */
+    fluid_real_t *b1;  /* b1 / a0 */
+    fluid_real_t *a1;  /* a0 / a0 */
+    fluid_real_t *a2;  /* a1 / a0 */
+
+    fluid_real_t *b02_incr;
+    fluid_real_t *b1_incr;
+    fluid_real_t *a1_incr;
+    fluid_real_t *a2_incr;
+    int *filter_coeff_incr_count;
+
+    /* pan and effect sends */
+    fluid_real_t *amp_left;
+    fluid_real_t *amp_right;
+    fluid_real_t *amp_reverb;
+    fluid_real_t *amp_chorus;
+};
+
+fluid_voice_bank_t *new_fluid_voice_bank(int size);
+void delete_fluid_voice_bank(fluid_voice_bank_t *bank);
+
+/* Node of the lookup lists of the synth (channel, channel and key,
+ * exclusive class), circular with the list head as sentinel. next is
+ * NULL while the voice isn't in a list. */
+typedef struct _fluid_voice_link_t fluid_voice_link_t;
+struct _fluid_voice_link_t {
+    fluid_voice_link_t *next;
+    fluid_voice_link_t *prev;
+};
+
+#define fluid_voice_from_link(_link, _field)                                                       \
+    ((fluid_voice_t *)((char *)(_link) - offsetof(fluid_voice_t, _field)))
+
+/* A parameter ramping to the value fluid_voice_update_param() set last,
+ * see fluid_voice_smooth() */
+typedef struct {
+    fluid_real_t val;    /* the value in use */
+    fluid_real_t incr;   /* added per sample while count > 0 */
+    fluid_real_t target; /* the value it ramps to */
+    int count;           /* samples left to the target */
+} fluid_smooth_t;
+
+/* DSP state 'field' of a voice, kept in its voice bank */
+#define _DSP(voice, field) ((voice)->bank->field[(voice)->slot])
+
 struct _fluid_voice_t {
     unsigned int id; /* the id is incremented for every new noteon.
         it's used for noteoff's  */
@@ -55,23 +123,61 @@ struct _fluid_voice_t {
                      parameters have to be checked. */
 
     fluid_sample_t *sample;
+    fluid_sample_stream_t *stream; /* reads a streamed sample ahead of the
+                                      phase, NULL without
+                                      SynthParams.stream_head_ms */
     fluid_real_t output_rate; /* the sample rate of the synthesizer */
+    int block_size;           /* samples per fluid_voice_write(), the control period */
+    unsigned int env_step;    /* samples per step of the envelopes and LFOs:
+                                 block_size, or 1 for FLUID_ENV_SAMPLE */
+    int smooth_samples;       /* samples the changes of the mix gains and the
+                                 attenuation ramp over, 0 to jump */
+    bool filter_bypass;       /* skip the filter while it is open, see
+                                 fluid_voice_set_filter_bypass() */
 
     unsigned int start_time;
     unsigned int ticks;
     unsigned int noteoff_ticks; /* Delay note-off until this tick */
-
-    fluid_real_t amp;    /* current linear amplitude */
-    fluid_phase_t phase; /* the phase of the sample wave */
+    int start_offset;           /* samples into its first block the voice
+                                   starts at, for timestamped note-ons */
+
+    /* lookup lists of the synth, see fluid_synth_start_voice() */
+    fluid_voice_link_t chan_link;
+    fluid_voice_link_t key_link;
+    fluid_voice_link_t excl_link;
+
+    /* place in the steal queue of the synth, -1 if not in it, see
+     * fluid_synth_free_voice_by_kill() */
+    int steal_pos;
+    double steal_prio;
+
+    /* per-block DSP state in the synth's voice bank, see _DSP() */
+    fluid_voice_bank_t *bank;
+    int slot;
+
+    /* the filter while filter_bypass skips it */
+    bool filter_bypassed;     /* it is open: fading out or skipped */
+    bool filter_fading;       /* it fades out or in over this block */
+    fluid_real_t filter_wet;  /* the share of the filtered samples, 1 while
+                                 the filter runs, 0 while it is skipped */
+    unsigned int filter_bypass_blocks; /* blocks rendered without the filter
+                                          since the voice was created */
 
     /* Temporary variables used in fluid_voice_write() */
 
-    fluid_real_t phase_incr; /* the phase increment for the next 64 samples */
-    fluid_real_t amp_incr;   /* amplitude increment value */
-    fluid_real_t *dsp_buf;   /* buffer to store interpolated sample data to */
+    fluid_bus_t *dsp_buf;    /* buffer to store interpolated sample data to */
+    short *dsp_data;         /* the sample data the interpolators read: the
+                                sample's, or the window of a streamed one
+                                with the points of the chunk */
+    unsigned int dsp_buf_size; /* samples the interpolator fills in dsp_buf */
+    int dry_start;             /* the samples fluid_voice_write_dry() left in */
+    int dry_count;             /* its buffer, dry_count is 0 for none */
 
     /* End temporary variables */
 
+    /* From here to the end: the parameters fluid_voice_init() and
+     * fluid_voice_start() set up, see fluid_voice_snapshot_t */
+
     /* basic parameters */
     fluid_real_t pitch;              /* the pitch in midicents */
     fluid_real_t attenuation;        /* the attenuation in centibels */
@@ -108,7 +214,7 @@ struct _fluid_voice_t {
     /* mod lfo */
     fluid_real_t modlfo_val;   /* the value of the modulation LFO */
     unsigned int modlfo_delay; /* the delay of the lfo in samples */
-    fluid_real_t modlfo_incr;  /* the lfo frequency is converted to a per-buffer
+    fluid_real_t modlfo_incr;  /* the lfo frequency is converted to a per-block
                                   increment */
     fluid_real_t modlfo_to_fc;
     fluid_real_t modlfo_to_pitch;
@@ -117,7 +223,7 @@ struct _fluid_voice_t {
     /* vib lfo */
     fluid_real_t viblfo_val;   /* the value of the vibrato LFO */
     unsigned int viblfo_delay; /* the delay of the lfo in samples */
-    fluid_real_t viblfo_incr;  /* the lfo frequency is converted to a per-buffer
+    fluid_real_t viblfo_incr;  /* the lfo frequency is converted to a per-block
                                   increment */
     fluid_real_t viblfo_to_pitch;
 
@@ -126,54 +232,95 @@ struct _fluid_voice_t {
     fluid_real_t last_fres; /* Current resonance frequency of the IIR filter */
     /* Serves as a flag: A deviation between fres and last_fres */
     /* indicates, that the filter has to be recalculated. */
+    fluid_real_t q_dB;         /* the height of the resonance peak in dB */
     fluid_real_t q_lin;        /* the q-factor on a linear scale */
     fluid_real_t filter_gain;  /* Gain correction factor, depends on q */
-    fluid_real_t hist1, hist2; /* Sample history for the IIR filter */
     bool filter_startup;    /* Flag: If set, the filter will be set directly. Else it changes
                                   smoothly. */
 
-    /* filter coefficients */
-    /* The coefficients are normalized to a0. */
-    /* b0 and b2 are identical => b02 */
-    fluid_real_t b02; /* b0 / a0 */
-    fluid_real_t b1;  /* b1 / a0 */
-    fluid_real_t a1;  /* a0 / a0 */
-    fluid_real_t a2;  /* a1 / a0 */
-
-    fluid_real_t b02_incr;
-    fluid_real_t b1_incr;
-    fluid_real_t a1_incr;
-    fluid_real_t a2_incr;
-    int filter_coeff_incr_count;
-
     /* pan */
     fluid_real_t pan;
-    fluid_real_t amp_left;
-    fluid_real_t amp_right;
 
     /* reverb */
     fluid_real_t reverb_send;
-    fluid_real_t amp_reverb;
 
     /* chorus */
     fluid_real_t chorus_send;
-    fluid_real_t amp_chorus;
 
     /* interpolation method, as in fluid_interp in fluidliter.h */
     uint8_t interp_method;
+
+    /* The modulators by source and destination, see fluid_voice_modulate():
+     * a bit for each controller (cc) and each general controller (gc) any
+     * modulator reads; the first modulator with the destination of
+     * modulator i and the next one after i, -1 at the end; and the last
+     * output of each modulator. */
+    uint32_t mod_cc_src[4];
+    uint32_t mod_gc_src;
+    int8_t mod_dest_first[FLUID_NUM_MOD];
+    int8_t mod_dest_next[FLUID_NUM_MOD];
+    fluid_real_t mod_val[FLUID_NUM_MOD];
+
+    /* With smooth_samples, the mix gains the DSP loop runs at and the
+     * attenuation the volume envelope uses, see fluid_voice_smooth() */
+    fluid_smooth_t smooth_left;
+    fluid_smooth_t smooth_right;
+    fluid_smooth_t smooth_reverb;
+    fluid_smooth_t smooth_chorus;
+    fluid_smooth_t smooth_attenuation;
 };
 
-fluid_voice_t *new_fluid_voice(fluid_real_t output_rate);
+/* What a voice starts with: its generators and modulators, and the
+ * parameters worked out from them. Saved from a voice just started, it
+ * starts another voice of the same note without working them out again,
+ * see fluid_voice_cache.h */
+typedef struct {
+    unsigned char key; /* GEN_KEYNUM and GEN_VELOCITY may have replaced */
+    unsigned char vel; /* the ones of the note */
+    fluid_gen_t gen[GEN_LAST];
+    fluid_mod_t mod[FLUID_NUM_MOD];
+    uint8_t mod_count;
+    fluid_real_t amp_left;
+    fluid_real_t amp_right;
+    fluid_real_t amp_reverb;
+    fluid_real_t amp_chorus;
+    char params[sizeof(fluid_voice_t) - offsetof(fluid_voice_t, pitch)];
+} fluid_voice_snapshot_t;
+
+fluid_voice_t *new_fluid_voice(fluid_voice_bank_t *bank, int slot, fluid_real_t output_rate,
+                               int block_size);
 int delete_fluid_voice(fluid_voice_t *voice);
 
 void fluid_voice_start(fluid_voice_t *voice);
 
-int fluid_voice_write(fluid_voice_t *voice, fluid_real_t *left, fluid_real_t *right,
-                      fluid_real_t* reverb_buf, fluid_real_t* chorus_buf);
+int fluid_voice_write(fluid_voice_t *voice, fluid_bus_t *left, fluid_bus_t *right,
+                      fluid_bus_t *reverb_buf, fluid_bus_t *chorus_buf);
+
+/* fluid_voice_write() in three steps, so that the filters of several
+ * voices can run side by side (float builds with vector kernels, blocks of
+ * up to FLUID_BUFSIZE samples):
+ * - fluid_voice_write_dry() interpolates the block into 'dry', a buffer of
+ *   block_size samples, and sets dry_start and dry_count
+ * - fluid_voice_filter_dry() filters the dry samples of n voices in place
+ * - fluid_voice_mix_dry() adds them to the outputs, in the order the
+ *   voices would have been written */
+int fluid_voice_write_dry(fluid_voice_t *voice, fluid_real_t *dry);
+void fluid_voice_filter_dry(fluid_voice_t **voices, int n);
+void fluid_voice_mix_dry(fluid_voice_t *voice, fluid_real_t *left, fluid_real_t *right,
+                         fluid_real_t *reverb_buf, fluid_real_t *chorus_buf);
 
 int fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample, fluid_channel_t *channel,
                      int key, int vel, unsigned int id, unsigned int time, fluid_real_t gain);
 
+/* fluid_voice_init() and fluid_voice_start() with the generators,
+ * modulators and parameters of a snapshot */
+int fluid_voice_init_from(fluid_voice_t *voice, const fluid_voice_snapshot_t *snapshot,
+                          fluid_sample_t *sample, fluid_channel_t *channel, int key, int vel,
+                          unsigned int id, unsigned int time);
+void fluid_voice_start_from(fluid_voice_t *voice, const fluid_voice_snapshot_t *snapshot);
+/* the snapshot of a voice right after fluid_voice_start() */
+void fluid_voice_save(fluid_voice_t *voice, fluid_voice_snapshot_t *snapshot);
+
 int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl);
 int fluid_voice_modulate_all(fluid_voice_t *voice);
 
@@ -190,6 +337,7 @@ int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain);
 void fluid_voice_update_param(fluid_voice_t *voice, int gen);
 
 int fluid_voice_noteoff(fluid_voice_t *voice);
+int fluid_voice_noteoff_at(fluid_voice_t *voice, int offset);
 int fluid_voice_off(fluid_voice_t *voice);
 int fluid_voice_calculate_runtime_synthesis_parameters(fluid_voice_t *voice);
 fluid_channel_t *fluid_voice_get_channel(fluid_voice_t *voice);
@@ -236,7 +384,38 @@ int fluid_dsp_float_interpolate_none(fluid_voice_t *voice);
 int fluid_dsp_float_interpolate_linear(fluid_voice_t *voice);
 int fluid_dsp_float_interpolate_4th_order(fluid_voice_t *voice);
 int fluid_dsp_float_interpolate_7th_order (fluid_voice_t *voice);
+int fluid_dsp_float_interpolate_sinc(fluid_voice_t *voice, int taps);
+int fluid_dsp_float_sinc_config(int taps);
+
+#ifdef WITH_FIXED
+/* defined in fluid_dsp_fixed.c */
+
+void fluid_dsp_fixed_config(void);
+int fluid_dsp_fixed_interpolate_none(fluid_voice_t *voice);
+int fluid_dsp_fixed_interpolate_linear(fluid_voice_t *voice);
+int fluid_dsp_fixed_interpolate_4th_order(fluid_voice_t *voice);
+int fluid_dsp_fixed_interpolate_7th_order(fluid_voice_t *voice);
+int fluid_dsp_fixed_interpolate_sinc(fluid_voice_t *voice, int taps);
+void fluid_dsp_fixed_effects(fluid_voice_t *voice, int count, fluid_bus_t *dsp_left_buf,
+                             fluid_bus_t *dsp_right_buf, fluid_bus_t *dsp_reverb_buf,
+                             fluid_bus_t *dsp_chorus_buf);
+
+#define fluid_dsp_interpolate_none fluid_dsp_fixed_interpolate_none
+#define fluid_dsp_interpolate_linear fluid_dsp_fixed_interpolate_linear
+#define fluid_dsp_interpolate_4th_order fluid_dsp_fixed_interpolate_4th_order
+#define fluid_dsp_interpolate_7th_order fluid_dsp_fixed_interpolate_7th_order
+#define fluid_dsp_interpolate_sinc fluid_dsp_fixed_interpolate_sinc
+#else
+#define fluid_dsp_interpolate_none fluid_dsp_float_interpolate_none
+#define fluid_dsp_interpolate_linear fluid_dsp_float_interpolate_linear
+#define fluid_dsp_interpolate_4th_order fluid_dsp_float_interpolate_4th_order
+#define fluid_dsp_interpolate_7th_order fluid_dsp_float_interpolate_7th_order
+#define fluid_dsp_interpolate_sinc fluid_dsp_float_interpolate_sinc
+#endif
 
 void fluid_voice_set_output_rate(fluid_voice_t *voice, fluid_real_t value);
+void fluid_voice_set_env_mode(fluid_voice_t *voice, int mode);
+void fluid_voice_set_smoothing(fluid_voice_t *voice, int samples);
+void fluid_voice_set_filter_bypass(fluid_voice_t *voice, int bypass);
 
 #endif /* _FLUID_VOICE_H */
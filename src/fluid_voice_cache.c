@@ -0,0 +1,169 @@
+#include "fluid_voice_cache.h"
+#include "fluid_chan.h"
+
+typedef struct _fluid_voice_cache_entry_t fluid_voice_cache_entry_t;
+struct _fluid_voice_cache_entry_t {
+    /* the note, zone is NULL while the entry is unused */
+    const void *zone;
+    fluid_channel_t *channel;
+    unsigned int version; /* of the channel when the snapshot was saved */
+    unsigned char key;
+    unsigned char vel;
+
+    fluid_voice_cache_entry_t *hash_next; /* next entry of its bucket */
+    /* the use order, circular with the cache's lru as sentinel: from the
+     * most recently used to the least */
+    fluid_voice_cache_entry_t *next;
+    fluid_voice_cache_entry_t *prev;
+
+    fluid_voice_snapshot_t snapshot;
+};
+
+struct _fluid_voice_cache_t {
+    fluid_voice_cache_entry_t *entries;
+    int size;
+    fluid_voice_cache_entry_t **buckets; /* entries of a note by its hash */
+    unsigned int mask;                   /* buckets - 1 */
+    fluid_voice_cache_entry_t lru;
+    unsigned int hits;
+    unsigned int misses;
+};
+
+/* the version isn't part of the hash, the snapshot of a note saved with
+ * another one is replaced by the next put */
+static FLUID_INLINE unsigned int fluid_voice_cache_hash(const void *zone,
+                                                        fluid_channel_t *channel, int key,
+                                                        int vel) {
+    uintptr_t h = (uintptr_t)zone ^ ((uintptr_t)channel >> 4);
+    h ^= (uintptr_t)(key << 7 | vel) * 0x9e3779b1u;
+    return (unsigned int)(h ^ (h >> 16));
+}
+
+static FLUID_INLINE int fluid_voice_cache_is(fluid_voice_cache_entry_t *entry, const void *zone,
+                                             fluid_channel_t *channel, int key, int vel) {
+    return entry->zone == zone && entry->channel == channel && entry->key == key &&
+           entry->vel == vel;
+}
+
+static FLUID_INLINE fluid_voice_cache_entry_t **
+fluid_voice_cache_find(fluid_voice_cache_t *cache, const void *zone, fluid_channel_t *channel,
+                       int key, int vel) {
+    fluid_voice_cache_entry_t **e =
+        &cache->buckets[fluid_voice_cache_hash(zone, channel, key, vel) & cache->mask];
+    while (*e != NULL && !fluid_voice_cache_is(*e, zone, channel, key, vel)) {
+        e = &(*e)->hash_next;
+    }
+    return e;
+}
+
+static FLUID_INLINE void fluid_voice_cache_unlink(fluid_voice_cache_entry_t *entry) {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+}
+
+static FLUID_INLINE void fluid_voice_cache_link(fluid_voice_cache_entry_t *head,
+                                                fluid_voice_cache_entry_t *entry) {
+    entry->next = head->next;
+    entry->prev = head;
+    head->next->prev = entry;
+    head->next = entry;
+}
+
+fluid_voice_cache_t *new_fluid_voice_cache(int size) {
+    fluid_voice_cache_t *cache;
+    unsigned int n = 1;
+
+    /* about two buckets per entry */
+    while (n < 2 * (unsigned int)size) n <<= 1;
+
+    cache = FLUID_NEW(fluid_voice_cache_t);
+    if (cache == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+    FLUID_MEMSET(cache, 0, sizeof(fluid_voice_cache_t));
+
+    cache->entries = FLUID_ARRAY(fluid_voice_cache_entry_t, size);
+    cache->buckets = FLUID_ARRAY(fluid_voice_cache_entry_t *, n);
+    if (cache->entries == NULL || cache->buckets == NULL) {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_voice_cache(cache);
+        return NULL;
+    }
+    cache->size = size;
+    cache->mask = n - 1;
+    fluid_voice_cache_clear(cache);
+    return cache;
+}
+
+void delete_fluid_voice_cache(fluid_voice_cache_t *cache) {
+    if (cache == NULL) return;
+    FLUID_FREE(cache->entries);
+    FLUID_FREE(cache->buckets);
+    FLUID_FREE(cache);
+}
+
+void fluid_voice_cache_clear(fluid_voice_cache_t *cache) {
+    int i;
+
+    FLUID_MEMSET(cache->buckets, 0, (cache->mask + 1) * sizeof(fluid_voice_cache_entry_t *));
+    cache->lru.next = cache->lru.prev = &cache->lru;
+    for (i = 0; i < cache->size; i++) {
+        cache->entries[i].zone = NULL;
+        fluid_voice_cache_link(&cache->lru, &cache->entries[i]);
+    }
+}
+
+const fluid_voice_snapshot_t *fluid_voice_cache_get(fluid_voice_cache_t *cache,
+                                                    const void *zone,
+                                                    fluid_channel_t *channel, int key,
+                                                    int vel) {
+    fluid_voice_cache_entry_t *entry = *fluid_voice_cache_find(cache, zone, channel, key, vel);
+
+    if (entry == NULL || entry->version != channel->version) {
+        cache->misses++;
+        return NULL;
+    }
+
+    fluid_voice_cache_unlink(entry);
+    fluid_voice_cache_link(&cache->lru, entry);
+    cache->hits++;
+    return &entry->snapshot;
+}
+
+void fluid_voice_cache_put(fluid_voice_cache_t *cache, const void *zone,
+                           fluid_channel_t *channel, int key, int vel, fluid_voice_t *voice) {
+    fluid_voice_cache_entry_t **e = fluid_voice_cache_find(cache, zone, channel, key, vel);
+    fluid_voice_cache_entry_t *entry = *e;
+
+    if (entry == NULL) {
+        /* the least recently used entry moves to the bucket of the note */
+        entry = cache->lru.prev;
+        if (entry->zone != NULL) {
+            fluid_voice_cache_entry_t **old = fluid_voice_cache_find(
+                cache, entry->zone, entry->channel, entry->key, entry->vel);
+            *old = entry->hash_next;
+            /* the note's bucket may have been the same */
+            e = fluid_voice_cache_find(cache, zone, channel, key, vel);
+        }
+        entry->zone = zone;
+        entry->channel = channel;
+        entry->key = (unsigned char)key;
+        entry->vel = (unsigned char)vel;
+        entry->hash_next = NULL;
+        *e = entry;
+    }
+
+    entry->version = channel->version;
+    fluid_voice_save(voice, &entry->snapshot);
+    fluid_voice_cache_unlink(entry);
+    fluid_voice_cache_link(&cache->lru, entry);
+}
+
+unsigned int fluid_voice_cache_hits(fluid_voice_cache_t *cache) {
+    return cache->hits;
+}
+
+unsigned int fluid_voice_cache_misses(fluid_voice_cache_t *cache) {
+    return cache->misses;
+}
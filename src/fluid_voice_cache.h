@@ -0,0 +1,41 @@
+#ifndef _FLUID_VOICE_CACHE_H
+#define _FLUID_VOICE_CACHE_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_voice.h"
+
+/*
+ * Least recently used voices started by note-ons
+ * (SynthParams.voice_cache_size).
+ *
+ * A note-on that plays the same zone of a preset with the same key and
+ * velocity on a channel whose state hasn't changed starts the same voice:
+ * the cache keeps the snapshot of the last one, see
+ * fluid_voice_init_from() and fluid_voice_start_from(). Every change of a
+ * channel that can alter its voices (controllers, NRPNs, pressure, pitch
+ * bend, tuning, ...) bumps the channel's version, so the entries saved
+ * before miss; changes for all channels clear the cache.
+ */
+typedef struct _fluid_voice_cache_t fluid_voice_cache_t;
+
+fluid_voice_cache_t *new_fluid_voice_cache(int size);
+void delete_fluid_voice_cache(fluid_voice_cache_t *cache);
+
+/* the snapshot of the note, NULL if not cached */
+const fluid_voice_snapshot_t *fluid_voice_cache_get(fluid_voice_cache_t *cache,
+                                                    const void *zone,
+                                                    fluid_channel_t *channel, int key,
+                                                    int vel);
+
+/* keeps the voice just started for the note, in place of an older
+ * snapshot of the same note or else of the least recently used one */
+void fluid_voice_cache_put(fluid_voice_cache_t *cache, const void *zone,
+                           fluid_channel_t *channel, int key, int vel, fluid_voice_t *voice);
+
+void fluid_voice_cache_clear(fluid_voice_cache_t *cache);
+
+/* lookups that found their note and those that didn't */
+unsigned int fluid_voice_cache_hits(fluid_voice_cache_t *cache);
+unsigned int fluid_voice_cache_misses(fluid_voice_cache_t *cache);
+
+#endif /* _FLUID_VOICE_CACHE_H */
@@ -37,8 +37,10 @@ typedef uint32_t uintptr;
  *       FORWARD DECLARATIONS
  */
 typedef struct _fluid_env_data_t fluid_env_data_t;
+typedef struct _fluid_voice_bank_t fluid_voice_bank_t;
 typedef struct _fluid_channel_t fluid_channel_t;
 typedef struct _fluid_tuning_t fluid_tuning_t;
+typedef struct _fluid_sample_stream_t fluid_sample_stream_t;
 // typedef struct _fluid_hashtable_t fluid_hashtable_t;
 
 /***************************************************************
@@ -46,12 +48,51 @@ typedef struct _fluid_tuning_t fluid_tuning_t;
  *                      CONSTANTS
  */
 
+/* Default samples per fluid_synth_one_block (SynthParams.block_size), and
+ * the chunk the voice DSP loop works on. */
 #define FLUID_BUFSIZE 64
+#define FLUID_MIN_BUFSIZE 8
+#define FLUID_MAX_BUFSIZE 4096
 
 #ifndef PI
 #define PI 3.141592654
 #endif
 
+/*
+ * Mix buses and voice DSP buffers.
+ *
+ * With WITH_FIXED (make WITH_FIXED=1) the per-sample path - interpolation,
+ * biquad, panning, sends and mixing - runs on integers only, for parts
+ * without an FPU. The control path (envelopes, modulators, conversions)
+ * still runs once per block in fluid_real_t.
+ *
+ * - the mix buses hold Q23 integers, full scale 1.0 is 1 << 23, and the
+ *   voices are added with saturation
+ * - the voice DSP buffer holds the interpolated sample in 16 bit sample
+ *   units with FLUID_FIXED_DSP_BITS fractional bits
+ */
+#ifdef WITH_FIXED
+typedef int32_t fluid_bus_t;
+#define FLUID_FIXED_BUS_BITS 23
+#define FLUID_FIXED_DSP_BITS 8
+#define fluid_bus_to_real(_x) ((fluid_real_t)(_x) * (1.0f / (1 << FLUID_FIXED_BUS_BITS)))
+
+static inline int32_t fluid_real_to_bus(fluid_real_t x) {
+    x *= (fluid_real_t)(1 << FLUID_FIXED_BUS_BITS);
+    return x >= 2147483647.0f ? INT32_MAX : (x <= -2147483648.0f ? INT32_MIN : (int32_t)x);
+}
+
+/* a + b, saturated to the int32_t range */
+static inline int32_t fluid_fixed_add_sat(int32_t a, int32_t b) {
+    int64_t s = (int64_t)a + b;
+    return s > INT32_MAX ? INT32_MAX : (s < INT32_MIN ? INT32_MIN : (int32_t)s);
+}
+#else
+typedef fluid_real_t fluid_bus_t;
+#define fluid_bus_to_real(_x) (_x)
+#define fluid_real_to_bus(_x) (_x)
+#endif
+
 /***************************************************************
  *
  *                      SYSTEM INTERFACE
@@ -101,6 +142,8 @@ typedef FILE *fluid_file;
 #define FLUID_FSEEK(_f, _n, _set) fseek(_f, _n, _set)
 #define FLUID_FTELL(_f) ftell(_f)
 #define FLUID_MEMCPY(_dst, _src, _n) memcpy(_dst, _src, _n)
+#define FLUID_MEMMOVE(_dst, _src, _n) memmove(_dst, _src, _n)
+#define FLUID_MEMCMP(_s, _t, _n) memcmp(_s, _t, _n)
 #define FLUID_MEMSET(_s, _c, _n) memset(_s, _c, _n)
 #define FLUID_STRLEN(_s) strlen(_s)
 #define FLUID_STRCMP(_s, _t) strcmp(_s, _t)